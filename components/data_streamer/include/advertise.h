@@ -0,0 +1,174 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace data_streamer {
+
+/**
+ * Service discovery: the load and capabilities of a device, to be published as mDNS TXT records,
+ * so that gateways can tell busy devices from idle ones, and schedule their pulls accordingly.
+ */
+namespace advertise {
+inline constexpr char TXT_STREAMS[] = "streams";    ///< responses being streamed
+inline constexpr char TXT_SLOTS[] = "slots";        ///< further streams the device accepts
+inline constexpr char TXT_FORMATS[] = "formats";    ///< collection formats, comma-separated
+inline constexpr char TXT_FEATURES[] = "features";  ///< request features, comma-separated
+inline constexpr char TXT_PENDING[] = "pending";    ///< bytes waiting for an acknowledgement
+
+using TxtRecords = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * @brief Concept for streamers whose load and capabilities can be advertised (see DataStreamer)
+ */
+template<typename S>
+concept Advertised = requires(S &s) {
+    { s.active_streams() } -> std::convertible_to<int>;
+    { s.max_followers() } -> std::convertible_to<size_t>;
+    { S::formats() } -> std::convertible_to<std::string>;
+    { S::features() } -> std::convertible_to<std::string>;
+    { s.pending_bytes() } -> std::same_as<std::optional<uint64_t>>;
+};
+
+/**
+ * @brief Load and capabilities of a device, over all its advertised streamers
+ */
+struct Status {
+    int active_streams{0};
+    int max_streams{0};                    ///< streams served at once
+    int free_slots{0};
+    std::string formats;                   ///< comma-separated, without duplicates
+    std::string features;                  ///< comma-separated, without duplicates
+    std::optional<uint64_t> pending_bytes; ///< nullopt if no streamer knows it
+
+    /**
+     * @brief Gets the TXT records to publish (pending bytes only if known)
+     */
+    [[nodiscard]] TxtRecords txt() const {
+        TxtRecords records{
+            {TXT_STREAMS, std::to_string(active_streams)},
+            {TXT_SLOTS, std::to_string(free_slots)},
+            {TXT_FORMATS, formats},
+            {TXT_FEATURES, features},
+        };
+        if (pending_bytes) {
+            records.emplace_back(TXT_PENDING, std::to_string(*pending_bytes));
+        }
+        return records;
+    }
+};
+
+/**
+ * @brief Adds the items of a comma-separated list to another, skipping those already in it
+ */
+inline void merge_list(std::string &list, std::string_view items) {
+    while (!items.empty()) {
+        auto comma = items.find(',');
+        auto item = items.substr(0, comma);
+        items = comma == std::string_view::npos ? std::string_view{} : items.substr(comma + 1);
+        bool found = false;
+        for (std::string_view rest = list; !found && !rest.empty();) {
+            auto c = rest.find(',');
+            found = rest.substr(0, c) == item;
+            rest = c == std::string_view::npos ? std::string_view{} : rest.substr(c + 1);
+        }
+        if (!item.empty() && !found) {
+            if (!list.empty()) list += ',';
+            list += item;
+        }
+    }
+}
+
+/**
+ * @brief Collects the status of the streamers of a device, to be published periodically
+ *
+ * Publishing is left to the application, e.g. with ESP-IDF's mDNS component:
+ * @code
+ * static advertise::Advertiser advertiser;
+ * advertiser.add(dir_streamer);
+ * // then every few seconds:
+ * auto txt = advertiser.status().txt();
+ * std::vector<mdns_txt_item_t> items;
+ * for (auto &[key, value]: txt) items.push_back({key.c_str(), value.c_str()});
+ * mdns_service_txt_set("_https", "_tcp", items.data(), items.size());
+ * @endcode
+ */
+class Advertiser {
+public:
+    /**
+     * @param max_streams Number of streams the device serves at once; nullopt to derive it from the streamers
+     *                    (see set_max_streams())
+     */
+    explicit Advertiser(std::optional<int> max_streams = std::nullopt): max_streams{max_streams} {}
+
+    /**
+     * @brief Sets the number of streams the device serves at once, nullopt to derive it from the streamers
+     *
+     * ESP-IDF's HTTP server runs every handler in its single task, whatever its max_open_sockets: it streams
+     * one response at a time, and follow streams run in tasks of their own. So by default, the device serves
+     * one stream plus the max_followers() of the advertised streamers.
+     */
+    void set_max_streams(std::optional<int> max) {
+        max_streams = max;
+    }
+
+    /**
+     * @brief Adds a streamer, which must outlive the advertiser
+     */
+    template<Advertised S>
+    void add(S &streamer) {
+        sources.emplace_back([&streamer](Status &status) {
+            status.active_streams += streamer.active_streams();
+            status.max_streams += static_cast<int>(streamer.max_followers());
+            merge_list(status.formats, S::formats());
+            merge_list(status.features, S::features());
+            if (auto pending = streamer.pending_bytes()) {
+                status.pending_bytes = status.pending_bytes.value_or(0) + *pending;
+            }
+        });
+    }
+
+    /**
+     * @brief Gets the current status. Safe to call from any task.
+     */
+    [[nodiscard]] Status status() const {
+        Status status;
+        for (const auto &source: sources) {
+            source(status);
+        }
+        status.max_streams = max_streams.value_or(1 + status.max_streams);
+        status.free_slots = std::max(status.max_streams - status.active_streams, 0);
+        return status;
+    }
+
+private:
+    std::optional<int> max_streams;
+    std::vector<std::function<void(Status &)>> sources;
+};
+}  // namespace advertise
+
+}  // namespace data_streamer
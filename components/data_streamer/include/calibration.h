@@ -0,0 +1,324 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/stat.h>
+#include "config.h"
+#include "diag.h"
+#include "planner.h"
+#include "esp_log.h"
+
+
+/**
+ * Storage calibration: measures the mounted card once, and tunes file reads and query planning to it.
+ *
+ * Cards differ widely in open latency and in throughput at small read sizes. calibrate() times
+ * directory reads, stat(), open() and sequential reads of a probe file at several sizes, within a
+ * time budget, and picks:
+ * - the read size of file content, up to the chunk size (the buffer of each response): the largest one
+ *   about as fast as the fastest one, as some cards are slower at some sizes
+ * - the read-ahead: a stdio buffer per open file, if reads larger than the chunk size are much faster
+ *   (otherwise files are read directly into the chunk buffer, without prefetching)
+ * and the per-operation costs of the query planner (plan::cost_model()).
+ *
+ * Results are saved on the card itself (`<mount>/.ds_calibration`, one text line), so that they follow
+ * the card it was measured on: run_at_boot() calibrates a card the first time it's seen only.
+ */
+namespace data_streamer::calibration {
+
+inline constexpr char RESULT_FILE[] = ".ds_calibration";
+inline constexpr char PROBE_FILE[] = ".ds_probe";
+inline constexpr char RESULT_MAGIC[] = "DSCAL1";
+inline constexpr size_t PROBE_SIZE = 128 * 1024;
+inline constexpr std::array<size_t, 6> READ_SIZES{512, 1024, 2048, 4096, 8192, 16384};
+// Reads within this fraction of the best throughput are good enough
+inline constexpr double GOOD_ENOUGH = 0.9;
+// Repetitions of the open and stat measurements
+inline constexpr int LATENCY_SAMPLES = 8;
+
+/**
+ * @brief Runtime tuning of file reads, used by FileChunker
+ */
+struct Tuning {
+    size_t read_size{0};   ///< bytes per read of file content, at most the chunk size (0: the chunk size)
+    size_t read_ahead{0};  ///< stdio buffer of each open file (0: the C library's default)
+};
+
+/**
+ * @brief Tuning used by the file streamers
+ */
+inline Tuning &tuning() {
+    static Tuning t;
+    return t;
+}
+
+/**
+ * @brief Measurements of a card, and the tuning chosen from them
+ */
+struct Result {
+    std::array<double, READ_SIZES.size()> mb_per_s{};  ///< sequential read throughput per read size, 0 if not measured
+    double open_us{0};
+    double stat_us{0};
+    double readdir_us{0};
+    Tuning chosen{};
+
+    [[nodiscard]] std::string to_line() const {
+        std::string out = std::string(RESULT_MAGIC);
+        char field[48];
+        snprintf(field, sizeof(field), " %zu %zu %.1f %.1f %.1f", chosen.read_size, chosen.read_ahead,
+                 open_us, stat_us, readdir_us);
+        out += field;
+        for (double v: mb_per_s) {
+            snprintf(field, sizeof(field), " %.3f", v);
+            out += field;
+        }
+        return out + "\n";
+    }
+
+    static std::optional<Result> parse(const std::string &line) {
+        Result r;
+        char magic[8]{};
+        int consumed = 0;
+        if (sscanf(line.c_str(), "%7s %zu %zu %lf %lf %lf%n", magic, &r.chosen.read_size, &r.chosen.read_ahead,
+                   &r.open_us, &r.stat_us, &r.readdir_us, &consumed) != 6 || std::string_view(magic) != RESULT_MAGIC) {
+            return std::nullopt;
+        }
+        const char *p = line.c_str() + consumed;
+        for (double &v: r.mb_per_s) {
+            int n = 0;
+            if (sscanf(p, " %lf%n", &v, &n) != 1) {
+                return std::nullopt;
+            }
+            p += n;
+        }
+        return r;
+    }
+};
+
+/**
+ * @brief Chooses the tuning from the read throughputs
+ *
+ * @param mb_per_s Throughput per entry of READ_SIZES, 0 if not measured
+ * @param max_read_size Largest read size (the chunk size)
+ */
+inline Tuning choose(const std::array<double, READ_SIZES.size()> &mb_per_s, size_t max_read_size) {
+    Tuning t;
+    double best = 0;
+    size_t best_size = 0;
+    for (size_t i = 0; i < READ_SIZES.size(); i++) {
+        if (mb_per_s[i] > best) {
+            best = mb_per_s[i];
+            best_size = READ_SIZES[i];
+        }
+    }
+    if (best == 0) {
+        return t;
+    }
+    // reads up to the chunk size: the largest one about as fast as the fastest one
+    double direct = 0;
+    for (size_t i = 0; i < READ_SIZES.size() && READ_SIZES[i] <= max_read_size; i++) {
+        direct = std::max(direct, mb_per_s[i]);
+    }
+    for (size_t i = 0; i < READ_SIZES.size() && READ_SIZES[i] <= max_read_size; i++) {
+        if (direct > 0 && mb_per_s[i] >= GOOD_ENOUGH * direct) {
+            t.read_size = READ_SIZES[i];
+        }
+    }
+    if (direct < GOOD_ENOUGH * best) {
+        t.read_ahead = best_size;  // larger reads are much faster: prefetch in reads of the best size
+    }
+    return t;
+}
+
+/**
+ * @brief Reads a file sequentially in reads of a size, unbuffered
+ *
+ * @return double Throughput in MB/s, 0 on error
+ */
+inline double time_reads(const std::string &path, size_t read_size, std::span<char> buf) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return 0;
+    }
+    setvbuf(f, nullptr, _IONBF, 0);
+    size_t total = 0;
+    auto start = timing::clock::now();
+    while (size_t n = fread(buf.data(), 1, read_size, f)) {
+        total += n;
+    }
+    auto s = std::chrono::duration<double>(timing::clock::now() - start).count();
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok && s > 0 ? static_cast<double>(total) / s / 1e6 : 0;
+}
+
+/**
+ * @brief Measures the storage of a directory (e.g. a mount point)
+ *
+ * The probe file is written the first time. Read sizes are measured while the budget lasts.
+ *
+ * @param dir Directory to measure, writable
+ * @param budget Time budget
+ * @param max_read_size Largest read size (the chunk size)
+ * @return std::optional<Result> nullopt if the probe file can't be written or read
+ */
+inline std::optional<Result> calibrate(const std::string &dir, std::chrono::milliseconds budget,
+                                       size_t max_read_size = CHUNK_SIZE) {
+    using clock = timing::clock;
+    auto deadline = clock::now() + budget;
+    auto probe = dir + "/" + PROBE_FILE;
+    struct stat st{};
+    if (stat(probe.c_str(), &st) != 0 || static_cast<size_t>(st.st_size) != PROBE_SIZE) {
+        if (auto err = diag::write_test_file(probe, PROBE_SIZE)) {
+            ESP_LOGE(TAG, "Can't write probe %s, err %d", probe.c_str(), *err);
+            return std::nullopt;
+        }
+    }
+    Result r;
+    auto us_since = [](clock::time_point start, int n) {
+        return std::chrono::duration<double, std::micro>(clock::now() - start).count() / std::max(n, 1);
+    };
+
+    if (DIR *d = opendir(dir.c_str())) {
+        int entries = 0;
+        auto start = clock::now();
+        while (readdir(d) != nullptr) {
+            entries++;
+        }
+        r.readdir_us = us_since(start, entries);
+        closedir(d);
+    }
+    auto start = clock::now();
+    for (int i = 0; i < LATENCY_SAMPLES; i++) {
+        stat(probe.c_str(), &st);
+    }
+    r.stat_us = us_since(start, LATENCY_SAMPLES);
+    start = clock::now();
+    for (int i = 0; i < LATENCY_SAMPLES; i++) {
+        if (FILE *f = fopen(probe.c_str(), "rb")) {
+            fclose(f);
+        }
+    }
+    r.open_us = us_since(start, LATENCY_SAMPLES);
+
+    // sizes around the chunk size first, in case the budget runs out
+    std::array<size_t, READ_SIZES.size()> order;
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::ranges::stable_sort(order, {}, [&](size_t i) {
+        return READ_SIZES[i] > max_read_size ? READ_SIZES[i] / max_read_size : max_read_size / READ_SIZES[i];
+    });
+    auto buf = std::make_unique<char[]>(READ_SIZES.back());
+    for (size_t i: order) {
+        if (clock::now() >= deadline) {
+            ESP_LOGW(TAG, "Calibration budget exhausted");
+            break;
+        }
+        r.mb_per_s[i] = time_reads(probe, READ_SIZES[i], {buf.get(), READ_SIZES.back()});
+    }
+    if (std::ranges::all_of(r.mb_per_s, [](double v) { return v == 0; })) {
+        return std::nullopt;
+    }
+    r.chosen = choose(r.mb_per_s, max_read_size);
+    return r;
+}
+
+/**
+ * @brief Loads the result saved in a directory
+ */
+inline std::optional<Result> load(const std::string &dir) {
+    FILE *f = fopen((dir + "/" + RESULT_FILE).c_str(), "r");
+    if (f == nullptr) {
+        return std::nullopt;
+    }
+    char line[256]{};
+    bool ok = fgets(line, sizeof(line), f) != nullptr;
+    fclose(f);
+    return ok ? Result::parse(line) : std::nullopt;
+}
+
+/**
+ * @brief Saves a result in a directory
+ *
+ * @return std::optional<int> errno value on failure, nullopt otherwise
+ */
+inline std::optional<int> save(const std::string &dir, const Result &r) {
+    FILE *f = fopen((dir + "/" + RESULT_FILE).c_str(), "w");
+    if (f == nullptr) {
+        return errno;
+    }
+    auto line = r.to_line();
+    bool ok = fwrite(line.data(), 1, line.size(), f) == line.size();
+    int err = ok ? 0 : (errno ? errno : EIO);
+    if (fclose(f) != 0 && ok) {
+        err = errno;
+    }
+    return err ? std::optional(err) : std::nullopt;
+}
+
+/**
+ * @brief Uses a result: sets tuning() and the costs of plan::cost_model()
+ */
+inline void apply(const Result &r) {
+    tuning() = r.chosen;
+    auto &model = plan::cost_model();
+    if (r.open_us > 0) model.open_us = r.open_us;
+    if (r.stat_us > 0) model.stat_us = r.stat_us;
+    if (r.readdir_us > 0) model.readdir_us = r.readdir_us;
+}
+
+/**
+ * @brief Applies the saved result of the card mounted at a mount point, calibrating it first if there's none
+ *
+ * Example usage (after mounting the SD card):
+ * @code
+ * data_streamer::calibration::run_at_boot("/sdcard");
+ * @endcode
+ *
+ * @param mount_point Mount point of the card
+ * @param budget Time budget of a calibration
+ * @return std::optional<Result> The result applied, nullopt if the card couldn't be calibrated (defaults kept)
+ */
+inline std::optional<Result> run_at_boot(const std::string &mount_point,
+                                         std::chrono::milliseconds budget = std::chrono::milliseconds(CALIBRATION_BUDGET_MS)) {
+    auto r = load(mount_point);
+    if (!r) {
+        ESP_LOGI(TAG, "Calibrating %s...", mount_point.c_str());
+        r = calibrate(mount_point, budget);
+        if (!r) {
+            ESP_LOGW(TAG, "Can't calibrate %s, keeping defaults", mount_point.c_str());
+            return std::nullopt;
+        }
+        if (auto err = save(mount_point, *r)) {
+            ESP_LOGW(TAG, "Can't save the calibration of %s, err %d", mount_point.c_str(), *err);
+        }
+    }
+    ESP_LOGI(TAG, "Storage: reads of %zu bytes, read-ahead %zu, open %.0f us", r->chosen.read_size,
+             r->chosen.read_ahead, r->open_us);
+    apply(*r);
+    return r;
+}
+}  // namespace data_streamer::calibration
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "esp_random.h"
+
+
+namespace data_streamer {
+
+// Trailer field carrying the commit token at the end of a collection stream
+inline constexpr char COMMIT_TOKEN_FIELD[] = "X-Commit-Token";
+
+/**
+ * @brief Items sent by a completed collection stream, to be committed once the client acknowledges it
+ *
+ * Only the names actually sent are covered: a stream can skip items in its name range (e.g. ones an
+ * index doesn't list yet, or ones written while it ran), and those must not be consumed.
+ */
+struct PendingCommit {
+    std::string token;
+    std::vector<std::string> sent;  ///< names of the items sent, sorted, not empty
+    time_t started;                 ///< stream start time: items modified later may have changed after being sent
+
+    /**
+     * @brief Gets the greatest item name sent
+     */
+    [[nodiscard]] const std::string &last() const {
+        return sent.back();
+    }
+
+    [[nodiscard]] bool covers(std::string_view name) const {
+        return std::binary_search(sent.begin(), sent.end(), name, std::less<>{});
+    }
+};
+
+/**
+ * @brief Concept for consumers of acknowledged streams
+ *
+ * Requirements:
+ * - Must provide a cursor() method returning the name of the last consumed item, if any
+ *   (collection streams start after it, unless the client asks for a `from` item)
+ * - Must provide a commit(const PendingCommit&) method, consuming the acknowledged items
+ *   and advancing the cursor; it returns an errno value on failure, nullopt otherwise
+ */
+template<typename T>
+concept CommitHandler = requires(T c, const PendingCommit &pending) {
+    { c.cursor() } -> std::same_as<std::optional<std::string>>;
+    { c.commit(pending) } -> std::same_as<std::optional<int>>;
+};
+
+/**
+ * @brief Default CommitHandler: streams are never acknowledged, nothing is consumed
+ */
+struct NoCommit {
+    std::optional<std::string> cursor() { return std::nullopt; }
+    std::optional<int> commit(const PendingCommit &) { return std::nullopt; }
+};
+
+/**
+ * @brief Bounded set of streams awaiting acknowledgement
+ *
+ * Tokens combine a per-boot random value with a counter, so tokens from before a reboot are
+ * never mistaken for new ones. When full, the oldest pending commit is forgotten (its client
+ * will simply get the same items again on the next pull).
+ *
+ * @tparam N Max number of pending commits
+ */
+template<size_t N = 4>
+class CommitLog {
+public:
+    CommitLog(): boot_id{esp_random()} {}
+
+    /**
+     * @brief Records a completed stream
+     *
+     * @param sent Names of the items sent (not empty)
+     * @param started Stream start time
+     * @return std::string Token the client sends back to acknowledge the stream
+     */
+    std::string issue(std::vector<std::string> sent, time_t started) {
+        char token[20];
+        snprintf(token, sizeof(token), "%08lx%08lx",
+                 static_cast<unsigned long>(boot_id), static_cast<unsigned long>(++counter));
+        std::sort(sent.begin(), sent.end());
+        entries[next] = PendingCommit{token, std::move(sent), started};
+        next = (next + 1) % N;
+        return token;
+    }
+
+    /**
+     * @brief Removes and returns the pending commit with the given token
+     *
+     * @return std::optional<PendingCommit> nullopt if the token is unknown, expired or already used
+     */
+    std::optional<PendingCommit> take(std::string_view token) {
+        for (auto &entry: entries) {
+            if (entry && entry->token == token) {
+                auto pending = std::move(entry);
+                entry.reset();
+                return pending;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    uint32_t boot_id;
+    uint32_t counter{0};
+    size_t next{0};
+    std::array<std::optional<PendingCommit>, N> entries{};
+};
+}  // namespace data_streamer
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <concepts>
+#include <ctime>
 #include <span>
 #include <optional>
 #include <iterator>
@@ -100,6 +101,55 @@ concept Chunkable = requires(T c) {
 };
 
 
+/**
+ * @brief Concept for Chunkable types that know their total size in advance
+ *
+ * Required by formats that announce the item size before its content (e.g. tar).
+ *
+ * Requirements:
+ * - Must satisfy Chunkable
+ * - Must provide a size() method returning std::optional<size_t> (nullopt if unknown)
+ */
+template<typename T>
+concept SizedChunkable = Chunkable<T> &&
+    requires(T c) {
+    { c.size() } -> std::same_as<std::optional<size_t>>;
+    };
+
+
+/**
+ * @brief Concept for SizedChunkable types that can start iteration at an arbitrary offset
+ *
+ * Required to serve HTTP Range requests.
+ *
+ * Requirements:
+ * - Must satisfy SizedChunkable
+ * - Must provide a seek(size_t offset) method returning bool (false on error), to be called before begin(),
+ *   or after an iteration to iterate again from another offset (e.g. for multiple ranges)
+ */
+template<typename T>
+concept SeekableChunkable = SizedChunkable<T> &&
+    requires(T c, size_t offset) {
+    { c.seek(offset) } -> std::same_as<bool>;
+    };
+
+
+/**
+ * @brief Concept for SizedChunkable types that know when they were last modified
+ *
+ * Used to date the items of archive formats (e.g. tar); others are dated 0.
+ *
+ * Requirements:
+ * - Must satisfy SizedChunkable
+ * - Must provide an mtime() method returning std::optional<time_t> (seconds since epoch, nullopt if unknown)
+ */
+template<typename T>
+concept DatedChunkable = SizedChunkable<T> &&
+    requires(T c) {
+    { c.mtime() } -> std::same_as<std::optional<time_t>>;
+    };
+
+
 /**
  * @brief Concept for types that iterate over Chunkable items
  *
@@ -142,4 +192,46 @@ concept IterableOfChunkables = requires (T c) {
     // can be constructed with string (a vfs path)
     requires std::constructible_from<T, std::string_view>;
 };
+
+/**
+ * @brief Concept for destinations of uploaded data
+ *
+ * Defines requirements for types receiving an upload (like files), possibly in several
+ * requests: data is written at the end of a pending upload, which is published at once by commit().
+ *
+ * Requirements:
+ * - Must provide a received() method returning the size of the pending upload (0 if none)
+ * - Must provide an open(size_t offset) method returning bool (false on error), to be called
+ *   before writing: 0 starts a new upload, received() resumes the pending one
+ * - Must provide a block_size() method returning the preferred write size (e.g. the cluster size)
+ * - Must provide a write(std::span<const char>) method returning bool (false on error)
+ * - Must provide a commit() method returning bool (false on error), publishing the upload
+ * - Must provide an error() method returning std::optional<int>
+ * - Must be constructible from std::string_view (typically a path)
+ *
+ * Example implementation:
+ * @code
+ * class MyUploadSink {
+ * public:
+ *     explicit MyUploadSink(std::string_view path);
+ *     size_t received();
+ *     bool open(size_t offset);
+ *     size_t block_size();
+ *     bool write(std::span<const char> data);
+ *     bool commit();
+ *     std::optional<int> error();
+ * };
+ * @endcode
+ */
+template<typename T>
+concept UploadSink = requires(T s, size_t offset, std::span<const char> data) {
+    { s.received() } -> std::same_as<size_t>;
+    { s.open(offset) } -> std::same_as<bool>;
+    { s.block_size() } -> std::same_as<size_t>;
+    { s.write(data) } -> std::same_as<bool>;
+    { s.commit() } -> std::same_as<bool>;
+    { s.error() } -> std::same_as<std::optional<int>>;
+    // can be constructed with string (e.g. a vfs path)
+    requires std::constructible_from<T, std::string_view>;
+};
 }  // namespace data_streamer
@@ -23,4 +23,17 @@ namespace data_streamer {
 inline constexpr char TAG[] = "DataStrm";
 inline constexpr const char* BOUNDARY = CONFIG_DATA_STREAMER_MULTIPART_BOUNDARY;
 inline constexpr size_t CHUNK_SIZE = CONFIG_DATA_STREAMER_CHUNK_SIZE;
+inline constexpr size_t UPLOAD_BUFFER_SIZE = CONFIG_DATA_STREAMER_UPLOAD_BUFFER_SIZE;
+inline constexpr size_t CLUSTER_SIZE = CONFIG_DATA_STREAMER_CLUSTER_SIZE;
+inline constexpr size_t MAX_FOLLOWERS = CONFIG_DATA_STREAMER_MAX_FOLLOWERS;
+inline constexpr int FOLLOW_HEARTBEAT_S = CONFIG_DATA_STREAMER_FOLLOW_HEARTBEAT;
+inline constexpr int FOLLOW_POLL_S = CONFIG_DATA_STREAMER_FOLLOW_POLL;
+inline constexpr size_t LINE_INDEX_STRIDE = CONFIG_DATA_STREAMER_LINE_INDEX_STRIDE;
+inline constexpr size_t TLS_RECORD_SIZE = CONFIG_DATA_STREAMER_TLS_RECORD_SIZE;
+inline constexpr int CALIBRATION_BUDGET_MS = CONFIG_DATA_STREAMER_CALIBRATION_BUDGET;
+#ifdef CONFIG_DATA_STREAMER_SERVER_TIMING
+inline constexpr bool SERVER_TIMING = true;
+#else
+inline constexpr bool SERVER_TIMING = false;
+#endif
 }
@@ -0,0 +1,836 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "concepts.h"
+#include "config.h"
+#include "server_ops.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+
+/**
+ * rsync-style delta transfer of single files.
+ *
+ * The client sends the signature of its copy (the basis): for each block of the basis, a weak
+ * rolling checksum and a strong hash. The device streams the current file through a DeltaEncoder,
+ * which finds the blocks of the basis in one pass and emits instructions: copy blocks of the basis,
+ * or insert literal bytes. The client rebuilds the file with a DeltaPatcher.
+ *
+ * Signature (request body, integers big endian):
+ *   "DSIG" u32 block_size u64 basis_size
+ *   { u32 weak u64 strong } for each block (the last one may be short)
+ *
+ * Delta (response body): instructions with the framed header layout (u8 type, u32 payload length):
+ *   'L' literal bytes
+ *   'C' u32 first_block u32 count: copy blocks of the basis
+ *   'Z' u64 size u64 hash: end, with the size and XXH64 of the reconstructed file
+ */
+namespace data_streamer::delta {
+
+inline constexpr char CONTENT_TYPE[] = "application/x-data-streamer-delta";
+inline constexpr char SIGNATURE_MAGIC[] = {'D', 'S', 'I', 'G'};
+inline constexpr size_t SIGNATURE_HEADER_SIZE = 16;
+inline constexpr size_t SIGNATURE_ENTRY_SIZE = 12;
+inline constexpr size_t HEADER_SIZE = 5;
+// Bound on the memory used by a signature on the device (about 16 bytes per block)
+inline constexpr size_t MAX_BLOCKS = 2048;
+inline constexpr size_t MIN_BLOCK_SIZE = 512;
+inline constexpr size_t MAX_BLOCK_SIZE = 1 << 20;
+
+enum Instruction : uint8_t {
+    Literal = 'L',
+    Copy = 'C',
+    End = 'Z',
+};
+
+namespace detail {
+inline void put_be(char *out, uint64_t value, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = static_cast<char>(value >> (8 * (n - 1 - i)));
+}
+
+inline uint64_t get_be(const char *in, size_t n) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < n; i++) value = (value << 8) | static_cast<uint8_t>(in[i]);
+    return value;
+}
+
+inline uint64_t get_le(const uint8_t *in, size_t n) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < n; i++) value |= uint64_t{in[i]} << (8 * i);
+    return value;
+}
+}  // namespace detail
+
+/**
+ * @brief Encodes an instruction header
+ */
+inline std::array<char, HEADER_SIZE> header(Instruction type, uint32_t payload_len) {
+    std::array<char, HEADER_SIZE> h{static_cast<char>(type)};
+    detail::put_be(&h[1], payload_len, 4);
+    return h;
+}
+
+
+/**
+ * @brief Streaming XXH64, the strong hash of blocks and files
+ */
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0)
+        : v{seed + P1 + P2, seed + P2, seed, seed - P1},
+          seed{seed} {}
+
+    void update(std::span<const char> data) {
+        auto p = reinterpret_cast<const uint8_t*>(data.data());
+        size_t len = data.size();
+        total += len;
+        if (buffered + len < STRIPE) {
+            memcpy(buffer.data() + buffered, p, len);
+            buffered += len;
+            return;
+        }
+        if (buffered > 0) {
+            size_t n = STRIPE - buffered;
+            memcpy(buffer.data() + buffered, p, n);
+            consume(buffer.data());
+            p += n;
+            len -= n;
+            buffered = 0;
+        }
+        for (; len >= STRIPE; p += STRIPE, len -= STRIPE) consume(p);
+        memcpy(buffer.data(), p, len);
+        buffered = len;
+    }
+
+    [[nodiscard]] uint64_t digest() const {
+        uint64_t h;
+        if (total >= STRIPE) {
+            h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+            for (auto lane: v) h = (h ^ round(0, lane)) * P1 + P4;
+        } else {
+            h = seed + P5;
+        }
+        h += total;
+        const uint8_t *p = buffer.data();
+        size_t len = buffered;
+        for (; len >= 8; p += 8, len -= 8) h = rotl(h ^ round(0, detail::get_le(p, 8)), 27) * P1 + P4;
+        if (len >= 4) {
+            h = rotl(h ^ (detail::get_le(p, 4) * P1), 23) * P2 + P3;
+            p += 4;
+            len -= 4;
+        }
+        for (; len > 0; p++, len--) h = rotl(h ^ (*p * P5), 11) * P1;
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t hash(std::span<const char> data, uint64_t seed = 0) {
+        Xxh64 h(seed);
+        h.update(data);
+        return h.digest();
+    }
+
+private:
+    static constexpr uint64_t P1 = 11400714785074694791ULL;
+    static constexpr uint64_t P2 = 14029467366897019727ULL;
+    static constexpr uint64_t P3 = 1609587929392839161ULL;
+    static constexpr uint64_t P4 = 9650029242287828579ULL;
+    static constexpr uint64_t P5 = 2870177450012600261ULL;
+    static constexpr size_t STRIPE = 32;
+
+    static constexpr uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static constexpr uint64_t round(uint64_t acc, uint64_t input) { return rotl(acc + input * P2, 31) * P1; }
+
+    void consume(const uint8_t *p) {
+        for (size_t i = 0; i < 4; i++) v[i] = round(v[i], detail::get_le(p + 8 * i, 8));
+    }
+
+    std::array<uint64_t, 4> v;
+    uint64_t seed;
+    uint64_t total{0};
+    std::array<uint8_t, STRIPE> buffer{};
+    size_t buffered{0};
+};
+
+
+/**
+ * @brief The weak checksum of rsync: cheap to roll by one byte
+ */
+class RollingChecksum {
+public:
+    void reset(std::span<const char> block) {
+        a = 0;
+        b = 0;
+        len = block.size();
+        for (size_t i = 0; i < len; i++) {
+            auto x = static_cast<uint8_t>(block[i]);
+            a += x;
+            b += static_cast<uint32_t>(len - i) * x;
+        }
+    }
+
+    /**
+     * @brief Slides the window by one byte: `out` leaves it, `in` enters it
+     */
+    void roll(char out, char in) {
+        auto o = static_cast<uint8_t>(out);
+        a += static_cast<uint8_t>(in) - o;
+        b += a - static_cast<uint32_t>(len) * o;
+    }
+
+    [[nodiscard]] uint32_t value() const { return (a & 0xffff) | (b << 16); }
+
+    static uint32_t of(std::span<const char> block) {
+        RollingChecksum c;
+        c.reset(block);
+        return c.value();
+    }
+
+private:
+    uint32_t a{0};
+    uint32_t b{0};
+    size_t len{0};
+};
+
+
+/**
+ * @brief Picks the block size for a basis of the given size
+ *
+ * About the square root of the size (as rsync), so that signature and delta overheads balance,
+ * and large enough to stay within MAX_BLOCKS.
+ */
+inline uint32_t choose_block_size(uint64_t basis_size) {
+    auto block = static_cast<uint64_t>(std::sqrt(static_cast<double>(basis_size)));
+    block = std::max(block, (basis_size + MAX_BLOCKS - 1) / MAX_BLOCKS);
+    block = (block + 63) / 64 * 64;
+    return static_cast<uint32_t>(std::clamp<uint64_t>(block, MIN_BLOCK_SIZE, MAX_BLOCK_SIZE));
+}
+
+
+/**
+ * @brief Builds the signature of a basis fed in pieces of any size
+ *
+ * Example usage:
+ * @code
+ * auto builder = SignatureBuilder(choose_block_size(basis_size));
+ * builder.update(data);  // repeatedly
+ * std::string body = builder.finish();
+ * @endcode
+ */
+class SignatureBuilder {
+public:
+    explicit SignatureBuilder(uint32_t block_size)
+        : block_size{block_size} {
+        block.reserve(block_size);
+        out.append(SIGNATURE_MAGIC, sizeof(SIGNATURE_MAGIC));
+        out.resize(SIGNATURE_HEADER_SIZE);
+    }
+
+    void update(std::span<const char> data) {
+        while (!data.empty()) {
+            size_t n = std::min(data.size(), block_size - block.size());
+            block.insert(block.end(), data.begin(), data.begin() + n);
+            data = data.subspan(n);
+            if (block.size() == block_size) add_block();
+        }
+    }
+
+    /**
+     * @brief Completes the signature
+     *
+     * @return std::string The serialized signature
+     */
+    std::string finish() {
+        if (!block.empty()) add_block();
+        detail::put_be(&out[4], block_size, 4);
+        detail::put_be(&out[8], size, 8);
+        return std::move(out);
+    }
+
+private:
+    void add_block() {
+        char entry[SIGNATURE_ENTRY_SIZE];
+        detail::put_be(entry, RollingChecksum::of(block), 4);
+        detail::put_be(entry + 4, Xxh64::hash(block), 8);
+        out.append(entry, sizeof(entry));
+        size += block.size();
+        block.clear();
+    }
+
+    uint32_t block_size;
+    uint64_t size{0};
+    std::vector<char> block;
+    std::string out;
+};
+
+
+/**
+ * @brief A parsed signature, indexed by weak checksum
+ */
+class Signature {
+public:
+    /**
+     * @brief Parses a serialized signature
+     *
+     * @return std::optional<Signature> nullopt if malformed or larger than MAX_BLOCKS
+     */
+    static std::optional<Signature> parse(std::span<const char> data) {
+        if (data.size() < SIGNATURE_HEADER_SIZE || memcmp(data.data(), SIGNATURE_MAGIC, sizeof(SIGNATURE_MAGIC)) != 0) {
+            return std::nullopt;
+        }
+        Signature sig;
+        sig.block_size = static_cast<uint32_t>(detail::get_be(&data[4], 4));
+        sig.basis_size = detail::get_be(&data[8], 8);
+        size_t count = (data.size() - SIGNATURE_HEADER_SIZE) / SIGNATURE_ENTRY_SIZE;
+        if (sig.block_size < MIN_BLOCK_SIZE || sig.block_size > MAX_BLOCK_SIZE || count > MAX_BLOCKS ||
+            (data.size() - SIGNATURE_HEADER_SIZE) % SIGNATURE_ENTRY_SIZE != 0 ||
+            count != (sig.basis_size + sig.block_size - 1) / sig.block_size) {
+            return std::nullopt;
+        }
+        sig.entries.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            const char *p = &data[SIGNATURE_HEADER_SIZE + i * SIGNATURE_ENTRY_SIZE];
+            sig.entries.push_back({static_cast<uint32_t>(detail::get_be(p, 4)), detail::get_be(p + 4, 8),
+                                   static_cast<uint32_t>(i)});
+        }
+        std::sort(sig.entries.begin(), sig.entries.end(), [](const Entry &l, const Entry &r) {
+            return l.weak < r.weak || (l.weak == r.weak && l.index < r.index);
+        });
+        return sig;
+    }
+
+    [[nodiscard]] uint32_t block() const { return block_size; }
+    [[nodiscard]] uint64_t size() const { return basis_size; }
+    [[nodiscard]] size_t block_count() const { return entries.size(); }
+
+    /**
+     * @brief Gets the length of a block of the basis (the last one may be short)
+     */
+    [[nodiscard]] size_t block_length(uint32_t index) const {
+        uint64_t start = uint64_t{index} * block_size;
+        return static_cast<size_t>(std::min<uint64_t>(block_size, basis_size - start));
+    }
+
+    /**
+     * @brief Finds a block of the basis equal to the given data
+     *
+     * @param weak Weak checksum of data
+     * @param data Candidate data
+     * @param preferred Index returned if it matches, among several matching blocks (e.g. the next one)
+     * @return std::optional<uint32_t> Index of the matching block
+     */
+    [[nodiscard]] std::optional<uint32_t> find(uint32_t weak, std::span<const char> data, uint32_t preferred) const {
+        auto [first, last] = std::equal_range(entries.begin(), entries.end(), Entry{weak, 0, 0},
+                                              [](const Entry &l, const Entry &r) { return l.weak < r.weak; });
+        std::optional<uint64_t> strong;
+        std::optional<uint32_t> found;
+        for (auto it = first; it != last; ++it) {
+            if (block_length(it->index) != data.size()) continue;
+            if (!strong) strong = Xxh64::hash(data);
+            if (it->strong != *strong) continue;
+            if (it->index == preferred) return preferred;
+            if (!found) found = it->index;
+        }
+        return found;
+    }
+
+private:
+    struct Entry {
+        uint32_t weak;
+        uint64_t strong;
+        uint32_t index;
+    };
+
+    uint32_t block_size{0};
+    uint64_t basis_size{0};
+    std::vector<Entry> entries;
+};
+
+
+/**
+ * @brief Delta encoding statistics
+ */
+struct DeltaStats {
+    uint64_t size{0};            ///< bytes of the encoded file
+    uint64_t literal_bytes{0};
+    uint64_t copied_bytes{0};
+    uint64_t delta_bytes{0};     ///< bytes of instructions emitted
+};
+
+/**
+ * @brief Computes the delta of a file against a signature, in one streaming pass
+ *
+ * The file is fed in pieces of any size. Memory is bounded by the block size plus the largest
+ * piece fed plus `max_literal`: bytes that can't be matched anymore are emitted as literals.
+ *
+ * Example usage:
+ * @code
+ * auto encoder = DeltaEncoder(*signature);
+ * auto emit = [&](std::span<const char> bytes) { return send(bytes); };
+ * for (auto chunk: file) encoder.feed(chunk, emit);
+ * encoder.finish(emit);
+ * @endcode
+ */
+class DeltaEncoder {
+public:
+    explicit DeltaEncoder(const Signature &signature, size_t max_literal = CHUNK_SIZE)
+        : sig{signature},
+          block_size{signature.block()},
+          max_literal{std::max<size_t>(max_literal, 1)} {
+        window.reserve(2 * block_size + max_literal);
+    }
+
+    /**
+     * @brief Feeds a piece of the file
+     *
+     * @tparam Emit Callable taking std::span<const char> and returning bool (false on error)
+     * @return bool false if emit failed
+     */
+    template<typename Emit>
+    bool feed(std::span<const char> data, Emit &&emit) {
+        hash.update(data);
+        stats.size += data.size();
+        window.insert(window.end(), data.begin(), data.end());
+        if (sig.block_count() > 0) {
+            while (window.size() - pos >= block_size) {
+                auto block = std::span<const char>(window.data() + pos, block_size);
+                if (!rolling_valid) {
+                    rolling.reset(block);
+                    rolling_valid = true;
+                }
+                auto preferred = copy_count > 0 ? copy_first + copy_count : 0;
+                if (auto index = sig.find(rolling.value(), block, preferred)) {
+                    if (!flush_literal(emit) || !add_copy(*index, emit)) return false;
+                    pos += block_size;
+                    lit_start = pos;
+                    rolling_valid = false;
+                    continue;
+                }
+                if (window.size() - pos == block_size) break;  // wait for the next byte
+                rolling.roll(window[pos], window[pos + block_size]);
+                pos++;
+                if (pos - lit_start >= max_literal && !flush_literal(emit)) return false;
+            }
+        } else {
+            pos = window.size();
+            if (pos - lit_start >= max_literal && !flush_literal(emit)) return false;
+        }
+        compact();
+        return true;
+    }
+
+    /**
+     * @brief Emits the remaining instructions, ending with the End instruction
+     *
+     * @return bool false if emit failed
+     */
+    template<typename Emit>
+    bool finish(Emit &&emit) {
+        // the tail may match the last (short) block of the basis
+        auto tail = std::span<const char>(window.data() + pos, window.size() - pos);
+        std::optional<uint32_t> index;
+        if (!tail.empty() && sig.block_count() > 0 && tail.size() < block_size) {
+            index = sig.find(RollingChecksum::of(tail), tail, static_cast<uint32_t>(sig.block_count() - 1));
+        }
+        if (index) {
+            if (!flush_literal(emit) || !add_copy(*index, emit)) return false;
+            lit_start = pos = window.size();
+        } else {
+            pos = window.size();
+        }
+        while (lit_start < pos) {
+            if (!flush_literal(emit)) return false;
+        }
+        if (!flush_copy(emit)) return false;
+        char payload[16];
+        detail::put_be(payload, stats.size, 8);
+        detail::put_be(payload + 8, hash.digest(), 8);
+        return emit_instruction(End, payload, sizeof(payload), emit);
+    }
+
+    [[nodiscard]] const DeltaStats& statistics() const { return stats; }
+
+private:
+    template<typename Emit>
+    bool emit_instruction(Instruction type, const char *payload, size_t len, Emit &&emit) {
+        auto hdr = header(type, static_cast<uint32_t>(len));
+        stats.delta_bytes += hdr.size() + len;
+        return emit(std::span<const char>(hdr.data(), hdr.size())) &&
+               (len == 0 || emit(std::span<const char>(payload, len)));
+    }
+
+    template<typename Emit>
+    bool flush_literal(Emit &&emit) {
+        if (lit_start == pos) return true;
+        if (!flush_copy(emit)) return false;
+        size_t n = std::min(pos - lit_start, max_literal);
+        stats.literal_bytes += n;
+        bool ok = emit_instruction(Literal, window.data() + lit_start, n, emit);
+        lit_start += n;
+        return ok;
+    }
+
+    template<typename Emit>
+    bool add_copy(uint32_t index, Emit &&emit) {
+        stats.copied_bytes += sig.block_length(index);
+        if (copy_count > 0 && index == copy_first + copy_count) {
+            copy_count++;
+            return true;
+        }
+        bool ok = flush_copy(emit);
+        copy_first = index;
+        copy_count = 1;
+        return ok;
+    }
+
+    template<typename Emit>
+    bool flush_copy(Emit &&emit) {
+        if (copy_count == 0) return true;
+        char payload[8];
+        detail::put_be(payload, copy_first, 4);
+        detail::put_be(payload + 4, copy_count, 4);
+        copy_count = 0;
+        return emit_instruction(Copy, payload, sizeof(payload), emit);
+    }
+
+    void compact() {
+        if (lit_start == 0) return;
+        window.erase(window.begin(), window.begin() + static_cast<std::ptrdiff_t>(lit_start));
+        pos -= lit_start;
+        lit_start = 0;
+    }
+
+    const Signature &sig;
+    size_t block_size;
+    size_t max_literal;
+    std::vector<char> window;  // pending literal bytes, then the bytes being matched
+    size_t lit_start{0};
+    size_t pos{0};
+    RollingChecksum rolling;
+    bool rolling_valid{false};
+    uint32_t copy_first{0};
+    uint32_t copy_count{0};
+    Xxh64 hash;
+    DeltaStats stats;
+};
+
+
+/**
+ * @brief Rebuilds a file from its basis and a delta, fed in pieces of any size
+ *
+ * @tparam Basis Callable `bool(uint64_t offset, std::span<char> out)` reading out.size() bytes of the basis
+ * @tparam Out Callable `bool(std::span<const char>)` writing the rebuilt file
+ *
+ * Example usage:
+ * @code
+ * auto patcher = DeltaPatcher(block_size, basis_size, read_basis, write_output);
+ * for (auto piece: response) if (!patcher.feed(piece)) break;
+ * bool ok = patcher.finish();  // verifies size and hash of the rebuilt file
+ * @endcode
+ */
+template<typename Basis, typename Out>
+class DeltaPatcher {
+public:
+    DeltaPatcher(uint32_t block_size, uint64_t basis_size, Basis basis, Out out)
+        : block_size{block_size},
+          basis_size{basis_size},
+          basis{std::move(basis)},
+          out{std::move(out)},
+          block(block_size) {}
+
+    /**
+     * @brief Feeds a piece of the delta
+     *
+     * @return bool false on malformed delta, basis read or output error
+     */
+    bool feed(std::span<const char> data) {
+        while (!data.empty() && !failed) {
+            if (state == State::Header || state == State::Payload) {
+                size_t want = state == State::Header ? HEADER_SIZE : remaining;
+                size_t n = std::min(data.size(), want - buffered);
+                memcpy(small.data() + buffered, data.data(), n);
+                buffered += n;
+                data = data.subspan(n);
+                if (buffered < want) continue;
+                buffered = 0;
+                if (state == State::Header) {
+                    failed = !start_instruction();
+                } else {
+                    remaining = 0;
+                    failed = !complete_instruction();
+                }
+            } else {  // State::Literal: streamed through
+                size_t n = std::min<size_t>(data.size(), remaining);
+                failed = !write(data.first(n));
+                remaining -= n;
+                data = data.subspan(n);
+                if (remaining == 0) state = State::Header;
+            }
+        }
+        return !failed;
+    }
+
+    /**
+     * @brief Checks that the delta ended and that the rebuilt file has the announced size and hash
+     */
+    bool finish() {
+        return !failed && ended;
+    }
+
+    [[nodiscard]] uint64_t written() const { return size; }
+
+private:
+    enum class State { Header, Payload, Literal };
+
+    bool start_instruction() {
+        type = static_cast<Instruction>(small[0]);
+        remaining = static_cast<uint32_t>(detail::get_be(&small[1], 4));
+        if (ended) return false;
+        switch (type) {
+            case Literal:
+                state = remaining > 0 ? State::Literal : State::Header;
+                return true;
+            case Copy:
+                state = State::Payload;
+                return remaining == 8;
+            case End:
+                state = State::Payload;
+                return remaining == 16;
+        }
+        return false;
+    }
+
+    bool complete_instruction() {
+        state = State::Header;
+        if (type == Copy) {
+            auto first = detail::get_be(small.data(), 4);
+            auto count = detail::get_be(small.data() + 4, 4);
+            for (uint64_t i = first; i < first + count; i++) {
+                uint64_t offset = i * block_size;
+                if (offset >= basis_size) return false;
+                auto n = static_cast<size_t>(std::min<uint64_t>(block_size, basis_size - offset));
+                auto piece = std::span<char>(block).first(n);
+                if (!basis(offset, piece) || !write(piece)) return false;
+            }
+            return true;
+        }
+        ended = true;
+        return detail::get_be(small.data(), 8) == size && detail::get_be(small.data() + 8, 8) == hash.digest();
+    }
+
+    bool write(std::span<const char> data) {
+        hash.update(data);
+        size += data.size();
+        return out(data);
+    }
+
+    uint32_t block_size;
+    uint64_t basis_size;
+    Basis basis;
+    Out out;
+    std::vector<char> block;
+    std::array<char, 16> small{};
+    size_t buffered{0};
+    State state{State::Header};
+    Instruction type{Literal};
+    uint32_t remaining{0};
+    uint64_t size{0};
+    Xxh64 hash;
+    bool ended{false};
+    bool failed{false};
+};
+}  // namespace data_streamer::delta
+
+
+namespace data_streamer {
+
+/**
+ * @brief HTTP handler streaming the delta of a Chunkable source against a client's signature
+ *
+ * `POST <uri>` with a signature as body (see delta.h) gets the delta of the current content
+ * (`application/x-data-streamer-delta`), computed while reading the source once. The signature is
+ * limited to delta::MAX_BLOCKS blocks, so that its memory use is bounded.
+ *
+ * @tparam T The data source type (must satisfy Chunkable)
+ * @tparam ServerOps Server operations interface (defaults to EspHttpServerOps)
+ *
+ * Example usage:
+ * @code
+ * auto streamer = DeltaStreamer<FileChunker<>>("/sdcard/state.db");
+ * streamer.bind(server, "/state.db/delta");
+ * @endcode
+ */
+template <typename T, typename ServerOps = EspHttpServerOps>
+    requires Chunkable<T>
+class DeltaStreamer {
+public:
+    /**
+     * @brief Constructs a DeltaStreamer for the given path
+     *
+     * @param vfs_path Path to the data source (e.g. a file)
+     */
+    explicit DeltaStreamer(std::string_view vfs_path)
+    : vfs_path{vfs_path} {}
+
+    ~DeltaStreamer() {
+        unbind();
+    }
+
+    /**
+     * @brief Binds the streamer to an HTTP server endpoint
+     *
+     * @param server HTTP server handle
+     * @param uri Endpoint URI
+     * @param method HTTP method (typically HTTP_POST, as the request has a body)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t bind(httpd_handle_t server, const std::string &uri, http_method method = HTTP_POST) {
+        if (!server) {
+            ESP_LOGE(TAG, "Null server handle");
+            return ESP_FAIL;
+        }
+        this->srv = server;
+        this->uri = uri;
+        this->method = method;
+        httpd_uri_t delta_endpoint = {
+            .uri       = uri.c_str(),
+            .method    = method,
+            .handler   = &DeltaStreamer::handler_wrapper,
+            .user_ctx  = this
+        };
+        return ServerOps::register_uri_handler(server, &delta_endpoint);
+    }
+
+    /**
+     * @brief Unbinds the streamer from the HTTP server
+     *
+     * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if not bound
+     */
+    esp_err_t unbind() {
+        if (srv == nullptr) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        return ServerOps::unregister_uri_handler(srv, uri.c_str(), method);
+    }
+
+    /**
+     * @brief HTTP handler callback wrapper
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    static esp_err_t handler_wrapper(httpd_req_t* req) {
+        auto* instance = static_cast<DeltaStreamer*>(req->user_ctx);
+        return instance->handler(req);
+    }
+
+private:
+    static constexpr size_t MAX_SIGNATURE_SIZE =
+        delta::SIGNATURE_HEADER_SIZE + delta::MAX_BLOCKS * delta::SIGNATURE_ENTRY_SIZE;
+    // Consecutive receive timeouts tolerated before giving up on a client
+    static constexpr int MAX_RECV_TIMEOUTS = 3;
+
+    /**
+     * @brief Receives the request body
+     *
+     * @return bool false if the connection broke
+     */
+    bool receive(httpd_req_t* req, std::vector<char> &body) {
+        size_t received = 0;
+        int timeouts = 0;
+        while (received < body.size()) {
+            int n = ServerOps::req_recv(req, body.data() + received, body.size() - received);
+            if (n == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= MAX_RECV_TIMEOUTS) continue;
+            if (n <= 0) return false;
+            timeouts = 0;
+            received += n;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Main request handler
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t handler(httpd_req_t* req) {
+        if (req->content_len > MAX_SIGNATURE_SIZE) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Signature too large");
+            return ESP_FAIL;  // body wasn't read: close the connection
+        }
+        std::optional<delta::Signature> signature;
+        {
+            std::vector<char> body(req->content_len);
+            if (!receive(req, body)) {
+                ESP_LOGE(TAG, "Can't receive signature");
+                return ESP_FAIL;
+            }
+            signature = delta::Signature::parse(body);
+        }
+        if (!signature) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid signature");
+            return ESP_OK;
+        }
+        auto chunk_provider = T(vfs_path);
+        auto encoder = delta::DeltaEncoder(*signature);
+        auto emit = [req](std::span<const char> data) {
+            return ServerOps::resp_send_chunk(req, data.data(), static_cast<ssize_t>(data.size())) == ESP_OK;
+        };
+        ServerOps::resp_set_status(req, HTTPD_200);
+        ServerOps::resp_set_type(req, delta::CONTENT_TYPE);
+        ServerOps::resp_set_hdr(req, "X-Part-Name", chunk_provider.name().data());
+        for (std::span<char> &chunk: chunk_provider) {
+            if (!encoder.feed(chunk, emit)) {
+                goto error;
+            }
+        }
+        if (chunk_provider.error() || !encoder.finish(emit)) {
+            goto error;
+        }
+        ESP_LOGI(TAG, "Delta sent: %llu literal bytes, %llu copied bytes",
+                 static_cast<unsigned long long>(encoder.statistics().literal_bytes),
+                 static_cast<unsigned long long>(encoder.statistics().copied_bytes));
+        ServerOps::resp_send_chunk(req, nullptr, 0);
+        return ESP_OK;
+
+        error:  // GOTO tag
+        ServerOps::resp_sendstr_chunk(req, nullptr);
+        ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send delta");
+        return ESP_FAIL;
+    }
+
+    std::string vfs_path;
+    httpd_handle_t srv{};
+    std::string uri{};
+    http_method method{};
+};
+}  // namespace data_streamer
@@ -0,0 +1,408 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "concepts.h"
+#include "config.h"
+#include "server_ops.h"
+#include "timing.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+
+/**
+ * Diagnostics telling network problems from storage problems.
+ *
+ * - Link test: SyntheticChunker, a Chunkable generating pseudo-random content into a reused buffer,
+ *   streamed by a DataStreamer like a file (so that TLS record sizing, Range requests and the
+ *   Server-Timing trailer apply), without touching storage.
+ * - Storage test: StorageTestStreamer reads a test file and discards its content, then reports the
+ *   open and read times in the response headers (and a JSON body).
+ *
+ * Synthetic content is a function of the offset (bytes of splitmix64 of the offset / 8, little
+ * endian), so clients can check it, ranges included.
+ */
+namespace data_streamer::diag {
+
+inline constexpr char SYNTHETIC_NAME[] = "synthetic.bin";
+inline constexpr char REPORT_CONTENT_TYPE[] = "application/json";
+inline constexpr char READ_BYTES_FIELD[] = "X-Read-Bytes";
+
+/**
+ * @brief Parses a size: a number of bytes, with an optional K, M or G (binary) suffix, e.g. "16M"
+ */
+inline std::optional<size_t> parse_size(std::string_view spec) {
+    uint64_t n = 0;
+    auto [ptr, ec] = std::from_chars(spec.data(), spec.data() + spec.size(), n);
+    if (ec != std::errc() || ptr == spec.data()) {
+        return std::nullopt;
+    }
+    std::string_view suffix(ptr, spec.data() + spec.size() - ptr);
+    int shift = suffix.empty() ? 0 : suffix == "K" ? 10 : suffix == "M" ? 20 : suffix == "G" ? 30 : -1;
+    if (shift < 0 || n > (SIZE_MAX >> shift)) {
+        return std::nullopt;
+    }
+    return static_cast<size_t>(n << shift);
+}
+
+inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Fills a buffer with the synthetic content found at an offset
+ */
+inline void fill(std::span<char> out, uint64_t offset) {
+    size_t i = 0;
+    while (i < out.size()) {
+        uint64_t word = splitmix64((offset + i) / 8);
+        size_t skip = (offset + i) % 8;
+        size_t n = std::min<size_t>(8 - skip, out.size() - i);
+        char bytes[8];
+        for (size_t k = 0; k < 8; k++) {  // a single store, on little endian targets
+            bytes[k] = static_cast<char>(word >> (8 * k));
+        }
+        memcpy(out.data() + i, bytes + skip, n);
+        i += n;
+    }
+}
+
+/**
+ * @brief Writes a file of synthetic content, to be read by the storage test
+ *
+ * @return std::optional<int> errno value on failure, nullopt otherwise
+ */
+inline std::optional<int> write_test_file(const std::string &path, size_t size) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        return errno;
+    }
+    std::array<char, CHUNK_SIZE> buf;
+    bool ok = true;
+    for (size_t offset = 0; ok && offset < size; offset += buf.size()) {
+        auto n = std::min(buf.size(), size - offset);
+        fill(std::span(buf).first(n), offset);
+        ok = fwrite(buf.data(), 1, n, f) == n;
+    }
+    int err = ok ? 0 : (errno ? errno : EIO);
+    if (fclose(f) != 0 && ok) {
+        err = errno;
+    }
+    return err ? std::optional(err) : std::nullopt;
+}
+
+/**
+ * @brief A SeekableChunkable of synthetic content, generated into a reused buffer
+ *
+ * Constructed from its size (see parse_size()), in place of a path. Generation is accounted as
+ * reading in the Server-Timing breakdown.
+ *
+ * @tparam CHUNK_SIZE Size of each chunk in bytes. Defaults to value from Kconfig.
+ *
+ * Example usage:
+ * @code
+ * // GET /diag/link streams 16 MiB (or a range of them) from memory
+ * static auto link_test = data_streamer::DataStreamer<data_streamer::diag::SyntheticChunker<>>("16M");
+ * link_test.bind(server, "/diag/link", HTTP_GET);
+ * @endcode
+ */
+template<int CHUNK_SIZE=CHUNK_SIZE>
+class SyntheticChunker {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::span<char>;
+        using difference_type = long;
+        using pointer = const std::span<char>*;
+        using reference = std::span<char>&;
+
+        Iterator(): parent(nullptr), is_end(true) {}
+        Iterator(SyntheticChunker* p, bool end)
+            : parent(p), is_end(end) {
+            ++(*this);  // generate the first chunk
+        }
+
+        Iterator& operator++() {
+            if (!is_end) {
+                parent->next_chunk();
+                if (parent->cur_chunk.empty()) {
+                    is_end = true;
+                }
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        std::span<char>& operator*() const {return parent->cur_chunk;}
+
+        bool operator==(const Iterator& other) const {
+            return is_end == other.is_end;
+        }
+    private:
+        SyntheticChunker *parent;
+        bool is_end;
+    };
+    using iterator = Iterator;
+
+    /**
+     * @param spec Size of the content, e.g. "16M"; EINVAL error if malformed
+     */
+    explicit SyntheticChunker(std::string_view spec): total{parse_size(spec)} {
+        if (!total) {
+            last_error = EINVAL;
+        }
+    }
+
+    std::string_view name() {
+        return SYNTHETIC_NAME;
+    }
+
+    std::optional<int> error() {
+        return last_error;
+    }
+
+    std::optional<size_t> size() {
+        return total;
+    }
+
+    /**
+     * @brief Moves the position, so that the next iteration starts at the given offset
+     *
+     * @return bool false if the offset is past the end
+     */
+    bool seek(size_t offset) {
+        if (!total || offset > *total) {
+            return false;
+        }
+        position = offset;
+        return true;
+    }
+
+    iterator begin() {
+        return {this, !total};
+    }
+
+    iterator end() {
+        return {this, true};
+    }
+
+private:
+    void next_chunk() {
+        timing::Span span(timing::Read);
+        size_t n = std::min<size_t>(CHUNK_SIZE, *total - position);
+        fill(std::span(buf).first(n), position);
+        position += n;
+        cur_chunk = std::span(buf.data(), n);
+    }
+
+    std::optional<size_t> total;
+    size_t position{0};
+    std::optional<int> last_error;
+    std::array<char, CHUNK_SIZE> buf;
+    std::span<char> cur_chunk;
+};
+
+/**
+ * @brief Result of a storage test
+ */
+struct StorageReport {
+    size_t bytes{0};
+    timing::clock::duration open{};
+    timing::clock::duration read{};
+
+    [[nodiscard]] double mb_per_s() const {
+        auto s = std::chrono::duration<double>(read).count();
+        return s > 0 ? static_cast<double>(bytes) / s / 1e6 : 0;
+    }
+
+    /**
+     * @brief Formats the times as a Server-Timing value, in milliseconds
+     */
+    [[nodiscard]] std::string to_header() const {
+        char out[64];
+        snprintf(out, sizeof(out), "open;dur=%.3f, read;dur=%.3f",
+                 std::chrono::duration<double, std::milli>(open).count(),
+                 std::chrono::duration<double, std::milli>(read).count());
+        return out;
+    }
+
+    [[nodiscard]] std::string to_json() const {
+        char out[160];
+        snprintf(out, sizeof(out), R"({"bytes":%zu,"open_us":%lld,"read_us":%lld,"mb_per_s":%.3f})", bytes,
+                 static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(open).count()),
+                 static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(read).count()),
+                 mb_per_s());
+        return out;
+    }
+};
+
+/**
+ * @brief Reads a Chunkable to the end, discarding its content
+ *
+ * @param report Bytes read, time taken to construct (open) and to iterate over (read) the item
+ * @return std::optional<int> error of the item, if any
+ */
+template<Chunkable C>
+std::optional<int> read_all(std::string_view path, StorageReport &report) {
+    auto start = timing::clock::now();
+    C chunkable(path);
+    auto opened = timing::clock::now();
+    report.open = opened - start;
+    report.bytes = 0;
+    if (!chunkable.error()) {
+        for (std::span<char> &chunk: chunkable) {
+            report.bytes += chunk.size();
+        }
+    }
+    report.read = timing::clock::now() - opened;
+    return chunkable.error();
+}
+}  // namespace data_streamer::diag
+
+
+namespace data_streamer {
+
+/**
+ * @brief HTTP handler measuring the read throughput of storage
+ *
+ * Each request reads the test file to the end, discarding its content, then responds with the
+ * results: X-Read-Bytes and Server-Timing (open, read) headers, and a JSON body, e.g.
+ * {"bytes":4194304,"open_us":2310,"read_us":1730211,"mb_per_s":2.424}
+ * 404 if the test file doesn't exist (see diag::write_test_file()).
+ *
+ * @tparam C Chunkable type of the test file
+ * @tparam ServerOps Server operations interface (defaults to EspHttpServerOps)
+ *
+ * Example usage:
+ * @code
+ * data_streamer::diag::write_test_file("/sdcard/.diag", 4 << 20);  // once
+ * static auto storage_test = data_streamer::StorageTestStreamer<data_streamer::FileChunker<>>("/sdcard/.diag");
+ * storage_test.bind(server, "/diag/storage");
+ * @endcode
+ */
+template <Chunkable C, typename ServerOps = EspHttpServerOps>
+class StorageTestStreamer {
+public:
+    /**
+     * @param vfs_path Path to the test file
+     */
+    explicit StorageTestStreamer(std::string_view vfs_path): vfs_path{vfs_path} {}
+
+    ~StorageTestStreamer() {
+        unbind();
+    }
+
+    /**
+     * @brief Binds the streamer to an HTTP server endpoint
+     *
+     * @param server HTTP server handle
+     * @param uri Endpoint URI
+     * @param method HTTP method (typically HTTP_GET)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t bind(httpd_handle_t server, const std::string &uri, http_method method = HTTP_GET) {
+        if (!server) {
+            ESP_LOGE(TAG, "Null server handle");
+            return ESP_FAIL;
+        }
+        this->srv = server;
+        this->uri = uri;
+        this->method = method;
+        httpd_uri_t endpoint = {
+            .uri       = uri.c_str(),
+            .method    = method,
+            .handler   = &StorageTestStreamer::handler_wrapper,
+            .user_ctx  = this
+        };
+        return ServerOps::register_uri_handler(server, &endpoint);
+    }
+
+    /**
+     * @brief Unbinds the streamer from the HTTP server
+     *
+     * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if not bound
+     */
+    esp_err_t unbind() {
+        if (srv == nullptr) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        return ServerOps::unregister_uri_handler(srv, uri.c_str(), method);
+    }
+
+    /**
+     * @brief HTTP handler callback wrapper
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    static esp_err_t handler_wrapper(httpd_req_t* req) {
+        auto* instance = static_cast<StorageTestStreamer*>(req->user_ctx);
+        return instance->handler(req);
+    }
+
+private:
+    esp_err_t handler(httpd_req_t* req) {
+        diag::StorageReport report;
+        if (auto err = diag::read_all<C>(vfs_path, report)) {
+            ESP_LOGE(TAG, "Storage test of %s failed, err %d", vfs_path.c_str(), *err);
+            if (*err == ENOENT) {
+                ServerOps::resp_send_err(req, HTTPD_404_NOT_FOUND, "No test file");
+                return ESP_OK;
+            }
+            ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Read failed");
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "Storage test: %s", report.to_json().c_str());
+        // header values must outlive the response, as headers are sent with the body
+        auto bytes = std::to_string(report.bytes);
+        auto server_timing = report.to_header();
+        auto json = report.to_json();
+        ServerOps::resp_set_status(req, HTTPD_200);
+        ServerOps::resp_set_type(req, diag::REPORT_CONTENT_TYPE);
+        ServerOps::resp_set_hdr(req, diag::READ_BYTES_FIELD, bytes.c_str());
+        ServerOps::resp_set_hdr(req, timing::SERVER_TIMING_FIELD, server_timing.c_str());
+        return ServerOps::resp_send(req, json.data(), static_cast<ssize_t>(json.size()));
+    }
+
+    std::string vfs_path;
+    httpd_handle_t srv{};
+    std::string uri{};
+    http_method method{};
+};
+}  // namespace data_streamer
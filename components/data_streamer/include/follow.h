@@ -0,0 +1,249 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include "config.h"
+#include "index.h"
+
+
+namespace data_streamer {
+
+/**
+ * Follow mode: collection streams kept open to send new items as they are completed.
+ */
+namespace follow {
+inline constexpr char HEARTBEAT_FIELD[] = "X-Heartbeat";
+inline constexpr char STATUS_503[] = "503 Service Unavailable";
+
+/**
+ * @brief Server-side settings of follow streams
+ */
+struct Options {
+    size_t max_followers{MAX_FOLLOWERS};  ///< per streamed path; more followers get 503
+    std::chrono::milliseconds heartbeat{std::chrono::seconds(FOLLOW_HEARTBEAT_S)};  ///< max silence
+    std::chrono::milliseconds poll{std::chrono::seconds(FOLLOW_POLL_S)};  ///< rescan interval without notification
+};
+}  // namespace follow
+
+/**
+ * @brief Tracks the files being written to a directory, and wakes up its followers when files are completed
+ *
+ * Writers notify a watch when they open, close (complete) and delete files: RecordWriter and FileSink do so.
+ * Once a writer has notified it, the watch considers every file not open by a writer complete; until
+ * then, files are considered complete when unmodified for `settle` seconds (polling fallback).
+ * Completed and deleted files are journaled to the directory's DirIndex, if any, which keeps it current
+ * without rescans. Watches are registered per directory with get().
+ *
+ * Example usage (custom writer):
+ * @code
+ * auto watch = DirWatch::get("/sdcard/logs");
+ * watch->opened("0001.log");
+ * // ... write ...
+ * watch->closed("0001.log", size);  // without the size, the file is stat'ed
+ * // ...
+ * watch->removed("0001.log");
+ * @endcode
+ */
+class DirWatch {
+public:
+    static constexpr time_t DEFAULT_SETTLE = 5;
+
+    explicit DirWatch(std::string_view dir_path): dir_path{dir_path} {}
+
+    /**
+     * @brief Gets the watch of a directory, registering one if needed.
+     */
+    static std::shared_ptr<DirWatch> get(std::string_view dir_path) {
+        std::lock_guard lock(registry_mutex());
+        auto &slot = registry()[std::string(dir_path)];
+        if (!slot) {
+            slot = std::make_shared<DirWatch>(dir_path);
+        }
+        return slot;
+    }
+
+    /**
+     * @brief Gets the watch of a directory, if one is registered.
+     */
+    static std::shared_ptr<DirWatch> find(std::string_view dir_path) {
+        std::lock_guard lock(registry_mutex());
+        auto it = registry().find(dir_path);
+        return it == registry().end() ? nullptr : it->second;
+    }
+
+    /**
+     * @brief Writer hook: a file is being written.
+     */
+    void opened(std::string_view name) {
+        std::lock_guard lock(mutex);
+        writers_seen = true;
+        open_files.emplace(name);
+    }
+
+    /**
+     * @brief Writer hook: a file is complete (closed, or published at once). Wakes up followers.
+     *
+     * @param name File name
+     * @param size Size of the file, if the writer knows it: saves a stat, its modification time being now
+     */
+    void closed(std::string_view name, std::optional<uint64_t> size = std::nullopt) {
+        forget(name);
+        if (auto index = DirIndex::find(dir_path)) {
+            if (size) {
+                index->upsert({std::string(name), *size, time(nullptr)});
+            } else {
+                struct stat st{};
+                std::string path = dir_path + "/" + std::string(name);
+                if (stat(path.c_str(), &st) == 0) {
+                    index->upsert({std::string(name), static_cast<uint64_t>(st.st_size), st.st_mtime});
+                }
+            }
+        }
+        changed();
+    }
+
+    /**
+     * @brief Writer hook: a file was deleted (or moved out of the directory).
+     */
+    void removed(std::string_view name) {
+        forget(name);
+        if (auto index = DirIndex::find(dir_path)) {
+            index->remove(name);
+        }
+    }
+
+    /**
+     * @brief Wakes up followers, e.g. after files were added by other means.
+     */
+    void changed() {
+        {
+            std::lock_guard lock(mutex);
+            seq++;
+        }
+        cv.notify_all();
+    }
+
+    /**
+     * @brief Gets the change counter, to be passed to wait().
+     */
+    [[nodiscard]] uint64_t sequence() const {
+        std::lock_guard lock(mutex);
+        return seq;
+    }
+
+    /**
+     * @brief Waits until a change after `since` (see sequence()), or the timeout.
+     */
+    void wait(uint64_t since, std::chrono::milliseconds timeout) {
+        std::unique_lock lock(mutex);
+        cv.wait_for(lock, timeout, [&] { return seq != since; });
+    }
+
+    /**
+     * @brief Checks whether a file is complete.
+     *
+     * @param name File name
+     * @param mtime Last modification time of the file
+     * @param now Current time
+     */
+    [[nodiscard]] bool settled(std::string_view name, time_t mtime, time_t now) const {
+        std::lock_guard lock(mutex);
+        if (writers_seen) {
+            return open_files.find(name) == open_files.end();
+        }
+        return now - mtime >= settle;
+    }
+
+    /**
+     * @brief Sets how long files must be left unmodified to be considered complete, without writer hooks.
+     */
+    void set_settle(time_t seconds) {
+        std::lock_guard lock(mutex);
+        settle = seconds;
+    }
+
+    /**
+     * @brief Takes a follower slot.
+     *
+     * @param max Maximum number of followers
+     * @return bool false if all slots are taken
+     */
+    bool try_follow(size_t max) {
+        std::lock_guard lock(mutex);
+        if (followers >= max) {
+            return false;
+        }
+        followers++;
+        return true;
+    }
+
+    /**
+     * @brief Releases a follower slot.
+     */
+    void unfollow() {
+        std::lock_guard lock(mutex);
+        followers--;
+    }
+
+    [[nodiscard]] size_t follower_count() const {
+        std::lock_guard lock(mutex);
+        return followers;
+    }
+
+private:
+    void forget(std::string_view name) {
+        std::lock_guard lock(mutex);
+        auto it = open_files.find(name);
+        if (it != open_files.end()) {
+            open_files.erase(it);
+        }
+    }
+
+    static std::map<std::string, std::shared_ptr<DirWatch>, std::less<>> &registry() {
+        static std::map<std::string, std::shared_ptr<DirWatch>, std::less<>> watches;
+        return watches;
+    }
+
+    static std::mutex &registry_mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    std::string dir_path;
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t seq{0};
+    bool writers_seen{false};
+    std::set<std::string, std::less<>> open_files;
+    time_t settle{DEFAULT_SETTLE};
+    size_t followers{0};
+};
+
+}  // namespace data_streamer
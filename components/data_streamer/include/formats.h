@@ -0,0 +1,161 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+
+namespace data_streamer {
+
+/**
+ * @brief Wire formats for collection (multi-item) streaming
+ *
+ * Selected by the client with the `format` query parameter.
+ */
+enum class StreamFormat {
+    Multipart,  ///< multipart/mixed, one part per item (default)
+    Tar,        ///< POSIX ustar archive, requires items with a known size
+    Framed,     ///< length-prefixed frames, see the framed namespace
+};
+
+/**
+ * @brief Parses the value of the `format` query parameter
+ *
+ * @return std::optional<StreamFormat> nullopt for unknown formats
+ */
+inline std::optional<StreamFormat> parse_stream_format(std::string_view name) {
+    if (name == "multipart") return StreamFormat::Multipart;
+    if (name == "tar") return StreamFormat::Tar;
+    if (name == "framed") return StreamFormat::Framed;
+    return std::nullopt;
+}
+
+/**
+ * Length-prefixed framing.
+ *
+ * The stream is a sequence of frames, each made of a 5-byte header (type, big endian u32 payload
+ * length) followed by the payload. An item starts with a PartStart frame carrying its name, followed
+ * by any number of Data frames carrying its content. An item resumed at a byte offset has a
+ * PartOffset frame (big endian u64 offset) right after its PartStart frame: its content is to be
+ * appended to what was received before. The stream ends with an End frame, whose payload is a
+ * (possibly empty) trailer. Decoders must skip frames of unknown type.
+ */
+namespace framed {
+inline constexpr char CONTENT_TYPE[] = "application/x-data-streamer-framed";
+inline constexpr size_t HEADER_SIZE = 5;
+inline constexpr size_t OFFSET_SIZE = 8;
+
+enum FrameType : uint8_t {
+    PartStart = 'P',
+    Data = 'D',
+    End = 'Z',
+    Heartbeat = 'H',  ///< empty, keeps follow streams alive while there's nothing new
+    PartOffset = 'O',
+};
+
+/**
+ * @brief Encodes a frame header
+ */
+inline std::array<char, HEADER_SIZE> header(FrameType type, uint32_t payload_len) {
+    return {static_cast<char>(type),
+            static_cast<char>(payload_len >> 24), static_cast<char>(payload_len >> 16),
+            static_cast<char>(payload_len >> 8), static_cast<char>(payload_len)};
+}
+
+/**
+ * @brief Encodes the payload of a PartOffset frame
+ */
+inline std::array<char, OFFSET_SIZE> offset_payload(uint64_t offset) {
+    std::array<char, OFFSET_SIZE> out{};
+    for (size_t i = 0; i < OFFSET_SIZE; i++) {
+        out[i] = static_cast<char>(offset >> (8 * (OFFSET_SIZE - 1 - i)));
+    }
+    return out;
+}
+
+/**
+ * @brief Decodes the payload of a PartOffset frame
+ */
+inline uint64_t offset_value(const char *payload) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < OFFSET_SIZE; i++) {
+        v = (v << 8) | static_cast<uint8_t>(payload[i]);
+    }
+    return v;
+}
+
+/**
+ * @brief Decodes the payload length of a frame header
+ */
+inline uint32_t payload_length(const char *hdr) {
+    auto b = reinterpret_cast<const uint8_t*>(hdr);
+    return (uint32_t{b[1]} << 24) | (uint32_t{b[2]} << 16) | (uint32_t{b[3]} << 8) | uint32_t{b[4]};
+}
+}  // namespace framed
+
+/**
+ * POSIX ustar archive helpers.
+ */
+namespace tar {
+inline constexpr char CONTENT_TYPE[] = "application/x-tar";
+inline constexpr size_t BLOCK_SIZE = 512;
+inline constexpr size_t NAME_SIZE = 100;
+
+/**
+ * @brief Number of zero bytes needed after `size` bytes of content to reach a block boundary
+ */
+constexpr size_t padding(size_t size) {
+    return (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+}
+
+/**
+ * @brief Builds the ustar header block for a regular file
+ *
+ * @param name File name, at most NAME_SIZE characters
+ * @param size File size in bytes (must fit in 11 octal digits)
+ * @param mtime Modification time (seconds since epoch)
+ * @return std::optional<std::array<char, BLOCK_SIZE>> nullopt if the name or size don't fit
+ */
+inline std::optional<std::array<char, BLOCK_SIZE>> file_header(std::string_view name, uint64_t size,
+                                                               uint64_t mtime = 0) {
+    if (name.empty() || name.size() > NAME_SIZE || size > 077777777777ULL) {
+        return std::nullopt;
+    }
+    std::array<char, BLOCK_SIZE> h{};
+    memcpy(h.data(), name.data(), name.size());
+    snprintf(&h[100], 8, "%07o", 0644);
+    snprintf(&h[108], 8, "%07o", 0);
+    snprintf(&h[116], 8, "%07o", 0);
+    snprintf(&h[124], 12, "%011llo", static_cast<unsigned long long>(size));
+    snprintf(&h[136], 12, "%011llo", static_cast<unsigned long long>(mtime & 077777777777ULL));
+    h[156] = '0';  // regular file
+    memcpy(&h[257], "ustar", 6);
+    memcpy(&h[263], "00", 2);
+    // checksum is computed with the checksum field filled with spaces
+    memset(&h[148], ' ', 8);
+    unsigned sum = 0;
+    for (char c: h) sum += static_cast<uint8_t>(c);
+    snprintf(&h[148], 8, "%06o", sum);  // six digits, NUL, then the space left from above
+    return h;
+}
+}  // namespace tar
+}  // namespace data_streamer
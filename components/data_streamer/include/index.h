@@ -0,0 +1,715 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "planner.h"
+#include "esp_log.h"
+
+
+namespace data_streamer {
+
+/**
+ * @brief A regular file of an indexed directory
+ */
+struct DirEntry {
+    std::string name;
+    uint64_t size{0};
+    time_t mtime{0};
+};
+
+/**
+ * @brief In-memory index of a directory: its regular files, sorted by name
+ *
+ * Lets FlatDirIterable serve filtered requests without reading and stat'ing the whole directory
+ * (see planner.h). Indexes are registered per directory with enable(), and are used by every
+ * FlatDirIterable over that directory. An index is rebuilt by build(), or as a side effect of any
+ * full scan of the directory. It goes stale `max_age` seconds after it was built (0: never), or when
+ * invalidate() is called, e.g. after files were added; stale indexes are not used until rebuilt.
+ * Removed files are skipped when the index is used, and invalidate it.
+ *
+ * Writers keep a built index current without rescans (see DirWatch): upsert() and remove() only append
+ * to a small journal, which is merged into the index when it's next read. Requests are only served
+ * from the index if every writer of the directory does so (Writers::Hooked): nothing else tells that a
+ * file was added, as FAT doesn't update the modification time of directories. Otherwise the index only
+ * gives estimates (total_size()), and requests scan the directory.
+ *
+ * warm_up() builds it incrementally instead, without holding it for the whole scan: while it runs,
+ * requests whose name bounds end before the first file not indexed yet are served from the partial
+ * index, and the others by a full scan (see IndexWarmUp to run it in the background).
+ *
+ * Example usage:
+ * @code
+ * auto index = DirIndex::enable("/sdcard/logs", DirIndex::Writers::Hooked);  // written by RecordWriter
+ * index->build();  // optional: the first full scan builds it otherwise
+ * @endcode
+ */
+class DirIndex {
+public:
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 4096;
+    static constexpr time_t DEFAULT_MAX_AGE = 60;
+    static constexpr size_t WARM_UP_BATCH = 32;
+    static constexpr size_t MAX_JOURNAL = 64;
+
+    /**
+     * @brief Who adds files to the indexed directory
+     */
+    enum class Writers {
+        Any,     ///< also writers that don't report their files: requests scan the directory
+        Hooked,  ///< only writers reporting to DirWatch, upsert() or remove(): requests use the index
+    };
+
+    /**
+     * @brief Progress of a warm-up
+     */
+    struct Progress {
+        size_t listed{0};    ///< files listed by the last warm-up
+        size_t indexed{0};   ///< of which already indexed
+        bool complete{false};///< the index is built (by the warm-up, build() or a full scan)
+    };
+
+    /**
+     * @brief Constructs an empty (stale) index.
+     *
+     * @param dir_path Indexed directory
+     * @param writers Whether all writers of the directory report their files, which lets requests use the index
+     * @param max_entries Larger directories aren't indexed, to bound memory use (~50 bytes per entry)
+     * @param max_age Seconds after which the index goes stale, 0 for never
+     */
+    explicit DirIndex(std::string_view dir_path, Writers writers = Writers::Any,
+                      size_t max_entries = DEFAULT_MAX_ENTRIES, time_t max_age = DEFAULT_MAX_AGE)
+        : dir_path{dir_path}, writers{writers}, max_entries{max_entries}, max_age{max_age} {}
+
+    /**
+     * @brief Registers an index for a directory, or returns the one already registered.
+     */
+    static std::shared_ptr<DirIndex> enable(std::string_view dir_path, Writers writers = Writers::Any,
+                                            size_t max_entries = DEFAULT_MAX_ENTRIES,
+                                            time_t max_age = DEFAULT_MAX_AGE) {
+        std::lock_guard lock(registry_mutex());
+        auto &slot = registry()[std::string(dir_path)];
+        if (!slot) {
+            slot = std::make_shared<DirIndex>(dir_path, writers, max_entries, max_age);
+        }
+        return slot;
+    }
+
+    /**
+     * @brief Gets the index registered for a directory, if any.
+     */
+    static std::shared_ptr<DirIndex> find(std::string_view dir_path) {
+        std::lock_guard lock(registry_mutex());
+        auto it = registry().find(dir_path);
+        return it == registry().end() ? nullptr : it->second;
+    }
+
+    /**
+     * @brief Unregisters the index of a directory. Iterables already using it keep it until destroyed.
+     */
+    static void disable(std::string_view dir_path) {
+        std::lock_guard lock(registry_mutex());
+        auto it = registry().find(dir_path);
+        if (it != registry().end()) {
+            registry().erase(it);
+        }
+    }
+
+    /**
+     * @brief Rebuilds the index by scanning the directory.
+     *
+     * @return std::optional<int> errno value on failure, nullopt on success
+     */
+    std::optional<int> build() {
+        time_t started = time(nullptr);
+        DIR *dir = opendir(dir_path.c_str());
+        if (dir == nullptr) {
+            return errno;
+        }
+        std::vector<DirEntry> scanned;
+        std::string full_path;
+        struct stat st{};
+        std::optional<int> err;
+        while (dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            full_path = dir_path + "/" + entry->d_name;
+            if (stat(full_path.c_str(), &st) == -1) {
+                err = errno;
+                break;
+            }
+            if (S_ISREG(st.st_mode)) {
+                scanned.push_back({entry->d_name, static_cast<uint64_t>(st.st_size), st.st_mtime});
+            }
+        }
+        closedir(dir);
+        if (err) {
+            return err;
+        }
+        if (!replace(std::move(scanned), started)) {
+            return EFBIG;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Replaces the content of the index with the result of a scan.
+     *
+     * @param scanned Regular files of the directory, in any order
+     * @param scanned_at Time the scan started
+     * @return bool false if the directory has too many entries to be indexed (the index is then stale)
+     */
+    bool replace(std::vector<DirEntry> scanned, time_t scanned_at) {
+        std::lock_guard lock(mutex);
+        generation++;  // supersedes a running warm-up
+        warming = false;
+        count = scanned.size();
+        if (scanned.size() > max_entries) {
+            ESP_LOGW(TAG, "%s has %zu entries, not indexed", dir_path.c_str(), scanned.size());
+            entries.clear();
+            entries.shrink_to_fit();
+            journal.clear();
+            built = false;
+            return false;
+        }
+        std::sort(scanned.begin(), scanned.end(), [](const auto &a, const auto &b) { return a.name < b.name; });
+        entries = std::move(scanned);
+        built_at = scanned_at;
+        built = true;
+        // changes journaled before the scan started are in it
+        std::erase_if(journal, [&](const Change &c) { return c.at < scanned_at; });
+        merge();
+        return true;
+    }
+
+    /**
+     * @brief Builds the index incrementally, publishing the files indexed so far after each batch.
+     *
+     * Lists the directory first, which is cheap, then stats its files in name order, which is what
+     * makes scans slow: from then on, the files named before the first one not stat'ed yet are indexed.
+     * A full scan or replace() completing meanwhile supersedes the warm-up. Does nothing if the index
+     * is fresh.
+     *
+     * @param yield Called between batches, e.g. to pause while requests are served; returns false to cancel
+     * @param batch Number of files stat'ed per batch
+     * @return std::optional<int> errno value on failure (ECANCELED if cancelled or superseded), nullopt on success
+     */
+    std::optional<int> warm_up(const std::function<bool()> &yield = nullptr, size_t batch = WARM_UP_BATCH) {
+        time_t started = time(nullptr);
+        uint64_t own_generation;
+        {
+            std::lock_guard lock(mutex);
+            if (is_fresh(started)) {
+                return std::nullopt;
+            }
+            own_generation = ++generation;
+            warming = false;
+            listed = indexed = 0;
+        }
+        DIR *dir = opendir(dir_path.c_str());
+        if (dir == nullptr) {
+            return errno;
+        }
+        std::vector<std::string> names;
+        while (dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                names.emplace_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+        if (names.size() > max_entries) {
+            ESP_LOGW(TAG, "%s has %zu entries, not indexed", dir_path.c_str(), names.size());
+            std::lock_guard lock(mutex);
+            journal.clear();
+            return EFBIG;
+        }
+        std::sort(names.begin(), names.end());
+        {
+            std::lock_guard lock(mutex);
+            if (generation != own_generation) {
+                return built ? std::nullopt : std::optional<int>(ECANCELED);
+            }
+            entries.clear();
+            std::erase_if(journal, [&](const Change &c) { return c.at < started; });
+            built = false;
+            warming = true;
+            count = listed = names.size();
+            pending = names.empty() ? std::nullopt : std::optional(names.front());
+        }
+        ESP_LOGI(TAG, "%s: warming up index of %zu entries", dir_path.c_str(), names.size());
+
+        std::vector<DirEntry> stated;
+        std::string full_path;
+        struct stat st{};
+        size_t i = 0;
+        do {
+            for (size_t end = std::min(i + batch, names.size()); i < end; i++) {
+                full_path = dir_path + "/" + names[i];
+                if (stat(full_path.c_str(), &st) == -1) {
+                    if (errno == ENOENT) {
+                        continue;  // removed since listed
+                    }
+                    int err = errno;
+                    std::lock_guard lock(mutex);
+                    if (generation == own_generation) {
+                        warming = false;
+                    }
+                    return err;
+                }
+                if (S_ISREG(st.st_mode)) {
+                    stated.push_back({names[i], static_cast<uint64_t>(st.st_size), st.st_mtime});
+                }
+            }
+            {
+                std::lock_guard lock(mutex);
+                if (generation != own_generation) {
+                    return built ? std::nullopt : std::optional<int>(ECANCELED);
+                }
+                for (auto &entry: stated) {
+                    insert(std::move(entry), false);  // entries merged from the journal are newer
+                }
+                indexed = i;
+                if (i < names.size()) {
+                    pending = names[i];
+                } else {
+                    pending.reset();
+                    warming = false;
+                    built = true;
+                    built_at = started;
+                    count = entries.size();
+                }
+            }
+            stated.clear();
+            if (i < names.size() && yield && !yield()) {
+                std::lock_guard lock(mutex);
+                if (generation == own_generation) {
+                    warming = false;
+                }
+                return ECANCELED;
+            }
+        } while (i < names.size());
+        ESP_LOGI(TAG, "%s: index warmed up in %llds", dir_path.c_str(), static_cast<long long>(time(nullptr) - started));
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Gets the progress of the last warm-up.
+     */
+    [[nodiscard]] Progress progress() const {
+        std::lock_guard lock(mutex);
+        return {.listed = listed, .indexed = indexed, .complete = built};
+    }
+
+    /**
+     * @brief Adds or updates one entry, e.g. when a writer completes a file (see DirWatch).
+     *
+     * Journaled in constant time, and merged when the index is next read. Stale indexes are left as they are.
+     */
+    void upsert(DirEntry entry) {
+        record({std::move(entry), time(nullptr), false});
+    }
+
+    /**
+     * @brief Removes one entry, e.g. when a file is deleted (see DirWatch).
+     *
+     * Journaled in constant time, like upsert().
+     */
+    void remove(std::string_view name) {
+        record({{std::string(name)}, time(nullptr), true});
+    }
+
+    /**
+     * @brief Marks the index stale, until the next build or full scan.
+     */
+    void invalidate() {
+        std::lock_guard lock(mutex);
+        built = false;
+        journal.clear();
+    }
+
+    /**
+     * @brief Checks whether the index is built and younger than max_age.
+     */
+    [[nodiscard]] bool fresh(time_t now) const {
+        std::lock_guard lock(mutex);
+        return is_fresh(now);
+    }
+
+    /**
+     * @brief Gets what the index knows about a request, for planning.
+     *
+     * The entry count of a stale index is the one of the last scan. An index being warmed up counts
+     * as fresh for the requests it already covers. An index of a directory with Writers::Any never
+     * counts as fresh: it can miss files added since it was built.
+     */
+    [[nodiscard]] plan::DirStats stats(const DirFilter &filter, time_t now) {
+        std::lock_guard lock(mutex);
+        merge();
+        const bool trusted = writers == Writers::Hooked;
+        plan::DirStats s{.entries = count, .index_fresh = trusted && is_fresh(now)};
+        if (trusted && !s.index_fresh && warming && covers(filter)) {
+            s.index_fresh = s.index_partial = true;
+        }
+        if (s.index_fresh) {
+            auto [first, last] = bounds(filter);
+            s.range_entries = static_cast<size_t>(last - first);
+            s.matching = static_cast<size_t>(std::count_if(first, last, [&](const auto &e) {
+                return filter.matches(e.name, e.mtime);
+            }));
+        }
+        return s;
+    }
+
+    /**
+     * @brief Gets the entries matching a request, in name order.
+     *
+     * @param filter Filters of the request
+     * @param strategy IndexSeek to only visit the entries within the name bounds, IndexScan to visit all
+     * @return std::vector<DirEntry> Matching entries (empty if the index is stale)
+     * @note While warming up, only the entries of requests covered so far are complete (see stats())
+     */
+    [[nodiscard]] std::vector<DirEntry> select(const DirFilter &filter, plan::Strategy strategy) {
+        std::lock_guard lock(mutex);
+        merge();
+        std::vector<DirEntry> out;
+        if (!built && !warming) {
+            return out;
+        }
+        auto [first, last] = strategy == plan::Strategy::IndexSeek ?
+            bounds(filter) : std::pair{entries.begin(), entries.end()};
+        for (auto it = first; it != last; ++it) {
+            if (filter.matches(it->name, it->mtime)) {
+                out.push_back(*it);
+            }
+        }
+        return out;
+    }
+
+    /**
+     * @brief Sums the sizes of the entries matching a filter, e.g. the backlog after a consumption cursor.
+     *
+     * Also answered by an index that is built but past its max_age, as an estimate.
+     *
+     * @return std::optional<uint64_t> nullopt if the index isn't built
+     */
+    [[nodiscard]] std::optional<uint64_t> total_size(const DirFilter &filter) {
+        std::lock_guard lock(mutex);
+        merge();
+        if (!built) {
+            return std::nullopt;
+        }
+        uint64_t total = 0;
+        auto [first, last] = bounds(filter);
+        for (auto it = first; it != last; ++it) {
+            if (filter.matches(it->name, it->mtime)) {
+                total += it->size;
+            }
+        }
+        return total;
+    }
+
+    [[nodiscard]] const std::string &path() const { return dir_path; }
+
+    /**
+     * @brief Gets the number of indexed entries.
+     */
+    [[nodiscard]] size_t size() {
+        std::lock_guard lock(mutex);
+        merge();
+        return entries.size();
+    }
+
+private:
+    using const_iterator = std::vector<DirEntry>::const_iterator;
+
+    // a change reported by a writer, not merged yet
+    struct Change {
+        DirEntry entry;
+        time_t at;
+        bool removed;
+    };
+
+    void record(Change change) {
+        std::lock_guard lock(mutex);
+        if (!built && !warming) {
+            return;
+        }
+        journal.push_back(std::move(change));
+        if (journal.size() >= MAX_JOURNAL) {
+            merge();
+        }
+    }
+
+    // applies the journal, in order
+    void merge() {
+        for (auto &change: journal) {
+            if (!built && !warming) {
+                break;  // went stale
+            }
+            if (change.removed) {
+                erase(change.entry.name);
+            } else {
+                insert(std::move(change.entry));
+            }
+        }
+        journal.clear();
+    }
+
+    [[nodiscard]] bool is_fresh(time_t now) const {
+        return built && (max_age == 0 || now - built_at <= max_age);
+    }
+
+    // while warming up: whether all names within the bounds of a filter are before the first pending one
+    [[nodiscard]] bool covers(const DirFilter &filter) const {
+        if (!pending) {
+            return true;
+        }
+        if (filter.to && *filter.to < *pending) {
+            return true;
+        }
+        return filter.prefix && *filter.prefix < *pending && !pending->starts_with(*filter.prefix);
+    }
+
+    [[nodiscard]] std::vector<DirEntry>::iterator lower_bound(const std::string &name) {
+        return std::lower_bound(entries.begin(), entries.end(), name,
+                                [](const DirEntry &e, const std::string &n) { return e.name < n; });
+    }
+
+    // sorted insert or update; an index that would exceed max_entries goes stale
+    void insert(DirEntry entry, bool overwrite = true) {
+        auto it = lower_bound(entry.name);
+        if (it != entries.end() && it->name == entry.name) {
+            if (overwrite) {
+                *it = std::move(entry);
+            }
+            return;
+        }
+        if (entries.size() >= max_entries) {
+            built = false;
+            warming = false;
+            generation++;
+            return;
+        }
+        entries.insert(it, std::move(entry));
+        if (built) {
+            count = entries.size();
+        }
+    }
+
+    void erase(const std::string &name) {
+        auto it = lower_bound(name);
+        if (it != entries.end() && it->name == name) {
+            entries.erase(it);
+            if (built) {
+                count = entries.size();
+            }
+        }
+    }
+
+    // entries within the name bounds of a filter (from, after, to, prefix)
+    [[nodiscard]] std::pair<const_iterator, const_iterator> bounds(const DirFilter &filter) const {
+        auto less = [](const DirEntry &e, std::string_view name) { return e.name < name; };
+        auto first = entries.begin();
+        auto last = entries.end();
+        if (filter.from) {
+            first = std::max(first, std::lower_bound(entries.begin(), entries.end(), *filter.from, less));
+        }
+        if (filter.after) {
+            first = std::max(first, std::upper_bound(entries.begin(), entries.end(), *filter.after,
+                                                     [](std::string_view name, const DirEntry &e) {
+                                                         return name < e.name;
+                                                     }));
+        }
+        if (filter.prefix) {
+            auto p = std::lower_bound(entries.begin(), entries.end(), *filter.prefix, less);
+            first = std::max(first, p);
+            last = std::min(last, std::partition_point(p, entries.end(), [&](const DirEntry &e) {
+                return e.name.starts_with(*filter.prefix);
+            }));
+        }
+        if (filter.to) {
+            last = std::min(last, std::upper_bound(entries.begin(), entries.end(), *filter.to,
+                                                   [](std::string_view name, const DirEntry &e) {
+                                                       return name < e.name;
+                                                   }));
+        }
+        return {first, std::max(first, last)};
+    }
+
+    static std::map<std::string, std::shared_ptr<DirIndex>, std::less<>> &registry() {
+        static std::map<std::string, std::shared_ptr<DirIndex>, std::less<>> indexes;
+        return indexes;
+    }
+
+    static std::mutex &registry_mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    std::string dir_path;
+    Writers writers;
+    size_t max_entries;
+    time_t max_age;
+    mutable std::mutex mutex;
+    std::vector<DirEntry> entries;
+    size_t count{0};
+    bool built{false};
+    time_t built_at{0};
+    uint64_t generation{0};             // bumped by each warm-up and replace(), to detect superseded warm-ups
+    bool warming{false};                // a warm-up is publishing entries
+    std::optional<std::string> pending; // while warming, first listed name not indexed yet
+    size_t listed{0};
+    size_t indexed{0};
+    std::vector<Change> journal;        // changes reported by writers since the last read
+};
+
+
+/**
+ * @brief Warms up directory indexes on a background thread, e.g. right after mounting the card
+ *
+ * Indexes are warmed up one after the other (see DirIndex::warm_up()). Between batches, the thread
+ * sleeps for `pause`, then for as long as `busy` returns true, so that requests get the card first.
+ * It inherits the priority of the thread calling start() (on ESP-IDF, see esp_pthread_set_cfg()).
+ *
+ * Example usage:
+ * @code
+ * static auto warm_up = IndexWarmUp([] { return streamer.active_streams() > 0; });
+ * warm_up.add(DirIndex::enable("/sdcard/logs", DirIndex::Writers::Hooked));
+ * warm_up.start();
+ * @endcode
+ */
+class IndexWarmUp {
+public:
+    explicit IndexWarmUp(std::function<bool()> busy = nullptr,
+                         std::chrono::milliseconds pause = std::chrono::milliseconds(10))
+        : busy{std::move(busy)},
+          pause{pause} {}
+
+    IndexWarmUp(const IndexWarmUp&) = delete;
+    IndexWarmUp& operator=(const IndexWarmUp&) = delete;
+
+    ~IndexWarmUp() {
+        stop();
+    }
+
+    /**
+     * @brief Adds an index to warm up (before start())
+     */
+    void add(std::shared_ptr<DirIndex> index) {
+        indexes.push_back(std::move(index));
+    }
+
+    /**
+     * @brief Starts the background thread
+     *
+     * @return bool false if already started
+     */
+    bool start() {
+        std::lock_guard lock(mutex);
+        if (worker.joinable()) return false;
+        stopping = false;
+        finished = false;
+        worker = std::thread([this] { run(); });
+        return true;
+    }
+
+    /**
+     * @brief Stops the background thread, leaving the indexes partially built
+     */
+    void stop() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    /**
+     * @brief Gets the progress over all indexes
+     */
+    [[nodiscard]] DirIndex::Progress progress() const {
+        DirIndex::Progress total{.complete = true};
+        for (const auto &index: indexes) {
+            auto p = index->progress();
+            total.listed += p.listed;
+            total.indexed += p.indexed;
+            total.complete = total.complete && p.complete;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Checks whether all indexes were warmed up (or failed to)
+     */
+    [[nodiscard]] bool done() const {
+        std::lock_guard lock(mutex);
+        return finished;
+    }
+
+private:
+    void run() {
+        for (auto &index: indexes) {
+            auto err = index->warm_up([this] { return wait(); });
+            if (err && *err != ECANCELED) {
+                ESP_LOGW(TAG, "Index warm-up of %s failed, err %d", index->path().c_str(), *err);
+            }
+            std::lock_guard lock(mutex);
+            if (stopping) break;
+        }
+        std::lock_guard lock(mutex);
+        finished = true;
+    }
+
+    // between batches: false to cancel
+    bool wait() {
+        std::unique_lock lock(mutex);
+        do {
+            wake.wait_for(lock, pause, [this] { return stopping; });
+        } while (!stopping && busy && busy());
+        return !stopping;
+    }
+
+    std::function<bool()> busy;
+    std::chrono::milliseconds pause;
+    std::vector<std::shared_ptr<DirIndex>> indexes;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    bool stopping{false};
+    bool finished{false};
+};
+
+}  // namespace data_streamer
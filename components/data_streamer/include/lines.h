@@ -0,0 +1,294 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/stat.h>
+#include "config.h"
+
+
+/**
+ * Line-number access to text files, through a sparse index of line offsets.
+ *
+ * The index of `<path>` is kept in the sidecar file `<path>.lines` (integers in the device's byte order):
+ *   u32 stride, then the u32 offsets of lines 1 + stride, 1 + 2 * stride, ... in order
+ * It is built lazily, as line ranges are requested, and extended as far as lines are scanned. Indexed
+ * files are assumed to be append-only, as logs are: an index pointing past the end of its file is dropped.
+ */
+namespace data_streamer::lines {
+
+inline constexpr char SIDECAR_SUFFIX[] = ".lines";
+
+/**
+ * @brief An inclusive range of line numbers, starting at 1
+ */
+struct LineRange {
+    size_t first{1};
+    std::optional<size_t> last{};  ///< nullopt: up to the end of the file
+};
+
+/**
+ * @brief Parses a line range: "a-b", "a-" or "a"
+ *
+ * @return std::optional<LineRange> nullopt if malformed
+ */
+inline std::optional<LineRange> parse(std::string_view spec) {
+    auto to_size = [](std::string_view s, size_t &out) {
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        return !s.empty() && ec == std::errc() && ptr == s.data() + s.size();
+    };
+    LineRange range;
+    auto dash = spec.find('-');
+    if (!to_size(spec.substr(0, dash), range.first) || range.first == 0) return std::nullopt;
+    if (dash == std::string_view::npos) {
+        range.last = range.first;
+    } else if (dash + 1 < spec.size()) {
+        size_t last;
+        if (!to_size(spec.substr(dash + 1), last) || last < range.first) return std::nullopt;
+        range.last = last;
+    }
+    return range;
+}
+
+/**
+ * @brief Counts the newlines of a buffer, a word at a time
+ */
+inline size_t count_newlines(std::span<const char> data) {
+    constexpr uint64_t ones = 0x0101010101010101ULL;
+    constexpr uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data.data() + i, sizeof(word));
+        uint64_t x = word ^ (ones * '\n');  // newline bytes become zero
+        // high bit set in each zero byte, exactly (no carries between bytes)
+        uint64_t zeros = ~(((x & low7) + low7) | x | low7);
+        count += std::popcount(zeros);
+    }
+    for (; i < data.size(); i++) {
+        count += data[i] == '\n';
+    }
+    return count;
+}
+
+/**
+ * @brief Finds the n-th newline (from 1) of a buffer
+ *
+ * @return size_t Its position, or npos if the buffer has fewer newlines
+ */
+inline size_t find_newline(std::span<const char> data, size_t n) {
+    const char *p = data.data();
+    const char *end = data.data() + data.size();
+    while (p < end) {
+        auto nl = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (nl == nullptr) break;
+        if (--n == 0) return nl - data.data();
+        p = nl + 1;
+    }
+    return std::string_view::npos;
+}
+
+/**
+ * @brief A line start: its number and offset
+ */
+struct Checkpoint {
+    size_t line{1};
+    size_t offset{0};
+};
+
+/**
+ * @brief Sparse index of the line offsets of a file, stored in a sidecar file
+ *
+ * Example usage:
+ * @code
+ * auto index = lines::LineIndex("/sdcard/log.txt");
+ * auto start = index.seek_point(120000);  // nearest indexed line start before line 120000
+ * // ...read from start.offset, calling index.add() for the line starts found (see LineCursor)
+ * index.save();
+ * @endcode
+ */
+class LineIndex {
+public:
+    /**
+     * @brief Loads the index of a file, if any
+     *
+     * @param file_path Path to the indexed file
+     * @param stride Number of lines between indexed line starts; an index with another stride is dropped
+     */
+    explicit LineIndex(std::string_view file_path, size_t stride = LINE_INDEX_STRIDE)
+    : sidecar{std::string(file_path) + SIDECAR_SUFFIX},
+      stride{stride > 0 ? stride : 1} {
+        struct stat st{};
+        if (stat(std::string(file_path).c_str(), &st) != 0) return;
+        FILE *f = fopen(sidecar.c_str(), "rb");
+        if (f == nullptr) return;
+        uint32_t header = 0;
+        uint32_t offset;
+        if (fread(&header, sizeof(header), 1, f) == 1 && header == this->stride) {
+            while (fread(&offset, sizeof(offset), 1, f) == 1 && offset <= static_cast<uint64_t>(st.st_size)) {
+                offsets.push_back(offset);
+            }
+            // an index past the end of the file (that was rewritten) is dropped entirely
+            if (!feof(f)) offsets.clear();
+            // a sidecar file ending with a partial entry is rewritten
+            rewrite = offsets.empty() || ftell(f) != static_cast<long>(sizeof(uint32_t) * (1 + offsets.size()));
+        }
+        fclose(f);
+        saved = rewrite ? 0 : offsets.size();
+    }
+
+    /**
+     * @brief Gets the nearest indexed line start at or before a line
+     */
+    [[nodiscard]] Checkpoint seek_point(size_t line) const {
+        size_t k = std::min((line - 1) / stride, offsets.size());
+        return k == 0 ? Checkpoint{} : Checkpoint{1 + k * stride, offsets[k - 1]};
+    }
+
+    /**
+     * @brief Gets the number of the next line start to index
+     */
+    [[nodiscard]] size_t next_line() const {
+        return 1 + (offsets.size() + 1) * stride;
+    }
+
+    /**
+     * @brief Indexes a line start, if it's the next one to index
+     */
+    void add(const Checkpoint &start) {
+        if (start.line == next_line() && start.offset <= std::numeric_limits<uint32_t>::max()) {
+            offsets.push_back(static_cast<uint32_t>(start.offset));
+        }
+    }
+
+    /**
+     * @brief Appends the line starts added since loading to the sidecar file
+     *
+     * @return std::optional<int> errno value on error, nullopt otherwise
+     */
+    std::optional<int> save() {
+        if (offsets.size() == saved) return std::nullopt;
+        FILE *f = fopen(sidecar.c_str(), rewrite ? "wb" : "ab");
+        if (f == nullptr) return errno;
+        auto header = static_cast<uint32_t>(stride);
+        bool ok = (!rewrite || fwrite(&header, sizeof(header), 1, f) == 1) &&
+                  fwrite(offsets.data() + saved, sizeof(uint32_t), offsets.size() - saved, f) == offsets.size() - saved;
+        int err = errno;
+        if (fclose(f) != 0 && ok) {
+            ok = false;
+            err = errno;
+        }
+        if (!ok) return err;
+        saved = offsets.size();
+        rewrite = false;
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Gets the number of indexed line starts (besides line 1)
+     */
+    [[nodiscard]] size_t size() const {
+        return offsets.size();
+    }
+
+private:
+    std::string sidecar;
+    size_t stride;
+    std::vector<uint32_t> offsets;  // of lines 1 + stride, 1 + 2 * stride...
+    size_t saved{0};  // number of offsets in the sidecar file
+    bool rewrite{true};  // the sidecar file is missing or invalid
+};
+
+/**
+ * @brief Selects the bytes of a line range in a file read from an indexed line start
+ *
+ * The file content is fed in chunks; line starts met on the way extend the index.
+ */
+class LineCursor {
+public:
+    /**
+     * @param index Index of the file, extended as lines are scanned
+     * @param range Lines to select
+     * @param start Line start the content is fed from (typically index.seek_point(range.first))
+     */
+    LineCursor(LineIndex &index, const LineRange &range, const Checkpoint &start)
+    : index{index}, range{range}, pos{start} {}
+
+    /**
+     * @brief Feeds the next chunk of content
+     *
+     * @return std::span<const char> Part of the chunk within the selected lines (possibly empty)
+     */
+    std::span<const char> feed(std::span<const char> chunk) {
+        size_t begin = std::string_view::npos;
+        size_t i = 0;
+        while (i < chunk.size() && !done()) {
+            if (pos.line >= range.first && begin == std::string_view::npos) begin = i;
+            auto rest = chunk.subspan(i);
+            size_t target = next_event();
+            size_t needed = target - pos.line;
+            // skip chunks with fewer newlines than needed without looking for them one by one
+            size_t n = count_newlines(rest);
+            if (n < needed) {
+                pos.line += n;
+                i = chunk.size();
+                break;
+            }
+            i += find_newline(rest, needed) + 1;
+            pos.line = target;
+            pos.offset = base + i;
+            index.add(pos);
+        }
+        base += chunk.size();
+        if (begin == std::string_view::npos) return {};
+        return chunk.subspan(begin, i - begin);
+    }
+
+    /**
+     * @brief Whether the whole range was selected
+     */
+    [[nodiscard]] bool done() const {
+        return range.last && pos.line > *range.last;
+    }
+
+private:
+    // number of the next line start to stop at
+    [[nodiscard]] size_t next_event() const {
+        size_t target = pos.line < range.first ? range.first
+                      : range.last ? *range.last + 1
+                      : std::numeric_limits<size_t>::max();
+        size_t indexed = index.next_line();
+        return indexed > pos.line && indexed < target ? indexed : target;
+    }
+
+    LineIndex &index;
+    LineRange range;
+    Checkpoint pos;  // current line, and its start offset once reached
+    size_t base{pos.offset};  // offset of the chunk being fed
+};
+}  // namespace data_streamer::lines
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "concepts.h"
+
+
+namespace data_streamer {
+
+/**
+ * @brief Filters of a directory request, on the name and modification time of the items
+ *
+ * All set filters must match. Name bounds use the lexicographic order of the streamer's `from`/`to`.
+ */
+struct DirFilter {
+    std::optional<std::string> from{};    ///< inclusive lower bound of the name
+    std::optional<std::string> after{};   ///< exclusive lower bound of the name (e.g. the consumption cursor)
+    std::optional<std::string> to{};      ///< inclusive upper bound of the name
+    std::optional<std::string> prefix{};  ///< the name starts with it
+    std::optional<time_t> since{};        ///< modified at or after it
+    bool settled{false};                  ///< yield items in name order, stopping before the first one not complete
+                                          ///< (still being written, see DirWatch)
+
+    /**
+     * @brief Checks whether the name filters bound a contiguous range of names.
+     */
+    [[nodiscard]] bool bounds_names() const {
+        return from || after || to || prefix;
+    }
+
+    /**
+     * @brief Checks the name filters.
+     */
+    [[nodiscard]] bool matches_name(std::string_view name) const {
+        if (from && name < *from) return false;
+        if (after && name <= *after) return false;
+        if (to && name > *to) return false;
+        if (prefix && !name.starts_with(*prefix)) return false;
+        return true;
+    }
+
+    /**
+     * @brief Checks all filters.
+     */
+    [[nodiscard]] bool matches(std::string_view name, time_t mtime) const {
+        return matches_name(name) && (!since || mtime >= *since);
+    }
+};
+
+namespace plan {
+
+/**
+ * @brief Ways of executing a directory request
+ */
+enum class Strategy {
+    FullScan,   ///< readdir() and stat() every entry, open the matching ones
+    IndexSeek,  ///< binary search of the name bounds in a sorted index, open the matching entries
+    IndexScan,  ///< walk the whole index (e.g. for a `since` filter only), open the matching entries
+};
+constexpr size_t STRATEGY_COUNT = 3;
+
+inline const char *strategy_name(Strategy s) {
+    switch (s) {
+        case Strategy::FullScan: return "full_scan";
+        case Strategy::IndexSeek: return "index_seek";
+        case Strategy::IndexScan: return "index_scan";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Cost of the elementary operations of a plan, in microseconds
+ *
+ * Defaults are typical of FAT on an SD card over SPI, where stat() searches the directory again.
+ * Change them through cost_model() to match the actual storage.
+ */
+struct CostModel {
+    double readdir_us{60};      ///< read one directory entry
+    double stat_us{400};        ///< stat one entry
+    double open_us{900};        ///< open one file
+    double index_entry_us{0.3}; ///< visit one entry of an in-memory index
+};
+
+/**
+ * @brief Cost model used by the directory streamers
+ */
+inline CostModel &cost_model() {
+    static CostModel model;
+    return model;
+}
+
+/**
+ * @brief What is known about a directory when planning a request
+ */
+struct DirStats {
+    size_t entries{0};         ///< number of entries: exact with an index, else the last count seen (or a guess)
+    bool index_fresh{false};   ///< a fresh sorted index of the directory is available
+    bool index_partial{false}; ///< ...still being built, but covering the name bounds of the request
+    size_t range_entries{0};   ///< with an index, entries within the name bounds
+    size_t matching{0};        ///< with an index, entries matching all filters
+};
+
+/**
+ * @brief Cost estimate of one strategy
+ */
+struct Estimate {
+    Strategy strategy{Strategy::FullScan};
+    bool available{false};
+    double cost_us{0};
+    size_t rows{0};            ///< items estimated to match
+};
+
+/**
+ * @brief A plan: the chosen strategy and the estimates of all strategies
+ */
+struct Plan {
+    Strategy strategy{Strategy::FullScan};
+    DirStats stats{};
+    std::array<Estimate, STRATEGY_COUNT> estimates{};
+
+    [[nodiscard]] const Estimate &chosen() const {
+        return estimates[static_cast<size_t>(strategy)];
+    }
+
+    /**
+     * @brief Describes the plan as a JSON object (the `?explain=1` response body)
+     */
+    [[nodiscard]] std::string to_json() const {
+        char buf[128];
+        std::string json;
+        snprintf(buf, sizeof(buf), R"({"strategy":"%s","entries":%zu,"index":"%s","estimates":[)",
+                 strategy_name(strategy), stats.entries, stats.index_partial ? "partial" : stats.index_fresh ? "fresh" : "none");
+        json += buf;
+        bool first = true;
+        for (const auto &e: estimates) {
+            if (!e.available) continue;
+            snprintf(buf, sizeof(buf), R"(%s{"strategy":"%s","cost_us":%.0f,"rows":%zu})",
+                     first ? "" : ",", strategy_name(e.strategy), e.cost_us, e.rows);
+            json += buf;
+            first = false;
+        }
+        json += "]}";
+        return json;
+    }
+};
+
+// selectivity assumed for a filter when no index tells better
+constexpr double GUESSED_SELECTIVITY = 0.5;
+
+/**
+ * @brief Estimates the cost of each strategy for a request, and picks the cheapest.
+ *
+ * Without a fresh index, only a full scan is possible, and its row count is a guess.
+ *
+ * @param filter Filters of the request
+ * @param stats What is known about the directory
+ * @param model Cost of the elementary operations
+ * @return Plan
+ */
+inline Plan choose(const DirFilter &filter, const DirStats &stats, const CostModel &model = cost_model()) {
+    Plan p{.stats = stats};
+    const auto n = static_cast<double>(stats.entries);
+    size_t rows = stats.matching;
+    if (!stats.index_fresh) {
+        double selectivity = 1.0;
+        if (filter.bounds_names()) selectivity *= GUESSED_SELECTIVITY;
+        if (filter.since) selectivity *= GUESSED_SELECTIVITY;
+        rows = static_cast<size_t>(n * selectivity);
+    }
+    const double open_cost = static_cast<double>(rows) * model.open_us;
+
+    auto &scan = p.estimates[static_cast<size_t>(Strategy::FullScan)];
+    scan = {Strategy::FullScan, true, n * (model.readdir_us + model.stat_us) + open_cost, rows};
+
+    auto &seek = p.estimates[static_cast<size_t>(Strategy::IndexSeek)];
+    seek = {Strategy::IndexSeek, stats.index_fresh && filter.bounds_names(),
+            (2 * std::log2(n + 1) + static_cast<double>(stats.range_entries)) * model.index_entry_us + open_cost,
+            rows};
+
+    auto &walk = p.estimates[static_cast<size_t>(Strategy::IndexScan)];
+    walk = {Strategy::IndexScan, stats.index_fresh, n * model.index_entry_us + open_cost, rows};
+
+    for (const auto &e: p.estimates) {
+        if (e.available && e.cost_us < p.chosen().cost_us) {
+            p.strategy = e.strategy;
+        }
+    }
+    return p;
+}
+
+}  // namespace plan
+
+/**
+ * @brief Concept for IterableOfChunkables types that can execute a plan
+ *
+ * DataStreamer pushes the filters of a request down to such types before iterating, so that they can
+ * skip non-matching items without opening them, using the cheapest strategy at hand.
+ *
+ * Requirements:
+ * - Must satisfy IterableOfChunkables
+ * - Must provide a plan(const DirFilter&) method returning plan::Plan, to be called before begin().
+ *   Iteration then only yields items matching the filter.
+ */
+template<typename T>
+concept PlannedIterable = IterableOfChunkables<T> &&
+    requires(T c, const DirFilter &f) {
+    { c.plan(f) } -> std::same_as<plan::Plan>;
+    };
+
+}  // namespace data_streamer
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace data_streamer::range {
+
+inline constexpr char STATUS_206[] = "206 Partial Content";
+inline constexpr char STATUS_416[] = "416 Range Not Satisfiable";
+
+// Max accepted length of a Range header; longer headers are ignored
+inline constexpr size_t MAX_HEADER_SIZE = 128;
+// Max number of ranges honoured in one request; requests with more are served whole
+inline constexpr size_t MAX_RANGES = 8;
+// Ranges closer than this are merged: the gap is cheaper to send than another part and seek
+// (and is likely within the SD sector already read)
+inline constexpr size_t COALESCE_GAP = 512;
+
+/**
+ * @brief An inclusive byte range within an item, as in HTTP Range headers
+ */
+struct ByteRange {
+    size_t first;
+    size_t last;
+
+    [[nodiscard]] size_t length() const { return last - first + 1; }
+};
+
+/**
+ * @brief Outcome of evaluating a Range header against an item size
+ */
+enum class RangeResult {
+    Ignore,         ///< absent, malformed or unsupported: send the whole item (200)
+    Satisfiable,    ///< send the ranges (206)
+    Unsatisfiable,  ///< no range overlaps the item (416)
+};
+
+/**
+ * @brief Parses one range-spec ("a-b", "a-" or "-n")
+ *
+ * @return false if malformed
+ */
+inline bool parse_spec(std::string_view spec, size_t &first, std::optional<size_t> &last, bool &suffix) {
+    auto dash = spec.find('-');
+    if (dash == std::string_view::npos) return false;
+    auto a = spec.substr(0, dash);
+    auto b = spec.substr(dash + 1);
+    auto to_size = [](std::string_view s, size_t &out) {
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        return !s.empty() && ec == std::errc() && ptr == s.data() + s.size();
+    };
+    suffix = a.empty();
+    if (suffix) {  // "-n": last n bytes
+        return to_size(b, first);
+    }
+    if (!to_size(a, first)) return false;
+    if (b.empty()) {
+        last.reset();
+        return true;
+    }
+    size_t l;
+    if (!to_size(b, l) || l < first) return false;
+    last = l;
+    return true;
+}
+
+/**
+ * @brief Evaluates a Range header value (RFC 9110 byte ranges) against an item of the given size
+ *
+ * Ranges are clamped to the item, and unsatisfiable ones dropped. Any syntax error makes the
+ * whole header ignored, as the RFC allows.
+ *
+ * @param header Range header value, e.g. "bytes=0-1023"
+ * @param size Item size in bytes
+ * @param out Satisfiable ranges, in request order
+ */
+inline RangeResult parse(std::string_view header, size_t size, std::vector<ByteRange> &out) {
+    out.clear();
+    auto trim = [](std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+        return s;
+    };
+    header = trim(header);
+    constexpr std::string_view unit = "bytes=";
+    if (header.substr(0, unit.size()) != unit) return RangeResult::Ignore;
+    header.remove_prefix(unit.size());
+    size_t n_specs = 0;
+    while (true) {
+        auto comma = header.find(',');
+        auto spec = trim(header.substr(0, comma));
+        if (!spec.empty()) {
+            if (++n_specs > MAX_RANGES) {
+                out.clear();
+                return RangeResult::Ignore;
+            }
+            size_t first;
+            std::optional<size_t> last;
+            bool suffix;
+            if (!parse_spec(spec, first, last, suffix)) {
+                out.clear();
+                return RangeResult::Ignore;
+            }
+            if (suffix) {
+                if (first > 0 && size > 0) {
+                    out.push_back({size - std::min(first, size), size - 1});
+                }
+            } else if (first < size) {
+                out.push_back({first, std::min(last.value_or(size - 1), size - 1)});
+            }
+        }
+        if (comma == std::string_view::npos) break;
+        header.remove_prefix(comma + 1);
+    }
+    if (n_specs == 0) return RangeResult::Ignore;
+    return out.empty() ? RangeResult::Unsatisfiable : RangeResult::Satisfiable;
+}
+
+/**
+ * @brief Sorts ranges by offset, and merges the ones that overlap or are separated by less than gap bytes
+ *
+ * Served ranges then only seek forward, as RFC 9110 allows.
+ *
+ * @param ranges Ranges to coalesce, in place
+ * @param gap Max number of unrequested bytes between two merged ranges
+ */
+inline void coalesce(std::vector<ByteRange> &ranges, size_t gap = COALESCE_GAP) {
+    std::sort(ranges.begin(), ranges.end(), [](const ByteRange &a, const ByteRange &b) { return a.first < b.first; });
+    size_t n = 0;
+    for (const auto &r: ranges) {
+        if (n > 0 && r.first <= ranges[n - 1].last + 1 + gap) {
+            ranges[n - 1].last = std::max(ranges[n - 1].last, r.last);
+        } else {
+            ranges[n++] = r;
+        }
+    }
+    ranges.resize(n);
+}
+
+/**
+ * @brief Formats a Content-Range header value, e.g. "bytes 0-1023/4096"
+ */
+inline std::string content_range(const ByteRange &r, size_t size) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "bytes %zu-%zu/%zu", r.first, r.last, size);
+    return buf;
+}
+
+/**
+ * @brief Formats the Content-Range header value of a 416 response, e.g. "bytes *\/4096"
+ */
+inline std::string unsatisfied_range(size_t size) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "bytes */%zu", size);
+    return buf;
+}
+}  // namespace data_streamer::range
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "config.h"
+#include "vfs_streamer.h"
+#include "esp_log.h"
+
+
+namespace data_streamer {
+
+/**
+ * @brief Limits enforced on a streamed directory by DirRetention
+ *
+ * Unset limits are not enforced. Files are removed oldest-first, oldest meaning first in name
+ * order: the order used by the streamer's `from`/`to` filters and by the consumption cursor.
+ */
+struct RetentionPolicy {
+    std::optional<time_t> max_age{};       ///< seconds since last modification
+    std::optional<uint64_t> max_bytes{};   ///< total size of the files in the directory
+    std::optional<size_t> max_entries{};   ///< number of files in the directory
+    bool only_acknowledged{false};         ///< only remove files up to the consumption cursor (see DirConsumer)
+    std::string archive_path{};            ///< move removed files there instead of deleting them
+    std::string cursor_path{};             ///< cursor file, empty for the DirConsumer default
+    size_t max_removals_per_run{16};       ///< I/O budget of one run
+};
+
+/**
+ * @brief Outcome of one retention run
+ */
+struct RetentionStats {
+    size_t entries{0};              ///< files in the directory before the run
+    uint64_t bytes{0};              ///< their total size
+    size_t removed{0};
+    uint64_t bytes_removed{0};
+    bool budget_exhausted{false};   ///< more files are due for removal
+    bool interrupted{false};        ///< stopped because the storage got busy
+    std::optional<int> error{};     ///< errno value if an error occurred
+};
+
+/**
+ * @brief Enforces a RetentionPolicy on a flat directory
+ *
+ * A run scans the directory once (readdir and stat, like FlatDirIterable), keeping only the
+ * `max_removals_per_run` oldest files in memory, then removes files oldest-first while any limit
+ * is exceeded. Before each removal it checks the `busy` predicate, so that it backs off as soon
+ * as the storage is needed to serve a download.
+ *
+ * Example usage:
+ * @code
+ * auto retention = DirRetention("/sdcard/logs", {.max_bytes = 512 * 1024 * 1024, .only_acknowledged = true},
+ *                               [&] { return streamer.active_streams() > 0; });
+ * auto stats = retention.run_once();
+ * @endcode
+ */
+class DirRetention {
+public:
+    /**
+     * @brief Constructs a DirRetention for the specified directory.
+     *
+     * @param dir_path Directory to keep within limits
+     * @param policy Limits to enforce
+     * @param busy Returns true while the storage should be left alone; null for never
+     */
+    DirRetention(std::string_view dir_path, RetentionPolicy policy, std::function<bool()> busy = nullptr)
+        : dir_path{dir_path},
+          policy{std::move(policy)},
+          busy{std::move(busy)} {
+        if (this->policy.cursor_path.empty()) {
+            this->policy.cursor_path = DirConsumer::default_cursor_path(this->dir_path);
+        }
+    }
+
+    /**
+     * @brief Runs the policy once.
+     *
+     * @param now Current time, for max_age
+     * @return RetentionStats
+     */
+    RetentionStats run_once(time_t now = time(nullptr)) {
+        RetentionStats stats;
+        if (is_busy()) {
+            stats.interrupted = true;
+            return stats;
+        }
+        auto candidates = scan(stats, now);
+        if (stats.error) return stats;
+
+        std::optional<std::string> cursor;
+        if (policy.only_acknowledged) {
+            cursor = DirConsumer::read_cursor(policy.cursor_path);
+        }
+        if (!policy.archive_path.empty() && mkdir(policy.archive_path.c_str(), 0755) != 0 && errno != EEXIST) {
+            stats.error = errno;
+            return stats;
+        }
+        size_t entries = stats.entries;
+        uint64_t bytes = stats.bytes;
+        auto index = DirIndex::find(dir_path);
+        for (const auto &file: candidates) {
+            if (!due(file, entries, bytes, now)) break;
+            if (policy.only_acknowledged && (!cursor || file.name > *cursor)) break;
+            if (is_busy()) {
+                stats.interrupted = true;
+                break;
+            }
+            auto path = dir_path + "/" + file.name;
+            int ret = policy.archive_path.empty() ?
+                unlink(path.c_str()) :
+                rename(path.c_str(), (policy.archive_path + "/" + file.name).c_str());
+            if (ret != 0) {
+                ESP_LOGE(TAG, "Retention: can't remove %s", file.name.c_str());
+                stats.error = errno;
+                break;
+            }
+            if (index) {
+                index->remove(file.name);
+            }
+            entries--;
+            bytes -= file.size;
+            stats.removed++;
+            stats.bytes_removed += file.size;
+        }
+        if (!stats.interrupted && !stats.error && stats.removed == candidates.size() && !candidates.empty()) {
+            // the whole budget was used: check whether the next file would be due as well
+            stats.budget_exhausted = (policy.max_entries && entries > *policy.max_entries) ||
+                                     (policy.max_bytes && bytes > *policy.max_bytes) ||
+                                     (policy.max_age && oldest_remaining_expired);
+        }
+        if (stats.removed > 0) {
+            ESP_LOGI(TAG, "Retention: removed %zu files (%llu bytes) from %s", stats.removed,
+                     static_cast<unsigned long long>(stats.bytes_removed), dir_path.c_str());
+        }
+        return stats;
+    }
+
+    [[nodiscard]] const std::string& path() const { return dir_path; }
+
+private:
+    struct FileInfo {
+        std::string name;
+        uint64_t size;
+        time_t mtime;
+        bool operator<(const FileInfo &other) const { return name < other.name; }
+    };
+
+    [[nodiscard]] bool is_busy() const { return busy && busy(); }
+
+    bool due(const FileInfo &file, size_t entries, uint64_t bytes, time_t now) const {
+        return (policy.max_entries && entries > *policy.max_entries) ||
+               (policy.max_bytes && bytes > *policy.max_bytes) ||
+               (policy.max_age && now - file.mtime > *policy.max_age);
+    }
+
+    /**
+     * @brief Scans the directory: totals in stats, oldest files (up to the removal budget) returned in name order
+     */
+    std::vector<FileInfo> scan(RetentionStats &stats, time_t now) {
+        const size_t budget = policy.max_removals_per_run;
+        std::priority_queue<FileInfo> oldest;  // max-heap: top is the newest of the oldest
+        std::optional<std::string> next_oldest;  // smallest name not kept in `oldest`
+        time_t next_oldest_mtime = 0;
+        DIR *dir = opendir(dir_path.c_str());
+        if (dir == nullptr) {
+            stats.error = errno;
+            return {};
+        }
+        struct stat st{};
+        while (dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            std::string name(entry->d_name);
+            if (stat((dir_path + "/" + name).c_str(), &st) != 0) {
+                stats.error = errno;
+                break;
+            }
+            if (!S_ISREG(st.st_mode)) continue;
+            stats.entries++;
+            stats.bytes += static_cast<uint64_t>(st.st_size);
+            FileInfo info{std::move(name), static_cast<uint64_t>(st.st_size), st.st_mtime};
+            if (budget > 0 && (oldest.size() < budget || info < oldest.top())) {
+                oldest.push(std::move(info));
+                if (oldest.size() <= budget) continue;
+                info = oldest.top();
+                oldest.pop();
+            }
+            if (!next_oldest || info.name < *next_oldest) {
+                next_oldest = info.name;
+                next_oldest_mtime = info.mtime;
+            }
+        }
+        closedir(dir);
+        std::vector<FileInfo> files;
+        files.reserve(oldest.size());
+        while (!oldest.empty()) {
+            files.push_back(oldest.top());
+            oldest.pop();
+        }
+        std::reverse(files.begin(), files.end());
+        oldest_remaining_expired = next_oldest && policy.max_age &&
+                                   now - next_oldest_mtime > *policy.max_age;
+        return files;
+    }
+
+    std::string dir_path;
+    RetentionPolicy policy;
+    std::function<bool()> busy;
+    bool oldest_remaining_expired{false};
+};
+
+
+/**
+ * @brief Runs DirRetention instances periodically on a background thread
+ *
+ * Runs are spaced by `interval`, or by `retry_interval` after a run that was interrupted or left
+ * files due for removal (so that a backlog is worked through in small, bounded steps).
+ *
+ * Example usage:
+ * @code
+ * static auto job = RetentionJob(std::chrono::minutes(5));
+ * job.add(DirRetention("/sdcard/logs", {.max_age = 30 * 24 * 3600}, [] { return streamer.active_streams() > 0; }));
+ * job.start();
+ * @endcode
+ */
+class RetentionJob {
+public:
+    explicit RetentionJob(std::chrono::milliseconds interval,
+                          std::chrono::milliseconds retry_interval = std::chrono::seconds(5))
+        : interval{interval},
+          retry_interval{retry_interval} {}
+
+    RetentionJob(const RetentionJob&) = delete;
+    RetentionJob& operator=(const RetentionJob&) = delete;
+
+    ~RetentionJob() {
+        stop();
+    }
+
+    /**
+     * @brief Adds a directory to the job (before start())
+     */
+    void add(DirRetention retention) {
+        retentions.push_back(std::move(retention));
+    }
+
+    /**
+     * @brief Starts the background thread
+     *
+     * @return bool false if already started
+     */
+    bool start() {
+        std::lock_guard lock(mutex);
+        if (worker.joinable()) return false;
+        stopping = false;
+        worker = std::thread([this] { loop(); });
+        return true;
+    }
+
+    /**
+     * @brief Stops the background thread, waiting for the current removal to complete
+     */
+    void stop() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    /**
+     * @brief Requests a run as soon as possible (e.g. after a large write)
+     */
+    void trigger() {
+        {
+            std::lock_guard lock(mutex);
+            triggered = true;
+        }
+        wake.notify_all();
+    }
+
+    /**
+     * @brief Gets the number of completed runs over all directories
+     */
+    [[nodiscard]] size_t runs() const {
+        std::lock_guard lock(mutex);
+        return completed_runs;
+    }
+
+private:
+    void loop() {
+        std::unique_lock lock(mutex);
+        while (!stopping) {
+            lock.unlock();
+            bool backlog = false;
+            for (auto &retention: retentions) {
+                auto stats = retention.run_once();
+                if (stats.error) {
+                    ESP_LOGW(TAG, "Retention of %s failed, err %d", retention.path().c_str(), *stats.error);
+                }
+                backlog = backlog || stats.interrupted || stats.budget_exhausted;
+            }
+            lock.lock();
+            completed_runs++;
+            triggered = false;
+            wake.wait_for(lock, backlog ? retry_interval : interval, [this] { return stopping || triggered; });
+        }
+    }
+
+    std::chrono::milliseconds interval;
+    std::chrono::milliseconds retry_interval;
+    std::vector<DirRetention> retentions;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    bool stopping{false};
+    bool triggered{false};
+    size_t completed_runs{0};
+};
+}  // namespace data_streamer
@@ -0,0 +1,541 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "follow.h"
+#include "summary.h"
+
+
+/**
+ * Rollup pyramid: aggregates of record files at several resolutions, maintained as records are written.
+ *
+ * For each level (bucket duration in seconds), `<dir>.rollup/<level>.agg` holds one fixed-size entry
+ * per bucket, in time order (integers and doubles in the device's byte order):
+ *   u32 start, u32 count, then per channel: f64 min, f64 max, f64 sum
+ */
+namespace data_streamer::rollup {
+
+inline constexpr char DIR_SUFFIX[] = ".rollup";
+
+/**
+ * @brief Size of a rollup entry
+ */
+constexpr size_t entry_size(size_t channels) {
+    return 8 + 3 * sizeof(double) * channels;
+}
+
+/**
+ * @brief Gets the path of the rollup file of a level
+ */
+inline std::string level_path(const std::string &dir_path, uint32_t level) {
+    return dir_path + DIR_SUFFIX + "/" + std::to_string(level) + ".agg";
+}
+
+/**
+ * @brief Serializes a bucket (of all channels) into a rollup entry
+ */
+inline void encode_entry(const summary::Bucket &bucket, char *out) {
+    auto start = static_cast<uint32_t>(bucket.start);
+    memcpy(out, &start, 4);
+    memcpy(out + 4, &bucket.count, 4);
+    out += 8;
+    for (size_t c = 0; c < bucket.sum.size(); c++) {
+        for (double v: {bucket.min[c], bucket.max[c], bucket.sum[c]}) {
+            memcpy(out, &v, sizeof(v));
+            out += sizeof(v);
+        }
+    }
+}
+
+/**
+ * @brief Deserializes the selected channels of a rollup entry
+ */
+inline summary::Bucket decode_entry(const char *in, std::span<const size_t> channels) {
+    summary::Bucket bucket(channels.size());
+    uint32_t start;
+    memcpy(&start, in, 4);
+    memcpy(&bucket.count, in + 4, 4);
+    bucket.start = start;
+    for (size_t i = 0; i < channels.size(); i++) {
+        const char *p = in + 8 + 3 * sizeof(double) * channels[i];
+        memcpy(&bucket.min[i], p, sizeof(double));
+        memcpy(&bucket.max[i], p + sizeof(double), sizeof(double));
+        memcpy(&bucket.sum[i], p + 2 * sizeof(double), sizeof(double));
+    }
+    return bucket;
+}
+
+/**
+ * @brief Picks the coarsest level that answers a query exactly
+ *
+ * A level answers a query if the requested bucket duration and the time range bounds are multiples of it.
+ *
+ * @param levels Available levels (seconds)
+ * @param query Summary query
+ * @return std::optional<uint32_t> nullopt if only raw records answer the query
+ */
+inline std::optional<uint32_t> choose_level(std::span<const uint32_t> levels, const summary::Query &query) {
+    std::optional<uint32_t> best;
+    for (auto level: levels) {
+        if (level == 0 || query.bucket_seconds % level != 0) continue;
+        if (query.since && *query.since % level != 0) continue;
+        if (query.until && *query.until % level != 0) continue;
+        if (!best || level > *best) best = level;
+    }
+    return best;
+}
+}  // namespace data_streamer::rollup
+
+
+namespace data_streamer {
+
+/**
+ * @brief Appends records to the files of a directory, maintaining a rollup pyramid
+ *
+ * Records go to `<dir>/<start>.rec` files, one per `file_seconds` period (start is the period's first
+ * timestamp, zero-padded so that names sort in time order). For each level, the bucket being filled is
+ * kept in memory, and its entry appended to the level's rollup file once a record of a later bucket
+ * arrives. Records must be appended in time order: records older than the open bucket of a level
+ * are written, but not rolled up into that level.
+ *
+ * append() can be called from any task, concurrently with queries. Record files are reported to the
+ * directory's DirWatch as they are opened and closed, so that follow streams send them once complete.
+ *
+ * Example usage:
+ * @code
+ * static auto writer = RecordWriter("/sdcard/logs", {.record_size = sizeof(Sample), .channels = 3}, {60, 3600, 86400});
+ * Sample s{static_cast<uint32_t>(time(nullptr)), t, h, p};
+ * writer.append({reinterpret_cast<const char*>(&s), sizeof(s)});
+ * @endcode
+ */
+class RecordWriter {
+public:
+    /**
+     * @brief Constructs a RecordWriter for the specified directory.
+     *
+     * @param dir_path Directory of the record files (created if needed)
+     * @param layout Layout of the records
+     * @param levels Rollup levels, bucket durations in seconds
+     * @param file_seconds Period covered by each record file
+     */
+    RecordWriter(std::string_view dir_path, summary::RecordLayout layout, std::vector<uint32_t> levels = {60, 3600},
+                 uint32_t file_seconds = 86400)
+        : dir_path{dir_path},
+          layout{layout},
+          file_seconds{std::max<uint32_t>(file_seconds, 1)},
+          watch{DirWatch::get(dir_path)} {
+        for (auto level: levels) {
+            if (level > 0) this->levels.push_back({level, std::nullopt, nullptr});
+        }
+        all_channels.resize(layout.channels);
+        for (size_t c = 0; c < layout.channels; c++) all_channels[c] = c;
+        values.resize(layout.channels);
+    }
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    ~RecordWriter() {
+        std::lock_guard lock(mutex);
+        close_files();
+    }
+
+    /**
+     * @brief Appends a record
+     *
+     * @param record One record, of layout.record_size bytes
+     * @return std::optional<int> errno value on failure, nullopt otherwise
+     */
+    std::optional<int> append(std::span<const char> record) {
+        if (record.size() != layout.record_size || !layout.valid()) return EINVAL;
+        std::lock_guard lock(mutex);
+        uint32_t ts = summary::timestamp(layout, record.data());
+        uint32_t file_start = ts - ts % file_seconds;
+        if (data_file == nullptr || file_start != current_file_start) {
+            if (auto err = open_data_file(file_start)) return err;
+        }
+        if (fwrite(record.data(), 1, record.size(), data_file) != record.size()) {
+            return errno ? errno : EIO;
+        }
+        summary::decode_values(layout, record.data(), all_channels, values.data());
+        for (auto &level: levels) {
+            int64_t start = ts - ts % level.seconds;
+            if (level.open && start < level.open->start) {
+                late_records++;
+                continue;
+            }
+            if (level.open && start > level.open->start) {
+                if (auto err = write_entry(level)) return err;
+                level.open.reset();
+            }
+            if (!level.open) {
+                level.open.emplace(layout.channels);
+                level.open->start = start;
+            }
+            level.open->add(values.data());
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Flushes the record file to storage
+     *
+     * @return std::optional<int> errno value on failure, nullopt otherwise
+     */
+    std::optional<int> flush() {
+        std::lock_guard lock(mutex);
+        if (data_file != nullptr && (fflush(data_file) != 0 || fsync(fileno(data_file)) != 0)) {
+            return errno;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Gets a copy of the bucket being filled at a level (not in the rollup file yet)
+     */
+    [[nodiscard]] std::optional<summary::Bucket> open_bucket(uint32_t seconds) const {
+        std::lock_guard lock(mutex);
+        for (const auto &level: levels) {
+            if (level.seconds == seconds) return level.open;
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] const std::string& path() const { return dir_path; }
+    [[nodiscard]] const summary::RecordLayout& record_layout() const { return layout; }
+    [[nodiscard]] std::vector<uint32_t> level_seconds() const {
+        std::vector<uint32_t> out;
+        for (const auto &level: levels) out.push_back(level.seconds);
+        return out;
+    }
+    [[nodiscard]] uint64_t late() const {
+        std::lock_guard lock(mutex);
+        return late_records;
+    }
+
+private:
+    struct Level {
+        uint32_t seconds;
+        std::optional<summary::Bucket> open;
+        FILE *file;
+    };
+
+    std::optional<int> open_data_file(uint32_t file_start) {
+        close_data_file();
+        if (mkdir(dir_path.c_str(), 0755) != 0 && errno != EEXIST) return errno;
+        char name[16];
+        snprintf(name, sizeof(name), "%010lu.rec", static_cast<unsigned long>(file_start));
+        watch->opened(name);
+        data_file = fopen((dir_path + "/" + name).c_str(), "ab");
+        if (data_file == nullptr) {
+            watch->closed(name);
+            return errno;
+        }
+        data_name = name;
+        current_file_start = file_start;
+        return std::nullopt;
+    }
+
+    // closes the record file, and tells followers it's complete
+    void close_data_file() {
+        if (data_file == nullptr) return;
+        struct stat st{};
+        bool sized = fstat(fileno(data_file), &st) == 0;
+        fclose(data_file);
+        data_file = nullptr;
+        watch->closed(data_name, sized ? std::optional<uint64_t>(st.st_size) : std::nullopt);
+    }
+
+    std::optional<int> write_entry(Level &level) {
+        if (level.file == nullptr) {
+            auto rollup_dir = dir_path + rollup::DIR_SUFFIX;
+            if (mkdir(rollup_dir.c_str(), 0755) != 0 && errno != EEXIST) return errno;
+            level.file = fopen(rollup::level_path(dir_path, level.seconds).c_str(), "ab");
+            if (level.file == nullptr) return errno;
+        }
+        std::vector<char> entry(rollup::entry_size(layout.channels));
+        rollup::encode_entry(*level.open, entry.data());
+        // flushed right away, so that queries see whole entries
+        if (fwrite(entry.data(), 1, entry.size(), level.file) != entry.size() || fflush(level.file) != 0) {
+            return errno ? errno : EIO;
+        }
+        return std::nullopt;
+    }
+
+    void close_files() {
+        close_data_file();
+        for (auto &level: levels) {
+            if (level.file != nullptr) fclose(level.file);
+            level.file = nullptr;
+        }
+    }
+
+    std::string dir_path;
+    summary::RecordLayout layout;
+    uint32_t file_seconds;
+    std::vector<Level> levels;
+    std::vector<size_t> all_channels;
+    std::vector<double> values;
+    std::shared_ptr<DirWatch> watch;
+    FILE *data_file{nullptr};
+    std::string data_name;
+    uint32_t current_file_start{0};
+    uint64_t late_records{0};
+    mutable std::mutex mutex;
+};
+
+
+/**
+ * @brief HTTP handler answering summary queries from the rollup pyramid of a RecordWriter
+ *
+ * Takes the same query parameters as SummaryStreamer (except `from`/`to`), and answers from the
+ * coarsest rollup level that gives exact results (see rollup::choose_level()): with `since`, a binary
+ * search finds the first entry, so that only the entries in range are read. Queries no level answers
+ * are computed from the raw records. The `X-Summary-Level` response header tells which was used.
+ *
+ * @tparam T The raw records source type for the fallback (must satisfy IterableOfChunkables)
+ * @tparam ServerOps Server operations interface (defaults to EspHttpServerOps)
+ *
+ * Example usage:
+ * @code
+ * static auto rollups = RollupStreamer<FlatDirIterable<>>(writer);
+ * rollups.bind(server, "/summary");
+ * // GET /summary?bucket=3600&since=1735689600
+ * @endcode
+ */
+template <typename T, typename ServerOps = EspHttpServerOps>
+    requires IterableOfChunkables<T>
+class RollupStreamer {
+public:
+    /**
+     * @brief Constructs a RollupStreamer for the data of a RecordWriter
+     *
+     * @param writer Writer maintaining the rollups (must outlive the streamer)
+     */
+    explicit RollupStreamer(const RecordWriter &writer)
+    : writer{writer},
+      raw{writer.path(), writer.record_layout()} {}
+
+    ~RollupStreamer() {
+        unbind();
+    }
+
+    /**
+     * @brief Binds the streamer to an HTTP server endpoint
+     *
+     * @param server HTTP server handle
+     * @param uri Endpoint URI
+     * @param method HTTP method (typically HTTP_GET)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t bind(httpd_handle_t server, const std::string &uri, http_method method = HTTP_GET) {
+        if (!server) {
+            ESP_LOGE(TAG, "Null server handle");
+            return ESP_FAIL;
+        }
+        this->srv = server;
+        this->uri = uri;
+        this->method = method;
+        httpd_uri_t rollup_endpoint = {
+            .uri       = uri.c_str(),
+            .method    = method,
+            .handler   = &RollupStreamer::handler_wrapper,
+            .user_ctx  = this
+        };
+        return ServerOps::register_uri_handler(server, &rollup_endpoint);
+    }
+
+    /**
+     * @brief Unbinds the streamer from the HTTP server
+     *
+     * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if not bound
+     */
+    esp_err_t unbind() {
+        if (srv == nullptr) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        return ServerOps::unregister_uri_handler(srv, uri.c_str(), method);
+    }
+
+    /**
+     * @brief HTTP handler callback wrapper
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    static esp_err_t handler_wrapper(httpd_req_t* req) {
+        auto* instance = static_cast<RollupStreamer*>(req->user_ctx);
+        return instance->handler(req);
+    }
+
+private:
+    /**
+     * @brief Main request handler
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t handler(httpd_req_t* req) {
+        const auto &layout = writer.record_layout();
+        auto params = summary::read_params<ServerOps>(req, layout.channels);
+        if (!params) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid summary query");
+            return ESP_OK;
+        }
+        auto levels = writer.level_seconds();
+        auto level = rollup::choose_level(levels, params->query);
+        if (!level) {
+            ESP_LOGD(TAG, "No rollup level answers the query, reading records");
+            return raw.stream(req, std::move(*params), "raw");
+        }
+        auto &query = params->query;
+        if (query.channels.empty()) {
+            for (size_t c = 0; c < layout.channels; c++) query.channels.push_back(c);
+        }
+        auto level_str = std::to_string(*level);
+        ServerOps::resp_set_status(req, HTTPD_200);
+        ServerOps::resp_set_type(req, summary::CONTENT_TYPE);
+        ServerOps::resp_set_hdr(req, summary::LEVEL_FIELD, level_str.c_str());
+
+        std::string out = summary::csv_header(query.channels);
+        std::optional<summary::Bucket> merged;
+        uint64_t entries = 0;
+        bool send_failed = false;
+        auto add = [&](const summary::Bucket &entry) {
+            if ((query.since && entry.start < *query.since) || (query.until && entry.start >= *query.until)) return;
+            int64_t start = entry.start - entry.start % query.bucket_seconds;
+            if (merged && merged->start != start) {
+                summary::append_csv_row(out, *merged);
+                merged.reset();
+                if (out.size() >= CHUNK_SIZE - 256) {
+                    send_failed = send_failed || ServerOps::resp_send_chunk(req, out.data(), out.size()) != ESP_OK;
+                    out.clear();
+                }
+            }
+            if (!merged) {
+                merged.emplace(query.channels.size());
+                merged->start = start;
+            }
+            merged->merge(entry);
+            entries++;
+        };
+        std::optional<int64_t> last_start;
+        auto err = read_level(*level, query, [&](const summary::Bucket &entry) {
+            add(entry);
+            last_start = entry.start;
+            return !send_failed;
+        });
+        if (err || send_failed) {
+            ESP_LOGE(TAG, "Can't read rollup level %lu", static_cast<unsigned long>(*level));
+            goto error;
+        }
+        if (auto open = writer.open_bucket(*level); open && (!last_start || open->start > *last_start)) {
+            summary::Bucket selected(query.channels.size());
+            selected.start = open->start;
+            selected.count = open->count;
+            for (size_t i = 0; i < query.channels.size(); i++) {
+                selected.min[i] = open->min[query.channels[i]];
+                selected.max[i] = open->max[query.channels[i]];
+                selected.sum[i] = open->sum[query.channels[i]];
+            }
+            add(selected);
+        }
+        if (merged) {
+            summary::append_csv_row(out, *merged);
+        }
+        if (send_failed || ServerOps::resp_send_chunk(req, out.data(), out.size()) != ESP_OK) {
+            goto error;
+        }
+        ESP_LOGI(TAG, "Summary of %llu rollup entries sent", static_cast<unsigned long long>(entries));
+        ServerOps::resp_send_chunk(req, nullptr, 0);
+        return ESP_OK;
+
+        error:  // GOTO tag
+        ServerOps::resp_sendstr_chunk(req, nullptr);
+        ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send summary");
+        return ESP_FAIL;
+    }
+
+    /**
+     * @brief Reads the entries of a level from the first one at or after `since`, until `until`
+     *
+     * @tparam F Callable taking const summary::Bucket& and returning bool (false to stop)
+     * @return std::optional<int> errno value on failure, nullopt otherwise
+     */
+    template<typename F>
+    std::optional<int> read_level(uint32_t level, const summary::Query &query, F &&f) {
+        const size_t size = rollup::entry_size(writer.record_layout().channels);
+        FILE *file = fopen(rollup::level_path(writer.path(), level).c_str(), "rb");
+        if (file == nullptr) {
+            return errno == ENOENT ? std::nullopt : std::optional<int>(errno);
+        }
+        struct stat st{};
+        if (fstat(fileno(file), &st) != 0) {
+            fclose(file);
+            return errno;
+        }
+        size_t count = static_cast<size_t>(st.st_size) / size;  // ignore an entry being written
+        std::vector<char> entry(size);
+        auto start_of = [&](size_t index) -> std::optional<int64_t> {
+            uint32_t start;
+            if (fseek(file, static_cast<long>(index * size), SEEK_SET) != 0 || fread(&start, 4, 1, file) != 1) {
+                return std::nullopt;
+            }
+            return start;
+        };
+        // binary search of the first entry at or after since
+        size_t lo = 0;
+        size_t hi = count;
+        while (query.since && lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            auto start = start_of(mid);
+            if (!start) break;
+            if (*start < *query.since) lo = mid + 1; else hi = mid;
+        }
+        std::optional<int> err;
+        if (fseek(file, static_cast<long>(lo * size), SEEK_SET) != 0) {
+            err = errno;
+        }
+        for (size_t i = lo; i < count && !err; i++) {
+            if (fread(entry.data(), 1, size, file) != size) {
+                err = errno ? errno : EIO;
+                break;
+            }
+            auto bucket = rollup::decode_entry(entry.data(), query.channels);
+            if (query.until && bucket.start >= *query.until) break;
+            if (!f(bucket)) break;
+        }
+        fclose(file);
+        return err;
+    }
+
+    const RecordWriter &writer;
+    SummaryStreamer<T, ServerOps> raw;
+    httpd_handle_t srv{};
+    std::string uri{};
+    http_method method{};
+};
+}  // namespace data_streamer
@@ -16,11 +16,18 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <vector>
 #include "esp_http_server.h"
 
 // Utility lightweight class allowing us to mock these operations when testing the DataStreamer
 class EspHttpServerOps {
 public:
+    // Size of the stack buffer gathering parts in resp_send_chunkv(), larger gathers use the heap
+    static constexpr size_t GATHER_BUFFER_SIZE = 512;
+
     static esp_err_t register_uri_handler(httpd_handle_t server, const httpd_uri_t* uri_desc) {
         return httpd_register_uri_handler(server, uri_desc);
     }
@@ -30,9 +37,64 @@ public:
     static esp_err_t resp_sendstr_chunk(httpd_req_t* req, const char* chunk) {
         return httpd_resp_sendstr_chunk(req, chunk);
     }
+    static esp_err_t resp_send(httpd_req_t* req, const char* buf, ssize_t size) {
+        return httpd_resp_send(req, buf, size);
+    }
     static esp_err_t resp_send_chunk(httpd_req_t* req, const char* chunk, ssize_t size) {
         return httpd_resp_send_chunk(req, chunk, size);
     }
+    /**
+     * @brief Sends several buffers as the content of one chunk (no empty chunk: empty parts send nothing)
+     *
+     * ESP's HTTP server has no vectored send, and only its chunk sends write the response headers first:
+     * parts are copied together, into a stack buffer if they fit, else into a heap one, and sent as one
+     * chunk. A single part is sent in place. Parts only add up past the stack buffer when headers come
+     * with the first data of an item, so the copy is made once per item, not once per chunk.
+     */
+    static esp_err_t resp_send_chunkv(httpd_req_t* req, std::span<const std::span<const char>> parts) {
+        size_t total = 0;
+        size_t non_empty = 0;
+        for (auto part: parts) {
+            total += part.size();
+            non_empty += part.empty() ? 0 : 1;
+        }
+        if (non_empty == 0) {
+            return ESP_OK;
+        }
+        if (non_empty == 1) {
+            auto part = *std::ranges::find_if(parts, [](auto p) { return !p.empty(); });
+            return httpd_resp_send_chunk(req, part.data(), static_cast<ssize_t>(part.size()));
+        }
+        char stack_buf[GATHER_BUFFER_SIZE];
+        std::vector<char> heap_buf;
+        char *buf = stack_buf;
+        if (total > sizeof(stack_buf)) {
+            heap_buf.resize(total);
+            buf = heap_buf.data();
+        }
+        size_t used = 0;
+        for (auto part: parts) {
+            if (!part.empty()) {
+                memcpy(buf + used, part.data(), part.size());
+                used += part.size();
+            }
+        }
+        return httpd_resp_send_chunk(req, buf, static_cast<ssize_t>(total));
+    }
+    /**
+     * @brief Writes bytes to the connection as they are, e.g. whole chunks once the response headers were sent
+     */
+    static esp_err_t send_raw(httpd_req_t* req, const char* buf, size_t len) {
+        while (len > 0) {
+            int n = httpd_send(req, buf, len);
+            if (n <= 0) {
+                return ESP_FAIL;
+            }
+            buf += n;
+            len -= n;
+        }
+        return ESP_OK;
+    }
     static esp_err_t resp_send_err(httpd_req_t* req, httpd_err_code_t error, const char* msg) {
         return httpd_resp_send_err(req, error, msg);
     }
@@ -54,4 +116,19 @@ public:
     static esp_err_t query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
         return httpd_query_key_value(qry, key, val, val_size);
     }
+    static size_t req_get_hdr_value_len(httpd_req_t *r, const char *field) {
+        return httpd_req_get_hdr_value_len(r, field);
+    }
+    static esp_err_t req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size) {
+        return httpd_req_get_hdr_value_str(r, field, val, val_size);
+    }
+    static int req_recv(httpd_req_t *r, char *buf, size_t buf_len) {
+        return httpd_req_recv(r, buf, buf_len);
+    }
+    static esp_err_t req_async_handler_begin(httpd_req_t *r, httpd_req_t **out) {
+        return httpd_req_async_handler_begin(r, out);
+    }
+    static esp_err_t req_async_handler_complete(httpd_req_t *r) {
+        return httpd_req_async_handler_complete(r);
+    }
 };
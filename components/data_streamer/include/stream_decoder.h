@@ -0,0 +1,673 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "formats.h"
+
+
+namespace data_streamer::decoder {
+
+/**
+ * @brief Concept for receivers of decoded parts
+ *
+ * Decoders call on_part_begin() once per item, then on_part_data() zero or more times with
+ * consecutive pieces of its content, then on_part_end(). Spans passed to on_part_data() point
+ * into the buffer handed to feed() whenever possible (zero-copy), so they are only valid for
+ * the duration of the call.
+ *
+ * Optionally, a handler may provide on_stream_end(std::string_view trailer), called once when
+ * the end-of-stream marker is decoded (the trailer is empty for formats that don't carry one).
+ * The trailer is made of "Field: value\r\n" lines, e.g. the commit token of acknowledged streams.
+ * A handler may also provide on_part_offset(uint64_t offset), called right after on_part_begin()
+ * for parts resuming an item at a byte offset: their content is to be appended to the data
+ * received before for that item (handlers without it can't tell resumed parts from whole items).
+ */
+template<typename H>
+concept PartHandler = requires(H h, std::string_view name, std::span<const char> data) {
+    h.on_part_begin(name);
+    h.on_part_data(data);
+    h.on_part_end();
+};
+
+/**
+ * @brief Substring search for a fixed pattern, using the Boyer-Moore-Horspool algorithm
+ *
+ * The bad-character table is built once, so repeated searches over incoming chunks are
+ * sub-linear on average for long patterns such as multipart delimiters.
+ */
+class BoundaryFinder {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit BoundaryFinder(std::string_view pattern): pattern{pattern} {
+        shift.fill(this->pattern.size());
+        for (size_t i = 0; i + 1 < this->pattern.size(); i++) {
+            shift[static_cast<uint8_t>(this->pattern[i])] = this->pattern.size() - 1 - i;
+        }
+    }
+
+    /**
+     * @brief Finds the first occurrence of the pattern in `hay`
+     *
+     * @return size_t Offset of the match, npos if not found
+     */
+    [[nodiscard]] size_t find(std::span<const char> hay) const {
+        const size_t m = pattern.size();
+        if (m == 0) return 0;
+        if (hay.size() < m) return npos;
+        const char last = pattern[m - 1];
+        size_t i = 0;
+        while (i <= hay.size() - m) {
+            char c = hay[i + m - 1];
+            if (c == last && memcmp(hay.data() + i, pattern.data(), m - 1) == 0) {
+                return i;
+            }
+            i += shift[static_cast<uint8_t>(c)];
+        }
+        return npos;
+    }
+
+    [[nodiscard]] size_t size() const { return pattern.size(); }
+
+private:
+    std::string pattern;
+    std::array<size_t, 256> shift{};
+};
+
+
+/**
+ * @brief Common driver for incremental decoders
+ *
+ * Derived classes implement `size_t step(std::span<const char> in)`, which consumes as many bytes
+ * as can be decided upon and returns how many were consumed. Input is normally handed to step()
+ * directly (zero-copy); only the undecided tail of a feed() call is copied into a small carry
+ * buffer, which is completed with as few bytes of the next feed() call as needed to get past it. step() must consume at least
+ * one byte whenever given CARRY_SIZE bytes or more, which bounds memory use for any input.
+ *
+ * Errors are reported with errno values, as in the rest of the library:
+ * - EBADMSG: malformed stream
+ * - EMSGSIZE: a header or name exceeds the decoder limits
+ * - ENODATA: finish() called before the end-of-stream marker
+ */
+template<typename Derived, size_t CARRY_SIZE>
+class DecoderBase {
+public:
+    /**
+     * @brief Decodes the next piece of the stream
+     *
+     * @param in Bytes received, in stream order. Any split of the stream into feed() calls is valid.
+     * @return bool false if the stream is invalid (see error())
+     */
+    bool feed(std::span<const char> in) {
+        while (!last_error && !in.empty()) {
+            if (carry_len > 0) {
+                // complete the carried bytes with (a bounded amount of) new input
+                const size_t c0 = carry_len;
+                size_t take = std::min({in.size(), CARRY_SIZE - c0, c0 + 256});
+                memcpy(carry.data() + c0, in.data(), take);
+                carry_len += take;
+                size_t consumed = 0;
+                size_t used;
+                while (consumed < c0 && !last_error &&
+                       (used = self().step(std::span<const char>(carry.data() + consumed, carry_len - consumed))) > 0) {
+                    consumed += used;
+                }
+                if (consumed >= c0) {  // carried bytes are done, continue zero-copy on the input
+                    in = in.subspan(consumed - c0);
+                    carry_len = 0;
+                    continue;
+                }
+                memmove(carry.data(), carry.data() + consumed, carry_len - consumed);
+                carry_len -= consumed;
+                in = in.subspan(take);
+                if (carry_len == CARRY_SIZE) {  // step() can't progress: limits exceeded
+                    fail(EMSGSIZE);
+                }
+                continue;
+            }
+            size_t used = self().step(in);
+            in = in.subspan(used);
+            if (used == 0 && !last_error) {
+                if (in.size() >= CARRY_SIZE) {
+                    fail(EMSGSIZE);
+                    break;
+                }
+                memcpy(carry.data(), in.data(), in.size());
+                carry_len = in.size();
+                break;
+            }
+        }
+        return !last_error;
+    }
+
+    /**
+     * @brief Signals the end of input
+     *
+     * @return bool true if the stream was complete and valid
+     */
+    bool finish() {
+        if (!last_error && !finished) {
+            fail(ENODATA);
+        }
+        if (!last_error) {
+            self().on_finish();
+        }
+        return !last_error;
+    }
+
+    /**
+     * @brief Returns whether the end-of-stream marker has been decoded
+     */
+    [[nodiscard]] bool done() const { return finished; }
+
+    /**
+     * @brief Returns any error that occurred while decoding
+     *
+     * @return std::optional<int> errno value if error occurred, nullopt otherwise
+     */
+    [[nodiscard]] std::optional<int> error() const { return last_error; }
+
+protected:
+    void fail(int err) {
+        if (!last_error) last_error = err;
+    }
+
+    // called by finish() on complete streams; derived classes may hide it to flush pending state
+    void on_finish() {}
+
+    bool finished{false};
+    std::optional<int> last_error{};
+
+private:
+    Derived& self() { return static_cast<Derived&>(*this); }
+
+    std::array<char, CARRY_SIZE> carry{};
+    size_t carry_len{0};
+};
+
+
+template<typename H>
+void notify_stream_end(H &handler, std::string_view trailer) {
+    if constexpr (requires { handler.on_stream_end(trailer); }) {
+        handler.on_stream_end(trailer);
+    }
+}
+
+template<typename H>
+void notify_part_offset(H &handler, uint64_t offset) {
+    if constexpr (requires { handler.on_part_offset(offset); }) {
+        handler.on_part_offset(offset);
+    }
+}
+
+
+/**
+ * @brief Incremental multipart/mixed decoder
+ *
+ * Part names are taken from the `X-Part-Name` header (as emitted by DataStreamer), falling back to
+ * the `filename` parameter of `Content-Disposition`. The offset of resumed parts is taken from the
+ * `X-Part-Offset` header. Parts with an `X-Heartbeat` header (sent by follow streams while there's
+ * nothing new) aren't reported. Header lines following the close delimiter,
+ * up to an empty line, are reported as the stream trailer; anything else there is ignored epilogue. The delimiter is searched with BoundaryFinder;
+ * content between delimiters is delivered zero-copy except for at most one carry buffer per feed().
+ *
+ * Example usage:
+ * @code
+ * MyHandler handler;
+ * auto dec = MultipartDecoder<MyHandler>(boundary, handler);
+ * while (auto chunk = receive()) {
+ *     if (!dec.feed(chunk)) break;
+ * }
+ * if (!dec.finish()) {
+ *     // dec.error() tells what went wrong
+ * }
+ * @endcode
+ */
+template<PartHandler H>
+class MultipartDecoder : public DecoderBase<MultipartDecoder<H>, 1024> {
+    using Base = DecoderBase<MultipartDecoder<H>, 1024>;
+    friend Base;
+public:
+    static constexpr size_t MAX_BOUNDARY = 200;
+    static constexpr size_t MAX_HEADER_LINE = 1000;
+    static constexpr size_t MAX_HEADER_LINES = 32;
+
+    MultipartDecoder(std::string_view boundary, H &handler)
+    : delimiter{std::string("\r\n--") + std::string(boundary)},
+      finder{delimiter},
+      handler{handler} {
+        if (boundary.empty() || boundary.size() > MAX_BOUNDARY) {
+            this->fail(EMSGSIZE);
+        }
+    }
+
+private:
+    enum class State { Start, Preamble, AfterDelimiter, Headers, Body, CloseLine, Trailer, Epilogue };
+
+    size_t step(std::span<const char> in) {
+        switch (state) {
+            case State::Start:
+                // the first delimiter may come without its leading CRLF
+                if (in.size() < delimiter.size() - 2) return 0;
+                if (std::string_view(in.data(), delimiter.size() - 2) == std::string_view(delimiter).substr(2)) {
+                    state = State::AfterDelimiter;
+                    return delimiter.size() - 2;
+                }
+                state = State::Preamble;
+                return scan_content(in);
+            case State::Preamble:
+            case State::Body:
+                return scan_content(in);
+            case State::AfterDelimiter:
+                return after_delimiter(in);
+            case State::Headers:
+                return header_line(in);
+            case State::CloseLine:
+                return close_line(in);
+            case State::Trailer:
+                return trailer_line(in);
+            case State::Epilogue:
+                return in.size();
+        }
+        return 0;
+    }
+
+    size_t scan_content(std::span<const char> in) {
+        size_t pos = finder.find(in);
+        if (pos == BoundaryFinder::npos) {
+            // keep back what could be the start of a delimiter
+            size_t safe = in.size() >= finder.size() ? in.size() - (finder.size() - 1) : 0;
+            if (safe > 0 && state == State::Body) {
+                handler.on_part_data(in.first(safe));
+            }
+            return safe;
+        }
+        if (state == State::Body) {
+            if (pos > 0) handler.on_part_data(in.first(pos));
+            handler.on_part_end();
+        }
+        state = State::AfterDelimiter;
+        return pos + finder.size();
+    }
+
+    size_t after_delimiter(std::span<const char> in) {
+        size_t i = 0;
+        while (i < in.size() && (in[i] == ' ' || in[i] == '\t')) i++;  // transport padding
+        if (in.size() - i < 2) return i;
+        if (in[i] == '-' && in[i + 1] == '-') {
+            this->finished = true;
+            state = State::CloseLine;
+            header_lines = 0;
+        } else if (in[i] == '\r' && in[i + 1] == '\n') {
+            state = State::Headers;
+            part_name.clear();
+            part_offset.reset();
+            heartbeat = false;
+            header_lines = 0;
+        } else {
+            this->fail(EBADMSG);
+        }
+        return i + 2;
+    }
+
+    size_t header_line(std::span<const char> in) {
+        std::string_view view(in.data(), in.size());
+        auto eol = view.find("\r\n");
+        if (eol == std::string_view::npos) {
+            if (in.size() > MAX_HEADER_LINE) this->fail(EMSGSIZE);
+            return 0;
+        }
+        if (eol > MAX_HEADER_LINE || ++header_lines > MAX_HEADER_LINES) {
+            this->fail(EMSGSIZE);
+            return 0;
+        }
+        auto line = view.substr(0, eol);
+        if (line.empty()) {  // end of part headers
+            if (heartbeat) {
+                state = State::Preamble;  // skip its (empty) content like a preamble
+            } else {
+                handler.on_part_begin(part_name);
+                if (part_offset) notify_part_offset(handler, *part_offset);
+                state = State::Body;
+            }
+        } else {
+            parse_header(line);
+        }
+        return eol + 2;
+    }
+
+    size_t close_line(std::span<const char> in) {
+        size_t i = 0;
+        while (i < in.size() && (in[i] == ' ' || in[i] == '\t')) i++;  // transport padding
+        if (in.size() - i < 2) return i;
+        if (in[i] == '\r' && in[i + 1] == '\n') {
+            state = State::Trailer;
+            return i + 2;
+        }
+        end_stream();
+        return i;
+    }
+
+    size_t trailer_line(std::span<const char> in) {
+        std::string_view view(in.data(), in.size());
+        auto eol = view.find("\r\n");
+        if (eol == std::string_view::npos) {
+            if (in.size() > MAX_HEADER_LINE) end_stream();  // not a trailer: epilogue
+            return 0;
+        }
+        auto line = view.substr(0, eol);
+        if (line.empty() || line.find(':') == std::string_view::npos ||
+            eol > MAX_HEADER_LINE || ++header_lines > MAX_HEADER_LINES) {
+            end_stream();
+            return eol + 2;
+        }
+        trailer.append(line);
+        trailer.append("\r\n");
+        return eol + 2;
+    }
+
+    void end_stream() {
+        notify_stream_end(handler, trailer);
+        state = State::Epilogue;
+    }
+
+    void on_finish() {
+        if (state == State::CloseLine || state == State::Trailer) {
+            end_stream();
+        }
+    }
+
+    void parse_header(std::string_view line) {
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            this->fail(EBADMSG);
+            return;
+        }
+        auto field = line.substr(0, colon);
+        auto value = trim(line.substr(colon + 1));
+        if (iequals(field, "X-Part-Name")) {
+            part_name = unquote(value);
+        } else if (iequals(field, "X-Heartbeat")) {
+            heartbeat = true;
+        } else if (iequals(field, "X-Part-Offset")) {
+            uint64_t offset = 0;
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), offset);
+            if (ec != std::errc() || ptr != value.data() + value.size() || value.empty()) {
+                this->fail(EBADMSG);
+                return;
+            }
+            part_offset = offset;
+        } else if (part_name.empty() && iequals(field, "Content-Disposition")) {
+            auto pos = value.find("filename=");
+            if (pos != std::string_view::npos) {
+                auto fname = value.substr(pos + 9);
+                auto end = fname.starts_with('"') ? fname.find('"', 1) + 1 : fname.find(';');
+                part_name = unquote(fname.substr(0, end));
+            }
+        }
+    }
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+        return s;
+    }
+
+    static std::string unquote(std::string_view s) {
+        if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
+            s = s.substr(1, s.size() - 2);
+        }
+        return std::string(s);
+    }
+
+    static bool iequals(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+        }
+        return true;
+    }
+
+    std::string delimiter;
+    BoundaryFinder finder;
+    H &handler;
+    State state{State::Start};
+    std::string part_name;
+    std::optional<uint64_t> part_offset;
+    bool heartbeat{false};
+    size_t header_lines{0};
+    std::string trailer;
+};
+
+
+/**
+ * @brief Incremental POSIX ustar decoder
+ *
+ * Regular file members are reported to the handler; other member types (directories, links,
+ * pax/GNU extension headers) are skipped. Header checksums are verified.
+ */
+template<PartHandler H>
+class TarDecoder : public DecoderBase<TarDecoder<H>, tar::BLOCK_SIZE> {
+    using Base = DecoderBase<TarDecoder<H>, tar::BLOCK_SIZE>;
+    friend Base;
+public:
+    explicit TarDecoder(H &handler): handler{handler} {}
+
+private:
+    enum class State { Header, Content, Padding, Epilogue };
+
+    size_t step(std::span<const char> in) {
+        switch (state) {
+            case State::Header:
+                if (in.size() < tar::BLOCK_SIZE) return 0;
+                parse_header(in.first(tar::BLOCK_SIZE));
+                return tar::BLOCK_SIZE;
+            case State::Content: {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, in.size()));
+                if (report && n > 0) handler.on_part_data(in.first(n));
+                remaining -= n;
+                if (remaining == 0) end_member();
+                return n;
+            }
+            case State::Padding: {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, in.size()));
+                remaining -= n;
+                if (remaining == 0) state = State::Header;
+                return n;
+            }
+            case State::Epilogue:
+                return in.size();
+        }
+        return 0;
+    }
+
+    void parse_header(std::span<const char> block) {
+        bool all_zero = std::all_of(block.begin(), block.end(), [](char c) { return c == 0; });
+        if (all_zero) {  // end of archive marker (a second zero block may follow)
+            this->finished = true;
+            notify_stream_end(handler, {});
+            state = State::Epilogue;
+            return;
+        }
+        auto checksum = octal(block.subspan(148, 8));
+        unsigned sum = 0;
+        for (size_t i = 0; i < block.size(); i++) {
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<uint8_t>(block[i]);
+        }
+        auto size = octal(block.subspan(124, 12));
+        if (!checksum || *checksum != sum || !size) {
+            this->fail(EBADMSG);
+            return;
+        }
+        char type = block[156];
+        report = (type == '0' || type == '\0');
+        remaining = *size;
+        pad = tar::padding(*size);
+        if (type == '5') {  // directories carry no content
+            remaining = 0;
+            pad = 0;
+        }
+        if (report) {
+            std::string name;
+            auto prefix = cstr(block.subspan(345, 155));
+            if (!prefix.empty()) {
+                name.append(prefix).append("/");
+            }
+            name.append(cstr(block.first(tar::NAME_SIZE)));
+            handler.on_part_begin(name);
+        }
+        state = State::Content;
+        if (remaining == 0) end_member();
+    }
+
+    void end_member() {
+        if (report) handler.on_part_end();
+        remaining = pad;
+        state = pad > 0 ? State::Padding : State::Header;
+    }
+
+    static std::string_view cstr(std::span<const char> field) {
+        auto len = strnlen(field.data(), field.size());
+        return {field.data(), len};
+    }
+
+    static std::optional<uint64_t> octal(std::span<const char> field) {
+        uint64_t v = 0;
+        size_t i = 0;
+        while (i < field.size() && field[i] == ' ') i++;
+        size_t digits = 0;
+        for (; i < field.size() && field[i] >= '0' && field[i] <= '7'; i++, digits++) {
+            v = (v << 3) | static_cast<uint64_t>(field[i] - '0');
+        }
+        if (digits == 0 || digits > 11) return std::nullopt;
+        for (; i < field.size(); i++) {  // only terminators may follow
+            if (field[i] != ' ' && field[i] != '\0') return std::nullopt;
+        }
+        return v;
+    }
+
+    H &handler;
+    State state{State::Header};
+    uint64_t remaining{0};
+    size_t pad{0};
+    bool report{false};
+};
+
+
+/**
+ * @brief Incremental decoder for the length-prefixed framing (see formats.h)
+ *
+ * Data frame payloads are delivered zero-copy and may span any number of feed() calls.
+ * Frames of unknown type are skipped.
+ */
+template<PartHandler H>
+class FramedDecoder : public DecoderBase<FramedDecoder<H>, 1024> {
+    using Base = DecoderBase<FramedDecoder<H>, 1024>;
+    friend Base;
+public:
+    static constexpr size_t MAX_NAME = 1024 - framed::HEADER_SIZE;
+
+    explicit FramedDecoder(H &handler): handler{handler} {}
+
+private:
+    enum class State { Header, Data, Skip, Epilogue };
+
+    size_t step(std::span<const char> in) {
+        switch (state) {
+            case State::Header:
+                return frame(in);
+            case State::Data:
+            case State::Skip: {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, in.size()));
+                if (state == State::Data && n > 0) handler.on_part_data(in.first(n));
+                remaining -= n;
+                if (remaining == 0) state = State::Header;
+                return n;
+            }
+            case State::Epilogue:
+                return in.size();
+        }
+        return 0;
+    }
+
+    size_t frame(std::span<const char> in) {
+        if (in.size() < framed::HEADER_SIZE) return 0;
+        auto type = static_cast<uint8_t>(in[0]);
+        uint32_t len = framed::payload_length(in.data());
+        switch (type) {
+            case framed::PartStart:
+            case framed::End: {
+                if (len > MAX_NAME) {
+                    this->fail(EMSGSIZE);
+                    return 0;
+                }
+                if (in.size() < framed::HEADER_SIZE + len) return 0;
+                std::string_view payload(in.data() + framed::HEADER_SIZE, len);
+                if (in_part) handler.on_part_end();
+                in_part = false;
+                if (type == framed::PartStart) {
+                    handler.on_part_begin(payload);
+                    in_part = true;
+                } else {
+                    this->finished = true;
+                    notify_stream_end(handler, payload);
+                    state = State::Epilogue;
+                }
+                return framed::HEADER_SIZE + len;
+            }
+            case framed::PartOffset:
+                if (!in_part || len != framed::OFFSET_SIZE) {
+                    this->fail(EBADMSG);
+                    return 0;
+                }
+                if (in.size() < framed::HEADER_SIZE + len) return 0;
+                notify_part_offset(handler, framed::offset_value(in.data() + framed::HEADER_SIZE));
+                return framed::HEADER_SIZE + len;
+            case framed::Data:
+                if (!in_part) {
+                    this->fail(EBADMSG);
+                    return 0;
+                }
+                state = State::Data;
+                break;
+            default:
+                state = State::Skip;
+                break;
+        }
+        remaining = len;
+        if (remaining == 0) state = State::Header;
+        return framed::HEADER_SIZE;
+    }
+
+    H &handler;
+    State state{State::Header};
+    uint64_t remaining{0};
+    bool in_part{false};
+};
+}  // namespace data_streamer::decoder
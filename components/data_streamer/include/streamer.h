@@ -16,10 +16,28 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <ranges>
+#include "commit.h"
 #include "concepts.h"
+#include "follow.h"
+#include "formats.h"
+#include "lines.h"
+#include "planner.h"
+#include "range.h"
 #include "server_ops.h"
+#include "timing.h"
+#include "tls.h"
+#include "wire.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "sdkconfig.h"
@@ -27,6 +45,8 @@
 
 namespace data_streamer {
 
+// Max number of buffers sent along with the first chunk of an item (see send_chunks())
+constexpr size_t MAX_PREFIX_PARTS = 7;
 // Max size for URL query parameters
 constexpr size_t MAX_URL_PARAM_SIZE = 128;
 
@@ -44,11 +64,17 @@ constexpr bool always_false = false;
  * Features:
  * - Single item streaming (for Chunkable types)
  * - Directory/collection streaming (for IterableOfChunkables types)
- * - Range-based filtering using 'from' and 'to' query parameters
+ * - Range-based filtering using 'from' and 'to' query parameters, and filtering by 'prefix' and 'since'
+ *   (for PlannedIterable types), with the execution plan reported by 'explain=1'
+ * - Follow mode ('follow=1', for PlannedIterable types): new items are sent as they are completed
+ * - HTTP Range requests on single items (for SeekableChunkable types)
+ * - Acknowledged consumption of collections (with a CommitHandler other than NoCommit)
+ * - Collection wire format selection using the 'format' query parameter (multipart, tar, framed)
  * - Chunked transfer encoding
  *
  * @tparam T The data source type (must satisfy Chunkable or IterableOfChunkables)
  * @tparam ServerOps Server operations interface (defaults to EspHttpServerOps)
+ * @tparam Committer Consumer of acknowledged collection streams (defaults to NoCommit, i.e. no acknowledgement)
  *
  * Example usage for single file:
  * @code
@@ -62,18 +88,27 @@ constexpr bool always_false = false;
  * streamer.bind(server, "/stream", HTTP_GET);
  * // Access with range: GET /stream?from=file1.txt&to=file9.txt
  * @endcode
+ *
+ * Example usage for directory with acknowledged consumption:
+ * @code
+ * auto streamer = DataStreamer<DirIterable, EspHttpServerOps, DirConsumer>("/path/to/dir", DirConsumer("/path/to/dir"));
+ * streamer.bind(server, "/stream", HTTP_GET);
+ * // GET /stream ends with an X-Commit-Token trailer; POST /stream?commit=<token> consumes what was sent
+ * @endcode
  */
-template <typename T, typename ServerOps = EspHttpServerOps>
-    requires(Chunkable<T> || IterableOfChunkables<T>)
+template <typename T, typename ServerOps = EspHttpServerOps, typename Committer = NoCommit>
+    requires((Chunkable<T> || IterableOfChunkables<T>) && CommitHandler<Committer>)
 class DataStreamer {
 public:
     /**
      * @brief Constructs a DataStreamer for the given path
      *
      * @param vfs_path Path to the data source (file or directory)
+     * @param committer Consumer of acknowledged streams (only used for IterableOfChunkables)
      */
-    explicit DataStreamer(std::string_view vfs_path)
-    : vfs_path{vfs_path} {}
+    explicit DataStreamer(std::string_view vfs_path, Committer committer = Committer())
+    : vfs_path{vfs_path},
+      committer{std::move(committer)} {}
 
     ~DataStreamer() {
         unbind();
@@ -82,6 +117,8 @@ public:
     /**
      * @brief Binds the streamer to an HTTP server endpoint
      *
+     * With acknowledged consumption, a POST handler for acknowledgements is bound to the same URI.
+     *
      * @param server HTTP server handle
      * @param uri Endpoint URI
      * @param method HTTP method (typically HTTP_GET)
@@ -101,18 +138,36 @@ public:
             .handler   = &DataStreamer::handler_wrapper,
             .user_ctx  = this
         };
-        return ServerOps::register_uri_handler(server, &streaming_endpoint);
+        esp_err_t ret = ServerOps::register_uri_handler(server, &streaming_endpoint);
+        if constexpr (ACKED) {
+            if (ret == ESP_OK) {
+                httpd_uri_t ack_endpoint = {
+                    .uri       = uri.c_str(),
+                    .method    = HTTP_POST,
+                    .handler   = &DataStreamer::ack_handler_wrapper,
+                    .user_ctx  = this
+                };
+                ret = ServerOps::register_uri_handler(server, &ack_endpoint);
+            }
+        }
+        return ret;
     }
 
     /**
      * @brief Unbinds the streamer from the HTTP server
      *
+     * Follow streams are ended first.
+     *
      * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if not bound
      */
     esp_err_t unbind() {
+        stop_followers();
         if (srv == nullptr) {
             return ESP_ERR_INVALID_STATE;
         }
+        if constexpr (ACKED) {
+            ServerOps::unregister_uri_handler(srv, uri.c_str(), HTTP_POST);
+        }
         return ServerOps::unregister_uri_handler(srv, uri.c_str(), method);
     }
 
@@ -131,92 +186,775 @@ public:
         return instance->handler(req);
     }
 
+    /**
+     * @brief HTTP handler callback wrapper for acknowledgements (POST ?commit=<token>)
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    static esp_err_t ack_handler_wrapper(httpd_req_t* req) {
+        auto* instance = static_cast<DataStreamer*>(req->user_ctx);
+        return instance->ack_handler(req);
+    }
+
+    /**
+     * @brief Gets the number of responses being streamed, e.g. to keep background jobs off the storage meanwhile
+     *
+     * @return int Number of active streams (safe to call from any task)
+     */
+    [[nodiscard]] int active_streams() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Gets the number of follow streams (?follow=1) served at once, besides the in-handler stream
+     *
+     * @return size_t The max_followers of the follow options, 0 if following isn't served
+     */
+    [[nodiscard]] size_t max_followers() const {
+        if constexpr (IterableOfChunkables<T> && PlannedIterable<T>) {
+            return follow_options.max_followers;
+        } else {
+            return 0;
+        }
+    }
+
+    /**
+     * @brief Gets the byte counts of the responses sent so far, split into payload, format, framing and
+     *        estimated TLS overhead (see wire.h)
+     *
+     * Responses are counted once sent (follow streams once ended). Safe to call from any task.
+     */
+    [[nodiscard]] wire::Stats wire_stats() const {
+        std::lock_guard lock(wire_mutex);
+        return wire_totals;
+    }
+
+    /**
+     * @brief Gets the collection formats served (see formats.h), comma-separated, e.g. for service discovery
+     *
+     * @return std::string e.g. "multipart,framed,tar", empty for single items
+     */
+    [[nodiscard]] static std::string formats() {
+        if constexpr (IterableOfChunkables<T>) {
+            return SizedChunkable<std::iter_value_t<typename T::iterator>> ? "multipart,framed,tar" : "multipart,framed";
+        } else {
+            return "";
+        }
+    }
+
+    /**
+     * @brief Gets the optional request features served, comma-separated, e.g. for service discovery
+     *
+     * range (Range headers), lines (?lines), filter (?prefix, ?since), follow (?follow), resume (?offset),
+     * ack (acknowledged consumption).
+     */
+    [[nodiscard]] static std::string features() {
+        std::string out;
+        auto add = [&out](bool served, const char *name) {
+            if (!served) return;
+            if (!out.empty()) out += ',';
+            out += name;
+        };
+        if constexpr (IterableOfChunkables<T>) {
+            add(PlannedIterable<T>, "filter");
+            add(PlannedIterable<T>, "follow");
+            add(SeekableChunkable<std::iter_value_t<typename T::iterator>>, "resume");
+            add(ACKED, "ack");
+        } else {
+            add(SeekableChunkable<T>, "range");
+            add(SeekableChunkable<T>, "lines");
+        }
+        return out;
+    }
+
+    /**
+     * @brief Estimates the bytes waiting for an acknowledgement: the size of the files after the consumption cursor
+     *
+     * Taken from the DirIndex of the streamed directory, so it costs no I/O. Safe to call from any task.
+     *
+     * @return std::optional<uint64_t> nullopt if streams aren't acknowledged, or the directory isn't indexed
+     */
+    [[nodiscard]] std::optional<uint64_t> pending_bytes() {
+        if constexpr (ACKED) {
+            if (auto index = DirIndex::find(vfs_path)) {
+                std::lock_guard lock(committer_mutex);
+                return index->total_size({.after = committer.cursor()});
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Sets the limits of follow streams (?follow=1), to be called before binding
+     */
+    void set_follow_options(const follow::Options &options) {
+        follow_options = options;
+    }
+
+    /**
+     * @brief Sets the TLS record payload size that content chunks are sized to fill (see tls.h), 0 to disable
+     *
+     * Defaults to CONFIG_DATA_STREAMER_TLS_RECORD_SIZE; to be called before binding.
+     */
+    void set_record_size(size_t size) {
+        record_size = size;
+    }
+
+    /**
+     * @brief Enables the Server-Timing trailer of responses (see timing.h)
+     *
+     * Defaults to CONFIG_DATA_STREAMER_SERVER_TIMING; to be called before binding.
+     */
+    void set_server_timing(bool enabled) {
+        server_timing = enabled;
+    }
+
 private:
+    static constexpr bool ACKED = IterableOfChunkables<T> && !std::is_same_v<Committer, NoCommit>;
+
+    // sends are accounted to the meter and timing recorder of the response being sent (see WireScope, TimingScope)
+    using Ops = wire::MeteredOps<timing::TimedOps<ServerOps>>;
+
+    /**
+     * @brief Records the timings of a response, if enabled
+     */
+    struct TimingScope {
+        timing::Timings timings{};
+        std::optional<timing::Recorder> recorder;
+        explicit TimingScope(bool enabled) {
+            if (enabled) {
+                recorder.emplace(timings);
+            }
+        }
+    };
+
+    /**
+     * @brief Meters the sends of a response, and adds them to the totals when it ends
+     */
+    struct WireScope {
+        DataStreamer &streamer;
+        wire::Stats stats{};
+        wire::Meter meter;
+        explicit WireScope(DataStreamer &s): streamer{s}, meter{stats, s.record_size} {}
+        ~WireScope() {
+            ESP_LOGD(TAG, "Wire bytes: %s", stats.to_json().c_str());
+            std::lock_guard lock(streamer.wire_mutex);
+            streamer.wire_totals += stats;
+        }
+    };
+
+    struct ActiveGuard {
+        std::atomic<int> &count;
+        explicit ActiveGuard(std::atomic<int> &c): count{c} { count++; }
+        ~ActiveGuard() { count--; }
+    };
 
    /**
     * @brief Handles streaming for Chunkable types
     *
     * Sets up appropriate headers and streams the content as a single file.
+    * If T is a SeekableChunkable, Range headers are honoured with a 206 response: ranges are
+    * coalesced (see range::coalesce), and if several remain, they're sent as multipart/byteranges
+    * parts in offset order. Unusable Range headers are ignored (whole content, 200), as allowed by RFC 9110.
+    * The 'lines' query parameter ("a-b", "a-" or "a", from 1) selects lines of a text file instead,
+    * found through its line index (see lines.h).
     *
     * @param req HTTP request handle
     * @param chunk_provider The Chunkable instance
-    * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+    * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if the request was rejected, ESP_FAIL on error
     */
     esp_err_t handle_chunkable(httpd_req_t *req, T &chunk_provider) {
-        ServerOps::resp_set_status(req, HTTPD_200);
-        ServerOps::resp_set_type(req, "application/octet-stream");
+        std::optional<lines::LineRange> line_range;
+        size_t query_len = ServerOps::req_get_url_query_len(req);
+        if (query_len > 0) {
+            std::vector<char> query_buf(query_len + 1);
+            char value[MAX_URL_PARAM_SIZE];
+            if (ServerOps::req_get_url_query_str(req, query_buf.data(), query_buf.size()) == ESP_OK &&
+                ServerOps::query_key_value(query_buf.data(), "lines", value, sizeof(value)) == ESP_OK) {
+                line_range = lines::parse(value);
+                if (!line_range) {
+                    ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad lines");
+                    return ESP_ERR_INVALID_ARG;
+                }
+                if constexpr (!SeekableChunkable<T>) {
+                    ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Filter not supported");
+                    return ESP_ERR_INVALID_ARG;
+                }
+            }
+        }
+        std::vector<range::ByteRange> ranges;
+        size_t size = 0;
+        std::string content_range;  // must outlive the response, as headers are sent with the first chunk
+        if constexpr (SeekableChunkable<T>) {
+            auto item_size = chunk_provider.size();
+            size = item_size.value_or(0);
+            auto result = item_size && !line_range ? read_range_header(req, size, ranges) : range::RangeResult::Ignore;
+            if (result == range::RangeResult::Unsatisfiable) {
+                content_range = range::unsatisfied_range(size);
+                ServerOps::resp_set_status(req, range::STATUS_416);
+                ServerOps::resp_set_hdr(req, "Content-Range", content_range.c_str());
+                Ops::resp_send_chunk(req, nullptr, 0);
+                return ESP_ERR_INVALID_ARG;
+            }
+            if (result == range::RangeResult::Satisfiable) {
+                range::coalesce(ranges);
+            } else {
+                ranges.clear();
+            }
+            if (ranges.size() == 1) {
+                content_range = range::content_range(ranges.front(), size);
+            }
+        }
+        ServerOps::resp_set_status(req, ranges.empty() ? HTTPD_200 : range::STATUS_206);
+        if (ranges.size() > 1) {
+            content_range = std::string("multipart/byteranges; boundary=") + std::string(BOUNDARY);
+            ServerOps::resp_set_type(req, content_range.c_str());
+        } else {
+            ServerOps::resp_set_type(req, "application/octet-stream");
+        }
         auto content_disposition = std::string("attachment; filename=\"") + std::string(chunk_provider.name()) + std::string("\"");
         ServerOps::resp_set_hdr(req, "Content-Disposition", content_disposition.c_str());
         ServerOps::resp_set_hdr(req, "X-Part-Name", chunk_provider.name().data());
+        announce_trailer(req);
+        if constexpr (SeekableChunkable<T>) {
+            ServerOps::resp_set_hdr(req, "Accept-Ranges", "bytes");
+            if (line_range) {
+                ESP_LOGD(TAG, "Sending lines from %zu...", line_range->first);
+                return send_lines(req, chunk_provider, *line_range);
+            }
+            if (ranges.size() == 1) {
+                ServerOps::resp_set_hdr(req, "Content-Range", content_range.c_str());
+                if (!chunk_provider.seek(ranges.front().first)) {
+                    ESP_LOGE(TAG, "Can't seek to %zu", ranges.front().first);
+                    return ESP_FAIL;
+                }
+                ESP_LOGD(TAG, "Sending range %s...", content_range.c_str());
+                return send_chunks(req, chunk_provider, ranges.front().length());
+            }
+            if (ranges.size() > 1) {
+                ESP_LOGD(TAG, "Sending %zu ranges...", ranges.size());
+                return send_byteranges(req, chunk_provider, ranges, size);
+            }
+        }
         ESP_LOGD(TAG, "Sending file...");
         return send_chunks(req, chunk_provider);
     }
 
+    /**
+     * @brief Sends a line range of the item, read from the nearest line start of its line index
+     *
+     * The line index is extended with the line starts scanned on the way.
+     *
+     * @param req HTTP request handle
+     * @param chunk_provider The item, seekable
+     * @param line_range Lines to send
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t send_lines(httpd_req_t *req, T &chunk_provider, const lines::LineRange &line_range) {
+        lines::LineIndex index(vfs_path);
+        auto start = index.seek_point(line_range.first);
+        if (!chunk_provider.seek(start.offset)) {
+            ESP_LOGE(TAG, "Can't seek to %zu", start.offset);
+            return ESP_FAIL;
+        }
+        lines::LineCursor cursor(index, line_range, start);
+        tls::ChunkPacker<Ops> packer(req, record_size);
+        esp_err_t ret = ESP_OK;
+        for (std::span<char> &chunk: chunk_provider) {
+            auto selected = cursor.feed(chunk);
+            wire::count_payload(selected.size());
+            ret = packer.write(selected);
+            if (ret != ESP_OK || cursor.done()) break;  // don't read past the range
+        }
+        if (ret == ESP_OK) {
+            ret = packer.flush();
+        }
+        if (auto err = index.save()) {
+            ESP_LOGW(TAG, "Can't save the line index of %s: %s", vfs_path.c_str(), strerror(*err));
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        return chunk_provider.error() ? ESP_FAIL : ESP_OK;
+    }
+
+    /**
+     * @brief Sends ranges of one item as multipart/byteranges parts, seeking between them
+     *
+     * @param req HTTP request handle
+     * @param chunk_provider The item, seekable
+     * @param ranges Ranges to send, in offset order
+     * @param size Item size in bytes, for the Content-Range part headers
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t send_byteranges(httpd_req_t *req, T &chunk_provider, const std::vector<range::ByteRange> &ranges, size_t size) {
+        for (const auto &r: ranges) {
+            if (!chunk_provider.seek(r.first)) {
+                ESP_LOGE(TAG, "Can't seek to %zu", r.first);
+                return ESP_FAIL;
+            }
+            auto content_range = range::content_range(r, size);
+            const std::array<std::span<const char>, 5> headers{
+                bytes("\r\n--"), bytes(BOUNDARY), bytes("\r\nContent-Type: application/octet-stream\r\nContent-Range: "),
+                bytes(content_range), bytes("\r\n\r\n")};
+            if (esp_err_t ret = send_chunks(req, chunk_provider, r.length(), headers); ret != ESP_OK) {
+                return ret;
+            }
+        }
+        const std::array<std::span<const char>, 3> end{bytes("\r\n--"), bytes(BOUNDARY), bytes("--\r\n")};
+        return Ops::resp_send_chunkv(req, end);
+    }
+
+    /**
+     * @brief Reads the request Range header and evaluates it against an item size
+     *
+     * @param req HTTP request handle
+     * @param size Item size in bytes
+     * @param ranges Output satisfiable ranges
+     * @return range::RangeResult Ignore if there's no usable Range header
+     */
+    range::RangeResult read_range_header(httpd_req_t *req, size_t size, std::vector<range::ByteRange> &ranges) {
+        size_t len = ServerOps::req_get_hdr_value_len(req, "Range");
+        if (len == 0 || len >= range::MAX_HEADER_SIZE) {
+            return range::RangeResult::Ignore;
+        }
+        char value[range::MAX_HEADER_SIZE];
+        if (ServerOps::req_get_hdr_value_str(req, "Range", value, sizeof(value)) != ESP_OK) {
+            return range::RangeResult::Ignore;
+        }
+        return range::parse(value, size, ranges);
+    }
+
    /**
     * @brief Handles streaming for IterableOfChunkables types
     *
-    * Streams multiple items as a multipart response, with optional range filtering
-    * based on 'from' and 'to' query parameters.
+    * Streams multiple items as a multipart (default), tar or framed response, as selected by
+    * the 'format' query parameter, with optional range filtering based on 'from' and 'to'
+    * query parameters. Name 'prefix' and modification time ('since', in seconds) filters need a
+    * PlannedIterable, which gets all filters pushed down; 'explain=1' responds with its plan
+    * (planner.h) as JSON instead of the data. 'follow=1' (PlannedIterable only) keeps the response
+    * open after the existing items, to send new ones as they are completed (see follow()).
+    * 'offset' resumes the item named by 'from' at a byte offset (for SeekableChunkable items): its
+    * part is marked with the offset (X-Part-Offset header, or framed PartOffset frame), so that the
+    * client appends it to what it received before the interruption.
+    *
+    * With acknowledged consumption, streams without 'from' start after the consumption cursor,
+    * and multipart and framed streams end with a trailer carrying a commit token (see commit.h),
+    * unless they were filtered by 'prefix' or 'since' (as items within the name range were skipped)
+    * or followed.
     *
     * @param req HTTP request handle
     * @param chunk_provider The IterableOfChunkables instance
-    * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+    * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG if the request was rejected,
+    *         ESP_ERR_NOT_FINISHED if the response was handed over to a follower, ESP_FAIL on error
     */
     esp_err_t handle_iterable_of_chunkables(httpd_req_t *req, T &chunk_provider) {
-        std::optional<std::string> from_param;
-        std::optional<std::string> to_param;
+        DirFilter filter;
+        bool explain = false;
+        bool follow = false;
+        std::optional<size_t> resume_offset;
+        StreamFormat format = StreamFormat::Multipart;
         size_t query_len = ServerOps::req_get_url_query_len(req);
         if (query_len > 0) {
             std::vector<char> query_buf(query_len + 1);
             if (ServerOps::req_get_url_query_str(req, query_buf.data(), query_buf.size()) == ESP_OK) {
                 char value[MAX_URL_PARAM_SIZE];
                 if (ServerOps::query_key_value(query_buf.data(), "from", value, sizeof(value)) == ESP_OK) {
-                    from_param = std::string(value);
+                    filter.from = std::string(value);
                 }
                 if (ServerOps::query_key_value(query_buf.data(), "to", value, sizeof(value)) == ESP_OK) {
-                    to_param = std::string(value);
+                    filter.to = std::string(value);
                 }
+                if (ServerOps::query_key_value(query_buf.data(), "prefix", value, sizeof(value)) == ESP_OK) {
+                    filter.prefix = std::string(value);
+                }
+                if (ServerOps::query_key_value(query_buf.data(), "since", value, sizeof(value)) == ESP_OK) {
+                    int64_t since;
+                    const char *end = value + strlen(value);
+                    auto [ptr, ec] = std::from_chars(value, end, since);
+                    if (ec != std::errc() || ptr != end || ptr == value) {
+                        ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad since");
+                        return ESP_ERR_INVALID_ARG;
+                    }
+                    filter.since = static_cast<time_t>(since);
+                }
+                if (ServerOps::query_key_value(query_buf.data(), "offset", value, sizeof(value)) == ESP_OK) {
+                    size_t offset;
+                    const char *end = value + strlen(value);
+                    auto [ptr, ec] = std::from_chars(value, end, offset);
+                    if (ec != std::errc() || ptr != end || ptr == value) {
+                        ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad offset");
+                        return ESP_ERR_INVALID_ARG;
+                    }
+                    resume_offset = offset;
+                }
+                if (ServerOps::query_key_value(query_buf.data(), "explain", value, sizeof(value)) == ESP_OK) {
+                    explain = strcmp(value, "0") != 0;
+                }
+                if (ServerOps::query_key_value(query_buf.data(), "follow", value, sizeof(value)) == ESP_OK) {
+                    follow = strcmp(value, "0") != 0;
+                }
+                if (ServerOps::query_key_value(query_buf.data(), "format", value, sizeof(value)) == ESP_OK) {
+                    auto parsed = parse_stream_format(value);
+                    if (!parsed) {
+                        ESP_LOGE(TAG, "Unknown format %s", value);
+                        ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown format");
+                        return ESP_ERR_INVALID_ARG;
+                    }
+                    format = *parsed;
+                }
+            }
+        }
+        if (format == StreamFormat::Tar && !SizedChunkable<std::iter_value_t<typename T::iterator>>) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Format needs items of known size");
+            return ESP_ERR_INVALID_ARG;
+        }
+        if constexpr (!PlannedIterable<T>) {
+            if (filter.since || follow) {
+                ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Filter not supported");
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+        if (follow && format == StreamFormat::Tar) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Format can't be followed");
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (resume_offset && (!filter.from || format == StreamFormat::Tar ||
+                              !SeekableChunkable<std::iter_value_t<typename T::iterator>>)) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Can't resume");
+            return ESP_ERR_INVALID_ARG;
+        }
+        time_t started = time(nullptr);
+        if constexpr (ACKED) {
+            if (!filter.from) {
+                std::lock_guard lock(committer_mutex);
+                filter.after = committer.cursor();  // exclusive lower bound: the consumption cursor
             }
         }
+        filter.settled = follow;
+        if (follow && !explain) {
+            return start_follower(req, filter, format, resume_offset);
+        }
+        plan::Plan plan;
+        if constexpr (PlannedIterable<T>) {
+            plan = chunk_provider.plan(filter);
+        } else {
+            plan = plan::choose(filter, {});
+        }
+        if (explain) {
+            auto json = plan.to_json();
+            ServerOps::resp_set_status(req, HTTPD_200);
+            ServerOps::resp_set_type(req, "application/json");
+            return Ops::resp_send_chunk(req, json.data(), json.size());
+        }
         ServerOps::resp_set_status(req, HTTPD_200);
-        auto content_type = std::string("multipart/mixed; boundary=") + std::string(BOUNDARY);
+        auto content_type = collection_content_type(format);
         ServerOps::resp_set_type(req, content_type.c_str());
+        if (format == StreamFormat::Tar) {
+            announce_trailer(req);
+        }
+        std::optional<std::string> last_sent;
+        std::vector<std::string> sent;
         ESP_LOGD(TAG, "Sending parts...");
+        if (send_items(req, chunk_provider, filter, format, last_sent, resume_offset,
+                       ACKED ? &sent : nullptr) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        // trailer: "Field: value\r\n" lines, sent after the end-of-stream marker where the format allows
+        std::string trailer;
+        if constexpr (ACKED) {
+            if (last_sent && !chunk_provider.error() && format != StreamFormat::Tar &&
+                !filter.prefix && !filter.since) {
+                auto token = commits.issue(std::move(sent), started);
+                trailer = std::string(COMMIT_TOKEN_FIELD) + ": " + token + "\r\n";
+            }
+        }
+        send_stream_end(req, format, trailer);
+        ESP_LOGD(TAG, "All parts sent");
+        if (chunk_provider.error()) {
+            ESP_LOGE(TAG, "Chunk provider error, err %d", chunk_provider.error().value());
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    static std::string collection_content_type(StreamFormat format) {
+        switch (format) {
+            case StreamFormat::Multipart:
+                return std::string("multipart/mixed; boundary=") + std::string(BOUNDARY);
+            case StreamFormat::Tar:
+                return tar::CONTENT_TYPE;
+            case StreamFormat::Framed:
+                return framed::CONTENT_TYPE;
+        }
+        return {};
+    }
+
+    /**
+     * @brief Sends the items of a collection matching the name filters, in the given format
+     *
+     * @param req HTTP request handle
+     * @param chunk_provider The IterableOfChunkables instance
+     * @param filter Filters of the request (those on names are applied again, in case T doesn't plan)
+     * @param format Wire format
+     * @param last_sent Greatest name sent so far, updated
+     * @param resume_offset Offset at which to resume the item named by filter.from, reset once used
+     * @param sent If set, the names of the items sent are appended to it (what an acknowledgement consumes)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t send_items(httpd_req_t *req, T &chunk_provider, const DirFilter &filter, StreamFormat format,
+                         std::optional<std::string> &last_sent, std::optional<size_t> &resume_offset,
+                         std::vector<std::string> *sent = nullptr) {
         auto filtered_range = chunk_provider | std::views::filter([&](auto& chunkable) {
-            if (from_param && chunkable.name() < *from_param) return false;
-            if (to_param && chunkable.name() > *to_param) return false;
-            return true;
+            return filter.matches_name(chunkable.name());
         });
-
-        esp_err_t ret = ESP_FAIL;
         for (auto &chunkable: filtered_range) {
             ESP_LOGD(TAG, "Sending %s", chunkable.name().data());
-            ServerOps::resp_send_chunk(req, "\r\n--", HTTPD_RESP_USE_STRLEN);
-            ServerOps::resp_send_chunk(req, BOUNDARY, HTTPD_RESP_USE_STRLEN);
-            ServerOps::resp_send_chunk(req, "\r\n", HTTPD_RESP_USE_STRLEN);
-
-            ServerOps::resp_send_chunk(req, "Content-Type: application/octet-stream\r\n", HTTPD_RESP_USE_STRLEN);
-            ServerOps::resp_send_chunk(req, "Content-Disposition: attachment;\r\n", HTTPD_RESP_USE_STRLEN);
-            ServerOps::resp_send_chunk(req, "X-Part-Name: \"", HTTPD_RESP_USE_STRLEN);
-            ServerOps::resp_send_chunk(req, chunkable.name().data(), HTTPD_RESP_USE_STRLEN);
-            ServerOps::resp_send_chunk(req, "\"\r\n\r\n", HTTPD_RESP_USE_STRLEN);
-            ret = send_chunks(req, chunkable);
+            std::optional<size_t> offset;
+            if (resume_offset && filter.from && chunkable.name() == *filter.from) {
+                offset = resume_offset;
+                resume_offset.reset();
+                if (!seek_part(chunkable, *offset)) {
+                    ESP_LOGE(TAG, "Can't resume %s at %zu", chunkable.name().data(), *offset);
+                    return ESP_FAIL;
+                }
+            }
+            esp_err_t ret = ESP_FAIL;
+            switch (format) {
+                case StreamFormat::Multipart:
+                    ret = send_multipart_part(req, chunkable, offset);
+                    break;
+                case StreamFormat::Tar:
+                    ret = send_tar_part(req, chunkable);
+                    break;
+                case StreamFormat::Framed:
+                    ret = send_framed_part(req, chunkable, offset);
+                    break;
+            }
             if (ret != ESP_OK) {
                 ESP_LOGE(TAG, "Failed to send chunks, err %d", ret);
                 return ESP_FAIL;
             }
+            if (!last_sent || chunkable.name() > *last_sent) {
+                last_sent = std::string(chunkable.name());
+            }
+            if (sent) {
+                sent->emplace_back(chunkable.name());
+            }
             ESP_LOGI(TAG, "File sent.");
         }
-        // send final boundary
-        ServerOps::resp_send_chunk(req, "\r\n--", HTTPD_RESP_USE_STRLEN);
-        ServerOps::resp_send_chunk(req, BOUNDARY, HTTPD_RESP_USE_STRLEN);
-        ServerOps::resp_send_chunk(req, "--\r\n", HTTPD_RESP_USE_STRLEN);
-        ESP_LOGD(TAG, "All parts sent");
-        if (chunk_provider.error()) {
-            ESP_LOGE(TAG, "Chunk provider error, err %d", chunk_provider.error().value());
+        return ESP_OK;
+    }
+
+    /**
+     * @brief Moves an item to a resume offset, clamped to its size (so that resuming a complete item sends nothing)
+     *
+     * @param offset Requested offset, updated to the actual one
+     * @return bool false if the item isn't seekable or the seek failed
+     */
+    template<Chunkable C>
+    static bool seek_part(C &chunkable, size_t &offset) {
+        if constexpr (SeekableChunkable<C>) {
+            auto size = chunkable.size();
+            if (!size) {
+                return false;
+            }
+            offset = std::min(offset, *size);
+            return chunkable.seek(offset);
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Sends the end-of-stream marker of a format, followed by the trailer where the format allows
+     *
+     * The Server-Timing field is added to the trailer if the response is timed.
+     *
+     * @param req HTTP request handle
+     * @param format Wire format
+     * @param trailer "Field: value\r\n" lines, possibly empty
+     */
+    void send_stream_end(httpd_req_t *req, StreamFormat format, std::string trailer) {
+        auto *recorder = timing::Recorder::active();
+        if (recorder && format != StreamFormat::Tar) {
+            trailer += std::string(timing::SERVER_TIMING_FIELD) + ": " + recorder->timings.to_header() + "\r\n";
+            recorder->timings.reported = true;
+        }
+        switch (format) {
+            case StreamFormat::Multipart: {
+                // send final boundary, then the trailer (if any) as header lines ended by an empty line
+                if (!trailer.empty()) {
+                    trailer += "\r\n";
+                }
+                const std::array<std::span<const char>, 4> end{
+                    bytes("\r\n--"), bytes(BOUNDARY), bytes("--\r\n"), bytes(trailer)};
+                Ops::resp_send_chunkv(req, end);
+                break;
+            }
+            case StreamFormat::Tar: {
+                // end of archive: two zero blocks
+                static constexpr char zeros[2 * tar::BLOCK_SIZE]{};
+                Ops::resp_send_chunk(req, zeros, sizeof(zeros));
+                break;
+            }
+            case StreamFormat::Framed: {
+                auto hdr = framed::header(framed::End, trailer.size());
+                const std::array<std::span<const char>, 2> end{hdr, bytes(trailer)};
+                Ops::resp_send_chunkv(req, end);
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Ends a chunked response with the last chunk
+     *
+     * If the response is timed and its timings weren't sent in a stream trailer, they're sent as an
+     * HTTP trailer field of the last chunk (announced by announce_trailer()).
+     */
+    esp_err_t send_last_chunk(httpd_req_t *req) {
+        auto *recorder = timing::Recorder::active();
+        if (recorder && recorder->timings.sending && !recorder->timings.reported) {
+            auto last = std::string("0\r\n") + timing::SERVER_TIMING_FIELD + ": " + recorder->timings.to_header() +
+                        "\r\n\r\n";
+            return Ops::send_raw(req, last.data(), last.size());
+        }
+        return Ops::resp_send_chunk(req, nullptr, 0);
+    }
+
+    /**
+     * @brief Announces the Server-Timing HTTP trailer field, for responses without a stream trailer
+     */
+    static void announce_trailer(httpd_req_t *req) {
+        if (timing::Recorder::active()) {
+            ServerOps::resp_set_hdr(req, "Trailer", timing::SERVER_TIMING_FIELD);
+        }
+    }
+
+    /**
+     * @brief Hands a follow request over to a follower task, if a follower slot is free (else 503)
+     *
+     * The request is made asynchronous, so that the HTTP server keeps serving other requests.
+     *
+     * @return esp_err_t ESP_ERR_NOT_FINISHED if handed over, ESP_ERR_INVALID_ARG if rejected, ESP_FAIL on error
+     */
+    esp_err_t start_follower(httpd_req_t *req, const DirFilter &filter, StreamFormat format,
+                             std::optional<size_t> resume_offset) {
+        auto watch = DirWatch::get(vfs_path);
+        if (!watch->try_follow(follow_options.max_followers)) {
+            ESP_LOGW(TAG, "Too many followers of %s", vfs_path.c_str());
+            ServerOps::resp_set_status(req, follow::STATUS_503);
+            ServerOps::resp_send(req, nullptr, 0);
+            return ESP_ERR_INVALID_ARG;
+        }
+        httpd_req_t *async_req = nullptr;
+        if (ServerOps::req_async_handler_begin(req, &async_req) != ESP_OK) {
+            ESP_LOGE(TAG, "Can't make follow request asynchronous");
+            watch->unfollow();
             return ESP_FAIL;
         }
-        return ESP_OK;
+        {
+            std::lock_guard lock(followers_mutex);
+            followers++;
+        }
+        std::thread(&DataStreamer::follow, this, async_req, filter, format, resume_offset, std::move(watch)).detach();
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    /**
+     * @brief Follower task: sends the matching items in name order, then new items as they are completed
+     *
+     * After each pass, waits for a writer notification or the polling interval, and sends a heartbeat
+     * when nothing was sent for the heartbeat interval: an empty multipart part with an X-Heartbeat
+     * header (the time), or a framed Heartbeat frame. Ends when sending fails (the client went away),
+     * or cleanly (end-of-stream marker, no trailer) when the streamer is unbound.
+     */
+    void follow(httpd_req_t *req, DirFilter filter, StreamFormat format, std::optional<size_t> resume_offset,
+                std::shared_ptr<DirWatch> watch) {
+        using clock = std::chrono::steady_clock;
+        TimingScope timing_scope{server_timing};
+        std::optional<WireScope> wire_scope{std::in_place, *this};
+        ServerOps::resp_set_status(req, HTTPD_200);
+        auto content_type = collection_content_type(format);
+        ServerOps::resp_set_type(req, content_type.c_str());
+        std::optional<std::string> last_sent;
+        auto last_activity = clock::now();
+        esp_err_t ret = ESP_OK;
+        while (!stopping) {
+            auto seq = watch->sequence();
+            auto before = last_sent;
+            {
+                ActiveGuard guard{active};  // idle followers don't count as active streams
+                auto chunk_provider = std::make_unique<T>(vfs_path);  // off the (small) task stack
+                if constexpr (PlannedIterable<T>) {  // always true, follow requests are rejected otherwise
+                    chunk_provider->plan(filter);
+                }
+                ret = send_items(req, *chunk_provider, filter, format, last_sent, resume_offset);
+                if (ret == ESP_OK && chunk_provider->error()) {
+                    ESP_LOGE(TAG, "Chunk provider error, err %d", chunk_provider->error().value());
+                    ret = ESP_FAIL;
+                }
+            }
+            if (ret != ESP_OK) {
+                break;
+            }
+            auto now = clock::now();
+            if (last_sent != before) {
+                filter.after = last_sent;  // items are yielded in name order: continue after the last one
+                filter.from.reset();
+                last_activity = now;
+            } else if (now - last_activity >= follow_options.heartbeat) {
+                ret = send_heartbeat(req, format);
+                if (ret != ESP_OK) {
+                    break;
+                }
+                last_activity = now;
+            }
+            auto until_heartbeat = std::chrono::duration_cast<std::chrono::milliseconds>(
+                follow_options.heartbeat - (now - last_activity));
+            watch->wait(seq, std::min(follow_options.poll, until_heartbeat));
+        }
+        if (ret == ESP_OK) {
+            send_stream_end(req, format, {});
+            send_last_chunk(req);
+        } else {
+            ESP_LOGI(TAG, "Follower of %s gone", vfs_path.c_str());
+        }
+        wire_scope.reset();  // before the streamer can be destroyed
+        ServerOps::req_async_handler_complete(req);
+        watch->unfollow();
+        std::unique_lock lock(followers_mutex);
+        followers--;
+        std::notify_all_at_thread_exit(followers_done, std::move(lock));
+    }
+
+    esp_err_t send_heartbeat(httpd_req_t *req, StreamFormat format) {
+        if (format == StreamFormat::Framed) {
+            auto hdr = framed::header(framed::Heartbeat, 0);
+            return Ops::resp_send_chunk(req, hdr.data(), hdr.size());
+        }
+        char part[128];
+        int len = snprintf(part, sizeof(part), "\r\n--%s\r\n%s: %lld\r\n\r\n", BOUNDARY,
+                           follow::HEARTBEAT_FIELD, static_cast<long long>(time(nullptr)));
+        return Ops::resp_send_chunk(req, part, std::min<int>(len, sizeof(part) - 1));
+    }
+
+    /**
+     * @brief Ends all follow streams, and waits for their tasks to finish
+     */
+    void stop_followers() {
+        std::unique_lock lock(followers_mutex);
+        if (followers == 0) {
+            return;
+        }
+        stopping = true;
+        if (auto watch = DirWatch::find(vfs_path)) {
+            watch->changed();
+        }
+        followers_done.wait(lock, [&] { return followers == 0; });
+        stopping = false;
     }
 
     /**
@@ -229,56 +967,294 @@ private:
      * @return esp_err_t ESP_OK on success, ESP_FAIL on error
      */
     esp_err_t handler(httpd_req_t* req) {
+        ActiveGuard guard{active};
+        TimingScope timing_scope{server_timing};
+        WireScope wire_scope{*this};
         auto chunk_provider = T(vfs_path);
+        esp_err_t ret;
 
         if constexpr (Chunkable<T>) {  // don't use multipart
-            if (handle_chunkable(req, chunk_provider) != ESP_OK) {
-                goto error;
-            }
-            ESP_LOGD(TAG, "File sent.");
+            ret = handle_chunkable(req, chunk_provider);
         } else if constexpr (IterableOfChunkables<T>) {  // use multipart
-            if (handle_iterable_of_chunkables(req, chunk_provider) != ESP_OK) {
-                goto error;
-            }
+            ret = handle_iterable_of_chunkables(req, chunk_provider);
         } else {
             static_assert(always_false<T>, "Type must respect either the Chunkable or IterableOfChunkable concepts");
         }
+        if (ret == ESP_ERR_INVALID_ARG) {  // request was rejected, error response already sent
+            return ESP_OK;
+        }
+        if (ret == ESP_ERR_NOT_FINISHED) {  // a follower task completes the response
+            return ESP_OK;
+        }
+        if (ret != ESP_OK) {
+            goto error;
+        }
 
         // Close chunked transmission by sending empty chunk
-        ServerOps::resp_send_chunk(req, nullptr, 0);
+        send_last_chunk(req);
         return ESP_OK;
 
         error:  // GOTO tag
-        ServerOps::resp_sendstr_chunk(req, nullptr);
+        Ops::resp_sendstr_chunk(req, nullptr);
         ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
         return ESP_FAIL;
     }
 
+    /**
+     * @brief Handles acknowledgements of collection streams
+     *
+     * Takes the token from the 'commit' query parameter, and has the committer consume the items
+     * covered by the acknowledged stream. Responds with the new consumption cursor.
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t ack_handler(httpd_req_t* req) {
+        if constexpr (ACKED) {
+            char token[MAX_URL_PARAM_SIZE]{};
+            size_t query_len = ServerOps::req_get_url_query_len(req);
+            std::vector<char> query_buf(query_len + 1);
+            if (query_len == 0 ||
+                ServerOps::req_get_url_query_str(req, query_buf.data(), query_buf.size()) != ESP_OK ||
+                ServerOps::query_key_value(query_buf.data(), "commit", token, sizeof(token)) != ESP_OK) {
+                ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing commit token");
+                return ESP_OK;
+            }
+            auto pending = commits.take(token);
+            if (!pending) {
+                ESP_LOGW(TAG, "Unknown commit token %s", token);
+                ServerOps::resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown or expired commit token");
+                return ESP_OK;
+            }
+            std::string cursor;
+            {
+                std::lock_guard lock(committer_mutex);
+                if (auto err = committer.commit(*pending)) {
+                    ESP_LOGE(TAG, "Commit failed, err %d", *err);
+                    ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Commit failed");
+                    return ESP_FAIL;
+                }
+                cursor = committer.cursor().value_or("");
+            }
+            ESP_LOGI(TAG, "Committed up to %s", pending->last().c_str());
+            ServerOps::resp_set_status(req, HTTPD_200);
+            ServerOps::resp_set_type(req, "text/plain");
+            if (!cursor.empty()) {
+                Ops::resp_send_chunk(req, cursor.data(), cursor.size());
+            }
+            Ops::resp_send_chunk(req, nullptr, 0);
+            return ESP_OK;
+        } else {
+            ServerOps::resp_send_err(req, HTTPD_404_NOT_FOUND, "Acknowledgements not enabled");
+            return ESP_OK;
+        }
+    }
+
+    /**
+     * @brief Views a string as a part of a vectored send
+     */
+    static std::span<const char> bytes(std::string_view s) {
+        return {s.data(), s.size()};
+    }
+
     /**
      * @brief Streams chunks from a Chunkable source
      *
      * @tparam C Type satisfying Chunkable concept
      * @param req HTTP request handle
      * @param chunker The Chunkable instance
+     * @param limit If set, exact number of bytes to send; fewer available bytes is an error
+     * @param prefix Buffers sent in the same chunk as the first data (e.g. part headers), at most MAX_PREFIX_PARTS
      * @return esp_err_t ESP_OK on success, ESP_FAIL on error
      */
     template<Chunkable C>
-    esp_err_t send_chunks(httpd_req_t* req, C &chunker) {
+    esp_err_t send_chunks(httpd_req_t* req, C &chunker, std::optional<size_t> limit = std::nullopt,
+                          std::span<const std::span<const char>> prefix = {}) {
         esp_err_t ret = ESP_OK;
+        size_t remaining = limit.value_or(0);
+        tls::ChunkPacker<Ops> packer(req, record_size);
         for (std::span<char> &chunk: chunker) {
-            // Send the buffer contents as HTTP response chunk
-            ret = ServerOps::resp_send_chunk(req, chunk.data(), chunk.size());
+            size_t n = limit ? std::min(chunk.size(), remaining) : chunk.size();
+            // Send the buffer contents as HTTP response chunk, with the prefix if not sent yet
+            wire::count_payload(n);
+            if (prefix.empty()) {
+                ret = packer.write(chunk.first(n));
+            } else {
+                std::array<std::span<const char>, MAX_PREFIX_PARTS + 1> parts;
+                std::ranges::copy(prefix, parts.begin());
+                parts[prefix.size()] = chunk.first(n);
+                ret = packer.write(std::span(parts).first(prefix.size() + 1));
+                prefix = {};
+            }
             if (ret != ESP_OK) {
                 return ret;
             }
+            if (limit) {
+                remaining -= n;
+                if (remaining == 0) break;  // don't read past the range
+            }
+        }
+        if (!prefix.empty() && (ret = packer.write(prefix)) != ESP_OK) {  // no data
+            return ret;
         }
-        if (chunker.error()) {
+        if ((ret = packer.flush()) != ESP_OK) {
+            return ret;
+        }
+        if (chunker.error() || remaining > 0) {
             return ESP_FAIL;
         }
         return ret;
     }
 
+    /**
+     * @brief Sends one item as a multipart/mixed part (boundary, part headers, content)
+     *
+     * @tparam C Type satisfying Chunkable concept
+     * @param req HTTP request handle
+     * @param chunkable The item to send
+     * @param offset If set, the part resumes the item at this offset (already seeked to)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    template<Chunkable C>
+    esp_err_t send_multipart_part(httpd_req_t* req, C &chunkable, std::optional<size_t> offset = std::nullopt) {
+        char offset_line[48];
+        int offset_len = offset ? snprintf(offset_line, sizeof(offset_line), "X-Part-Offset: %zu\r\n", *offset) : 0;
+        // part headers go in the same chunk as the beginning of the content
+        const std::array<std::span<const char>, 7> headers{
+            bytes("\r\n--"), bytes(BOUNDARY),
+            bytes("\r\nContent-Type: application/octet-stream\r\nContent-Disposition: attachment;\r\nX-Part-Name: \""),
+            bytes(chunkable.name()), bytes("\"\r\n"),
+            std::span<const char>(offset_line, std::clamp<int>(offset_len, 0, sizeof(offset_line) - 1)),
+            bytes("\r\n"),
+        };
+        return send_chunks(req, chunkable, std::nullopt, headers);
+    }
+
+    /**
+     * @brief Sends one item as a ustar archive member (header block, content, padding)
+     *
+     * The size and modification time (if the item knows it) announced in the header are taken
+     * before reading; content is truncated or zero-padded to that size if the item changes while
+     * being sent (the latter is an error).
+     *
+     * @tparam C Type satisfying Chunkable concept (must also satisfy SizedChunkable)
+     * @param req HTTP request handle
+     * @param chunkable The item to send
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    template<Chunkable C>
+    esp_err_t send_tar_part(httpd_req_t* req, C &chunkable) {
+        if constexpr (SizedChunkable<C>) {
+            static constexpr char zeros[tar::BLOCK_SIZE]{};
+            auto size = chunkable.size();
+            if (!size) {
+                ESP_LOGE(TAG, "Unknown size for %s", chunkable.name().data());
+                return ESP_FAIL;
+            }
+            uint64_t mtime = 0;
+            if constexpr (DatedChunkable<C>) {
+                mtime = static_cast<uint64_t>(std::max<time_t>(chunkable.mtime().value_or(0), 0));
+            }
+            auto header = tar::file_header(chunkable.name(), *size, mtime);
+            if (!header) {
+                ESP_LOGE(TAG, "Can't represent %s in tar header", chunkable.name().data());
+                return ESP_FAIL;
+            }
+            esp_err_t ret = Ops::resp_send_chunk(req, header->data(), header->size());
+            size_t remaining = *size;
+            for (std::span<char> &chunk: chunkable) {
+                if (ret != ESP_OK || remaining == 0) break;
+                auto n = std::min(chunk.size(), remaining);
+                ret = Ops::resp_send_chunk(req, chunk.data(), n);
+                wire::count_payload(n);
+                remaining -= n;
+            }
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            bool short_read = remaining > 0;
+            while (remaining > 0) {  // keep archive consistent if the item shrank
+                auto n = std::min(remaining, sizeof(zeros));
+                ret = Ops::resp_send_chunk(req, zeros, n);
+                if (ret != ESP_OK) return ret;
+                remaining -= n;
+            }
+            if (auto pad = tar::padding(*size); pad > 0) {
+                ret = Ops::resp_send_chunk(req, zeros, pad);
+            }
+            if (short_read || chunkable.error()) {
+                return ESP_FAIL;
+            }
+            return ret;
+        } else {
+            return ESP_FAIL;
+        }
+    }
+
+    /**
+     * @brief Sends one item as length-prefixed frames (a PartStart frame, then one Data frame per chunk)
+     *
+     * @tparam C Type satisfying Chunkable concept
+     * @param req HTTP request handle
+     * @param chunkable The item to send
+     * @param offset If set, the part resumes the item at this offset (already seeked to)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    template<Chunkable C>
+    esp_err_t send_framed_part(httpd_req_t* req, C &chunkable, std::optional<size_t> offset = std::nullopt) {
+        // each frame header goes in the same chunk as its payload, and the part start (and offset)
+        // frames in the same chunk as the first data frame
+        auto name = chunkable.name();
+        auto start_hdr = framed::header(framed::PartStart, name.size());
+        auto offset_hdr = framed::header(framed::PartOffset, framed::OFFSET_SIZE);
+        auto offset_payload = framed::offset_payload(offset.value_or(0));
+        std::array<char, framed::HEADER_SIZE> hdr;
+        std::array<std::span<const char>, 6> frames{start_hdr, bytes(name)};
+        size_t n = 2;
+        if (offset) {
+            frames[n++] = offset_hdr;
+            frames[n++] = offset_payload;
+        }
+        tls::ChunkPacker<Ops> packer(req, record_size);
+        esp_err_t ret = ESP_OK;
+        for (std::span<char> &chunk: chunkable) {
+            hdr = framed::header(framed::Data, chunk.size());
+            wire::count_payload(chunk.size());
+            frames[n++] = hdr;
+            frames[n++] = chunk;
+            ret = packer.write(std::span(frames).first(n));
+            n = 0;
+            if (ret != ESP_OK) break;
+        }
+        if (n > 0) {
+            ret = packer.write(std::span(frames).first(n));
+        }
+        if (ret == ESP_OK) {
+            ret = packer.flush();
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (chunkable.error()) {
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
     std::string vfs_path;
+    std::mutex committer_mutex;
+    Committer committer;
+    CommitLog<> commits{};
+    std::atomic<int> active{0};
+    follow::Options follow_options{};
+    size_t record_size{TLS_RECORD_SIZE};
+    bool server_timing{SERVER_TIMING};
+    mutable std::mutex wire_mutex;
+    wire::Stats wire_totals{};
+    std::mutex followers_mutex;
+    std::condition_variable followers_done;
+    size_t followers{0};
+    std::atomic<bool> stopping{false};
     httpd_handle_t srv{};
     std::string uri{};
     http_method method{};
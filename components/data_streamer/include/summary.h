@@ -0,0 +1,572 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "concepts.h"
+#include "config.h"
+#include "server_ops.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+
+/**
+ * Per-bucket aggregates (count, min, max, mean) of record-structured files.
+ *
+ * Files hold fixed-size binary records (in the device's byte order): a u32 timestamp in seconds and
+ * one value per channel, as described by a RecordLayout.
+ */
+namespace data_streamer::summary {
+
+inline constexpr char CONTENT_TYPE[] = "text/csv";
+// Response header telling which data answered the query: "raw" or a rollup level in seconds
+inline constexpr char LEVEL_FIELD[] = "X-Summary-Level";
+// Buckets aggregated at once; beyond that, the oldest one is emitted
+inline constexpr size_t MAX_OPEN_BUCKETS = 32;
+inline constexpr size_t MAX_CHANNELS = 32;
+
+enum class ValueType : uint8_t {
+    Int16,
+    Int32,
+    Float32,
+};
+
+/**
+ * @brief Layout of the records of a file
+ */
+struct RecordLayout {
+    size_t record_size;              ///< bytes per record
+    size_t channels{1};              ///< values per record
+    ValueType value_type{ValueType::Float32};
+    size_t time_offset{0};           ///< offset of the u32 timestamp
+    size_t values_offset{4};         ///< offset of the first value, values are contiguous
+
+    [[nodiscard]] constexpr size_t value_size() const {
+        return value_type == ValueType::Int16 ? 2 : 4;
+    }
+
+    [[nodiscard]] constexpr bool valid() const {
+        return channels > 0 && channels <= MAX_CHANNELS && time_offset + 4 <= record_size &&
+               values_offset + channels * value_size() <= record_size;
+    }
+};
+
+/**
+ * @brief Aggregates of one bucket, for the selected channels
+ */
+struct Bucket {
+    int64_t start{0};
+    uint32_t count{0};
+    std::vector<double> min;
+    std::vector<double> max;
+    std::vector<double> sum;
+
+    explicit Bucket(size_t channels = 0)
+        : min(channels, std::numeric_limits<double>::infinity()),
+          max(channels, -std::numeric_limits<double>::infinity()),
+          sum(channels, 0.0) {}
+
+    /**
+     * @brief Adds a record (its selected values)
+     */
+    void add(const double *values) {
+        const size_t n = sum.size();
+        double *mn = min.data();
+        double *mx = max.data();
+        double *sm = sum.data();
+        for (size_t c = 0; c < n; c++) {  // contiguous: vectorized
+            mn[c] = std::min(mn[c], values[c]);
+            mx[c] = std::max(mx[c], values[c]);
+            sm[c] += values[c];
+        }
+        count++;
+    }
+
+    /**
+     * @brief Merges the aggregates of another bucket (e.g. a rollup)
+     */
+    void merge(const Bucket &other) {
+        for (size_t c = 0; c < sum.size(); c++) {
+            min[c] = std::min(min[c], other.min[c]);
+            max[c] = std::max(max[c], other.max[c]);
+            sum[c] += other.sum[c];
+        }
+        count += other.count;
+    }
+};
+
+/**
+ * @brief Decodes the values of the given channels of a record
+ *
+ * @param layout Layout of the record
+ * @param record Start of the record
+ * @param channels Channels to decode
+ * @param out Decoded values, one per channel
+ */
+inline void decode_values(const RecordLayout &layout, const char *record, std::span<const size_t> channels,
+                          double *out) {
+    const char *base = record + layout.values_offset;
+    for (size_t i = 0; i < channels.size(); i++) {
+        const char *p = base + channels[i] * layout.value_size();
+        switch (layout.value_type) {
+            case ValueType::Int16: {
+                int16_t v;
+                memcpy(&v, p, sizeof(v));
+                out[i] = v;
+                break;
+            }
+            case ValueType::Int32: {
+                int32_t v;
+                memcpy(&v, p, sizeof(v));
+                out[i] = v;
+                break;
+            }
+            case ValueType::Float32: {
+                float v;
+                memcpy(&v, p, sizeof(v));
+                out[i] = v;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Gets the timestamp of a record
+ */
+inline uint32_t timestamp(const RecordLayout &layout, const char *record) {
+    uint32_t ts;
+    memcpy(&ts, record + layout.time_offset, sizeof(ts));
+    return ts;
+}
+
+/**
+ * @brief Query of a summary
+ */
+struct Query {
+    uint32_t bucket_seconds{60};
+    std::optional<int64_t> since{};    ///< inclusive lower bound on timestamps
+    std::optional<int64_t> until{};    ///< exclusive upper bound on timestamps
+    std::vector<size_t> channels{};    ///< selected channels, empty for all
+};
+
+/**
+ * @brief Parameters of a summary request
+ */
+struct Params {
+    std::optional<std::string> from;   ///< file name range, as for DataStreamer
+    std::optional<std::string> to;
+    Query query;
+};
+
+/**
+ * @brief Computes per-bucket aggregates of records fed in pieces of any size, in one pass
+ *
+ * Records split across pieces are reassembled; a partial record at the end of a file is dropped
+ * (see end_file()). Completed buckets are passed to the sink in time order as long as fewer than
+ * MAX_OPEN_BUCKETS are open at once; otherwise a bucket may be passed more than once, and the
+ * client merges rows with the same start.
+ *
+ * @tparam Sink Callable taking const Bucket& and returning bool (false to stop)
+ */
+template<typename Sink>
+class Aggregator {
+public:
+    Aggregator(const RecordLayout &layout, Query query, Sink sink)
+        : layout{layout},
+          query{std::move(query)},
+          sink{std::move(sink)} {
+        if (this->query.channels.empty()) {
+            for (size_t c = 0; c < layout.channels; c++) this->query.channels.push_back(c);
+        }
+        values.resize(this->query.channels.size());
+        partial.reserve(layout.record_size);
+    }
+
+    /**
+     * @brief Feeds a piece of a file
+     *
+     * @return bool false if the sink stopped
+     */
+    bool feed(std::span<const char> data) {
+        const size_t size = layout.record_size;
+        if (!partial.empty()) {
+            size_t n = std::min(size - partial.size(), data.size());
+            partial.insert(partial.end(), data.begin(), data.begin() + n);
+            data = data.subspan(n);
+            if (partial.size() < size) return true;
+            if (!add_record(partial.data())) return false;
+            partial.clear();
+        }
+        size_t whole = data.size() / size * size;
+        for (size_t i = 0; i < whole; i += size) {
+            if (!add_record(data.data() + i)) return false;
+        }
+        partial.assign(data.begin() + whole, data.end());
+        return true;
+    }
+
+    /**
+     * @brief Ends the current file, dropping a partial record (e.g. being written)
+     */
+    void end_file() {
+        if (!partial.empty()) dropped_bytes += partial.size();
+        partial.clear();
+    }
+
+    /**
+     * @brief Passes the remaining buckets to the sink
+     *
+     * @return bool false if the sink stopped
+     */
+    bool finish() {
+        end_file();
+        while (!open.empty()) {
+            if (!emit_oldest()) return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] uint64_t records() const { return record_count; }
+    [[nodiscard]] uint64_t dropped() const { return dropped_bytes; }
+    [[nodiscard]] const Query& get_query() const { return query; }
+
+private:
+    bool add_record(const char *record) {
+        int64_t t = timestamp(layout, record);
+        if ((query.since && t < *query.since) || (query.until && t >= *query.until)) return true;
+        int64_t start = t - t % query.bucket_seconds;
+        if (current == nullptr || current->start != start) {
+            auto it = open.find(start);
+            if (it == open.end()) {
+                if (open.size() >= MAX_OPEN_BUCKETS && !emit_oldest()) return false;
+                it = open.emplace(start, Bucket(query.channels.size())).first;
+                it->second.start = start;
+            }
+            current = &it->second;
+        }
+        decode_values(layout, record, query.channels, values.data());
+        current->add(values.data());
+        record_count++;
+        return true;
+    }
+
+    bool emit_oldest() {
+        auto node = open.extract(open.begin());
+        if (current == &node.mapped()) current = nullptr;
+        return sink(node.mapped());
+    }
+
+    RecordLayout layout;
+    Query query;
+    Sink sink;
+    std::map<int64_t, Bucket> open;
+    Bucket *current{nullptr};
+    std::vector<double> values;
+    std::vector<char> partial;
+    uint64_t record_count{0};
+    uint64_t dropped_bytes{0};
+};
+
+/**
+ * @brief Formats the CSV header line of a summary
+ */
+inline std::string csv_header(const std::vector<size_t> &channels) {
+    std::string line = "start,count";
+    for (auto c: channels) {
+        auto name = std::to_string(c);
+        line += ",min" + name + ",max" + name + ",mean" + name;
+    }
+    return line + "\n";
+}
+
+/**
+ * @brief Appends the CSV line of a bucket
+ */
+inline void append_csv_row(std::string &out, const Bucket &bucket) {
+    char buf[32];
+    out += std::to_string(bucket.start);
+    out += ',';
+    out += std::to_string(bucket.count);
+    for (size_t c = 0; c < bucket.sum.size(); c++) {
+        for (double v: {bucket.min[c], bucket.max[c], bucket.sum[c] / bucket.count}) {
+            snprintf(buf, sizeof(buf), ",%.7g", v);
+            out += buf;
+        }
+    }
+    out += '\n';
+}
+
+/**
+ * @brief Parses a comma-separated list of channel indices
+ *
+ * @return std::optional<std::vector<size_t>> nullopt if malformed or out of range
+ */
+inline std::optional<std::vector<size_t>> parse_channels(std::string_view list, size_t channels) {
+    std::vector<size_t> out;
+    while (!list.empty()) {
+        auto comma = list.find(',');
+        auto item = list.substr(0, comma);
+        size_t c;
+        auto [ptr, ec] = std::from_chars(item.data(), item.data() + item.size(), c);
+        if (ec != std::errc() || ptr != item.data() + item.size() || c >= channels ||
+            out.size() == MAX_CHANNELS) {
+            return std::nullopt;
+        }
+        out.push_back(c);
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    if (out.empty()) return std::nullopt;
+    return out;
+}
+
+namespace detail {
+inline bool parse_int(const char *value, int64_t &out) {
+    const char *end = value + strlen(value);
+    auto [ptr, ec] = std::from_chars(value, end, out);
+    return ec == std::errc() && ptr == end && ptr != value;
+}
+}  // namespace detail
+
+/**
+ * @brief Reads the query parameters of a summary request (from, to, since, until, bucket, channels)
+ *
+ * @tparam ServerOps Server operations interface
+ * @param req HTTP request handle
+ * @param channels Number of channels of the records
+ * @return std::optional<Params> nullopt if a parameter is malformed
+ */
+template<typename ServerOps>
+std::optional<Params> read_params(httpd_req_t *req, size_t channels) {
+    constexpr size_t MAX_PARAM_SIZE = 128;
+    Params params;
+    size_t query_len = ServerOps::req_get_url_query_len(req);
+    if (query_len == 0) {
+        return params;
+    }
+    std::vector<char> query_buf(query_len + 1);
+    if (ServerOps::req_get_url_query_str(req, query_buf.data(), query_buf.size()) != ESP_OK) {
+        return params;
+    }
+    char value[MAX_PARAM_SIZE];
+    int64_t number;
+    if (ServerOps::query_key_value(query_buf.data(), "from", value, sizeof(value)) == ESP_OK) {
+        params.from = std::string(value);
+    }
+    if (ServerOps::query_key_value(query_buf.data(), "to", value, sizeof(value)) == ESP_OK) {
+        params.to = std::string(value);
+    }
+    if (ServerOps::query_key_value(query_buf.data(), "since", value, sizeof(value)) == ESP_OK) {
+        if (!detail::parse_int(value, number)) return std::nullopt;
+        params.query.since = number;
+    }
+    if (ServerOps::query_key_value(query_buf.data(), "until", value, sizeof(value)) == ESP_OK) {
+        if (!detail::parse_int(value, number)) return std::nullopt;
+        params.query.until = number;
+    }
+    if (ServerOps::query_key_value(query_buf.data(), "bucket", value, sizeof(value)) == ESP_OK) {
+        if (!detail::parse_int(value, number) || number <= 0 || number > UINT32_MAX) return std::nullopt;
+        params.query.bucket_seconds = static_cast<uint32_t>(number);
+    }
+    if (ServerOps::query_key_value(query_buf.data(), "channels", value, sizeof(value)) == ESP_OK) {
+        auto selected = parse_channels(value, channels);
+        if (!selected) return std::nullopt;
+        params.query.channels = std::move(*selected);
+    }
+    return params;
+}
+}  // namespace data_streamer::summary
+
+
+namespace data_streamer {
+
+/**
+ * @brief HTTP handler streaming per-bucket aggregates of the record files of a collection
+ *
+ * Reads the files of an IterableOfChunkables once and responds with a CSV table: one row per time
+ * bucket with the record count and, per channel, min, max and mean. Query parameters:
+ * - `from`, `to`: file name range, as for DataStreamer
+ * - `since`, `until`: timestamp range (seconds, until exclusive)
+ * - `bucket`: bucket duration in seconds (default 60)
+ * - `channels`: comma-separated channel indices (default all)
+ *
+ * @tparam T The data source type (must satisfy IterableOfChunkables)
+ * @tparam ServerOps Server operations interface (defaults to EspHttpServerOps)
+ *
+ * Example usage:
+ * @code
+ * auto summary = SummaryStreamer<FlatDirIterable<>>("/sdcard/logs", {.record_size = 16, .channels = 3});
+ * summary.bind(server, "/summary");
+ * // GET /summary?bucket=60&channels=0,2&since=1735689600
+ * @endcode
+ */
+template <typename T, typename ServerOps = EspHttpServerOps>
+    requires IterableOfChunkables<T>
+class SummaryStreamer {
+public:
+    /**
+     * @brief Constructs a SummaryStreamer for the given path
+     *
+     * @param vfs_path Path to the data source (e.g. a directory)
+     * @param layout Layout of the records of every file
+     */
+    SummaryStreamer(std::string_view vfs_path, summary::RecordLayout layout)
+    : vfs_path{vfs_path},
+      layout{layout} {}
+
+    ~SummaryStreamer() {
+        unbind();
+    }
+
+    /**
+     * @brief Binds the streamer to an HTTP server endpoint
+     *
+     * @param server HTTP server handle
+     * @param uri Endpoint URI
+     * @param method HTTP method (typically HTTP_GET)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t bind(httpd_handle_t server, const std::string &uri, http_method method = HTTP_GET) {
+        if (!server) {
+            ESP_LOGE(TAG, "Null server handle");
+            return ESP_FAIL;
+        }
+        if (!layout.valid()) {
+            ESP_LOGE(TAG, "Invalid record layout");
+            return ESP_FAIL;
+        }
+        this->srv = server;
+        this->uri = uri;
+        this->method = method;
+        httpd_uri_t summary_endpoint = {
+            .uri       = uri.c_str(),
+            .method    = method,
+            .handler   = &SummaryStreamer::handler_wrapper,
+            .user_ctx  = this
+        };
+        return ServerOps::register_uri_handler(server, &summary_endpoint);
+    }
+
+    /**
+     * @brief Unbinds the streamer from the HTTP server
+     *
+     * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if not bound
+     */
+    esp_err_t unbind() {
+        if (srv == nullptr) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        return ServerOps::unregister_uri_handler(srv, uri.c_str(), method);
+    }
+
+    /**
+     * @brief HTTP handler callback wrapper
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    static esp_err_t handler_wrapper(httpd_req_t* req) {
+        auto* instance = static_cast<SummaryStreamer*>(req->user_ctx);
+        return instance->handler(req);
+    }
+
+    /**
+     * @brief Streams the summary for already parsed parameters (e.g. as fallback of RollupStreamer)
+     *
+     * @param req HTTP request handle
+     * @param params Request parameters
+     * @param level_header Value of the X-Summary-Level response header, if any
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t stream(httpd_req_t* req, summary::Params params, const char *level_header = nullptr) {
+        std::string out;
+        out.reserve(CHUNK_SIZE);
+        bool send_failed = false;
+        auto sink = [&](const summary::Bucket &bucket) {
+            summary::append_csv_row(out, bucket);
+            if (out.size() >= CHUNK_SIZE - 256) {
+                send_failed = ServerOps::resp_send_chunk(req, out.data(), out.size()) != ESP_OK;
+                out.clear();
+            }
+            return !send_failed;
+        };
+        auto aggregator = summary::Aggregator(layout, std::move(params.query), sink);
+        auto chunk_provider = T(vfs_path);
+        ServerOps::resp_set_status(req, HTTPD_200);
+        ServerOps::resp_set_type(req, summary::CONTENT_TYPE);
+        if (level_header != nullptr) {
+            ServerOps::resp_set_hdr(req, summary::LEVEL_FIELD, level_header);
+        }
+        out = summary::csv_header(aggregator.get_query().channels);
+        for (auto &chunkable: chunk_provider) {
+            if (params.from && chunkable.name() < *params.from) continue;
+            if (params.to && chunkable.name() > *params.to) continue;
+            for (std::span<char> &chunk: chunkable) {
+                if (!aggregator.feed(chunk)) break;
+            }
+            aggregator.end_file();
+            if (send_failed || chunkable.error()) goto error;
+        }
+        if (chunk_provider.error() || !aggregator.finish()) {
+            goto error;
+        }
+        if (!out.empty() && ServerOps::resp_send_chunk(req, out.data(), out.size()) != ESP_OK) {
+            goto error;
+        }
+        ESP_LOGI(TAG, "Summary of %llu records sent", static_cast<unsigned long long>(aggregator.records()));
+        ServerOps::resp_send_chunk(req, nullptr, 0);
+        return ESP_OK;
+
+        error:  // GOTO tag
+        ServerOps::resp_sendstr_chunk(req, nullptr);
+        ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send summary");
+        return ESP_FAIL;
+    }
+
+private:
+    /**
+     * @brief Main request handler
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t handler(httpd_req_t* req) {
+        auto params = summary::read_params<ServerOps>(req, layout.channels);
+        if (!params) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid summary query");
+            return ESP_OK;
+        }
+        return stream(req, std::move(*params));
+    }
+
+    std::string vfs_path;
+    summary::RecordLayout layout;
+    httpd_handle_t srv{};
+    std::string uri{};
+    http_method method{};
+};
+}  // namespace data_streamer
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+
+/**
+ * Per-response timing breakdown, reported to the client as a Server-Timing trailer.
+ *
+ * Time is accounted to phases by Span scopes placed around directory scans, file opens and reads
+ * (vfs_streamer.h), and around sends (TimedOps). Sends lasting longer than BLOCKED_AFTER are taken to wait
+ * for the client to read (the socket buffer being full): the excess is accounted as blocked.
+ */
+namespace data_streamer::timing {
+
+using clock = std::chrono::steady_clock;
+
+enum Phase : uint8_t {
+    Scan,     ///< listing directories, stat'ing entries
+    Open,     ///< opening files
+    Read,     ///< reading file content
+    Send,     ///< handing data to the server
+    Blocked,  ///< waiting for the client to read
+};
+inline constexpr size_t PHASE_COUNT = 5;
+inline constexpr std::array<const char*, PHASE_COUNT> PHASE_NAMES{"scan", "open", "read", "send", "blocked"};
+
+// Trailer field carrying the timings
+inline constexpr char SERVER_TIMING_FIELD[] = "Server-Timing";
+// Sends taking longer than this are waiting for the client
+inline constexpr clock::duration BLOCKED_AFTER = std::chrono::milliseconds(2);
+
+/**
+ * @brief Time spent in each phase of a response
+ */
+struct Timings {
+    clock::time_point started{clock::now()};
+    std::array<clock::duration, PHASE_COUNT> spent{};
+    std::array<uint32_t, PHASE_COUNT> count{};
+    bool sending{false};   ///< the response status and headers were sent
+    bool reported{false};  ///< the timings were sent in the response
+
+    void add(Phase phase, clock::duration d) {
+        spent[phase] += d;
+        count[phase]++;
+    }
+
+    void add_send(clock::duration d) {
+        sending = true;
+        add(Send, std::min(d, BLOCKED_AFTER));
+        if (d > BLOCKED_AFTER) {
+            add(Blocked, d - BLOCKED_AFTER);
+        }
+    }
+
+    /**
+     * @brief Formats the timings as a Server-Timing value, in milliseconds, e.g.
+     *        "scan;dur=1.204, open;dur=0.310, read;dur=35.112, send;dur=12.870, blocked;dur=0.000, total;dur=52.004"
+     */
+    [[nodiscard]] std::string to_header(clock::time_point now = clock::now()) const {
+        std::string out;
+        char entry[48];
+        auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+        for (size_t i = 0; i < PHASE_COUNT; i++) {
+            snprintf(entry, sizeof(entry), "%s;dur=%.3f, ", PHASE_NAMES[i], ms(spent[i]));
+            out += entry;
+        }
+        snprintf(entry, sizeof(entry), "total;dur=%.3f", ms(now - started));
+        return out + entry;
+    }
+};
+
+/**
+ * @brief Accounts the spans of the current task to Timings, while alive
+ *
+ * As for wire::Meter, a response is sent by a single task, so that spans find the recorder of their
+ * response through a thread-local pointer. Without a recorder, spans don't read the clock.
+ */
+class Recorder {
+public:
+    explicit Recorder(Timings &timings): timings{timings}, previous{current} {
+        current = this;
+    }
+
+    ~Recorder() {
+        current = previous;
+    }
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    /**
+     * @brief Gets the recorder of the current task, if any
+     */
+    static Recorder *active() {
+        return current;
+    }
+
+    Timings &timings;
+
+private:
+    static inline thread_local Recorder *current = nullptr;
+    Recorder *previous;
+};
+
+/**
+ * @brief Accounts the lifetime of the scope to a phase of the current response, if recorded
+ *
+ * Example usage:
+ * @code
+ * {
+ *     timing::Span span(timing::Read);
+ *     n = fread(buf, 1, size, file);
+ * }
+ * @endcode
+ */
+class Span {
+public:
+    explicit Span(Phase phase)
+    : recorder{Recorder::active()},
+      phase{phase},
+      start{recorder ? clock::now() : clock::time_point{}} {}
+
+    ~Span() {
+        if (recorder) {
+            auto d = clock::now() - start;
+            if (phase == Send) {
+                recorder->timings.add_send(d);
+            } else {
+                recorder->timings.add(phase, d);
+            }
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    Recorder *recorder;
+    Phase phase;
+    clock::time_point start;
+};
+
+/**
+ * @brief Server operations accounting sends to the recorder of the current task, if any
+ *
+ * @tparam ServerOps Server operations (see server_ops.h)
+ */
+template<typename ServerOps>
+struct TimedOps: ServerOps {
+    static esp_err_t resp_send_chunk(httpd_req_t* req, const char* chunk, ssize_t size) {
+        Span span(Send);
+        return ServerOps::resp_send_chunk(req, chunk, size);
+    }
+    static esp_err_t resp_sendstr_chunk(httpd_req_t* req, const char* chunk) {
+        Span span(Send);
+        return ServerOps::resp_sendstr_chunk(req, chunk);
+    }
+    static esp_err_t resp_send_chunkv(httpd_req_t* req, std::span<const std::span<const char>> parts) {
+        Span span(Send);
+        return ServerOps::resp_send_chunkv(req, parts);
+    }
+    static esp_err_t send_raw(httpd_req_t* req, const char* buf, size_t len) {
+        Span span(Send);
+        return ServerOps::send_raw(req, buf, len);
+    }
+};
+}  // namespace data_streamer::timing
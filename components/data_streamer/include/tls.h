@@ -0,0 +1,168 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <vector>
+#include "config.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+
+/**
+ * Sizing of response chunks to TLS records.
+ *
+ * Over TLS, every write to the connection is sent as one or more records, each carrying a header, a MAC
+ * and padding besides its payload. ESP's chunked responses take three writes per chunk (size line, data,
+ * CRLF), so that each chunk makes three records, two of them nearly empty. Chunks can instead be packed
+ * into frames of exactly one record payload each (size line, data and CRLF), sent in a single write.
+ */
+namespace data_streamer::tls {
+
+// Smallest record size packed by ChunkPacker; smaller sizes disable packing
+inline constexpr size_t MIN_RECORD_SIZE = 256;
+
+/**
+ * @brief Gets the number of hex digits of a value
+ */
+constexpr size_t hex_digits(size_t n) {
+    size_t digits = 1;
+    while (n >>= 4) digits++;
+    return digits;
+}
+
+/**
+ * @brief Gets the data size of a chunk whose framing (size line, data, CRLF) is exactly record_size bytes
+ *
+ * The size line is zero-padded to the number of digits of record_size.
+ */
+constexpr size_t chunk_payload(size_t record_size) {
+    return record_size - hex_digits(record_size) - 4;
+}
+
+/**
+ * @brief Packs the content of a response into chunks of one TLS record each
+ *
+ * Written data is buffered until it fills a chunk of chunk_payload(record_size) bytes, which is sent with its
+ * framing in one write (ServerOps::send_raw). The first chunk is sent with ServerOps::resp_send_chunk, that also
+ * sends the response headers if needed. With a record size of 0 (or below MIN_RECORD_SIZE), data is sent as
+ * written, one chunk per write() call.
+ *
+ * Example usage:
+ * @code
+ * auto packer = tls::ChunkPacker<EspHttpServerOps>(req, 4096);
+ * for (auto chunk : chunks) {
+ *     if (packer.write(chunk) != ESP_OK) break;
+ * }
+ * packer.flush();  // sends the last, partial chunk
+ * @endcode
+ *
+ * @tparam ServerOps Server operations (see server_ops.h)
+ */
+template<typename ServerOps>
+class ChunkPacker {
+public:
+    /**
+     * @param req HTTP request handle
+     * @param record_size Record payload size to fill, 0 to send data as written
+     */
+    ChunkPacker(httpd_req_t *req, size_t record_size)
+    : req{req},
+      digits{hex_digits(record_size)},
+      capacity{record_size >= MIN_RECORD_SIZE ? chunk_payload(record_size) : 0} {
+        if (capacity > 0) {
+            buf.resize(record_size);
+        }
+    }
+
+    /**
+     * @brief Writes buffers, sent together
+     */
+    esp_err_t write(std::span<const std::span<const char>> parts) {
+        if (capacity == 0) {
+            return ServerOps::resp_send_chunkv(req, parts);
+        }
+        for (auto part: parts) {
+            if (esp_err_t ret = append(part); ret != ESP_OK) {
+                return ret;
+            }
+        }
+        return ESP_OK;
+    }
+
+    /**
+     * @brief Writes a buffer
+     */
+    esp_err_t write(std::span<const char> data) {
+        if (capacity == 0) {
+            return data.empty() ? ESP_OK : ServerOps::resp_send_chunk(req, data.data(), static_cast<ssize_t>(data.size()));
+        }
+        return append(data);
+    }
+
+    /**
+     * @brief Sends the buffered data, if any
+     */
+    esp_err_t flush() {
+        if (used == 0) {
+            return ESP_OK;
+        }
+        char *payload = buf.data() + digits + 2;
+        esp_err_t ret;
+        if (!started) {
+            ret = ServerOps::resp_send_chunk(req, payload, static_cast<ssize_t>(used));
+            started = true;
+        } else {
+            // zero-padded size line, so that the payload stays in place
+            char size_line[2 * sizeof(size_t) + 1];
+            snprintf(size_line, sizeof(size_line), "%0*zx", static_cast<int>(digits), used);
+            memcpy(buf.data(), size_line, digits);
+            memcpy(buf.data() + digits, "\r\n", 2);
+            memcpy(payload + used, "\r\n", 2);
+            ret = ServerOps::send_raw(req, buf.data(), digits + 4 + used);
+        }
+        used = 0;
+        return ret;
+    }
+
+private:
+    esp_err_t append(std::span<const char> data) {
+        while (!data.empty()) {
+            size_t n = std::min(data.size(), capacity - used);
+            memcpy(buf.data() + digits + 2 + used, data.data(), n);
+            used += n;
+            data = data.subspan(n);
+            if (used == capacity) {
+                if (esp_err_t ret = flush(); ret != ESP_OK) {
+                    return ret;
+                }
+            }
+        }
+        return ESP_OK;
+    }
+
+    httpd_req_t *req;
+    size_t digits;
+    size_t capacity;  // data size of full chunks, 0 if not packing
+    std::vector<char> buf;  // size line, data, CRLF
+    size_t used{0};
+    bool started{false};
+};
+}  // namespace data_streamer::tls
@@ -0,0 +1,445 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+#include "concepts.h"
+#include "config.h"
+#include "server_ops.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+
+namespace data_streamer {
+
+namespace upload {
+// Response header carrying the size of the pending upload
+inline constexpr char OFFSET_FIELD[] = "X-Upload-Offset";
+inline constexpr char STATUS_409[] = "409 Conflict";
+// Consecutive receive timeouts tolerated before giving up on a client
+inline constexpr int MAX_RECV_TIMEOUTS = 3;
+}  // namespace upload
+
+/**
+ * @brief Writes buffers to an UploadSink on a separate thread
+ *
+ * Owns nothing but a writer thread: the two buffers come from the caller, so that they can be
+ * reused across uploads. While one buffer is being written, the other one can be filled.
+ * After a write error, further buffers are discarded and submit() returns false.
+ *
+ * Example usage:
+ * @code
+ * auto writer = DoubleBufferedWriter(sink, buffers);
+ * auto buf = writer.buffer();  // fill it
+ * writer.submit(n);
+ * bool ok = writer.finish();
+ * @endcode
+ *
+ * @tparam S Type satisfying UploadSink
+ */
+template<UploadSink S>
+class DoubleBufferedWriter {
+public:
+    DoubleBufferedWriter(S &sink, std::array<std::vector<char>, 2> &buffers)
+        : sink{sink},
+          buffers{buffers},
+          worker{[this] { loop(); }} {}
+
+    DoubleBufferedWriter(const DoubleBufferedWriter&) = delete;
+    DoubleBufferedWriter& operator=(const DoubleBufferedWriter&) = delete;
+
+    ~DoubleBufferedWriter() {
+        finish();
+    }
+
+    /**
+     * @brief Gets the buffer to fill next, waiting until it has been written if needed
+     */
+    std::span<char> buffer() {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [this] { return pending[fill] == 0; });
+        return buffers[fill];
+    }
+
+    /**
+     * @brief Hands the first n bytes of the buffer returned by buffer() over to the writer thread
+     *
+     * @return bool false if a previous write failed
+     */
+    bool submit(size_t n) {
+        std::lock_guard lock(mutex);
+        if (n > 0) {
+            pending[fill] = n;
+            fill ^= 1;
+            changed.notify_all();
+        }
+        return !failed;
+    }
+
+    /**
+     * @brief Waits until all submitted buffers are written, and stops the writer thread
+     *
+     * @return bool false if a write failed
+     */
+    bool finish() {
+        {
+            std::lock_guard lock(mutex);
+            done = true;
+        }
+        changed.notify_all();
+        if (worker.joinable()) worker.join();
+        return !failed;
+    }
+
+    /**
+     * @brief Gets the number of bytes written to the sink so far
+     */
+    [[nodiscard]] size_t written() const {
+        std::lock_guard lock(mutex);
+        return bytes_written;
+    }
+
+private:
+    void loop() {
+        size_t next = 0;  // buffers are written in the order they were filled
+        std::unique_lock lock(mutex);
+        while (true) {
+            changed.wait(lock, [&] { return pending[next] > 0 || done; });
+            if (pending[next] == 0) break;  // done, and nothing left to write
+            size_t n = pending[next];
+            bool skip = failed;
+            lock.unlock();
+            bool ok = skip || sink.write(std::span<const char>(buffers[next].data(), n));
+            lock.lock();
+            if (!ok) {
+                failed = true;
+            } else if (!skip) {
+                bytes_written += n;
+            }
+            pending[next] = 0;
+            next ^= 1;
+            changed.notify_all();
+        }
+    }
+
+    S &sink;
+    std::array<std::vector<char>, 2> &buffers;
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::array<size_t, 2> pending{};
+    size_t fill{0};
+    size_t bytes_written{0};
+    bool failed{false};
+    bool done{false};
+    std::thread worker;  // last, so that it starts once everything else is initialized
+};
+
+
+/**
+ * @brief HTTP upload handler writing request bodies to an UploadSink
+ *
+ * The counterpart of DataStreamer: the request body is received into one of two buffers while the
+ * other one is written to storage by a DoubleBufferedWriter. Buffers are sized to a multiple of the
+ * sink's block size (e.g. the FAT cluster size), and writes are aligned to it.
+ *
+ * Protocol:
+ * - `PUT <uri>` with a Content-Length body uploads the whole content, which is published at once
+ *   (e.g. renamed into place) when the body has been received completely.
+ * - `?offset=N` appends the body to the pending upload instead, e.g. to resume after a broken
+ *   connection. N must be the size of the pending upload, otherwise the response is 409 Conflict.
+ *   Data received before a connection breaks is kept.
+ * - `?more=1` keeps the upload pending after this body, to send content of unknown length as
+ *   successive requests.
+ * - `HEAD <uri>` gets the size of the pending upload.
+ * All responses carry the size of the pending (or just published) upload in `X-Upload-Offset`.
+ *
+ * @note ESP's HTTP server doesn't decode chunked request bodies, so requests must have a Content-Length.
+ *
+ * @tparam T The upload destination type (must satisfy UploadSink)
+ * @tparam ServerOps Server operations interface (defaults to EspHttpServerOps)
+ *
+ * Example usage:
+ * @code
+ * auto uploader = DataUploader<FileSink>("/sdcard/calibration.bin");
+ * uploader.bind(server, "/calibration");
+ * // curl -T table.bin https://device/calibration
+ * @endcode
+ */
+template <typename T, typename ServerOps = EspHttpServerOps>
+    requires UploadSink<T>
+class DataUploader {
+public:
+    /**
+     * @brief Constructs a DataUploader for the given path
+     *
+     * @param vfs_path Path of the uploaded data (e.g. a file)
+     */
+    explicit DataUploader(std::string_view vfs_path)
+    : vfs_path{vfs_path} {}
+
+    ~DataUploader() {
+        unbind();
+    }
+
+    /**
+     * @brief Binds the uploader to an HTTP server endpoint
+     *
+     * A HEAD handler reporting the pending upload size is bound to the same URI.
+     *
+     * @param server HTTP server handle
+     * @param uri Endpoint URI
+     * @param method HTTP method for uploads (typically HTTP_PUT)
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t bind(httpd_handle_t server, const std::string &uri, http_method method = HTTP_PUT) {
+        if (!server) {
+            ESP_LOGE(TAG, "Null server handle");
+            return ESP_FAIL;
+        }
+        this->srv = server;
+        this->uri = uri;
+        this->method = method;
+        httpd_uri_t upload_endpoint = {
+            .uri       = uri.c_str(),
+            .method    = method,
+            .handler   = &DataUploader::handler_wrapper,
+            .user_ctx  = this
+        };
+        esp_err_t ret = ServerOps::register_uri_handler(server, &upload_endpoint);
+        if (ret == ESP_OK) {
+            httpd_uri_t status_endpoint = {
+                .uri       = uri.c_str(),
+                .method    = HTTP_HEAD,
+                .handler   = &DataUploader::status_handler_wrapper,
+                .user_ctx  = this
+            };
+            ret = ServerOps::register_uri_handler(server, &status_endpoint);
+        }
+        return ret;
+    }
+
+    /**
+     * @brief Unbinds the uploader from the HTTP server
+     *
+     * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_STATE if not bound
+     */
+    esp_err_t unbind() {
+        if (srv == nullptr) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        ServerOps::unregister_uri_handler(srv, uri.c_str(), HTTP_HEAD);
+        return ServerOps::unregister_uri_handler(srv, uri.c_str(), method);
+    }
+
+    /**
+     * @brief HTTP handler callback wrapper for uploads
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error (the connection is closed)
+     */
+    static esp_err_t handler_wrapper(httpd_req_t* req) {
+        auto* instance = static_cast<DataUploader*>(req->user_ctx);
+        return instance->handler(req);
+    }
+
+    /**
+     * @brief HTTP handler callback wrapper for upload status requests (HEAD)
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    static esp_err_t status_handler_wrapper(httpd_req_t* req) {
+        auto* instance = static_cast<DataUploader*>(req->user_ctx);
+        return instance->status_handler(req);
+    }
+
+private:
+    struct Params {
+        size_t offset{0};
+        bool more{false};
+    };
+
+    /**
+     * @brief Reads the 'offset' and 'more' query parameters
+     *
+     * @return std::optional<Params> nullopt if a parameter is malformed
+     */
+    std::optional<Params> read_params(httpd_req_t *req) {
+        Params params;
+        size_t query_len = ServerOps::req_get_url_query_len(req);
+        if (query_len == 0) {
+            return params;
+        }
+        std::vector<char> query_buf(query_len + 1);
+        if (ServerOps::req_get_url_query_str(req, query_buf.data(), query_buf.size()) != ESP_OK) {
+            return params;
+        }
+        char value[MAX_UPLOAD_PARAM_SIZE];
+        if (ServerOps::query_key_value(query_buf.data(), "offset", value, sizeof(value)) == ESP_OK) {
+            const char *end = value + strlen(value);
+            auto [ptr, ec] = std::from_chars(value, end, params.offset);
+            if (ec != std::errc() || ptr != end || ptr == value) {
+                return std::nullopt;
+            }
+        }
+        if (ServerOps::query_key_value(query_buf.data(), "more", value, sizeof(value)) == ESP_OK) {
+            params.more = strcmp(value, "1") == 0 || strcmp(value, "true") == 0;
+        }
+        return params;
+    }
+
+    /**
+     * @brief Sends a response without body, carrying the upload offset
+     */
+    esp_err_t respond(httpd_req_t *req, const char *status, size_t offset) {
+        auto offset_str = std::to_string(offset);
+        ServerOps::resp_set_status(req, status);
+        ServerOps::resp_set_hdr(req, upload::OFFSET_FIELD, offset_str.c_str());
+        return ServerOps::resp_send(req, nullptr, 0);
+    }
+
+    /**
+     * @brief Handles uploads
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t handler(httpd_req_t* req) {
+        auto params = read_params(req);
+        if (!params) {
+            ServerOps::resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid offset");
+            return ESP_FAIL;  // body wasn't read: close the connection
+        }
+        if (req->content_len == 0 && ServerOps::req_get_hdr_value_len(req, "Transfer-Encoding") > 0) {
+            ServerOps::resp_send_err(req, HTTPD_411_LENGTH_REQUIRED, "Content-Length required");
+            return ESP_FAIL;
+        }
+        auto sink = T(vfs_path);
+        size_t pending = sink.received();
+        if (params->offset != 0 && params->offset != pending) {
+            ESP_LOGW(TAG, "Upload offset %zu, expected %zu", params->offset, pending);
+            respond(req, upload::STATUS_409, pending);
+            return ESP_FAIL;
+        }
+        if (!sink.open(params->offset)) {
+            ESP_LOGE(TAG, "Can't open upload, err %d", sink.error().value_or(0));
+            ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Can't open upload");
+            return ESP_FAIL;
+        }
+        auto received = receive(req, sink, params->offset);
+        if (!received) {
+            return ESP_FAIL;  // connection broke or storage failed, response already sent if possible
+        }
+        size_t total = params->offset + *received;
+        if (!params->more) {
+            if (!sink.commit()) {
+                ESP_LOGE(TAG, "Can't publish upload, err %d", sink.error().value_or(0));
+                ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Can't publish upload");
+                return ESP_FAIL;
+            }
+            ESP_LOGI(TAG, "Upload of %zu bytes published", total);
+        }
+        respond(req, params->more ? HTTPD_200 : HTTPD_201, total);
+        return ESP_OK;
+    }
+
+    /**
+     * @brief Receives the request body and writes it to the sink
+     *
+     * The first buffer is shortened so that writes start on a block boundary when resuming.
+     *
+     * @return std::optional<size_t> Bytes received and written, nullopt on error
+     */
+    std::optional<size_t> receive(httpd_req_t* req, T &sink, size_t offset) {
+        size_t block = std::max<size_t>(sink.block_size(), 1);
+        size_t buffer_size = (UPLOAD_BUFFER_SIZE + block - 1) / block * block;
+        for (auto &buffer: buffers) {
+            if (buffer.size() != buffer_size) {
+                buffer.resize(buffer_size);
+                buffer.shrink_to_fit();
+            }
+        }
+        size_t remaining = req->content_len;
+        size_t received = 0;
+        auto writer = DoubleBufferedWriter<T>(sink, buffers);
+        auto buf = writer.buffer();
+        size_t target = buffer_size - offset % block;
+        size_t filled = 0;
+        int timeouts = 0;
+        while (remaining > 0) {
+            int n = ServerOps::req_recv(req, buf.data() + filled, std::min(target - filled, remaining));
+            if (n == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= upload::MAX_RECV_TIMEOUTS) {
+                continue;
+            }
+            if (n <= 0) {
+                // keep what was received, so that the client can resume
+                writer.submit(filled);
+                writer.finish();
+                ESP_LOGW(TAG, "Upload interrupted after %zu bytes", offset + writer.written());
+                return std::nullopt;
+            }
+            timeouts = 0;
+            filled += n;
+            received += n;
+            remaining -= n;
+            if (filled == target || remaining == 0) {
+                if (!writer.submit(filled)) break;
+                if (remaining > 0) {
+                    buf = writer.buffer();
+                    target = buffer_size;
+                    filled = 0;
+                }
+            }
+        }
+        if (!writer.finish()) {
+            ESP_LOGE(TAG, "Can't write upload, err %d", sink.error().value_or(0));
+            ServerOps::resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Can't write upload");
+            return std::nullopt;
+        }
+        return received;
+    }
+
+    /**
+     * @brief Handles upload status requests
+     *
+     * @param req HTTP request handle
+     * @return esp_err_t ESP_OK on success, ESP_FAIL on error
+     */
+    esp_err_t status_handler(httpd_req_t* req) {
+        auto sink = T(vfs_path);
+        return respond(req, HTTPD_200, sink.received());
+    }
+
+    static constexpr size_t MAX_UPLOAD_PARAM_SIZE = 24;
+
+    std::string vfs_path;
+    std::array<std::vector<char>, 2> buffers{};  // reused across uploads
+    httpd_handle_t srv{};
+    std::string uri{};
+    http_method method{};
+};
+}  // namespace data_streamer
@@ -22,8 +22,20 @@
 #include <sys/stat.h>
 #include <optional>
 #include <memory>
+#include <cstdio>
+#include <unistd.h>
+#include "advertise.h"
+#include "calibration.h"
 #include "config.h"
+#include "delta.h"
+#include "diag.h"
+#include "follow.h"
+#include "index.h"
+#include "planner.h"
 #include "streamer.h"
+#include "summary.h"
+#include "timing.h"
+#include "uploader.h"
 
 
 namespace data_streamer {
@@ -35,7 +47,8 @@ namespace data_streamer {
  * which is memory efficient and suitable for streaming large files. It implements
  * the Chunkable concept required by DataStreamer.
  *
- * @tparam CHUNK_SIZE Size of each chunk in bytes. Defaults to value from Kconfig.
+ * @tparam CHUNK_SIZE Size of each chunk in bytes. Defaults to value from Kconfig. Files are read in
+ *         calibration::tuning().read_size pieces if smaller, with its read-ahead (see calibration.h).
  *
  * Example usage:
  * @code
@@ -109,9 +122,16 @@ public:
         file{nullptr},
         last_error{std::nullopt},
         has_active_iterator{false} {
+        timing::Span span(timing::Open);
+        const auto &tuning = calibration::tuning();
+        if (tuning.read_size > 0) {
+            read_size = std::min<size_t>(tuning.read_size, CHUNK_SIZE);
+        }
         file = fopen(this->path.c_str(), "r");
         if (file == nullptr) {
             last_error = errno;
+        } else if (tuning.read_ahead > 0) {
+            setvbuf(file, nullptr, _IOFBF, tuning.read_ahead);
         }
     }
 
@@ -149,6 +169,53 @@ public:
         return last_error;
     }
 
+    /**
+     * @brief Gets the size of the file at the time of the call.
+     *
+     * @return std::optional<size_t> Size in bytes, nullopt if the file isn't open or can't be stat'ed
+     */
+    std::optional<size_t> size() {
+        struct stat st{};
+        if (file == nullptr || fstat(fileno(file), &st) != 0) {
+            return std::nullopt;
+        }
+        return static_cast<size_t>(st.st_size);
+    }
+
+    /**
+     * @brief Gets the modification time of the file at the time of the call.
+     *
+     * @return std::optional<time_t> Seconds since epoch, nullopt if the file isn't open or can't be stat'ed
+     */
+    std::optional<time_t> mtime() {
+        struct stat st{};
+        if (file == nullptr || fstat(fileno(file), &st) != 0) {
+            return std::nullopt;
+        }
+        return st.st_mtime;
+    }
+
+    /**
+     * @brief Moves the read position, so that the next iteration starts at the given offset.
+     *
+     * Ends the current iteration, if any: iterators obtained before must not be used anymore.
+     *
+     * @param offset Offset from the start of the file, in bytes
+     * @return bool true on success; false if the file isn't open or can't be seeked
+     */
+    bool seek(size_t offset) {
+        if (file == nullptr) {
+            return false;
+        }
+        timing::Span span(timing::Read);
+        if (fseek(file, static_cast<long>(offset), SEEK_SET) != 0) {
+            last_error = errno;
+            return false;
+        }
+        has_active_iterator = false;
+        return true;
+    }
+
     /**
      * @brief Gets an iterator to the beginning of the file.
      *
@@ -175,9 +242,10 @@ public:
     }
 private:
     void read_chunk() {
-        auto bytes_read = fread(buf.data(), 1, CHUNK_SIZE, file);
+        timing::Span span(timing::Read);
+        auto bytes_read = fread(buf.data(), 1, read_size, file);
         cur_chunk = std::span(buf.data(), bytes_read);
-        if (bytes_read != CHUNK_SIZE) {
+        if (bytes_read != read_size) {
             if (ferror(file) != 0) {
                 last_error = errno;
             }
@@ -188,6 +256,7 @@ private:
     FILE *file;
     std::optional<int> last_error;
     bool has_active_iterator;
+    size_t read_size{CHUNK_SIZE};
     std::array<char, CHUNK_SIZE> buf;
     std::span<char> cur_chunk;
 };
@@ -198,7 +267,10 @@ private:
  *
  * FlatDirIterable traverses a directory and provides access to each regular file
  * through a FileChunker. It implements the IterableOfChunkables concept required
- * by DataStreamer.
+ * by DataStreamer, and the PlannedIterable one: filters passed to plan() are applied
+ * before files are opened, and if a DirIndex is enabled for the directory, matching
+ * files are looked up in it (in name order) when that's cheaper than a full scan.
+ * Full scans rebuild the index of the directory, if any.
  *
  * @tparam CHUNK_SIZE Size of chunks for the underlying FileChunker
  *
@@ -280,7 +352,10 @@ public:
         : dir{nullptr},
           last_error{std::nullopt},
           base_path{base_path},
-          full_path{} {
+          full_path{},
+          index{DirIndex::find(base_path)},
+          scan_started{time(nullptr)} {
+        timing::Span span(timing::Scan);
         dir = opendir(this->base_path.c_str());
         if (dir == nullptr) {
             last_error = errno;
@@ -300,6 +375,30 @@ public:
      */
     [[nodiscard]] std::optional<int> error() const { return last_error; }
 
+    /**
+     * @brief Restricts iteration to the files matching a filter, choosing the cheapest way to find them.
+     *
+     * @param f Filters of the request
+     * @return plan::Plan The chosen strategy and the estimates it was chosen from
+     * @note Must be called before begin()
+     */
+    plan::Plan plan(const DirFilter &f) {
+        auto stats = index ? index->stats(f, time(nullptr)) : plan::DirStats{};
+        auto p = plan::choose(f, stats);
+        filter = f;
+        strategy = p.strategy;
+        if (strategy != plan::Strategy::FullScan) {
+            timing::Span span(timing::Scan);
+            selected = index->select(f, strategy);
+            use_selected = true;
+        } else if (f.settled) {
+            scan_selected();
+        }
+        ESP_LOGD(TAG, "%s: %s, estimated %.0f us", base_path.c_str(), plan::strategy_name(strategy),
+                 p.chosen().cost_us);
+        return p;
+    }
+
     /**
      * @brief Gets an iterator to the first file in the directory.
      *
@@ -321,9 +420,25 @@ private:
      */
     bool next_file_chunker() {
         current_chunker.reset();  // cause deletion, file closing
+        if (use_selected) {
+            return next_selected_chunker();
+        }
+        if (next_match() == nullptr) {
+            return false;
+        }
+        current_chunker.emplace(full_path);
+        return true;
+    }
 
+    /**
+     * @brief Reads the directory up to the next regular file matching the filter, and sets full_path to it.
+     *
+     * @return const char* Name of the file, nullptr if no more files or error
+     */
+    const char *next_match() {
         struct stat st{};
-        if (!dir) return false;
+        if (!dir) return nullptr;
+        timing::Span span(timing::Scan);
 
         while (dirent* entry = readdir(dir)) {
             // Skip . and ..
@@ -335,20 +450,430 @@ private:
             if (stat(full_path.c_str(), &st) == -1) {
                 ESP_LOGE(TAG, "Can't stat path");
                 last_error = errno;
-                return false;
+                return nullptr;
             }
             if (S_ISREG(st.st_mode)) {
-                current_chunker.emplace(full_path);
+                if (index) {
+                    scanned.push_back({entry->d_name, static_cast<uint64_t>(st.st_size), st.st_mtime});
+                }
+                if (filter && !filter->matches(entry->d_name, st.st_mtime)) {
+                    continue;
+                }
+                return entry->d_name;
+            }
+        }
+        if (index && !scan_complete) {  // the scan completed: refresh the index with it
+            index->replace(std::move(scanned), scan_started);
+        }
+        scan_complete = true;
+        return nullptr;
+    }
+
+    /**
+     * @brief Scans the whole directory for the files matching the filter, sorting them by name.
+     */
+    void scan_selected() {
+        while (const char *name = next_match()) {
+            selected.push_back({name});
+        }
+        use_selected = true;
+        std::sort(selected.begin(), selected.end(), [](const auto &a, const auto &b) { return a.name < b.name; });
+    }
+
+    /**
+     * @brief Advances to the next selected file, skipping files removed since they were listed.
+     *
+     * With a `settled` filter, stops at the first file that isn't complete.
+     */
+    bool next_selected_chunker() {
+        auto watch = filter && filter->settled ? DirWatch::get(base_path) : nullptr;
+        while (selected_pos < selected.size()) {
+            const auto &name = selected[selected_pos].name;
+            full_path = base_path + "/" + name;
+            if (watch) {
+                timing::Span span(timing::Scan);
+                struct stat st{};
+                if (stat(full_path.c_str(), &st) == 0 && !watch->settled(name, st.st_mtime, time(nullptr))) {
+                    return false;  // the files after it are yielded once it's complete
+                }
+            }
+            selected_pos++;
+            current_chunker.emplace(full_path);
+            if (current_chunker->error() != ENOENT) {
                 return true;
             }
+            current_chunker.reset();
+            if (index) {
+                index->invalidate();
+            }
         }
         return false;
     }
+
     DIR* dir;
     std::optional<int> last_error;
     std::string base_path;
     std::string full_path;
     std::optional<FileChunker<CHUNK_SIZE>> current_chunker;
+    std::shared_ptr<DirIndex> index;
+    time_t scan_started;
+    std::optional<DirFilter> filter;
+    plan::Strategy strategy{plan::Strategy::FullScan};
+    bool use_selected{false};
+    std::vector<DirEntry> selected;     // files to iterate over, with an index strategy or a sorted scan
+    size_t selected_pos{0};
+    std::vector<DirEntry> scanned;      // regular files seen by a full scan, to refresh the index
+    bool scan_complete{false};
+};
+
+/**
+ * @brief Consumes acknowledged files of a directory, by deleting them or moving them to an archive directory.
+ *
+ * DirConsumer implements the CommitHandler concept used by DataStreamer for acknowledged streams.
+ * The consumption cursor (name of the last consumed file) is persisted in a small file next to the
+ * directory (`<dir>.cursor` by default), so pulls continue where the last acknowledged one ended
+ * across reboots. Files modified after the acknowledged stream started (e.g. a log still being
+ * written) are kept, and the cursor stops before them.
+ *
+ * Example usage:
+ * @code
+ * auto streamer = DataStreamer<FlatDirIterable<>, EspHttpServerOps, DirConsumer>(
+ *     "/sdcard/logs", DirConsumer("/sdcard/logs", "/sdcard/archive"));
+ * @endcode
+ */
+class DirConsumer {
+public:
+    /**
+     * @brief Constructs a DirConsumer for the specified directory.
+     *
+     * @param dir_path Directory whose files are consumed
+     * @param archive_path Directory where consumed files are moved; empty to delete them instead
+     * @param cursor_path File persisting the cursor; empty for `<dir_path>.cursor`
+     */
+    explicit DirConsumer(std::string_view dir_path, std::string_view archive_path = {},
+                         std::string_view cursor_path = {})
+        : dir_path{dir_path},
+          archive_path{archive_path},
+          cursor_path{cursor_path.empty() ? default_cursor_path(dir_path) : std::string(cursor_path)} {}
+
+    /**
+     * @brief Gets the default path of the file persisting the cursor of a directory.
+     */
+    static std::string default_cursor_path(std::string_view dir_path) {
+        return std::string(dir_path) + ".cursor";
+    }
+
+    /**
+     * @brief Reads a persisted cursor, without caching (e.g. for other tasks than the streaming one).
+     *
+     * @return std::optional<std::string> nullopt if no cursor was persisted yet
+     */
+    static std::optional<std::string> read_cursor(const std::string &cursor_path) {
+        // fall back to the temporary file, in case a previous save was interrupted
+        for (const auto &path: {cursor_path, cursor_path + ".tmp"}) {
+            FILE *f = fopen(path.c_str(), "r");
+            if (f == nullptr) continue;
+            char buf[256];
+            size_t n = fread(buf, 1, sizeof(buf), f);
+            fclose(f);
+            if (n > 0) return std::string(buf, n);
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Gets the name of the last consumed file.
+     *
+     * @return std::optional<std::string> nullopt if nothing was consumed yet
+     */
+    std::optional<std::string> cursor() {
+        if (!loaded) {
+            current = read_cursor(cursor_path);
+            loaded = true;
+        }
+        return current;
+    }
+
+    /**
+     * @brief Consumes the files covered by an acknowledged stream.
+     *
+     * The cursor advances over the files of the stream, up to the first file it can't pass: one modified
+     * since the stream started, or one the stream didn't send (e.g. a `from=` stream starting after the
+     * cursor, or a file written after the stream listed the directory, or not in its index yet). Files before the cursor that no
+     * stream covered are logged and left in place. The new cursor is persisted before files are removed.
+     *
+     * @param pending The acknowledged stream
+     * @return std::optional<int> errno value on failure, nullopt otherwise
+     */
+    std::optional<int> commit(const PendingCommit &pending) {
+        auto old_cursor = cursor();
+        // FAT stores modification times rounded down to 2 s: a file rewritten within 2 s after the
+        // stream started can show an earlier mtime, so only older files count as unchanged
+        auto consumable = [&](const std::string &name, const struct stat &st) {
+            return pending.covers(name) && st.st_mtime < pending.started - 2;
+        };
+        // first pass: the cursor can't go past files that changed after being sent, or weren't sent
+        std::optional<std::string> first_kept;
+        size_t unsent_before_cursor = 0;
+        auto err = for_each_file([&](const std::string &name, const struct stat &st) {
+            if (old_cursor && name <= *old_cursor) {
+                if (!pending.covers(name)) unsent_before_cursor++;
+            } else if (name <= pending.last() && !consumable(name, st) && (!first_kept || name < *first_kept)) {
+                first_kept = name;
+            }
+            return true;
+        });
+        if (err) return err;
+        if (unsent_before_cursor > 0) {
+            ESP_LOGW(TAG, "%zu files before the cursor of %s were never streamed, kept", unsent_before_cursor,
+                     dir_path.c_str());
+        }
+        std::optional<std::string> new_cursor = old_cursor;
+        if (!first_kept) {
+            if (!new_cursor || pending.last() > *new_cursor) {
+                new_cursor = pending.last();
+            }
+        } else {
+            // greatest consumable name before the first kept file
+            err = for_each_file([&](const std::string &name, const struct stat &st) {
+                if (name < *first_kept && consumable(name, st) && (!new_cursor || name > *new_cursor)) {
+                    new_cursor = name;
+                }
+                return true;
+            });
+            if (err) return err;
+        }
+        if (new_cursor != old_cursor) {
+            if ((err = save_cursor(*new_cursor))) return err;
+            current = new_cursor;
+        }
+        if (!archive_path.empty() && mkdir(archive_path.c_str(), 0755) != 0 && errno != EEXIST) {
+            return errno;
+        }
+        // second pass: remove consumed files
+        std::optional<int> remove_err;
+        auto index = DirIndex::find(dir_path);
+        err = for_each_file([&](const std::string &name, const struct stat &st) {
+            if (!consumable(name, st)) return true;
+            auto path = dir_path + "/" + name;
+            int ret = archive_path.empty() ?
+                unlink(path.c_str()) :
+                rename(path.c_str(), (archive_path + "/" + name).c_str());
+            if (ret != 0) {
+                ESP_LOGE(TAG, "Can't consume %s", name.c_str());
+                remove_err = errno;
+            } else if (index) {
+                index->remove(name);
+            }
+            return true;
+        });
+        return err ? err : remove_err;
+    }
+
+private:
+    template<typename F>
+    std::optional<int> for_each_file(F &&f) {
+        DIR *dir = opendir(dir_path.c_str());
+        if (dir == nullptr) return errno;
+        struct stat st{};
+        std::optional<int> err;
+        while (dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            std::string name(entry->d_name);
+            if (stat((dir_path + "/" + name).c_str(), &st) != 0) {
+                err = errno;
+                break;
+            }
+            if (S_ISREG(st.st_mode) && !f(name, st)) break;
+        }
+        closedir(dir);
+        return err;
+    }
+
+    std::optional<int> save_cursor(const std::string &name) {
+        // write then rename; FAT can't rename over an existing file, so remove it first
+        auto tmp_path = cursor_path + ".tmp";
+        FILE *f = fopen(tmp_path.c_str(), "w");
+        if (f == nullptr) return errno;
+        bool ok = fwrite(name.data(), 1, name.size(), f) == name.size();
+        ok = (fflush(f) == 0) && ok;
+        ok = (fsync(fileno(f)) == 0) && ok;
+        if (fclose(f) != 0 || !ok) return errno ? errno : EIO;
+        if (unlink(cursor_path.c_str()) != 0 && errno != ENOENT) return errno;
+        if (rename(tmp_path.c_str(), cursor_path.c_str()) != 0) return errno;
+        return std::nullopt;
+    }
+
+    std::string dir_path;
+    std::string archive_path;
+    std::string cursor_path;
+    bool loaded{false};
+    std::optional<std::string> current;
+};
+
+/**
+ * @brief An upload sink writing to a file through a temporary `<path>.part` file.
+ *
+ * The upload is written to `<path>.part`, which is renamed to `<path>` by commit(), so that readers
+ * never see a partial file. A `.part` file left by an interrupted upload can be resumed. Writes are
+ * unbuffered, as DataUploader already writes in multiples of block_size().
+ *
+ * Example usage:
+ * @code
+ * auto sink = FileSink("/sdcard/table.bin");
+ * if (sink.open(0) && sink.write(data) && sink.commit()) {
+ *     // /sdcard/table.bin has been replaced
+ * }
+ * @endcode
+ */
+class FileSink {
+public:
+    /**
+     * @brief Constructs a FileSink for the specified path.
+     *
+     * @param path Path of the file to upload
+     */
+    explicit FileSink(std::string_view path)
+        : path{path},
+          part_path{std::string(path) + ".part"},
+          file{nullptr} {}
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    ~FileSink() {
+        if (file != nullptr) {
+            fclose(file);
+        }
+    }
+
+    /**
+     * @brief Gets the size of the pending upload.
+     *
+     * @return size_t Size of the `.part` file, 0 if there is none
+     */
+    size_t received() {
+        struct stat st{};
+        if (stat(part_path.c_str(), &st) != 0) {
+            return 0;
+        }
+        return static_cast<size_t>(st.st_size);
+    }
+
+    /**
+     * @brief Opens the pending upload for writing.
+     *
+     * @param offset 0 to start a new upload (discarding any pending one), received() to resume
+     * @return bool true on success
+     */
+    bool open(size_t offset) {
+        if (file != nullptr) {
+            fclose(file);
+        }
+        file = fopen(part_path.c_str(), offset == 0 ? "wb" : "r+b");
+        if (file == nullptr) {
+            last_error = errno;
+            return false;
+        }
+        setvbuf(file, nullptr, _IONBF, 0);
+        if (offset > 0 && fseek(file, static_cast<long>(offset), SEEK_SET) != 0) {
+            last_error = errno;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Gets the preferred write size: the block (cluster) size of the file system.
+     *
+     * ESP-IDF's FAT `stat()` doesn't report it, so on the device it comes from
+     * CONFIG_DATA_STREAMER_CLUSTER_SIZE, and falls back to the sector size if that is 0.
+     *
+     * @return size_t Block size in bytes, 512 if neither the configuration nor the file system gives it
+     */
+    size_t block_size() {
+        if constexpr (CLUSTER_SIZE > 0) {
+            return CLUSTER_SIZE;
+        }
+        struct stat st{};
+        auto sep = path.rfind('/');
+        auto dir = sep == std::string::npos ? std::string(".") : path.substr(0, std::max<size_t>(sep, 1));
+        if (stat(dir.c_str(), &st) == 0 && st.st_blksize > 0) {
+            return static_cast<size_t>(st.st_blksize);
+        }
+        return 512;
+    }
+
+    /**
+     * @brief Appends data to the pending upload.
+     *
+     * @return bool true on success
+     */
+    bool write(std::span<const char> data) {
+        if (file == nullptr) {
+            last_error = EBADF;
+            return false;
+        }
+        if (fwrite(data.data(), 1, data.size(), file) != data.size()) {
+            last_error = errno ? errno : EIO;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Publishes the upload: syncs the `.part` file, and renames it to the target path.
+     *
+     * @return bool true on success
+     */
+    bool commit() {
+        if (file == nullptr) {
+            last_error = EBADF;
+            return false;
+        }
+        bool ok = fflush(file) == 0;
+        ok = (fsync(fileno(file)) == 0) && ok;
+        if (!ok) last_error = errno;
+        long size = ftell(file);
+        if (fclose(file) != 0 && ok) {
+            last_error = errno;
+            ok = false;
+        }
+        file = nullptr;
+        if (!ok) return false;
+        // FAT can't rename over an existing file, so remove it first
+        if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+            last_error = errno;
+            return false;
+        }
+        if (rename(part_path.c_str(), path.c_str()) != 0) {
+            last_error = errno;
+            return false;
+        }
+        auto slash = path.find_last_of('/');
+        if (slash != std::string::npos) {  // tell followers of the directory
+            if (auto watch = DirWatch::find(std::string_view(path).substr(0, slash))) {
+                watch->closed(std::string_view(path).substr(slash + 1),
+                              size >= 0 ? std::optional<uint64_t>(size) : std::nullopt);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Gets the last error that occurred.
+     *
+     * @return std::optional<int> errno value if an error occurred
+     */
+    std::optional<int> error() {
+        return last_error;
+    }
+
+private:
+    std::string path;
+    std::string part_path;
+    FILE *file;
+    std::optional<int> last_error;
 };
 
 /**
@@ -360,4 +885,34 @@ using VFSFileStreamer = DataStreamer<FileChunker<>>;
  * @brief Type alias for a directory-based data streamer
  */
 using VFSFlatDirStreamer = DataStreamer<FlatDirIterable<>>;
+
+/**
+ * @brief Type alias for a directory-based data streamer whose files are consumed once acknowledged
+ */
+using VFSAckedDirStreamer = DataStreamer<FlatDirIterable<>, EspHttpServerOps, DirConsumer>;
+
+/**
+ * @brief Type alias for a streamer of aggregates of the record files of a directory
+ */
+using VFSDirSummaryStreamer = SummaryStreamer<FlatDirIterable<>>;
+
+/**
+ * @brief Type alias for a file-based delta streamer
+ */
+using VFSFileDeltaStreamer = DeltaStreamer<FileChunker<>>;
+
+/**
+ * @brief Type alias for a file-based data uploader
+ */
+using VFSFileUploader = DataUploader<FileSink>;
+
+/**
+ * @brief Type alias for a streamer of synthetic content (link test), constructed from its size (e.g. "16M")
+ */
+using LinkTestStreamer = DataStreamer<diag::SyntheticChunker<>>;
+
+/**
+ * @brief Type alias for a storage read test of a file
+ */
+using VFSStorageTestStreamer = StorageTestStreamer<FileChunker<>>;
 }  // namespace data_streamer
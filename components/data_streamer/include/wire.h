@@ -0,0 +1,225 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "tls.h"
+
+
+/**
+ * Wire efficiency accounting: how many of the bytes sent for a response are item content.
+ *
+ * The bytes of a response body are split into:
+ * - payload: item content
+ * - format: everything else handed to the server operations (part headers, boundaries, frame headers,
+ *   archive headers and padding, trailers)
+ * - framing: chunked transfer encoding (size lines and CRLFs)
+ * - TLS: an estimate of the record overhead, if the response went over TLS
+ * Response status and header lines aren't counted.
+ */
+namespace data_streamer::wire {
+
+// Record overhead of TLS 1.2 with AES-GCM: header, explicit nonce and tag
+inline constexpr size_t TLS_RECORD_OVERHEAD = 29;
+// Largest TLS record payload
+inline constexpr size_t TLS_MAX_FRAGMENT = 16384;
+
+/**
+ * @brief Byte counts of one or more responses
+ */
+struct Stats {
+    uint64_t payload{0};  ///< item content
+    uint64_t sent{0};     ///< payload and format bytes
+    uint64_t framing{0};  ///< chunked transfer encoding
+    uint64_t tls{0};      ///< estimated TLS record overhead
+    uint64_t writes{0};   ///< writes to the connection
+
+    [[nodiscard]] uint64_t format() const { return sent - payload; }
+    [[nodiscard]] uint64_t total() const { return sent + framing + tls; }
+
+    /**
+     * @brief Gets the share of the bytes on the wire that are payload
+     */
+    [[nodiscard]] double efficiency() const {
+        return total() > 0 ? static_cast<double>(payload) / static_cast<double>(total()) : 0;
+    }
+
+    Stats &operator+=(const Stats &other) {
+        payload += other.payload;
+        sent += other.sent;
+        framing += other.framing;
+        tls += other.tls;
+        writes += other.writes;
+        return *this;
+    }
+
+    [[nodiscard]] std::string to_json() const {
+        char buf[256];
+        snprintf(buf, sizeof(buf),
+                 R"({"payload_bytes":%llu,"format_bytes":%llu,"framing_bytes":%llu,"tls_bytes":%llu,)"
+                 R"("writes":%llu,"efficiency":%.4f})",
+                 static_cast<unsigned long long>(payload), static_cast<unsigned long long>(format()),
+                 static_cast<unsigned long long>(framing), static_cast<unsigned long long>(tls),
+                 static_cast<unsigned long long>(writes), efficiency());
+        return buf;
+    }
+};
+
+/**
+ * @brief Accounts the sends of the current task to Stats, while alive
+ *
+ * A response is sent by a single task (the server's, or a follower's), so the meter of a response is
+ * found through a thread-local pointer, without passing it down every send function. Sends are modelled
+ * as ESP's HTTP server makes them: resp_send_chunk writes the size line, the data and the CRLF separately.
+ *
+ * Example usage:
+ * @code
+ * wire::Stats stats;
+ * {
+ *     wire::Meter meter(stats);
+ *     // ...send the response through wire::MeteredOps<ServerOps>, calling wire::count_payload() for content
+ * }
+ * ESP_LOGI(TAG, "%s", stats.to_json().c_str());
+ * @endcode
+ */
+class Meter {
+public:
+    /**
+     * @param stats Stats to add to
+     * @param max_fragment TLS record payload size
+     */
+    explicit Meter(Stats &stats, size_t max_fragment = TLS_MAX_FRAGMENT)
+    : stats{stats},
+      max_fragment{max_fragment > 0 ? max_fragment : TLS_MAX_FRAGMENT},
+      previous{current} {
+        current = this;
+    }
+
+    ~Meter() {
+        current = previous;
+    }
+
+    Meter(const Meter&) = delete;
+    Meter& operator=(const Meter&) = delete;
+
+    /**
+     * @brief Gets the meter of the current task, if any
+     */
+    static Meter *active() {
+        return current;
+    }
+
+    /**
+     * @brief Accounts a chunk of n bytes (0: the last chunk) sent with resp_send_chunk
+     */
+    void chunk(size_t n) {
+        if (n == 0) {
+            write(5);  // "0\r\n\r\n"
+            stats.framing += 5;
+            return;
+        }
+        size_t size_line = tls::hex_digits(n) + 2;
+        write(size_line);
+        write(n);
+        write(2);
+        stats.sent += n;
+        stats.framing += size_line + 2;
+    }
+
+    /**
+     * @brief Accounts a raw write of whole chunks (see tls::ChunkPacker)
+     */
+    void raw(std::span<const char> data) {
+        write(data.size());
+        auto crlf = std::string_view(data.data(), data.size()).find("\r\n");
+        size_t framing = crlf == std::string_view::npos ? 0 : crlf + 4;
+        stats.sent += data.size() - std::min(framing, data.size());
+        stats.framing += std::min(framing, data.size());
+    }
+
+    /**
+     * @brief Accounts item content, already sent or about to be
+     */
+    void payload(size_t n) {
+        stats.payload += n;
+    }
+
+private:
+    void write(size_t n) {
+        size_t records = (n + max_fragment - 1) / max_fragment;
+        stats.writes++;
+        stats.tls += records * TLS_RECORD_OVERHEAD;
+    }
+
+    static inline thread_local Meter *current = nullptr;
+    Stats &stats;
+    size_t max_fragment;
+    Meter *previous;
+};
+
+/**
+ * @brief Accounts item content to the meter of the current task, if any
+ */
+inline void count_payload(size_t n) {
+    if (auto *meter = Meter::active()) {
+        meter->payload(n);
+    }
+}
+
+/**
+ * @brief Server operations accounting sends to the meter of the current task, if any
+ *
+ * @tparam ServerOps Server operations (see server_ops.h)
+ */
+template<typename ServerOps>
+struct MeteredOps: ServerOps {
+    static esp_err_t resp_send_chunk(httpd_req_t* req, const char* chunk, ssize_t size) {
+        if (auto *meter = Meter::active()) {
+            meter->chunk(chunk == nullptr ? 0 : size == HTTPD_RESP_USE_STRLEN ? strlen(chunk) : static_cast<size_t>(size));
+        }
+        return ServerOps::resp_send_chunk(req, chunk, size);
+    }
+    static esp_err_t resp_sendstr_chunk(httpd_req_t* req, const char* chunk) {
+        if (auto *meter = Meter::active()) {
+            meter->chunk(chunk == nullptr ? 0 : strlen(chunk));
+        }
+        return ServerOps::resp_sendstr_chunk(req, chunk);
+    }
+    static esp_err_t resp_send_chunkv(httpd_req_t* req, std::span<const std::span<const char>> parts) {
+        if (auto *meter = Meter::active()) {
+            size_t n = 0;
+            for (auto part: parts) n += part.size();
+            if (n > 0) meter->chunk(n);
+        }
+        return ServerOps::resp_send_chunkv(req, parts);
+    }
+    static esp_err_t send_raw(httpd_req_t* req, const char* buf, size_t len) {
+        if (auto *meter = Meter::active()) {
+            meter->raw({buf, len});
+        }
+        return ServerOps::send_raw(req, buf, len);
+    }
+};
+}  // namespace data_streamer::wire
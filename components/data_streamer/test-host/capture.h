@@ -0,0 +1,421 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+
+namespace data_streamer::capture {
+
+/*
+ * Capture file layout (all integers little endian):
+ *
+ *   "DSCAP" 0x01                          magic + version
+ *   { u8 kind, u32 length, length bytes }  repeated records
+ *
+ * Record kinds:
+ *   'S' response status line (e.g. "200 OK")
+ *   'H' response header, formatted as "Field: value"
+ *   'C' one body chunk, exactly as handed to resp_send_chunk (boundaries preserved), or the parts
+ *       handed to one resp_send_chunkv call, concatenated as a vectored write would send them
+ *   'E' end of response (empty chunk / error), payload: the trailer fields of the last chunk, if any,
+ *       as "Field: value\r\n" lines
+ */
+inline constexpr char MAGIC[] = {'D', 'S', 'C', 'A', 'P', '\x01'};
+
+enum class RecordKind : uint8_t {
+    Status = 'S',
+    Header = 'H',
+    Chunk = 'C',
+    End = 'E',
+};
+
+struct Record {
+    RecordKind kind;
+    std::string data;
+};
+
+/**
+ * @brief An in-memory response capture
+ *
+ * Holds the records of one streamed response in emission order. Captures are kept in memory
+ * during replay so that disk I/O does not disturb measurements.
+ */
+struct Capture {
+    std::vector<Record> records;
+
+    /**
+     * @brief Returns the value of the first header with the given field name, if any
+     */
+    [[nodiscard]] std::optional<std::string> header(std::string_view field) const {
+        for (const auto &r: records) {
+            if (r.kind != RecordKind::Header) continue;
+            auto sep = r.data.find(": ");
+            if (sep != std::string::npos && std::string_view(r.data).substr(0, sep) == field) {
+                return r.data.substr(sep + 2);
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Returns the first status line, if any (none for a plain 200 response)
+     */
+    [[nodiscard]] std::optional<std::string> status() const {
+        for (const auto &r: records) {
+            if (r.kind == RecordKind::Status) return r.data;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Returns the concatenation of all body chunks
+     */
+    [[nodiscard]] std::string body() const {
+        std::string out;
+        for (const auto &r: records) {
+            if (r.kind == RecordKind::Chunk) out += r.data;
+        }
+        return out;
+    }
+
+    /**
+     * @brief Number of body chunks in the capture
+     */
+    [[nodiscard]] size_t chunk_count() const {
+        size_t n = 0;
+        for (const auto &r: records) {
+            if (r.kind == RecordKind::Chunk) n++;
+        }
+        return n;
+    }
+
+    /**
+     * @brief Writes the capture to a file
+     *
+     * @return std::optional<int> errno value on failure, nullopt otherwise
+     */
+    [[nodiscard]] std::optional<int> save(const std::string &path) const {
+        FILE *f = fopen(path.c_str(), "wb");
+        if (f == nullptr) return errno;
+        bool ok = fwrite(MAGIC, 1, sizeof(MAGIC), f) == sizeof(MAGIC);
+        for (const auto &r: records) {
+            if (!ok) break;
+            uint8_t hdr[5];
+            auto len = static_cast<uint32_t>(r.data.size());
+            hdr[0] = static_cast<uint8_t>(r.kind);
+            for (int i = 0; i < 4; i++) hdr[1 + i] = static_cast<uint8_t>(len >> (8 * i));
+            ok = fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr) &&
+                 fwrite(r.data.data(), 1, r.data.size(), f) == r.data.size();
+        }
+        int err = ok ? 0 : (errno ? errno : EIO);
+        if (fclose(f) != 0 && ok) err = errno;
+        if (err) return err;
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Loads a capture from a file
+     *
+     * @return std::optional<Capture> nullopt if the file can't be read or is malformed
+     */
+    static std::optional<Capture> load(const std::string &path) {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (f == nullptr) return std::nullopt;
+        Capture cap;
+        struct stat st{};
+        char magic[sizeof(MAGIC)];
+        bool ok = fstat(fileno(f), &st) == 0 && static_cast<uint64_t>(st.st_size) >= sizeof(MAGIC) &&
+                  fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                  memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+        uint64_t remaining = ok ? static_cast<uint64_t>(st.st_size) - sizeof(MAGIC) : 0;
+        uint8_t hdr[5];
+        while (ok && fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr)) {
+            uint32_t len = 0;
+            for (int i = 0; i < 4; i++) len |= static_cast<uint32_t>(hdr[1 + i]) << (8 * i);
+            // a corrupt length must not allocate more than the file holds
+            if (remaining < sizeof(hdr) + static_cast<uint64_t>(len)) {
+                ok = false;
+                break;
+            }
+            remaining -= sizeof(hdr) + len;
+            Record r{static_cast<RecordKind>(hdr[0]), std::string(len, '\0')};
+            ok = fread(r.data.data(), 1, len, f) == len;
+            cap.records.push_back(std::move(r));
+        }
+        ok = ok && feof(f);
+        fclose(f);
+        if (!ok) return std::nullopt;
+        return cap;
+    }
+};
+
+
+/**
+ * @brief ServerOps implementation recording everything DataStreamer emits
+ *
+ * Drop-in replacement for EspHttpServerOps on host. Status, headers and every chunk are appended
+ * to `capture`, preserving chunk boundaries. Query parameters for the scenario are taken from
+ * `query` (e.g. "from=a&to=b"), request headers from `request_headers`, and the request body from
+ * `request_body`, received at most `recv_size` bytes at a time (and failing at `recv_fail_at`, if set).
+ *
+ * Example usage:
+ * @code
+ * CapturingServerOps::begin("from=file1.txt");
+ * auto streamer = DataStreamer<FlatDirIterable<>, CapturingServerOps>("/path/to/dir");
+ * httpd_req_t req{.user_ctx = &streamer};
+ * decltype(streamer)::handler_wrapper(&req);
+ * CapturingServerOps::capture.save("dir.dscap");
+ * @endcode
+ */
+struct CapturingServerOps {
+    static inline Capture capture{};
+    static inline std::string query{};
+    static inline std::map<std::string, std::string> request_headers{};
+    static inline std::string request_body{};
+    static inline size_t recv_size{1460};
+    static inline std::optional<size_t> recv_fail_at{};
+    static inline size_t received{0};
+
+    /**
+     * @brief Clears the current capture and sets the query string and request headers for the next response
+     */
+    static void begin(std::string_view query_str = {}, std::map<std::string, std::string> headers = {}) {
+        capture = {};
+        query = std::string(query_str);
+        request_headers = std::move(headers);
+        request_body.clear();
+        recv_fail_at.reset();
+        received = 0;
+    }
+
+    /**
+     * @brief Like begin(), also setting the request body (the request's content_len must match it)
+     */
+    static void begin_upload(std::string_view body, std::string_view query_str = {},
+                             std::optional<size_t> fail_at = std::nullopt) {
+        begin(query_str);
+        request_body = std::string(body);
+        recv_fail_at = fail_at;
+    }
+
+    static esp_err_t register_uri_handler(httpd_handle_t, const httpd_uri_t*) { return ESP_OK; }
+    static esp_err_t unregister_uri_handler(httpd_handle_t, const char*, http_method) { return ESP_OK; }
+
+    static esp_err_t resp_sendstr_chunk(httpd_req_t* req, const char* chunk) {
+        return resp_send_chunk(req, chunk, HTTPD_RESP_USE_STRLEN);
+    }
+    static esp_err_t resp_send(httpd_req_t* req, const char* buf, ssize_t size) {
+        if (buf != nullptr && size != 0) resp_send_chunk(req, buf, size);
+        capture.records.push_back({RecordKind::End, {}});
+        return ESP_OK;
+    }
+    static esp_err_t resp_send_chunk(httpd_req_t*, const char* chunk, ssize_t size) {
+        if (chunk == nullptr) {
+            capture.records.push_back({RecordKind::End, {}});
+            return ESP_OK;
+        }
+        if (size == HTTPD_RESP_USE_STRLEN) size = static_cast<ssize_t>(strlen(chunk));
+        if (size == 0) {
+            capture.records.push_back({RecordKind::End, {}});
+            return ESP_OK;
+        }
+        capture.records.push_back({RecordKind::Chunk, std::string(chunk, size)});
+        return ESP_OK;
+    }
+    static esp_err_t resp_send_chunkv(httpd_req_t*, std::span<const std::span<const char>> parts) {
+        std::string chunk;
+        for (auto part: parts) chunk.append(part.data(), part.size());
+        if (!chunk.empty()) capture.records.push_back({RecordKind::Chunk, std::move(chunk)});
+        return ESP_OK;
+    }
+    static esp_err_t send_raw(httpd_req_t*, const char* buf, size_t len) {
+        // raw writes carry whole chunks (size line, data, CRLF): record their data, as for resp_send_chunk
+        std::string_view raw(buf, len);
+        size_t size = 0;
+        auto [ptr, ec] = std::from_chars(raw.data(), raw.data() + raw.size(), size, 16);
+        size_t start = ptr - raw.data() + 2;
+        if (ec == std::errc() && size == 0 && raw.substr(start - 2, 2) == "\r\n" && raw.ends_with("\r\n\r\n")) {
+            // last chunk, with trailer fields
+            capture.records.push_back({RecordKind::End, std::string(raw.substr(start, raw.size() - start - 2))});
+            return ESP_OK;
+        }
+        if (ec != std::errc() || raw.substr(start - 2, 2) != "\r\n" || start + size + 2 != raw.size() ||
+            raw.substr(start + size) != "\r\n") {
+            return ESP_FAIL;
+        }
+        capture.records.push_back({RecordKind::Chunk, std::string(raw.substr(start, size))});
+        return ESP_OK;
+    }
+    static esp_err_t resp_send_err(httpd_req_t*, httpd_err_code_t error, const char*) {
+        // only the status line: the message isn't part of the streamed body
+        capture.records.push_back({RecordKind::Status, err_status(error)});
+        return ESP_OK;
+    }
+    static esp_err_t resp_set_type(httpd_req_t* req, const char* type) {
+        return resp_set_hdr(req, "Content-Type", type);
+    }
+    static esp_err_t resp_set_status(httpd_req_t*, const char* status) {
+        capture.records.push_back({RecordKind::Status, status});
+        return ESP_OK;
+    }
+    static esp_err_t resp_set_hdr(httpd_req_t*, const char* field, const char* value) {
+        capture.records.push_back({RecordKind::Header, std::string(field) + ": " + value});
+        return ESP_OK;
+    }
+    static size_t req_get_url_query_len(httpd_req_t*) { return query.size(); }
+    static esp_err_t req_get_url_query_str(httpd_req_t*, char* buf, size_t buf_len) {
+        if (buf_len <= query.size()) return ESP_FAIL;
+        memcpy(buf, query.c_str(), query.size() + 1);
+        return ESP_OK;
+    }
+    static esp_err_t query_key_value(const char* qry, const char* key, char* val, size_t val_size) {
+        std::string_view q(qry);
+        std::string_view k(key);
+        while (!q.empty()) {
+            auto amp = q.find('&');
+            auto pair = q.substr(0, amp);
+            auto eq = pair.find('=');
+            if (eq != std::string_view::npos && pair.substr(0, eq) == k) {
+                auto v = pair.substr(eq + 1);
+                if (v.size() >= val_size) return ESP_FAIL;
+                memcpy(val, v.data(), v.size());
+                val[v.size()] = '\0';
+                return ESP_OK;
+            }
+            if (amp == std::string_view::npos) break;
+            q.remove_prefix(amp + 1);
+        }
+        return ESP_FAIL;
+    }
+    static size_t req_get_hdr_value_len(httpd_req_t*, const char* field) {
+        auto it = request_headers.find(field);
+        return it == request_headers.end() ? 0 : it->second.size();
+    }
+    static esp_err_t req_get_hdr_value_str(httpd_req_t*, const char* field, char* val, size_t val_size) {
+        auto it = request_headers.find(field);
+        if (it == request_headers.end()) return ESP_ERR_NOT_FOUND;
+        if (it->second.size() >= val_size) return ESP_FAIL;
+        memcpy(val, it->second.c_str(), it->second.size() + 1);
+        return ESP_OK;
+    }
+    static int req_recv(httpd_req_t*, char* buf, size_t buf_len) {
+        size_t end = recv_fail_at.value_or(request_body.size());
+        if (received >= end) return recv_fail_at ? HTTPD_SOCK_ERR_FAIL : 0;
+        size_t n = std::min({buf_len, recv_size, end - received});
+        memcpy(buf, request_body.data() + received, n);
+        received += n;
+        return static_cast<int>(n);
+    }
+    static esp_err_t req_async_handler_begin(httpd_req_t* req, httpd_req_t** out) {
+        *out = new httpd_req_t(*req);
+        return ESP_OK;
+    }
+    static esp_err_t req_async_handler_complete(httpd_req_t* req) {
+        delete req;
+        return ESP_OK;
+    }
+
+    /**
+     * @brief Status line that httpd_resp_send_err sends for an error code
+     */
+    static std::string err_status(httpd_err_code_t error) {
+        switch (error) {
+            case HTTPD_501_METHOD_NOT_IMPLEMENTED: return "501 Method Not Implemented";
+            case HTTPD_505_VERSION_NOT_SUPPORTED: return "505 Version Not Supported";
+            case HTTPD_400_BAD_REQUEST: return "400 Bad Request";
+            case HTTPD_401_UNAUTHORIZED: return "401 Unauthorized";
+            case HTTPD_403_FORBIDDEN: return "403 Forbidden";
+            case HTTPD_404_NOT_FOUND: return "404 Not Found";
+            case HTTPD_405_METHOD_NOT_ALLOWED: return "405 Method Not Allowed";
+            case HTTPD_408_REQ_TIMEOUT: return "408 Request Timeout";
+            case HTTPD_411_LENGTH_REQUIRED: return "411 Length Required";
+            case HTTPD_414_URI_TOO_LONG: return "414 URI Too Long";
+            case HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE: return "431 Request Header Fields Too Large";
+            default: return "500 Internal Server Error";
+        }
+    }
+};
+
+
+/**
+ * @brief Result of a replay run
+ */
+struct ReplayStats {
+    size_t bytes;
+    size_t chunks;
+    double seconds;
+
+    [[nodiscard]] double bytes_per_second() const {
+        return seconds > 0 ? static_cast<double>(bytes) / seconds : 0.0;
+    }
+};
+
+/**
+ * @brief Feeds the body chunks of a capture into a sink
+ *
+ * Chunks are delivered with their original boundaries. When `link_rate` (bytes/s) is non-zero,
+ * delivery is paced so that the cumulative byte count never runs ahead of a link of that rate;
+ * otherwise chunks are delivered as fast as the sink consumes them.
+ *
+ * @tparam Sink Callable accepting std::span<const char>
+ * @param cap Capture to replay
+ * @param sink Consumer of body chunks (e.g. a client decoder)
+ * @param link_rate Simulated link rate in bytes per second, 0 for maximum speed
+ * @return ReplayStats Bytes, chunks and wall time spent
+ */
+template<typename Sink>
+ReplayStats replay(const Capture &cap, Sink &&sink, double link_rate = 0) {
+    using clock = std::chrono::steady_clock;
+    ReplayStats stats{0, 0, 0};
+    auto start = clock::now();
+    for (const auto &r: cap.records) {
+        if (r.kind != RecordKind::Chunk) continue;
+        if (link_rate > 0) {
+            auto due = start + std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double>(static_cast<double>(stats.bytes) / link_rate));
+            std::this_thread::sleep_until(due);
+        }
+        sink(std::span<const char>(r.data.data(), r.data.size()));
+        stats.bytes += r.data.size();
+        stats.chunks++;
+    }
+    if (link_rate > 0) {
+        // account for the transmission time of the last chunk, too
+        auto due = start + std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(stats.bytes) / link_rate));
+        std::this_thread::sleep_until(due);
+    }
+    stats.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return stats;
+}
+}  // namespace data_streamer::capture
@@ -4,7 +4,10 @@
 #define ESP_FAIL -1
 
 #define ESP_ERR 1
+#define ESP_ERR_INVALID_ARG         0x102   /*!< Invalid argument */
 #define ESP_ERR_INVALID_STATE       0x103   /*!< Invalid state */
+#define ESP_ERR_NOT_FOUND           0x105   /*!< Requested resource not found */
+#define ESP_ERR_NOT_FINISHED        0x10C   /*!< Operation has not fully completed */
 
 typedef int esp_err_t;
 
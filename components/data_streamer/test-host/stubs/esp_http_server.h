@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 
 #include "esp_err.h"
@@ -8,6 +9,10 @@
 
 #define HTTPD_RESP_USE_STRLEN (-1)
 
+#define HTTPD_SOCK_ERR_FAIL      (-1)
+#define HTTPD_SOCK_ERR_INVALID   (-2)
+#define HTTPD_SOCK_ERR_TIMEOUT   (-3)
+
 #define HTTPD_DEFAULT_CONFIG() \
 {}
 
@@ -15,10 +20,22 @@ typedef httpd_method_t http_method;
 
 typedef enum {
     HTTPD_500_INTERNAL_SERVER_ERROR = 0,
+    HTTPD_501_METHOD_NOT_IMPLEMENTED,
+    HTTPD_505_VERSION_NOT_SUPPORTED,
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_401_UNAUTHORIZED,
+    HTTPD_403_FORBIDDEN,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_405_METHOD_NOT_ALLOWED,
+    HTTPD_408_REQ_TIMEOUT,
+    HTTPD_411_LENGTH_REQUIRED,
+    HTTPD_414_URI_TOO_LONG,
+    HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE,
   } httpd_err_code_t;
 
 typedef struct httpd_req {
-    void *user_ctx;
+    size_t content_len{};
+    void *user_ctx{};
 } httpd_req_t;
 
 typedef struct httpd_uri {
@@ -39,10 +56,18 @@ inline esp_err_t httpd_register_err_handler(httpd_handle_t handle, httpd_err_cod
 inline esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler) {return ESP_OK;}
 inline esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len) {return ESP_OK;}
 inline esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len) {return ESP_OK;}
+// framed as by ESP-IDF: size line, data, CRLF (the last chunk for a null or empty buffer)
 inline esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len) {
-    std::cout.write(buf, buf_len);
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = buf ? static_cast<ssize_t>(strlen(buf)) : 0;
+    std::cout << std::hex << (buf ? buf_len : 0) << std::dec << "\r\n";
+    if (buf) std::cout.write(buf, buf_len);
+    std::cout << "\r\n";
     return ESP_OK;
 }
+inline int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len) {
+    std::cout.write(buf, buf_len);
+    return static_cast<int>(buf_len);
+}
 inline esp_err_t httpd_resp_send_err(httpd_req_t* r, httpd_err_code_t error, const char* err_str) {return ESP_OK;}
 inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *r, const char *str) {return ESP_OK;}
 inline esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value) {return ESP_OK;}
@@ -51,12 +76,18 @@ inline esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type) {return E
 inline esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle, const char *uri, httpd_method_t method) {return ESP_OK;}
 inline size_t httpd_req_get_url_query_len(httpd_req_t* r) {return ESP_OK;}
 inline esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {return ESP_OK;}
+inline size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field) {return 0;}
+inline esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size) {return ESP_OK;}
+inline int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len) {return 0;}
+inline esp_err_t httpd_req_async_handler_begin(httpd_req_t* r, httpd_req_t** out) {*out = new httpd_req_t(*r); return ESP_OK;}
+inline esp_err_t httpd_req_async_handler_complete(httpd_req_t* r) {delete r; return ESP_OK;}
 inline esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config) {return ESP_OK;}
 inline void httpd_stop(httpd_handle_t handle) {}
 
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
 #define HTTPD_207      "207 Multi-Status"           /*!< HTTP Response 207 */
+#define HTTPD_201      "201 Created"                /*!< HTTP Response 201 */
 #define HTTPD_400      "400 Bad Request"            /*!< HTTP Response 400 */
 #define HTTPD_404      "404 Not Found"              /*!< HTTP Response 404 */
 #define HTTPD_408      "408 Request Timeout"        /*!< HTTP Response 408 */
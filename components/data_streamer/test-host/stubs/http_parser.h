@@ -3,5 +3,7 @@
 enum httpd_method_t {
     HTTP_DELETE = 0,
     HTTP_GET,
-    HTTP_POST
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_HEAD
 };
\ No newline at end of file
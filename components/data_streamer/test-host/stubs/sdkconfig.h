@@ -1,3 +1,11 @@
 #pragma once
 #define CONFIG_DATA_STREAMER_CHUNK_SIZE 1024
-#define CONFIG_DATA_STREAMER_MULTIPART_BOUNDARY "~*-._.-*~*-._.-*BOUNDARY*-._.-*~*-._.-*~"
\ No newline at end of file
+#define CONFIG_DATA_STREAMER_MULTIPART_BOUNDARY "~*-._.-*~*-._.-*BOUNDARY*-._.-*~*-._.-*~"
+#define CONFIG_DATA_STREAMER_UPLOAD_BUFFER_SIZE 2048
+#define CONFIG_DATA_STREAMER_CLUSTER_SIZE 0
+#define CONFIG_DATA_STREAMER_MAX_FOLLOWERS 2
+#define CONFIG_DATA_STREAMER_FOLLOW_HEARTBEAT 15
+#define CONFIG_DATA_STREAMER_FOLLOW_POLL 5
+#define CONFIG_DATA_STREAMER_LINE_INDEX_STRIDE 1024
+#define CONFIG_DATA_STREAMER_TLS_RECORD_SIZE 0
+#define CONFIG_DATA_STREAMER_CALIBRATION_BUDGET 1500
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+using AdvertisedDirStreamer = DataStreamer<FlatDirIterable<>, CapturingServerOps, DirConsumer>;
+using AdvertisedFileStreamer = DataStreamer<FileChunker<>, CapturingServerOps>;
+
+TEST(AdvertiseTest, test_merge_list) {
+    std::string list;
+    advertise::merge_list(list, "multipart,framed");
+    advertise::merge_list(list, "multipart,framed,tar");
+    advertise::merge_list(list, "");
+    EXPECT_EQ(list, "multipart,framed,tar");
+    advertise::merge_list(list, "frame,,tar,");
+    EXPECT_EQ(list, "multipart,framed,tar,frame");
+}
+
+TEST(AdvertiseTest, test_capabilities) {
+    EXPECT_EQ(AdvertisedDirStreamer::formats(), "multipart,framed,tar");
+    EXPECT_EQ(AdvertisedDirStreamer::features(), "filter,follow,resume,ack");
+    EXPECT_EQ(AdvertisedFileStreamer::formats(), "");
+    EXPECT_EQ(AdvertisedFileStreamer::features(), "range,lines");
+}
+
+TEST(AdvertiseTest, test_max_followers) {
+    auto dir_streamer = AdvertisedDirStreamer("/nonexistent", DirConsumer("/nonexistent"));
+    EXPECT_EQ(dir_streamer.max_followers(), MAX_FOLLOWERS);
+    dir_streamer.set_follow_options({.max_followers = 1});
+    EXPECT_EQ(dir_streamer.max_followers(), 1u);
+    EXPECT_EQ(AdvertisedFileStreamer("/nonexistent").max_followers(), 0u);
+}
+
+class AdvertiseDirTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_advertise";
+        fs::remove_all(dir);
+        fs::remove(dir.string() + ".cursor");
+        fs::create_directories(dir);
+        for (auto name: {"a.log", "b.log", "c.log"}) {
+            std::ofstream(dir / name, std::ios::binary) << std::string(100, name[0]);
+            fs::last_write_time(dir / name, fs::file_time_type::clock::now() - 1h);
+        }
+    }
+
+    void TearDown() override {
+        DirIndex::disable(dir.string());
+        fs::remove_all(dir);
+        fs::remove(dir.string() + ".cursor");
+    }
+
+    // pulls names up to `to`, and acknowledges them
+    void pull_and_ack(AdvertisedDirStreamer &streamer, const std::string &to) {
+        CapturingServerOps::begin("to=" + to);
+        httpd_req_t req{.user_ctx = &streamer};
+        ASSERT_EQ(AdvertisedDirStreamer::handler_wrapper(&req), ESP_OK);
+        auto body = CapturingServerOps::capture.body();
+        constexpr std::string_view field = "X-Commit-Token: ";
+        auto at = body.find(field);
+        ASSERT_NE(at, std::string::npos);
+        auto token = body.substr(at + field.size(), body.find("\r\n", at) - at - field.size());
+        CapturingServerOps::begin("commit=" + token);
+        ASSERT_EQ(AdvertisedDirStreamer::ack_handler_wrapper(&req), ESP_OK);
+    }
+
+    fs::path dir;
+};
+
+TEST_F(AdvertiseDirTest, test_pending_bytes_follow_acks) {
+    auto streamer = AdvertisedDirStreamer(dir.string(), DirConsumer(dir.string()));
+    EXPECT_FALSE(streamer.pending_bytes());  // not indexed
+
+    DirIndex::enable(dir.string())->build();
+    EXPECT_EQ(streamer.pending_bytes(), 300u);
+    pull_and_ack(streamer, "b.log");
+    EXPECT_EQ(streamer.pending_bytes(), 100u);
+
+    // not acknowledged: nothing pending
+    auto plain = DataStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string());
+    EXPECT_FALSE(plain.pending_bytes());
+}
+
+TEST_F(AdvertiseDirTest, test_txt_records) {
+    DirIndex::enable(dir.string())->build();
+    auto dir_streamer = AdvertisedDirStreamer(dir.string(), DirConsumer(dir.string()));
+    auto file_streamer = AdvertisedFileStreamer((dir / "a.log").string());
+    advertise::Advertiser advertiser;
+    advertiser.add(file_streamer);
+    advertiser.add(dir_streamer);
+
+    // one stream in the HTTP server task, plus the followers of the directory
+    auto status = advertiser.status();
+    EXPECT_EQ(status.active_streams, 0);
+    EXPECT_EQ(status.max_streams, 1 + static_cast<int>(MAX_FOLLOWERS));
+    EXPECT_EQ(status.free_slots, 3);
+    EXPECT_EQ(status.txt(), (advertise::TxtRecords{
+        {"streams", "0"}, {"slots", "3"}, {"formats", "multipart,framed,tar"},
+        {"features", "range,lines,filter,follow,resume,ack"}, {"pending", "300"}}));
+
+    dir_streamer.set_follow_options({.max_followers = 0});
+    EXPECT_EQ(advertiser.status().free_slots, 1);
+    advertiser.set_max_streams(0);
+    EXPECT_EQ(advertiser.status().free_slots, 0);
+
+    // without an index, the backlog isn't advertised
+    DirIndex::disable(dir.string());
+    EXPECT_EQ(advertiser.status().txt().size(), 4u);
+}
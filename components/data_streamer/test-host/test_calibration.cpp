@@ -0,0 +1,127 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "calibration.h"
+
+using namespace data_streamer;
+using namespace std::chrono_literals;
+
+namespace fs = std::filesystem;
+
+TEST(CalibrationTest, test_choose) {
+    //                    512  1K   2K   4K   8K   16K
+    // fast at any size: reads of the chunk size, no read-ahead
+    auto t = calibration::choose({1.0, 1.9, 2.0, 2.0, 2.0, 2.0}, 4096);
+    EXPECT_EQ(t.read_size, 4096);
+    EXPECT_EQ(t.read_ahead, 0);
+    // slower at 4K than at 2K: reads of 2K
+    t = calibration::choose({1.0, 1.5, 2.0, 1.2, 2.1, 2.1}, 4096);
+    EXPECT_EQ(t.read_size, 2048);
+    EXPECT_EQ(t.read_ahead, 0);
+    // much faster with large reads: read-ahead of the best size
+    t = calibration::choose({0.5, 0.8, 1.0, 1.2, 1.8, 2.4}, 1024);
+    EXPECT_EQ(t.read_size, 1024);
+    EXPECT_EQ(t.read_ahead, 16384);
+    // sizes not measured
+    t = calibration::choose({0, 0, 0, 0, 0, 0}, 1024);
+    EXPECT_EQ(t.read_size, 0);
+    EXPECT_EQ(t.read_ahead, 0);
+}
+
+TEST(CalibrationTest, test_result_line) {
+    calibration::Result r{.mb_per_s = {1, 2, 3, 4, 5, 6.5}, .open_us = 900, .stat_us = 410.5, .readdir_us = 60,
+                          .chosen = {.read_size = 2048, .read_ahead = 8192}};
+    auto parsed = calibration::Result::parse(r.to_line());
+    ASSERT_TRUE(parsed);
+    EXPECT_EQ(parsed->chosen.read_size, 2048);
+    EXPECT_EQ(parsed->chosen.read_ahead, 8192);
+    EXPECT_DOUBLE_EQ(parsed->stat_us, 410.5);
+    EXPECT_DOUBLE_EQ(parsed->mb_per_s[5], 6.5);
+    EXPECT_FALSE(calibration::Result::parse("DSCAL0 2048 0 1 1 1 1 1 1 1 1 1\n"));
+    EXPECT_FALSE(calibration::Result::parse("DSCAL1 2048 0 1 1 1 1 1\n"));
+}
+
+class CalibrationDirTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_calibration";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        saved_model = plan::cost_model();
+    }
+
+    void TearDown() override {
+        calibration::tuning() = {};
+        plan::cost_model() = saved_model;
+        fs::remove_all(dir);
+    }
+
+    fs::path dir;
+    plan::CostModel saved_model;
+};
+
+TEST_F(CalibrationDirTest, test_run_at_boot) {
+    auto r = calibration::run_at_boot(dir.string(), 2s);
+    ASSERT_TRUE(r);
+    EXPECT_EQ(fs::file_size(dir / calibration::PROBE_FILE), calibration::PROBE_SIZE);
+    EXPECT_TRUE(fs::exists(dir / calibration::RESULT_FILE));
+    EXPECT_GT(r->open_us, 0);
+    EXPECT_GT(r->mb_per_s[1], 0);
+    EXPECT_GT(r->chosen.read_size, 0);
+    EXPECT_LE(r->chosen.read_size, CHUNK_SIZE);
+    EXPECT_EQ(calibration::tuning().read_size, r->chosen.read_size);
+    EXPECT_EQ(plan::cost_model().open_us, r->open_us);
+
+    // later boots use the saved result
+    calibration::Result saved{.mb_per_s = {1, 1, 1, 1, 1, 1}, .open_us = 1234, .chosen = {.read_size = 512}};
+    ASSERT_FALSE(calibration::save(dir.string(), saved));
+    r = calibration::run_at_boot(dir.string(), 2s);
+    ASSERT_TRUE(r);
+    EXPECT_EQ(r->open_us, 1234);
+    EXPECT_EQ(calibration::tuning().read_size, 512);
+    EXPECT_EQ(plan::cost_model().open_us, 1234);
+}
+
+TEST_F(CalibrationDirTest, test_budget) {
+    // no time: only latencies, and no read measured
+    EXPECT_FALSE(calibration::calibrate(dir.string(), 0ms));
+    EXPECT_FALSE(calibration::run_at_boot((dir / "missing").string(), 1s));
+    EXPECT_EQ(calibration::tuning().read_size, 0);
+}
+
+TEST_F(CalibrationDirTest, test_tuned_chunker) {
+    std::ofstream(dir / "data.bin", std::ios::binary) << std::string(1000, 'x');
+    calibration::tuning() = {.read_size = 300, .read_ahead = 4096};
+    FileChunker<1024> chunker((dir / "data.bin").string());
+    std::vector<size_t> sizes;
+    std::string content;
+    for (std::span<char> &chunk: chunker) {
+        sizes.push_back(chunk.size());
+        content.append(chunk.data(), chunk.size());
+    }
+    EXPECT_EQ(sizes, (std::vector<size_t>{300, 300, 300, 100}));
+    EXPECT_EQ(content, std::string(1000, 'x'));
+    EXPECT_FALSE(chunker.error());
+
+    // larger than the chunk size: the chunk size
+    calibration::tuning() = {.read_size = 4096};
+    FileChunker<1024> capped((dir / "data.bin").string());
+    EXPECT_EQ((*capped.begin()).size(), 1000);
+}
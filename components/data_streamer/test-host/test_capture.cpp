@@ -0,0 +1,136 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "capture.h"
+#include "test_config.h"
+
+using namespace data_streamer;
+using namespace data_streamer::capture;
+
+constexpr char TEST_FILE_PATH[] = TEST_RESOURCES_DIR "/test_data_1.txt";
+
+template<typename T>
+static esp_err_t run_capture(std::string_view path, std::string_view query = {}) {
+    CapturingServerOps::begin(query);
+    auto streamer = DataStreamer<T, CapturingServerOps>(path);
+    httpd_req_t req{.user_ctx = &streamer};
+    return DataStreamer<T, CapturingServerOps>::handler_wrapper(&req);
+}
+
+static std::string read_file(const char *path) {
+    std::ifstream f(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+TEST(capture, test_capture_single_file) {
+    ASSERT_EQ(run_capture<FileChunker<100>>(TEST_FILE_PATH), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    EXPECT_EQ(cap.records.front().kind, RecordKind::Status);
+    EXPECT_EQ(cap.header("Content-Type"), "application/octet-stream");
+    EXPECT_EQ(cap.body(), read_file(TEST_FILE_PATH));
+    // chunk boundaries are preserved: ceil(size / 100) payload chunks
+    EXPECT_EQ(cap.chunk_count(), (TEST_DATA_1_FILE_SIZE + 99) / 100);
+    EXPECT_EQ(cap.records.back().kind, RecordKind::End);
+}
+
+TEST(capture, test_capture_dir_multipart) {
+    ASSERT_EQ(run_capture<FlatDirIterable<>>(TEST_RESOURCES_DIR, "from=test_data_1.txt&to=test_data_1.txt"), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    auto content_type = cap.header("Content-Type");
+    ASSERT_TRUE(content_type);
+    EXPECT_EQ(*content_type, std::string("multipart/mixed; boundary=") + BOUNDARY);
+    auto body = cap.body();
+    EXPECT_NE(body.find("X-Part-Name: \"test_data_1.txt\""), std::string::npos);
+    EXPECT_EQ(body.find("test_data_2.txt"), std::string::npos);  // filtered out by "to"
+    EXPECT_NE(body.find(read_file(TEST_FILE_PATH)), std::string::npos);
+    EXPECT_TRUE(body.ends_with(std::string("--") + BOUNDARY + "--\r\n"));
+}
+
+TEST(capture, test_capture_headers_with_payload) {
+    // part and frame headers are sent in the same chunk as the data they announce
+    auto content = read_file(TEST_FILE_PATH);
+    for (auto format: {"multipart", "framed"}) {
+        auto query = std::string("from=test_data_1.txt&to=test_data_1.txt&format=") + format;
+        ASSERT_EQ(run_capture<FlatDirIterable<100>>(TEST_RESOURCES_DIR, query), ESP_OK);
+        const auto &cap = CapturingServerOps::capture;
+        // one chunk per 100 bytes of content, plus the end of the stream
+        EXPECT_EQ(cap.chunk_count(), (TEST_DATA_1_FILE_SIZE + 99) / 100 + 1) << format;
+        auto first = std::find_if(cap.records.begin(), cap.records.end(),
+                                  [](const Record &r) { return r.kind == RecordKind::Chunk; });
+        ASSERT_NE(first, cap.records.end());
+        EXPECT_NE(first->data.find("test_data_1.txt"), std::string::npos) << format;
+        EXPECT_TRUE(first->data.ends_with(content.substr(0, 100))) << format;
+    }
+}
+
+TEST(capture, test_save_load_roundtrip) {
+    ASSERT_EQ(run_capture<FileChunker<100>>(TEST_FILE_PATH), ESP_OK);
+    auto path = (std::filesystem::temp_directory_path() / "ds_test_roundtrip.dscap").string();
+    ASSERT_FALSE(CapturingServerOps::capture.save(path));
+    auto loaded = Capture::load(path);
+    std::filesystem::remove(path);
+    ASSERT_TRUE(loaded);
+    ASSERT_EQ(loaded->records.size(), CapturingServerOps::capture.records.size());
+    for (size_t i = 0; i < loaded->records.size(); i++) {
+        EXPECT_EQ(loaded->records[i].kind, CapturingServerOps::capture.records[i].kind);
+        EXPECT_EQ(loaded->records[i].data, CapturingServerOps::capture.records[i].data);
+    }
+    EXPECT_FALSE(Capture::load("not_a_capture_path"));
+}
+
+TEST(capture, test_load_rejects_oversized_record) {
+    auto path = (std::filesystem::temp_directory_path() / "ds_test_corrupt.dscap").string();
+    // a header record claiming 4 GiB - 1, followed by 3 bytes
+    std::ofstream(path, std::ios::binary) << std::string(MAGIC, sizeof(MAGIC)) << std::string("H\xff\xff\xff\xff" "abc", 8);
+    EXPECT_FALSE(Capture::load(path));
+    std::filesystem::remove(path);
+}
+
+TEST(capture, test_send_err_records_status) {
+    CapturingServerOps::begin();
+    httpd_req_t req{};
+    EXPECT_EQ(CapturingServerOps::resp_send_err(&req, HTTPD_404_NOT_FOUND, "No such file"), ESP_OK);
+    ASSERT_EQ(CapturingServerOps::capture.records.size(), 1);
+    EXPECT_EQ(CapturingServerOps::capture.records.front().kind, RecordKind::Status);
+    EXPECT_EQ(CapturingServerOps::capture.status(), "404 Not Found");
+}
+
+TEST(capture, test_replay_preserves_chunks) {
+    ASSERT_EQ(run_capture<FileChunker<100>>(TEST_FILE_PATH), ESP_OK);
+    std::vector<size_t> sizes;
+    std::string replayed;
+    auto stats = replay(CapturingServerOps::capture, [&](std::span<const char> chunk) {
+        sizes.push_back(chunk.size());
+        replayed.append(chunk.data(), chunk.size());
+    });
+    EXPECT_EQ(replayed, CapturingServerOps::capture.body());
+    EXPECT_EQ(stats.bytes, replayed.size());
+    EXPECT_EQ(stats.chunks, sizes.size());
+    EXPECT_EQ(sizes.front(), 100);
+}
+
+TEST(capture, test_replay_link_rate) {
+    ASSERT_EQ(run_capture<FileChunker<100>>(TEST_FILE_PATH), ESP_OK);
+    // 1024 bytes at 20 KB/s should take at least ~50ms
+    constexpr double rate = 20 * 1024;
+    auto stats = replay(CapturingServerOps::capture, [](std::span<const char>) {}, rate);
+    EXPECT_GE(stats.seconds, TEST_DATA_1_FILE_SIZE / rate);
+    EXPECT_LE(stats.bytes_per_second(), rate * 1.01);
+}
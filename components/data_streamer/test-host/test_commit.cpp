@@ -0,0 +1,272 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "stream_decoder.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+using capture::RecordKind;
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+using AckedStreamer = DataStreamer<FlatDirIterable<>, CapturingServerOps, DirConsumer>;
+
+struct TrailerHandler {
+    std::map<std::string, std::string> parts;
+    std::string current;
+    std::optional<std::string> trailer;
+
+    void on_part_begin(std::string_view name) { current = name; parts[current]; }
+    void on_part_data(std::span<const char> data) { parts[current].append(data.data(), data.size()); }
+    void on_part_end() {}
+    void on_stream_end(std::string_view t) { trailer = std::string(t); }
+};
+
+class CommitTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = fs::temp_directory_path() / "ds_test_commit";
+        fs::remove_all(root);
+        dir = root / "logs";
+        fs::create_directories(dir);
+        for (auto name: {"a.log", "b.log", "c.log"}) write(name, std::string("content of ") + name);
+    }
+
+    void TearDown() override {
+        DirIndex::disable(dir.string());
+        fs::remove_all(root);
+    }
+
+    void write(const std::string &name, const std::string &content, bool old = true) {
+        std::ofstream(dir / name, std::ios::binary) << content;
+        if (old) {  // written before the stream starts
+            fs::last_write_time(dir / name, fs::file_time_type::clock::now() - 1h);
+        }
+    }
+
+    TrailerHandler pull(AckedStreamer &streamer, std::string_view query = {}) {
+        CapturingServerOps::begin(query);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ(AckedStreamer::handler_wrapper(&req), ESP_OK);
+        TrailerHandler h;
+        auto dec = decoder::MultipartDecoder<TrailerHandler>(BOUNDARY, h);
+        auto body = CapturingServerOps::capture.body();
+        EXPECT_TRUE(dec.feed(body));
+        EXPECT_TRUE(dec.finish());
+        return h;
+    }
+
+    static std::string token_of(const TrailerHandler &h) {
+        constexpr std::string_view prefix = "X-Commit-Token: ";
+        if (!h.trailer || !h.trailer->starts_with(prefix)) return {};
+        return h.trailer->substr(prefix.size(), h.trailer->find("\r\n") - prefix.size());
+    }
+
+    esp_err_t ack(AckedStreamer &streamer, const std::string &token) {
+        CapturingServerOps::begin("commit=" + token);
+        httpd_req_t req{.user_ctx = &streamer};
+        return AckedStreamer::ack_handler_wrapper(&req);
+    }
+
+    AckedStreamer make_streamer(std::string_view archive = {}) {
+        return AckedStreamer(dir.string(), DirConsumer(dir.string(), archive));
+    }
+
+    static std::string read(const fs::path &path) {
+        std::ifstream f(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+    }
+
+    fs::path root;
+    fs::path dir;
+};
+
+TEST_F(CommitTest, test_commit_log) {
+    CommitLog<2> log;
+    auto t1 = log.issue({"a"}, 0);
+    auto t2 = log.issue({"b", "a"}, 0);
+    EXPECT_NE(t1, t2);
+    auto p2 = log.take(t2);
+    ASSERT_TRUE(p2);
+    EXPECT_EQ(p2->last(), "b");
+    EXPECT_FALSE(log.take(t2));  // single use
+    log.issue({"c"}, 0);
+    log.issue({"d"}, 0);
+    EXPECT_FALSE(log.take(t1));  // evicted
+    EXPECT_FALSE(log.take("unknown"));
+}
+
+TEST_F(CommitTest, test_pending_commit_covers) {
+    auto p = PendingCommit{"t", {"b", "d"}, 0};
+    EXPECT_FALSE(p.covers("a"));
+    EXPECT_TRUE(p.covers("b"));
+    EXPECT_FALSE(p.covers("c"));  // in range, but not sent
+    EXPECT_TRUE(p.covers("d"));
+    EXPECT_FALSE(p.covers("e"));
+}
+
+TEST_F(CommitTest, test_ack_deletes_and_advances_cursor) {
+    auto streamer = make_streamer();
+    auto h = pull(streamer);
+    EXPECT_EQ(h.parts.size(), 3);
+    auto token = token_of(h);
+    ASSERT_FALSE(token.empty());
+
+    // nothing is consumed until acknowledged
+    EXPECT_TRUE(fs::exists(dir / "a.log"));
+    ASSERT_EQ(ack(streamer, token), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.body(), "c.log");
+    EXPECT_TRUE(fs::is_empty(dir));
+    EXPECT_EQ(read(root / "logs.cursor"), "c.log");
+
+    // a token can't be used twice
+    EXPECT_EQ(ack(streamer, token), ESP_OK);
+    EXPECT_TRUE(CapturingServerOps::capture.body().empty());
+
+    // the next pull starts after the cursor, also with a new consumer (e.g. after a reboot)
+    write("b2.log", "late, but before the cursor");
+    write("d.log", "new");
+    auto streamer2 = make_streamer();
+    h = pull(streamer2);
+    ASSERT_EQ(h.parts.size(), 1);
+    EXPECT_EQ(h.parts.begin()->first, "d.log");
+
+    // explicit from overrides the cursor
+    auto from_h = pull(streamer2, "from=b");
+    EXPECT_EQ(from_h.parts.size(), 2);
+
+    // files before the cursor that were never streamed are kept
+    ASSERT_EQ(ack(streamer2, token_of(h)), ESP_OK);
+    EXPECT_FALSE(fs::exists(dir / "d.log"));
+    EXPECT_TRUE(fs::exists(dir / "b2.log"));
+    EXPECT_EQ(read(root / "logs.cursor"), "d.log");
+}
+
+TEST_F(CommitTest, test_from_past_cursor_keeps_cursor) {
+    auto streamer = make_streamer();
+    ASSERT_EQ(ack(streamer, token_of(pull(streamer, "to=a.log"))), ESP_OK);
+    EXPECT_EQ(read(root / "logs.cursor"), "a.log");
+
+    // b.log wasn't sent: the cursor can't move past it
+    auto h = pull(streamer, "from=c.log");
+    ASSERT_EQ(h.parts.size(), 1);
+    ASSERT_EQ(ack(streamer, token_of(h)), ESP_OK);
+    EXPECT_FALSE(fs::exists(dir / "c.log"));
+    EXPECT_TRUE(fs::exists(dir / "b.log"));
+    EXPECT_EQ(read(root / "logs.cursor"), "a.log");
+
+    h = pull(streamer);
+    ASSERT_EQ(h.parts.size(), 1);
+    EXPECT_EQ(h.parts.begin()->first, "b.log");
+    ASSERT_EQ(ack(streamer, token_of(h)), ESP_OK);
+    EXPECT_TRUE(fs::is_empty(dir));
+    EXPECT_EQ(read(root / "logs.cursor"), "b.log");
+}
+
+TEST_F(CommitTest, test_mtime_resolution) {
+    // on FAT, a file rewritten just after the stream started can be dated up to 2 s earlier
+    write("b.log", "rewritten", false);
+    fs::last_write_time(dir / "b.log", fs::file_time_type::clock::now() - 1s);
+    auto streamer = make_streamer();
+    ASSERT_EQ(ack(streamer, token_of(pull(streamer))), ESP_OK);
+    EXPECT_FALSE(fs::exists(dir / "a.log"));
+    EXPECT_TRUE(fs::exists(dir / "b.log"));
+    EXPECT_EQ(read(root / "logs.cursor"), "a.log");
+}
+
+TEST_F(CommitTest, test_no_token_for_empty_stream) {
+    fs::remove(dir / "a.log");
+    fs::remove(dir / "b.log");
+    fs::remove(dir / "c.log");
+    auto streamer = make_streamer();
+    auto h = pull(streamer);
+    EXPECT_TRUE(h.parts.empty());
+    EXPECT_TRUE(token_of(h).empty());
+}
+
+TEST_F(CommitTest, test_files_modified_after_stream_start_are_kept) {
+    write("b.log", "still being written", false);
+    auto streamer = make_streamer();
+    auto token = token_of(pull(streamer));
+    ASSERT_EQ(ack(streamer, token), ESP_OK);
+    EXPECT_FALSE(fs::exists(dir / "a.log"));
+    EXPECT_TRUE(fs::exists(dir / "b.log"));
+    EXPECT_FALSE(fs::exists(dir / "c.log"));
+    // the cursor stops before the kept file, so the next pull gets it again
+    EXPECT_EQ(read(root / "logs.cursor"), "a.log");
+    auto h = pull(streamer);
+    ASSERT_EQ(h.parts.size(), 1);
+    EXPECT_EQ(h.parts.begin()->first, "b.log");
+}
+
+TEST_F(CommitTest, test_files_not_sent_are_kept) {
+    DirIndex::enable(dir.string(), DirIndex::Writers::Hooked)->build();
+    // added by a writer that doesn't report it, so the stream served from the index doesn't send it
+    write("b2.log", "not indexed");
+    auto streamer = make_streamer();
+    auto h = pull(streamer);
+    EXPECT_EQ(h.parts.size(), 3);
+    EXPECT_FALSE(h.parts.contains("b2.log"));
+    ASSERT_EQ(ack(streamer, token_of(h)), ESP_OK);
+    EXPECT_FALSE(fs::exists(dir / "a.log"));
+    EXPECT_TRUE(fs::exists(dir / "b2.log"));
+    EXPECT_FALSE(fs::exists(dir / "c.log"));
+    // the cursor stops before the file, so the next pull without the index gets it
+    EXPECT_EQ(read(root / "logs.cursor"), "b.log");
+    DirIndex::disable(dir.string());
+    h = pull(streamer);
+    ASSERT_EQ(h.parts.size(), 1);
+    EXPECT_EQ(h.parts.begin()->first, "b2.log");
+}
+
+TEST_F(CommitTest, test_archive_instead_of_delete) {
+    auto streamer = make_streamer((root / "archive").string());
+    auto token = token_of(pull(streamer, "to=b.log"));
+    ASSERT_EQ(ack(streamer, token), ESP_OK);
+    EXPECT_EQ(read(root / "archive" / "a.log"), "content of a.log");
+    EXPECT_TRUE(fs::exists(root / "archive" / "b.log"));
+    EXPECT_TRUE(fs::exists(dir / "c.log"));
+}
+
+TEST_F(CommitTest, test_framed_trailer) {
+    auto streamer = make_streamer();
+    CapturingServerOps::begin("format=framed");
+    httpd_req_t req{.user_ctx = &streamer};
+    ASSERT_EQ(AckedStreamer::handler_wrapper(&req), ESP_OK);
+    TrailerHandler h;
+    auto dec = decoder::FramedDecoder<TrailerHandler>(h);
+    EXPECT_TRUE(dec.feed(CapturingServerOps::capture.body()));
+    EXPECT_TRUE(dec.finish());
+    ASSERT_FALSE(token_of(h).empty());
+    EXPECT_EQ(ack(streamer, token_of(h)), ESP_OK);
+    EXPECT_TRUE(fs::is_empty(dir));
+}
+
+TEST_F(CommitTest, test_unknown_token) {
+    auto streamer = make_streamer();
+    pull(streamer);
+    EXPECT_EQ(ack(streamer, "0123"), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.status(), "404 Not Found");
+    EXPECT_TRUE(CapturingServerOps::capture.body().empty());
+    EXPECT_TRUE(fs::exists(dir / "a.log"));
+}
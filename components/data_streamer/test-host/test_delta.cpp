@@ -0,0 +1,202 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using namespace data_streamer::delta;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+struct DeltaResult {
+    std::string rebuilt;
+    DeltaStats stats;
+    bool ok;
+};
+
+static std::string random_bytes(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string s(n, '\0');
+    for (auto &c: s) c = static_cast<char>(rng());
+    return s;
+}
+
+// encodes `current` against `basis` feeding `piece` bytes at a time, then patches the basis
+static DeltaResult roundtrip(const std::string &basis, const std::string &current, uint32_t block_size,
+                             size_t piece = 1000) {
+    auto builder = SignatureBuilder(block_size);
+    builder.update(basis);
+    auto signature = Signature::parse(builder.finish());
+    EXPECT_TRUE(signature);
+    std::string delta;
+    auto encoder = DeltaEncoder(*signature);
+    auto emit = [&](std::span<const char> d) { delta.append(d.data(), d.size()); return true; };
+    for (size_t i = 0; i < current.size(); i += piece) {
+        EXPECT_TRUE(encoder.feed(std::string_view(current).substr(i, piece), emit));
+    }
+    EXPECT_TRUE(encoder.finish(emit));
+    EXPECT_EQ(encoder.statistics().delta_bytes, delta.size());
+
+    DeltaResult result{{}, encoder.statistics(), false};
+    auto read_basis = [&](uint64_t offset, std::span<char> out) {
+        memcpy(out.data(), basis.data() + offset, out.size());
+        return true;
+    };
+    auto write = [&](std::span<const char> d) { result.rebuilt.append(d.data(), d.size()); return true; };
+    auto patcher = DeltaPatcher(block_size, basis.size(), read_basis, write);
+    // feed the delta in odd-sized pieces
+    bool fed = true;
+    for (size_t i = 0; i < delta.size() && fed; i += 7) fed = patcher.feed(std::string_view(delta).substr(i, 7));
+    result.ok = fed && patcher.finish();
+    return result;
+}
+
+TEST(DeltaTest, test_xxh64) {
+    EXPECT_EQ(Xxh64::hash({}), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(Xxh64::hash(std::string_view("abc")), 0x44BC2CF5AD770999ULL);
+    auto data = random_bytes(1000, 1);
+    Xxh64 h;
+    for (size_t i = 0; i < data.size(); i += 13) h.update(std::string_view(data).substr(i, 13));
+    EXPECT_EQ(h.digest(), Xxh64::hash(data));
+}
+
+TEST(DeltaTest, test_rolling_checksum) {
+    auto data = random_bytes(2000, 2);
+    RollingChecksum rolling;
+    rolling.reset(std::string_view(data).substr(0, 512));
+    for (size_t i = 0; i + 512 < data.size(); i++) {
+        rolling.roll(data[i], data[i + 512]);
+        ASSERT_EQ(rolling.value(), RollingChecksum::of(std::string_view(data).substr(i + 1, 512)));
+    }
+}
+
+TEST(DeltaTest, test_identical_file_is_all_copies) {
+    auto basis = random_bytes(100000, 3);
+    auto result = roundtrip(basis, basis, 1024);
+    EXPECT_TRUE(result.ok);
+    EXPECT_EQ(result.rebuilt, basis);
+    EXPECT_EQ(result.stats.literal_bytes, 0u);
+    EXPECT_LT(result.stats.delta_bytes, 64u);  // one copy instruction and the end
+}
+
+TEST(DeltaTest, test_edits_insertions_and_appends) {
+    auto basis = random_bytes(100000, 4);
+    auto current = basis;
+    current[5000] ^= 0x55;                                 // in-place edit
+    current.insert(30000, "inserted bytes");               // insertion shifting the rest
+    current.erase(60000, 100);                             // deletion
+    current += random_bytes(3000, 5);                      // append
+    for (size_t piece: {1u, 1000u, 1u << 20}) {
+        auto result = roundtrip(basis, current, 1024, piece);
+        EXPECT_TRUE(result.ok);
+        EXPECT_EQ(result.rebuilt, current);
+        // about one block per change, plus the appended data
+        EXPECT_LT(result.stats.literal_bytes, 3000u + 4 * 1024);
+    }
+}
+
+TEST(DeltaTest, test_short_last_block_and_empty_basis) {
+    auto basis = random_bytes(10000, 6);  // last block is 784 bytes
+    auto result = roundtrip(basis, basis, 1024, 333);
+    EXPECT_TRUE(result.ok);
+    EXPECT_EQ(result.stats.literal_bytes, 0u);
+
+    auto current = random_bytes(5000, 7);
+    result = roundtrip("", current, 1024);
+    EXPECT_TRUE(result.ok);
+    EXPECT_EQ(result.rebuilt, current);
+    EXPECT_EQ(result.stats.literal_bytes, current.size());
+
+    result = roundtrip(basis, "", 1024);
+    EXPECT_TRUE(result.ok);
+    EXPECT_TRUE(result.rebuilt.empty());
+}
+
+TEST(DeltaTest, test_corrupt_basis_is_detected) {
+    auto basis = random_bytes(10000, 8);
+    auto builder = SignatureBuilder(1024);
+    builder.update(basis);
+    auto signature = Signature::parse(builder.finish());
+    std::string delta;
+    auto encoder = DeltaEncoder(*signature);
+    auto emit = [&](std::span<const char> d) { delta.append(d.data(), d.size()); return true; };
+    encoder.feed(basis, emit);
+    encoder.finish(emit);
+    auto changed = basis;
+    changed[100] ^= 1;  // the client's basis changed since the signature
+    auto patcher = DeltaPatcher(1024, changed.size(),
+                                [&](uint64_t offset, std::span<char> out) {
+                                    memcpy(out.data(), changed.data() + offset, out.size());
+                                    return true;
+                                },
+                                [](std::span<const char>) { return true; });
+    EXPECT_FALSE(patcher.feed(delta));  // hash mismatch at the end instruction
+    EXPECT_FALSE(patcher.finish());
+}
+
+TEST(DeltaTest, test_signature_validation) {
+    EXPECT_FALSE(Signature::parse(std::string_view("DSIG")));
+    auto builder = SignatureBuilder(1024);
+    builder.update(random_bytes(5000, 9));
+    auto sig = builder.finish();
+    EXPECT_TRUE(Signature::parse(sig));
+    EXPECT_FALSE(Signature::parse(std::string_view(sig).substr(0, sig.size() - 1)));
+    EXPECT_FALSE(Signature::parse(std::string_view(sig).substr(0, sig.size() - SIGNATURE_ENTRY_SIZE)));
+    EXPECT_GE(choose_block_size(1ull << 40) * uint64_t{MAX_BLOCKS}, 1ull << 30);
+    EXPECT_EQ(choose_block_size(0), MIN_BLOCK_SIZE);
+}
+
+TEST(DeltaTest, test_delta_endpoint) {
+    auto path = fs::temp_directory_path() / "ds_test_delta.bin";
+    auto basis = random_bytes(50000, 10);
+    auto current = basis;
+    current.replace(20000, 10, "0123456789");
+    std::ofstream(path, std::ios::binary) << current;
+
+    auto builder = SignatureBuilder(choose_block_size(basis.size()));
+    builder.update(basis);
+    auto body = builder.finish();
+    auto streamer = DeltaStreamer<FileChunker<>, CapturingServerOps>(path.string());
+    CapturingServerOps::begin_upload(body);
+    httpd_req_t req{.content_len = body.size(), .user_ctx = &streamer};
+    EXPECT_EQ(decltype(streamer)::handler_wrapper(&req), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.header("Content-Type"), CONTENT_TYPE);
+    auto delta = CapturingServerOps::capture.body();
+    EXPECT_LT(delta.size(), 2 * choose_block_size(basis.size()));
+
+    std::string rebuilt;
+    auto patcher = DeltaPatcher(choose_block_size(basis.size()), basis.size(),
+                                [&](uint64_t offset, std::span<char> out) {
+                                    memcpy(out.data(), basis.data() + offset, out.size());
+                                    return true;
+                                },
+                                [&](std::span<const char> d) { rebuilt.append(d.data(), d.size()); return true; });
+    EXPECT_TRUE(patcher.feed(delta));
+    EXPECT_TRUE(patcher.finish());
+    EXPECT_EQ(rebuilt, current);
+
+    CapturingServerOps::begin_upload("not a signature");
+    req.content_len = 15;
+    EXPECT_EQ(decltype(streamer)::handler_wrapper(&req), ESP_OK);
+    EXPECT_TRUE(CapturingServerOps::capture.body().empty());
+    fs::remove(path);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "diag.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+using capture::RecordKind;
+
+namespace fs = std::filesystem;
+
+static std::string synthetic(size_t offset, size_t n) {
+    std::string out(n, '\0');
+    diag::fill(out, offset);
+    return out;
+}
+
+TEST(DiagTest, test_parse_size) {
+    EXPECT_EQ(diag::parse_size("123"), 123);
+    EXPECT_EQ(diag::parse_size("4K"), 4096);
+    EXPECT_EQ(diag::parse_size("16M"), 16 << 20);
+    EXPECT_FALSE(diag::parse_size(""));
+    EXPECT_FALSE(diag::parse_size("M"));
+    EXPECT_FALSE(diag::parse_size("16MB"));
+    EXPECT_FALSE(diag::parse_size("-1"));
+}
+
+TEST(DiagTest, test_fill_offsets) {
+    auto whole = synthetic(0, 1000);
+    EXPECT_EQ(synthetic(13, 500), whole.substr(13, 500));
+    EXPECT_EQ(synthetic(999, 1), whole.substr(999, 1));
+    // not constant
+    EXPECT_NE(whole.substr(0, 8), whole.substr(8, 8));
+}
+
+TEST(DiagTest, test_link_test_streamer) {
+    using Streamer = DataStreamer<diag::SyntheticChunker<1024>, CapturingServerOps>;
+    auto streamer = Streamer("10000");
+    httpd_req_t req{.user_ctx = &streamer};
+    CapturingServerOps::begin();
+    ASSERT_EQ(Streamer::handler_wrapper(&req), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    EXPECT_EQ(cap.header("X-Part-Name"), diag::SYNTHETIC_NAME);
+    EXPECT_EQ(cap.body(), synthetic(0, 10000));
+    EXPECT_EQ(cap.chunk_count(), 10);
+
+    // ranges of the same content
+    CapturingServerOps::begin({}, {{"Range", "bytes=5000-5999"}});
+    ASSERT_EQ(Streamer::handler_wrapper(&req), ESP_OK);
+    EXPECT_EQ(cap.body(), synthetic(5000, 1000));
+
+    // malformed size
+    auto bad = Streamer("lots");
+    httpd_req_t bad_req{.user_ctx = &bad};
+    CapturingServerOps::begin();
+    EXPECT_EQ(Streamer::handler_wrapper(&bad_req), ESP_FAIL);
+}
+
+TEST(DiagTest, test_storage_test_streamer) {
+    auto path = (fs::temp_directory_path() / "ds_test_diag.bin").string();
+    fs::remove(path);
+    using Streamer = StorageTestStreamer<FileChunker<1024>, CapturingServerOps>;
+    auto streamer = Streamer(path);
+    httpd_req_t req{.user_ctx = &streamer};
+
+    // no test file: 404, no body
+    CapturingServerOps::begin();
+    EXPECT_EQ(Streamer::handler_wrapper(&req), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.status(), "404 Not Found");
+    EXPECT_TRUE(CapturingServerOps::capture.body().empty());
+
+    ASSERT_FALSE(diag::write_test_file(path, 100000));
+    EXPECT_EQ(fs::file_size(path), 100000);
+    CapturingServerOps::begin();
+    ASSERT_EQ(Streamer::handler_wrapper(&req), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    EXPECT_EQ(cap.header("Content-Type"), diag::REPORT_CONTENT_TYPE);
+    EXPECT_EQ(cap.header(diag::READ_BYTES_FIELD), "100000");
+    auto server_timing = cap.header(timing::SERVER_TIMING_FIELD);
+    ASSERT_TRUE(server_timing);
+    EXPECT_TRUE(server_timing->starts_with("open;dur="));
+    EXPECT_NE(server_timing->find(", read;dur="), std::string::npos);
+    EXPECT_TRUE(cap.body().starts_with(R"({"bytes":100000,"open_us":)")) << cap.body();
+    fs::remove(path);
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "stream_decoder.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+namespace {
+struct NameHandler {
+    std::vector<std::string> names;
+    void on_part_begin(std::string_view name) { names.emplace_back(name); }
+    void on_part_data(std::span<const char>) {}
+    void on_part_end() {}
+};
+}
+
+class FollowTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // a directory per test, as watches are registered per directory for the process lifetime
+        dir = fs::temp_directory_path() / ("ds_test_follow_" +
+              std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        for (auto name: {"a1.log", "a2.log"}) write(name);
+        watch = DirWatch::get(dir.string());
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    void write(const std::string &name) {
+        std::ofstream(dir / name) << name;
+    }
+
+    // starts a follow stream; its task runs until the streamer is unbound
+    template<typename S>
+    void follow(S &streamer, std::string_view query) {
+        CapturingServerOps::begin(query);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ(S::handler_wrapper(&req), ESP_OK);
+    }
+
+    fs::path dir;
+    std::shared_ptr<DirWatch> watch;
+};
+
+TEST_F(FollowTest, test_writer_notifications) {
+    auto streamer = DataStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string());
+    streamer.set_follow_options({.max_followers = 1, .heartbeat = 10s, .poll = 10s});
+    watch->opened("a3.log");
+    write("a3.log");
+    follow(streamer, "follow=1&format=framed");
+    std::this_thread::sleep_for(100ms);
+    EXPECT_EQ(watch->follower_count(), 1u);
+    EXPECT_EQ(streamer.active_streams(), 0);  // idle followers aren't active
+
+    write("a4.log");  // complete, but after a3.log which isn't
+    std::this_thread::sleep_for(100ms);
+    watch->closed("a3.log");
+    std::this_thread::sleep_for(100ms);
+    streamer.unbind();
+    EXPECT_EQ(watch->follower_count(), 0u);
+
+    NameHandler handler;
+    auto decoder = decoder::FramedDecoder<NameHandler>(handler);
+    EXPECT_TRUE(decoder.feed(CapturingServerOps::capture.body()));
+    EXPECT_TRUE(decoder.finish());
+    EXPECT_EQ(handler.names, (std::vector<std::string>{"a1.log", "a2.log", "a3.log", "a4.log"}));
+    EXPECT_EQ(CapturingServerOps::capture.records.back().kind, capture::RecordKind::End);
+}
+
+TEST_F(FollowTest, test_polling_and_heartbeats) {
+    watch->set_settle(0);
+    auto streamer = DataStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string());
+    streamer.set_follow_options({.max_followers = 1, .heartbeat = 20ms, .poll = 10ms});
+    follow(streamer, "follow=1&from=a2.log");
+    std::this_thread::sleep_for(100ms);
+    write("b1.log");  // no notification: found by polling
+    std::this_thread::sleep_for(100ms);
+    streamer.unbind();
+
+    auto body = CapturingServerOps::capture.body();
+    EXPECT_NE(body.find(std::string(follow::HEARTBEAT_FIELD) + ": "), std::string::npos);
+    NameHandler handler;
+    auto decoder = decoder::MultipartDecoder<NameHandler>(BOUNDARY, handler);
+    EXPECT_TRUE(decoder.feed(body));
+    EXPECT_TRUE(decoder.finish());
+    EXPECT_EQ(handler.names, (std::vector<std::string>{"a2.log", "b1.log"}));
+}
+
+TEST_F(FollowTest, test_rejected_requests) {
+    auto streamer = DataStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string());
+    streamer.set_follow_options({.max_followers = 0});
+    follow(streamer, "follow=1");
+    ASSERT_FALSE(CapturingServerOps::capture.records.empty());
+    EXPECT_EQ(CapturingServerOps::capture.records.front().data, follow::STATUS_503);
+    EXPECT_EQ(watch->follower_count(), 0u);
+
+    follow(streamer, "follow=1&format=tar");
+    EXPECT_EQ(CapturingServerOps::capture.status(), "400 Bad Request");
+}
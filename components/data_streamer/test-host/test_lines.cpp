@@ -0,0 +1,190 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "lines.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+TEST(LinesTest, test_parse) {
+    auto r = lines::parse("120-150");
+    ASSERT_TRUE(r);
+    EXPECT_EQ(r->first, 120);
+    EXPECT_EQ(r->last, 150);
+    EXPECT_EQ(lines::parse("7")->last, 7);
+    EXPECT_FALSE(lines::parse("7-")->last);
+    for (auto bad: {"", "0-5", "5-4", "-5", "a-b", "5-x", "5--6"}) {
+        EXPECT_FALSE(lines::parse(bad)) << bad;
+    }
+}
+
+TEST(LinesTest, test_count_newlines) {
+    std::mt19937 rng(7);
+    // bytes close to '\n' (and with the high bit set) must not be counted
+    const std::string alphabet{'\n', '\x0b', '\x09', '\x8a', '\xff', '\0', 'a'};
+    for (size_t len: {0, 1, 7, 8, 9, 63, 64, 1000}) {
+        std::string data(len, ' ');
+        for (auto &c: data) c = alphabet[rng() % alphabet.size()];
+        auto expected = static_cast<size_t>(std::count(data.begin(), data.end(), '\n'));
+        EXPECT_EQ(lines::count_newlines(data), expected) << len;
+        if (expected > 0) {
+            EXPECT_EQ(lines::find_newline(data, expected), data.rfind('\n'));
+        }
+        EXPECT_EQ(lines::find_newline(data, expected + 1), std::string_view::npos);
+    }
+}
+
+class LineIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_lines";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        path = (dir / "log.txt").string();
+        append(1, 5000);
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    // appends lines of varying length
+    void append(size_t first, size_t last) {
+        std::ofstream f(path, std::ios::app | std::ios::binary);
+        for (size_t i = first; i <= last; i++) {
+            auto line = "line " + std::to_string(i) + std::string(i % 13, '.') + "\n";
+            f << line;
+            text.push_back(line);
+        }
+    }
+
+    [[nodiscard]] std::string expected(size_t first, size_t last) const {
+        std::string out;
+        for (size_t i = first; i <= std::min(last, text.size()); i++) out += text[i - 1];
+        return out;
+    }
+
+    // reads lines through a LineCursor, feeding the file in pieces
+    std::string select(lines::LineIndex &index, const lines::LineRange &range, size_t piece) {
+        auto start = index.seek_point(range.first);
+        std::ifstream f(path, std::ios::binary);
+        f.seekg(static_cast<std::streamoff>(start.offset));
+        std::string content{std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+        lines::LineCursor cursor(index, range, start);
+        std::string out;
+        for (size_t i = 0; i < content.size() && !cursor.done(); i += piece) {
+            auto selected = cursor.feed(std::span<const char>(content).subspan(i, std::min(piece, content.size() - i)));
+            out.append(selected.data(), selected.size());
+        }
+        return out;
+    }
+
+    std::optional<std::string> stream(const std::string &query) {
+        CapturingServerOps::begin(query);
+        auto streamer = DataStreamer<FileChunker<100>, CapturingServerOps>(path);
+        httpd_req_t req{.user_ctx = &streamer};
+        if (DataStreamer<FileChunker<100>, CapturingServerOps>::handler_wrapper(&req) != ESP_OK ||
+            CapturingServerOps::capture.records.empty()) {
+            return std::nullopt;
+        }
+        if (auto status = CapturingServerOps::capture.status(); status && !status->starts_with("2")) {
+            return std::nullopt;
+        }
+        return CapturingServerOps::capture.body();
+    }
+
+    fs::path dir;
+    std::string path;
+    std::vector<std::string> text;
+};
+
+TEST_F(LineIndexTest, test_cursor_extends_index) {
+    for (size_t piece: {1, 7, 100, 100000}) {
+        fs::remove(path + lines::SIDECAR_SUFFIX);
+        lines::LineIndex index(path, 100);
+        EXPECT_EQ(select(index, {.first = 250, .last = 260}, piece), expected(250, 260)) << piece;
+        EXPECT_EQ(index.size(), 2);  // lines 101 and 201
+        EXPECT_EQ(select(index, {.first = 1, .last = 1}, piece), expected(1, 1)) << piece;
+        EXPECT_EQ(select(index, {.first = 4990}, piece), expected(4990, 5000)) << piece;
+        EXPECT_EQ(index.size(), 50);  // up to line 5001, at the end of the file
+        EXPECT_EQ(index.seek_point(4990).line, 4901);
+        EXPECT_EQ(select(index, {.first = 450, .last = 1200}, piece), expected(450, 1200)) << piece;
+        EXPECT_EQ(select(index, {.first = 6000}, piece), "");
+        ASSERT_FALSE(index.save());
+    }
+    // the saved index is reused
+    lines::LineIndex index(path, 100);
+    EXPECT_EQ(index.size(), 50);
+    auto start = index.seek_point(3456);
+    EXPECT_EQ(start.line, 3401);
+    EXPECT_EQ(start.offset, expected(1, 3400).size());
+}
+
+TEST_F(LineIndexTest, test_index_follows_file) {
+    {
+        lines::LineIndex index(path, 100);
+        select(index, {.first = 5000}, 4096);
+        ASSERT_FALSE(index.save());
+    }
+    // appended lines extend the saved index
+    append(5001, 5500);
+    {
+        lines::LineIndex index(path, 100);
+        EXPECT_EQ(index.size(), 50);
+        EXPECT_EQ(select(index, {.first = 5450, .last = 5460}, 4096), expected(5450, 5460));
+        EXPECT_EQ(index.size(), 54);
+        ASSERT_FALSE(index.save());
+    }
+    EXPECT_EQ(fs::file_size(path + lines::SIDECAR_SUFFIX), 4 * (1 + 54));
+
+    // a rewritten, shorter file drops the index
+    fs::remove(path);
+    text.clear();
+    append(1, 300);
+    lines::LineIndex index(path, 100);
+    EXPECT_EQ(index.size(), 0);
+    EXPECT_EQ(select(index, {.first = 280, .last = 290}, 4096), expected(280, 290));
+    // as does another stride
+    ASSERT_FALSE(index.save());
+    EXPECT_EQ(lines::LineIndex(path, 50).size(), 0);
+}
+
+TEST_F(LineIndexTest, test_streamer_lines) {
+    EXPECT_EQ(stream("lines=2000-2005"), expected(2000, 2005));
+    EXPECT_EQ(lines::LineIndex(path).size(), 1);  // line 1025
+    EXPECT_EQ(stream("lines=4321-"), expected(4321, 5000));
+    EXPECT_EQ(lines::LineIndex(path).size(), 4);
+    EXPECT_EQ(stream("lines=3000"), expected(3000, 3000));
+
+    // the Range header is ignored
+    CapturingServerOps::begin("lines=3-4", {{"Range", "bytes=0-1"}});
+    auto streamer = DataStreamer<FileChunker<100>, CapturingServerOps>(path);
+    httpd_req_t req{.user_ctx = &streamer};
+    ASSERT_EQ((DataStreamer<FileChunker<100>, CapturingServerOps>::handler_wrapper(&req)), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.body(), expected(3, 4));
+    EXPECT_FALSE(CapturingServerOps::capture.header("Content-Range"));
+
+    EXPECT_FALSE(stream("lines=5-4"));
+}
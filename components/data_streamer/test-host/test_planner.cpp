@@ -0,0 +1,281 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+TEST(PlannerTest, test_no_index_scans) {
+    auto p = plan::choose({.prefix = "a"}, {.entries = 100});
+    EXPECT_EQ(p.strategy, plan::Strategy::FullScan);
+    EXPECT_EQ(p.chosen().rows, 50u);
+    EXPECT_FALSE(p.estimates[static_cast<size_t>(plan::Strategy::IndexSeek)].available);
+    EXPECT_FALSE(p.estimates[static_cast<size_t>(plan::Strategy::IndexScan)].available);
+}
+
+TEST(PlannerTest, test_fresh_index_picks_cheapest) {
+    plan::DirStats stats{.entries = 1000, .index_fresh = true, .range_entries = 10, .matching = 10};
+    auto seek = plan::choose({.from = "b", .to = "c"}, stats);
+    EXPECT_EQ(seek.strategy, plan::Strategy::IndexSeek);
+    EXPECT_LT(seek.chosen().cost_us, seek.estimates[static_cast<size_t>(plan::Strategy::IndexScan)].cost_us);
+
+    // no name bounds: the index can only be walked
+    auto walk = plan::choose({.since = 100}, {.entries = 1000, .index_fresh = true, .range_entries = 1000});
+    EXPECT_EQ(walk.strategy, plan::Strategy::IndexScan);
+    EXPECT_FALSE(walk.estimates[static_cast<size_t>(plan::Strategy::IndexSeek)].available);
+
+    // opening files dominates once the index is no faster than the directory
+    auto slow_index = plan::CostModel{.readdir_us = 0, .stat_us = 0, .index_entry_us = 10};
+    EXPECT_EQ(plan::choose({.since = 100}, stats, slow_index).strategy, plan::Strategy::FullScan);
+}
+
+TEST(PlannerTest, test_explain_json) {
+    auto p = plan::choose({.from = "b"}, {.entries = 1000, .index_fresh = true, .range_entries = 2, .matching = 2});
+    EXPECT_EQ(p.to_json(),
+              R"({"strategy":"index_seek","entries":1000,"index":"fresh","estimates":[)"
+              R"({"strategy":"full_scan","cost_us":461800,"rows":2},)"
+              R"({"strategy":"index_seek","cost_us":1807,"rows":2},)"
+              R"({"strategy":"index_scan","cost_us":2100,"rows":2}]})");
+}
+
+class DirPlanTest : public ::testing::Test {
+protected:
+    // enough entries for index seeks to beat walking the index
+    static constexpr int FILLERS = 40;
+
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_planner";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        // a*.log and d*.log are a day old, b*.log and c1.log are fresh
+        std::vector<std::string> files{"b2.log", "a1.log", "b1.log", "a2.log", "c1.log"};
+        for (int i = 0; i < FILLERS; i++) files.push_back("d" + std::to_string(10 + i) + ".log");
+        for (const auto &name: files) {
+            std::ofstream(dir / name) << name;
+            if (name[0] == 'a' || name[0] == 'd') {
+                fs::last_write_time(dir / name, fs::file_time_type::clock::now() - 24h);
+            }
+        }
+    }
+
+    void TearDown() override {
+        DirIndex::disable(dir.string());
+        fs::remove_all(dir);
+    }
+
+    std::vector<std::string> names(const DirFilter &filter, plan::Strategy expected) {
+        auto iterable = FlatDirIterable<>(dir.string());
+        EXPECT_EQ(iterable.plan(filter).strategy, expected);
+        std::vector<std::string> out;
+        for (auto &chunker: iterable) out.emplace_back(chunker.name());
+        EXPECT_FALSE(iterable.error());
+        return out;
+    }
+
+    std::string get(std::string_view query) {
+        auto streamer = DataStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string());
+        CapturingServerOps::begin(query);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ(decltype(streamer)::handler_wrapper(&req), ESP_OK);
+        return CapturingServerOps::capture.body();
+    }
+
+    fs::path dir;
+};
+
+TEST_F(DirPlanTest, test_scan_filters_before_opening) {
+    auto since = time(nullptr) - 3600;
+    auto found = names({.prefix = "b"}, plan::Strategy::FullScan);
+    std::sort(found.begin(), found.end());
+    EXPECT_EQ(found, (std::vector<std::string>{"b1.log", "b2.log"}));
+    found = names({.since = since}, plan::Strategy::FullScan);
+    std::sort(found.begin(), found.end());
+    EXPECT_EQ(found, (std::vector<std::string>{"b1.log", "b2.log", "c1.log"}));
+}
+
+TEST_F(DirPlanTest, test_index_seek_in_name_order) {
+    auto index = DirIndex::enable(dir.string(), DirIndex::Writers::Hooked);
+    ASSERT_FALSE(index->build());
+    EXPECT_EQ(index->size(), 5u + FILLERS);
+    EXPECT_EQ(names({.from = "a2.log", .to = "b2.log"}, plan::Strategy::IndexSeek),
+              (std::vector<std::string>{"a2.log", "b1.log", "b2.log"}));
+    EXPECT_EQ(names({.after = "a2.log", .prefix = "b"}, plan::Strategy::IndexSeek),
+              (std::vector<std::string>{"b1.log", "b2.log"}));
+    EXPECT_EQ(names({.since = time(nullptr) - 3600}, plan::Strategy::IndexScan),
+              (std::vector<std::string>{"b1.log", "b2.log", "c1.log"}));
+
+    // removed files are skipped, and invalidate the index
+    fs::remove(dir / "b1.log");
+    EXPECT_EQ(names({.prefix = "b"}, plan::Strategy::IndexSeek), (std::vector<std::string>{"b2.log"}));
+    EXPECT_FALSE(index->fresh(time(nullptr)));
+}
+
+TEST_F(DirPlanTest, test_full_scan_refreshes_index) {
+    auto index = DirIndex::enable(dir.string(), DirIndex::Writers::Hooked);
+    EXPECT_FALSE(index->fresh(time(nullptr)));
+    EXPECT_EQ(names({.prefix = "c"}, plan::Strategy::FullScan), (std::vector<std::string>{"c1.log"}));
+    EXPECT_TRUE(index->fresh(time(nullptr)));
+    EXPECT_EQ(index->size(), 5u + FILLERS);
+    EXPECT_EQ(names({.prefix = "c"}, plan::Strategy::IndexSeek), (std::vector<std::string>{"c1.log"}));
+}
+
+TEST_F(DirPlanTest, test_explain_and_filtered_stream) {
+    auto explained = get("explain=1&prefix=a");
+    EXPECT_TRUE(explained.starts_with(R"({"strategy":"full_scan","entries":0,"index":"none")")) << explained;
+    EXPECT_EQ(CapturingServerOps::capture.header("Content-Type"), "application/json");
+
+    auto body = get("prefix=a");
+    EXPECT_NE(body.find("X-Part-Name: \"a1.log\""), std::string::npos);
+    EXPECT_NE(body.find("X-Part-Name: \"a2.log\""), std::string::npos);
+    EXPECT_EQ(body.find("X-Part-Name: \"b"), std::string::npos);
+
+    DirIndex::enable(dir.string(), DirIndex::Writers::Hooked)->build();
+    explained = get("explain=1&to=a2.log");
+    EXPECT_TRUE(explained.starts_with(R"({"strategy":"index_seek","entries":45,"index":"fresh")")) << explained;
+
+    EXPECT_EQ(get("since=yesterday"), "");
+    EXPECT_EQ(CapturingServerOps::capture.status(), "400 Bad Request");
+}
+
+TEST_F(DirPlanTest, test_unhooked_writers_scan) {
+    auto index = DirIndex::enable(dir.string());
+    ASSERT_FALSE(index->build());
+    EXPECT_TRUE(index->fresh(time(nullptr)));
+    // written without reporting it: only a scan finds it
+    std::ofstream(dir / "b3.log") << "b3";
+    auto found = names({.prefix = "b"}, plan::Strategy::FullScan);
+    std::sort(found.begin(), found.end());
+    EXPECT_EQ(found, (std::vector<std::string>{"b1.log", "b2.log", "b3.log"}));
+    EXPECT_TRUE(get("explain=1&to=a2.log").starts_with(R"({"strategy":"full_scan","entries":46,"index":"none")"));
+    // the scans keep it current for estimates
+    EXPECT_EQ(index->total_size({.prefix = "b3"}), 2u);
+}
+
+TEST_F(DirPlanTest, test_warm_up_serves_covered_ranges) {
+    auto index = DirIndex::enable(dir.string(), DirIndex::Writers::Hooked);
+    int batches = 0;
+    auto err = index->warm_up([&] {
+        batches++;
+        // a1, a2, b1 and b2 are indexed, c1 is next
+        auto progress = index->progress();
+        EXPECT_EQ(progress.listed, 5u + FILLERS);
+        EXPECT_EQ(progress.indexed, 4u);
+        EXPECT_FALSE(progress.complete);
+        EXPECT_FALSE(index->fresh(time(nullptr)));
+
+        EXPECT_EQ(names({.prefix = "b"}, plan::Strategy::IndexSeek), (std::vector<std::string>{"b1.log", "b2.log"}));
+        EXPECT_EQ(names({.to = "b1.log"}, plan::Strategy::IndexSeek),
+                  (std::vector<std::string>{"a1.log", "a2.log", "b1.log"}));
+        EXPECT_TRUE(get("explain=1&prefix=a").starts_with(R"({"strategy":"index_seek","entries":45,"index":"partial")"));
+        // not covered yet
+        EXPECT_FALSE(index->stats({.prefix = "c"}, time(nullptr)).index_fresh);
+        EXPECT_FALSE(index->stats({.from = "a"}, time(nullptr)).index_fresh);
+        return false;
+    }, 4);
+    EXPECT_EQ(batches, 1);
+    EXPECT_EQ(err, ECANCELED);
+    EXPECT_FALSE(index->stats({.prefix = "b"}, time(nullptr)).index_fresh);
+
+    EXPECT_FALSE(index->warm_up(nullptr, 4));
+    EXPECT_TRUE(index->fresh(time(nullptr)));
+    EXPECT_EQ(index->size(), 5u + FILLERS);
+    EXPECT_TRUE(index->progress().complete);
+    EXPECT_EQ(names({.prefix = "d1"}, plan::Strategy::IndexSeek).size(), 10u);
+}
+
+TEST_F(DirPlanTest, test_full_scan_supersedes_warm_up) {
+    auto index = DirIndex::enable(dir.string());
+    int batches = 0;
+    auto err = index->warm_up([&] {
+        // not covered: served by a full scan, which completes the index
+        if (batches++ == 0) {
+            EXPECT_EQ(names({.prefix = "c"}, plan::Strategy::FullScan), (std::vector<std::string>{"c1.log"}));
+        }
+        return true;
+    }, 4);
+    EXPECT_EQ(batches, 1);
+    EXPECT_FALSE(err);
+    EXPECT_TRUE(index->fresh(time(nullptr)));
+    EXPECT_EQ(index->size(), 5u + FILLERS);
+}
+
+TEST_F(DirPlanTest, test_background_warm_up_yields_to_requests) {
+    std::atomic<bool> busy{true};
+    IndexWarmUp warm_up([&] { return busy.load(); }, 1ms);
+    warm_up.add(DirIndex::enable(dir.string()));
+    ASSERT_TRUE(warm_up.start());
+    std::this_thread::sleep_for(20ms);
+    auto progress = warm_up.progress();
+    EXPECT_EQ(progress.indexed, DirIndex::WARM_UP_BATCH);
+    EXPECT_FALSE(progress.complete);
+    EXPECT_FALSE(warm_up.done());
+
+    busy = false;
+    for (int i = 0; i < 500 && !warm_up.done(); i++) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_TRUE(warm_up.done());
+    progress = warm_up.progress();
+    EXPECT_EQ(progress.indexed, 5u + FILLERS);
+    EXPECT_TRUE(progress.complete);
+}
+
+TEST_F(DirPlanTest, test_writer_journal_keeps_index_current) {
+    auto index = DirIndex::enable(dir.string(), DirIndex::Writers::Hooked);
+    ASSERT_FALSE(index->build());
+    auto watch = DirWatch::get(dir.string());
+
+    watch->opened("b3.log");
+    std::ofstream(dir / "b3.log") << "b3";
+    watch->closed("b3.log", 2);
+    fs::remove(dir / "b1.log");
+    watch->removed("b1.log");
+
+    // merged on the next read, without going stale
+    auto selected = index->select({.prefix = "b"}, plan::Strategy::IndexSeek);
+    ASSERT_EQ(selected.size(), 2u);
+    EXPECT_EQ(selected[0].name, "b2.log");
+    EXPECT_EQ(selected[1].name, "b3.log");
+    EXPECT_EQ(selected[1].size, 2u);
+    EXPECT_EQ(names({.prefix = "b"}, plan::Strategy::IndexSeek), (std::vector<std::string>{"b2.log", "b3.log"}));
+    EXPECT_TRUE(index->fresh(time(nullptr)));
+    EXPECT_EQ(index->size(), 5u + FILLERS);
+
+    // longer journals are merged as they fill up
+    for (size_t i = 0; i < 2 * DirIndex::MAX_JOURNAL; i++) {
+        index->upsert({"e" + std::to_string(1000 + i) + ".log", i, time(nullptr)});
+    }
+    EXPECT_EQ(index->size(), 5u + FILLERS + 2 * DirIndex::MAX_JOURNAL);
+    EXPECT_EQ(index->stats({.prefix = "e"}, time(nullptr)).range_entries, 2 * DirIndex::MAX_JOURNAL);
+}
+
+TEST_F(DirPlanTest, test_stale_index_ignores_journal) {
+    auto index = DirIndex::enable(dir.string());
+    index->upsert({"z.log", 1, time(nullptr)});
+    EXPECT_FALSE(index->fresh(time(nullptr)));
+    ASSERT_FALSE(index->build());
+    EXPECT_EQ(index->size(), 5u + FILLERS);
+}
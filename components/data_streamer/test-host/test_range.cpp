@@ -0,0 +1,170 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <fstream>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "range.h"
+#include "capture.h"
+#include "test_config.h"
+
+using namespace data_streamer;
+using namespace data_streamer::capture;
+
+constexpr char TEST_FILE_PATH[] = TEST_RESOURCES_DIR "/test_data_1.txt";
+
+static esp_err_t run_with_range(std::string_view range_header) {
+    CapturingServerOps::begin({}, {{"Range", std::string(range_header)}});
+    auto streamer = DataStreamer<FileChunker<100>, CapturingServerOps>(TEST_FILE_PATH);
+    httpd_req_t req{.user_ctx = &streamer};
+    return DataStreamer<FileChunker<100>, CapturingServerOps>::handler_wrapper(&req);
+}
+
+static std::string read_file(const char *path) {
+    std::ifstream f(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+static std::string status(const Capture &cap) {
+    for (const auto &r: cap.records) {
+        if (r.kind == RecordKind::Status) return r.data;
+    }
+    return {};
+}
+
+TEST(range, test_parse_single_ranges) {
+    std::vector<range::ByteRange> out;
+    ASSERT_EQ(range::parse("bytes=0-9", 100, out), range::RangeResult::Satisfiable);
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_EQ(out[0].first, 0);
+    EXPECT_EQ(out[0].last, 9);
+    EXPECT_EQ(out[0].length(), 10);
+
+    ASSERT_EQ(range::parse("bytes=90-", 100, out), range::RangeResult::Satisfiable);
+    EXPECT_EQ(out[0].first, 90);
+    EXPECT_EQ(out[0].last, 99);
+
+    // last byte position beyond the end is clamped
+    ASSERT_EQ(range::parse("bytes=50-1000", 100, out), range::RangeResult::Satisfiable);
+    EXPECT_EQ(out[0].last, 99);
+
+    // suffix ranges, including larger than the item
+    ASSERT_EQ(range::parse("bytes=-10", 100, out), range::RangeResult::Satisfiable);
+    EXPECT_EQ(out[0].first, 90);
+    EXPECT_EQ(out[0].last, 99);
+    ASSERT_EQ(range::parse("bytes=-500", 100, out), range::RangeResult::Satisfiable);
+    EXPECT_EQ(out[0].first, 0);
+}
+
+TEST(range, test_parse_multiple_ranges) {
+    std::vector<range::ByteRange> out;
+    ASSERT_EQ(range::parse("bytes=0-9, 20-29,200-300", 100, out), range::RangeResult::Satisfiable);
+    ASSERT_EQ(out.size(), 2);  // the unsatisfiable one is dropped
+    EXPECT_EQ(out[1].first, 20);
+
+    std::string many = "bytes=0-0";
+    for (size_t i = 1; i <= range::MAX_RANGES; i++) many += "," + std::to_string(i) + "-" + std::to_string(i);
+    EXPECT_EQ(range::parse(many, 100, out), range::RangeResult::Ignore);
+}
+
+TEST(range, test_parse_unsatisfiable_and_malformed) {
+    std::vector<range::ByteRange> out;
+    EXPECT_EQ(range::parse("bytes=100-", 100, out), range::RangeResult::Unsatisfiable);
+    EXPECT_EQ(range::parse("bytes=-0", 100, out), range::RangeResult::Unsatisfiable);
+    EXPECT_EQ(range::parse("bytes=0-", 0, out), range::RangeResult::Unsatisfiable);
+    EXPECT_TRUE(out.empty());
+
+    for (auto header: {"", "bytes=", "items=0-1", "bytes=5-1", "bytes=a-b", "bytes=1", "bytes=0-1,x"}) {
+        EXPECT_EQ(range::parse(header, 100, out), range::RangeResult::Ignore) << header;
+    }
+}
+
+TEST(range, test_streamer_partial_content) {
+    auto content = read_file(TEST_FILE_PATH);
+    ASSERT_GT(content.size(), 250);
+
+    ASSERT_EQ(run_with_range("bytes=10-249"), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    EXPECT_EQ(status(cap), range::STATUS_206);
+    EXPECT_EQ(cap.header("Content-Range"),
+              "bytes 10-249/" + std::to_string(content.size()));
+    EXPECT_EQ(cap.header("Accept-Ranges"), "bytes");
+    EXPECT_EQ(cap.body(), content.substr(10, 240));
+    EXPECT_EQ(cap.records.back().kind, RecordKind::End);
+
+    ASSERT_EQ(run_with_range("bytes=-7"), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.body(), content.substr(content.size() - 7));
+}
+
+TEST(range, test_coalesce) {
+    std::vector<range::ByteRange> ranges{{5000, 5999}, {0, 99}, {50, 149}, {150, 199}, {1000, 1999}, {2100, 2199}};
+    range::coalesce(ranges, 100);
+    ASSERT_EQ(ranges.size(), 3);
+    EXPECT_EQ(ranges[0].first, 0);  // overlapping and adjacent
+    EXPECT_EQ(ranges[0].last, 199);
+    EXPECT_EQ(ranges[1].first, 1000);  // within the gap
+    EXPECT_EQ(ranges[1].last, 2199);
+    EXPECT_EQ(ranges[2].first, 5000);
+    EXPECT_EQ(ranges[2].last, 5999);
+
+    ranges = {{0, 99}, {20, 30}};  // contained
+    range::coalesce(ranges, 0);
+    ASSERT_EQ(ranges.size(), 1);
+    EXPECT_EQ(ranges[0].last, 99);
+}
+
+TEST(range, test_streamer_multiple_ranges) {
+    auto content = read_file(TEST_FILE_PATH);
+    auto size = content.size();
+    ASSERT_GT(size, 20 + range::COALESCE_GAP);
+    auto last = std::to_string(size - 1);
+
+    // a header, plus the end of the file; the overlapping ranges are merged, and sent in offset order
+    ASSERT_EQ(run_with_range("bytes=-5,0-9,5-14"), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    EXPECT_EQ(status(cap), range::STATUS_206);
+    EXPECT_EQ(cap.header("Content-Type"), std::string("multipart/byteranges; boundary=") + BOUNDARY);
+    EXPECT_FALSE(cap.header("Content-Range"));
+    auto part = [&](size_t first, size_t last) {
+        return std::string("\r\n--") + BOUNDARY + "\r\nContent-Type: application/octet-stream\r\n"
+            + "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(size)
+            + "\r\n\r\n" + content.substr(first, last - first + 1);
+    };
+    EXPECT_EQ(cap.body(), part(0, 14) + part(size - 5, size - 1) + "\r\n--" + BOUNDARY + "--\r\n");
+    EXPECT_EQ(cap.records.back().kind, RecordKind::End);
+
+    // nearby ranges make a single one
+    ASSERT_EQ(run_with_range("bytes=0-1,5-6"), ESP_OK);
+    EXPECT_EQ(status(cap), range::STATUS_206);
+    EXPECT_EQ(cap.header("Content-Range"), "bytes 0-6/" + std::to_string(size));
+    EXPECT_EQ(cap.body(), content.substr(0, 7));
+}
+
+TEST(range, test_streamer_whole_content) {
+    auto content = read_file(TEST_FILE_PATH);
+    ASSERT_EQ(run_with_range("garbage"), ESP_OK);
+    EXPECT_EQ(status(CapturingServerOps::capture), HTTPD_200);
+    EXPECT_EQ(CapturingServerOps::capture.body(), content);
+}
+
+TEST(range, test_streamer_unsatisfiable) {
+    auto content = read_file(TEST_FILE_PATH);
+    ASSERT_EQ(run_with_range("bytes=" + std::to_string(content.size()) + "-"), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    EXPECT_EQ(status(cap), range::STATUS_416);
+    EXPECT_EQ(cap.header("Content-Range"), "bytes */" + std::to_string(content.size()));
+    EXPECT_TRUE(cap.body().empty());
+}
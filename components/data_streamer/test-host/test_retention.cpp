@@ -0,0 +1,142 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "retention.h"
+
+using namespace data_streamer;
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+class RetentionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = fs::temp_directory_path() / "ds_test_retention";
+        fs::remove_all(root);
+        dir = root / "logs";
+        fs::create_directories(dir);
+        // d0.log is the oldest (10 days), d4.log the newest (now)
+        for (int i = 0; i < 5; i++) {
+            write("d" + std::to_string(i) + ".log", std::string(100, 'x'), (4 - i) * 24h * 10 / 4);
+        }
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    void write(const std::string &name, const std::string &content, std::chrono::hours age) {
+        std::ofstream(dir / name, std::ios::binary) << content;
+        fs::last_write_time(dir / name, fs::file_time_type::clock::now() - age);
+    }
+
+    std::vector<std::string> files() const {
+        std::vector<std::string> names;
+        for (auto &entry: fs::directory_iterator(dir)) names.push_back(entry.path().filename().string());
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    fs::path root;
+    fs::path dir;
+};
+
+TEST_F(RetentionTest, test_max_entries_removes_oldest_first) {
+    auto retention = DirRetention(dir.string(), {.max_entries = 3});
+    auto stats = retention.run_once();
+    EXPECT_FALSE(stats.error);
+    EXPECT_EQ(stats.entries, 5u);
+    EXPECT_EQ(stats.bytes, 500u);
+    EXPECT_EQ(stats.removed, 2u);
+    EXPECT_EQ(stats.bytes_removed, 200u);
+    EXPECT_FALSE(stats.budget_exhausted);
+    EXPECT_EQ(files(), (std::vector<std::string>{"d2.log", "d3.log", "d4.log"}));
+}
+
+TEST_F(RetentionTest, test_removals_keep_index_current) {
+    auto index = DirIndex::enable(dir.string());
+    ASSERT_FALSE(index->build());
+    EXPECT_EQ(DirRetention(dir.string(), {.max_entries = 3}).run_once().removed, 2u);
+    EXPECT_TRUE(index->fresh(time(nullptr)));
+    EXPECT_EQ(index->size(), 3u);
+    EXPECT_EQ(index->select({.to = "d2.log"}, plan::Strategy::IndexSeek).size(), 1u);
+    DirIndex::disable(dir.string());
+}
+
+TEST_F(RetentionTest, test_max_bytes_and_max_age) {
+    auto by_size = DirRetention(dir.string(), {.max_bytes = 250});
+    EXPECT_EQ(by_size.run_once().removed, 3u);
+    EXPECT_EQ(files(), (std::vector<std::string>{"d3.log", "d4.log"}));
+
+    // d3.log is 2.5 days old
+    auto by_age = DirRetention(dir.string(), {.max_age = 24 * 3600});
+    EXPECT_EQ(by_age.run_once().removed, 1u);
+    EXPECT_EQ(files(), (std::vector<std::string>{"d4.log"}));
+}
+
+TEST_F(RetentionTest, test_budget_bounds_each_run) {
+    auto retention = DirRetention(dir.string(), {.max_entries = 1, .max_removals_per_run = 2});
+    auto stats = retention.run_once();
+    EXPECT_EQ(stats.removed, 2u);
+    EXPECT_TRUE(stats.budget_exhausted);
+    EXPECT_EQ(files(), (std::vector<std::string>{"d2.log", "d3.log", "d4.log"}));
+    stats = retention.run_once();
+    EXPECT_EQ(stats.removed, 2u);
+    EXPECT_FALSE(stats.budget_exhausted);
+    EXPECT_EQ(files(), (std::vector<std::string>{"d4.log"}));
+}
+
+TEST_F(RetentionTest, test_only_acknowledged_stops_at_cursor) {
+    RetentionPolicy policy{.max_entries = 0, .only_acknowledged = true};
+    // nothing acknowledged yet
+    EXPECT_EQ(DirRetention(dir.string(), policy).run_once().removed, 0u);
+    std::ofstream(DirConsumer::default_cursor_path(dir.string())) << "d1.log";
+    EXPECT_EQ(DirRetention(dir.string(), policy).run_once().removed, 2u);
+    EXPECT_EQ(files(), (std::vector<std::string>{"d2.log", "d3.log", "d4.log"}));
+}
+
+TEST_F(RetentionTest, test_archive_and_busy) {
+    auto archive = root / "archive";
+    bool busy = true;
+    auto retention = DirRetention(dir.string(), {.max_entries = 3, .archive_path = archive.string()},
+                                  [&] { return busy; });
+    auto stats = retention.run_once();
+    EXPECT_TRUE(stats.interrupted);
+    EXPECT_EQ(stats.removed, 0u);
+    EXPECT_EQ(files().size(), 5u);
+
+    busy = false;
+    EXPECT_EQ(retention.run_once().removed, 2u);
+    EXPECT_TRUE(fs::exists(archive / "d0.log"));
+    EXPECT_TRUE(fs::exists(archive / "d1.log"));
+}
+
+TEST_F(RetentionTest, test_background_job) {
+    std::atomic<bool> busy = true;
+    auto job = RetentionJob(1h, 1ms);
+    job.add(DirRetention(dir.string(), {.max_entries = 2, .max_removals_per_run = 1}, [&] { return busy.load(); }));
+    job.start();
+    while (job.runs() < 3) std::this_thread::sleep_for(1ms);
+    EXPECT_EQ(files().size(), 5u);  // interrupted runs are retried without removing anything
+    busy = false;
+    for (int i = 0; i < 1000 && files().size() > 2; i++) std::this_thread::sleep_for(1ms);
+    job.stop();
+    EXPECT_EQ(files(), (std::vector<std::string>{"d3.log", "d4.log"}));
+}
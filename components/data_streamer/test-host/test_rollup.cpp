@@ -0,0 +1,129 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "rollup.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+#pragma pack(push, 1)
+struct Sample {
+    uint32_t ts;
+    float value;
+    int16_t level;
+};
+#pragma pack(pop)
+
+static constexpr summary::RecordLayout LAYOUT{.record_size = sizeof(Sample), .channels = 1};
+static constexpr uint32_t T0 = 1735689600;  // midnight
+
+using Rollups = RollupStreamer<FlatDirIterable<>, CapturingServerOps>;
+
+class RollupTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = fs::temp_directory_path() / "ds_test_rollup";
+        fs::remove_all(root);
+        fs::create_directories(root);
+        dir = (root / "logs").string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    // one record every 10 s for `seconds`
+    static void fill(RecordWriter &writer, uint32_t seconds) {
+        for (uint32_t t = 0; t < seconds; t += 10) {
+            Sample s{T0 + t, static_cast<float>(t % 3600), 0};
+            ASSERT_FALSE(writer.append({reinterpret_cast<const char*>(&s), sizeof(s)}));
+        }
+        ASSERT_FALSE(writer.flush());
+    }
+
+    static std::pair<std::string, std::string> get(Rollups &streamer,
+                                                   std::string_view query) {
+        CapturingServerOps::begin(query);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ(Rollups::handler_wrapper(&req), ESP_OK);
+        return {CapturingServerOps::capture.header(summary::LEVEL_FIELD).value_or(""),
+                CapturingServerOps::capture.body()};
+    }
+
+    fs::path root;
+    std::string dir;
+};
+
+TEST(RollupLevelTest, test_choose_coarsest_exact_level) {
+    std::vector<uint32_t> levels{60, 3600, 86400};
+    EXPECT_EQ(rollup::choose_level(levels, {.bucket_seconds = 7200}), 3600u);
+    EXPECT_EQ(rollup::choose_level(levels, {.bucket_seconds = 86400}), 86400u);
+    EXPECT_EQ(rollup::choose_level(levels, {.bucket_seconds = 86400, .since = 1800}), 60u);
+    EXPECT_EQ(rollup::choose_level(levels, {.bucket_seconds = 90}), std::nullopt);
+    EXPECT_EQ(rollup::choose_level(levels, {.bucket_seconds = 30}), std::nullopt);
+}
+
+TEST_F(RollupTest, test_rollups_match_raw_summaries) {
+    auto writer = RecordWriter(dir, LAYOUT, {60, 3600}, 3 * 3600);
+    fill(writer, 6 * 3600);
+    EXPECT_TRUE(fs::exists(rollup::level_path(dir, 60)));
+    EXPECT_EQ(fs::file_size(rollup::level_path(dir, 3600)), 5 * rollup::entry_size(1));  // last hour is open
+    EXPECT_TRUE(fs::exists(fs::path(dir) / "1735689600.rec"));
+    EXPECT_TRUE(fs::exists(fs::path(dir) / "1735700400.rec"));
+
+    auto streamer = Rollups(writer);
+    auto raw_summary = SummaryStreamer<FlatDirIterable<>, CapturingServerOps>(dir, LAYOUT);
+    for (std::string query: {std::string("bucket=3600"), "bucket=7200&since=" + std::to_string(T0 + 3600),
+                             "bucket=120&since=" + std::to_string(T0 + 600) + "&until=" + std::to_string(T0 + 4800)}) {
+        auto [level, body] = get(streamer, query);
+        EXPECT_NE(level, "raw");
+        CapturingServerOps::begin(query);
+        httpd_req_t req{.user_ctx = &raw_summary};
+        decltype(raw_summary)::handler_wrapper(&req);
+        EXPECT_EQ(body, CapturingServerOps::capture.body()) << query;
+    }
+    EXPECT_EQ(get(streamer, "bucket=3600").first, "3600");
+    EXPECT_EQ(get(streamer, "bucket=120").first, "60");
+}
+
+TEST_F(RollupTest, test_fallback_to_raw_records) {
+    auto writer = RecordWriter(dir, LAYOUT, {60, 3600});
+    fill(writer, 600);
+    auto streamer = Rollups(writer);
+    auto [level, body] = get(streamer, "bucket=30");
+    EXPECT_EQ(level, "raw");
+    std::istringstream lines(body);
+    std::string line;
+    size_t rows = 0;
+    while (std::getline(lines, line)) rows++;
+    EXPECT_EQ(rows, 1u + 20u);
+}
+
+TEST_F(RollupTest, test_late_records_are_not_rolled_up) {
+    auto writer = RecordWriter(dir, LAYOUT, {60});
+    fill(writer, 300);
+    Sample late{T0 + 5, 0, 0};
+    EXPECT_FALSE(writer.append({reinterpret_cast<const char*>(&late), sizeof(late)}));
+    EXPECT_EQ(writer.late(), 1u);
+    EXPECT_EQ(writer.append(std::span<const char>("short", 5)), EINVAL);
+}
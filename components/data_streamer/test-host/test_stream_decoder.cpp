@@ -0,0 +1,268 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "stream_decoder.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using namespace data_streamer::decoder;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+struct CollectingHandler {
+    std::map<std::string, std::string> parts;
+    std::string current;
+    bool open{false};
+    bool ended{false};
+    size_t begins{0};
+
+    void on_part_begin(std::string_view name) {
+        EXPECT_FALSE(open);
+        current = std::string(name);
+        parts[current];
+        open = true;
+        begins++;
+    }
+    void on_part_data(std::span<const char> data) {
+        EXPECT_TRUE(open);
+        parts[current].append(data.data(), data.size());
+    }
+    void on_part_end() {
+        EXPECT_TRUE(open);
+        open = false;
+    }
+    void on_stream_end(std::string_view) { ended = true; }
+};
+
+struct NullHandler {
+    size_t bytes{0};
+    void on_part_begin(std::string_view) {}
+    void on_part_data(std::span<const char> data) { bytes += data.size(); }
+    void on_part_end() {}
+};
+
+class StreamDecoderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_decoder";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        std::mt19937 rng(42);
+        // sizes around chunk and tar block boundaries, plus content resembling the delimiter
+        for (size_t size: {0UL, 1UL, 511UL, 512UL, 513UL, CHUNK_SIZE, 3 * CHUNK_SIZE + 17}) {
+            std::string content(size, '\0');
+            for (auto &c: content) c = static_cast<char>(rng());
+            write("file_" + std::to_string(size) + ".bin", content);
+        }
+        write("tricky.txt", std::string("\r\n--") + std::string(BOUNDARY).substr(0, 10) + "\r\n--\r\n");
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    void write(const std::string &name, const std::string &content) {
+        std::ofstream(dir / name, std::ios::binary) << content;
+        expected[name] = content;
+    }
+
+    std::string capture(std::string_view format) {
+        CapturingServerOps::begin(std::string("format=") + std::string(format));
+        auto streamer = DataStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string());
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ((DataStreamer<FlatDirIterable<>, CapturingServerOps>::handler_wrapper(&req)), ESP_OK);
+        return CapturingServerOps::capture.body();
+    }
+
+    template<typename D>
+    void decode_in_pieces(D &dec, const std::string &body, size_t piece) {
+        for (size_t i = 0; i < body.size(); i += piece) {
+            ASSERT_TRUE(dec.feed(std::span<const char>(body).subspan(i, std::min(piece, body.size() - i))))
+                << "error " << dec.error().value_or(0) << " at " << i;
+        }
+        EXPECT_TRUE(dec.finish());
+    }
+
+    fs::path dir;
+    std::map<std::string, std::string> expected;
+};
+
+TEST_F(StreamDecoderTest, test_boundary_finder) {
+    auto finder = BoundaryFinder("abcab");
+    std::string hay = "xxabcaxabcabyy";
+    EXPECT_EQ(finder.find(hay), 7);
+    EXPECT_EQ(finder.find(std::string_view("abca")), BoundaryFinder::npos);
+    EXPECT_EQ(finder.find(std::string_view("abcab")), 0);
+}
+
+TEST_F(StreamDecoderTest, test_multipart_roundtrip) {
+    auto body = capture("multipart");
+    for (size_t piece: {1UL, 7UL, 64UL, 1000UL, 4096UL, body.size()}) {
+        CollectingHandler h;
+        auto dec = MultipartDecoder<CollectingHandler>(BOUNDARY, h);
+        decode_in_pieces(dec, body, piece);
+        EXPECT_TRUE(h.ended);
+        EXPECT_EQ(h.parts, expected) << "piece size " << piece;
+    }
+}
+
+TEST_F(StreamDecoderTest, test_multipart_trailer) {
+    struct TrailerHandler : NullHandler {
+        std::optional<std::string> trailer;
+        void on_stream_end(std::string_view t) { trailer = std::string(t); }
+    };
+    const std::string close = std::string("\r\n--") + BOUNDARY + "--\r\n";
+    const std::string part = std::string("\r\n--") + BOUNDARY + "\r\nX-Part-Name: \"a\"\r\n\r\nxyz";
+    const std::map<std::string, std::string> cases = {
+        {part + close + "X-Commit-Token: 42\r\nX-Other: 1\r\n\r\nignored", "X-Commit-Token: 42\r\nX-Other: 1\r\n"},
+        {part + close, ""},                                    // no trailer
+        {part + close + "X-Commit-Token: 42\r\n", "X-Commit-Token: 42\r\n"},  // unterminated trailer
+        {part + close + "plain epilogue\r\n", ""},
+    };
+    for (const auto &[body, trailer]: cases) {
+        for (size_t piece: {1UL, 5UL, body.size()}) {
+            TrailerHandler h;
+            auto dec = MultipartDecoder<TrailerHandler>(BOUNDARY, h);
+            decode_in_pieces(dec, body, piece);
+            EXPECT_EQ(h.bytes, 3);
+            EXPECT_EQ(h.trailer, trailer) << "piece size " << piece;
+        }
+    }
+}
+
+TEST_F(StreamDecoderTest, test_tar_roundtrip) {
+    auto body = capture("tar");
+    EXPECT_EQ(body.size() % tar::BLOCK_SIZE, 0);
+    for (size_t piece: {1UL, 100UL, 512UL, 5000UL, body.size()}) {
+        CollectingHandler h;
+        auto dec = TarDecoder<CollectingHandler>(h);
+        decode_in_pieces(dec, body, piece);
+        EXPECT_TRUE(h.ended);
+        EXPECT_EQ(h.parts, expected) << "piece size " << piece;
+    }
+}
+
+TEST_F(StreamDecoderTest, test_tar_mtime) {
+    auto body = capture("tar");
+    ASSERT_GE(body.size(), tar::BLOCK_SIZE);
+    struct stat st{};
+    ASSERT_EQ(stat((dir / body.c_str()).c_str(), &st), 0);  // the name of the first member
+    EXPECT_GT(st.st_mtime, 0);
+    EXPECT_EQ(std::stoll(body.substr(136, 11), nullptr, 8), static_cast<long long>(st.st_mtime));
+}
+
+TEST_F(StreamDecoderTest, test_framed_roundtrip) {
+    auto body = capture("framed");
+    for (size_t piece: {1UL, 3UL, 333UL, body.size()}) {
+        CollectingHandler h;
+        auto dec = FramedDecoder<CollectingHandler>(h);
+        decode_in_pieces(dec, body, piece);
+        EXPECT_TRUE(h.ended);
+        EXPECT_EQ(h.parts, expected) << "piece size " << piece;
+    }
+}
+
+TEST_F(StreamDecoderTest, test_resumed_part) {
+    struct ResumeHandler : CollectingHandler {
+        std::map<std::string, uint64_t> offsets;
+        void on_part_offset(uint64_t offset) { offsets[current] = offset; }
+    };
+    const std::string name = "file_" + std::to_string(3 * CHUNK_SIZE + 17) + ".bin";
+    for (auto format: {"multipart", "framed"}) {
+        auto body = capture(std::string(format) + "&from=" + name + "&offset=1000");
+        ResumeHandler h;
+        if (std::string_view(format) == "multipart") {
+            auto dec = MultipartDecoder<ResumeHandler>(BOUNDARY, h);
+            decode_in_pieces(dec, body, 7);
+        } else {
+            auto dec = FramedDecoder<ResumeHandler>(h);
+            decode_in_pieces(dec, body, 7);
+        }
+        EXPECT_EQ(h.offsets, (std::map<std::string, uint64_t>{{name, 1000}})) << format;
+        EXPECT_EQ(h.parts[name], expected[name].substr(1000)) << format;
+        EXPECT_EQ(h.parts["tricky.txt"], expected["tricky.txt"]) << format;
+        EXPECT_FALSE(h.parts.contains("file_0.bin")) << format;
+    }
+
+    // resuming past the end sends an empty part at the end of the item
+    auto body = capture("framed&from=" + name + "&offset=99999");
+    ResumeHandler h;
+    auto dec = FramedDecoder<ResumeHandler>(h);
+    decode_in_pieces(dec, body, body.size());
+    EXPECT_EQ(h.offsets[name], expected[name].size());
+    EXPECT_EQ(h.parts[name], "");
+
+    // an offset needs the name of the item to resume
+    EXPECT_EQ(capture("multipart&offset=10"), "");
+}
+
+TEST_F(StreamDecoderTest, test_unknown_format_rejected) {
+    CapturingServerOps::begin("format=zip");
+    auto streamer = DataStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string());
+    httpd_req_t req{.user_ctx = &streamer};
+    EXPECT_EQ((DataStreamer<FlatDirIterable<>, CapturingServerOps>::handler_wrapper(&req)), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.chunk_count(), 0);
+}
+
+TEST_F(StreamDecoderTest, test_truncated_stream) {
+    auto body = capture("framed");
+    CollectingHandler h;
+    auto dec = FramedDecoder<CollectingHandler>(h);
+    EXPECT_TRUE(dec.feed(std::span<const char>(body).first(body.size() / 2)));
+    EXPECT_FALSE(dec.finish());
+    EXPECT_EQ(dec.error(), ENODATA);
+}
+
+TEST_F(StreamDecoderTest, test_oversized_header_line) {
+    CollectingHandler h;
+    auto dec = MultipartDecoder<CollectingHandler>("b", h);
+    std::string body = "--b\r\nX-Part-Name: " + std::string(5000, 'a');
+    EXPECT_FALSE(dec.feed(body));
+    EXPECT_EQ(dec.error(), EMSGSIZE);
+}
+
+TEST_F(StreamDecoderTest, test_corrupted_input_is_safe) {
+    // Mutated and random inputs must never crash or over-read; they either decode or fail cleanly
+    std::mt19937 rng(7);
+    for (auto format: {"multipart", "tar", "framed"}) {
+        auto body = capture(format);
+        for (int round = 0; round < 200; round++) {
+            auto mutated = body;
+            for (int i = 0; i < 1 + round % 16; i++) {
+                mutated[rng() % mutated.size()] = static_cast<char>(rng());
+            }
+            mutated.resize(rng() % (mutated.size() + 1));
+            NullHandler h;
+            auto mp = MultipartDecoder<NullHandler>(BOUNDARY, h);
+            auto td = TarDecoder<NullHandler>(h);
+            auto fd = FramedDecoder<NullHandler>(h);
+            size_t piece = 1 + rng() % 2048;
+            for (size_t i = 0; i < mutated.size(); i += piece) {
+                auto in = std::span<const char>(mutated).subspan(i, std::min(piece, mutated.size() - i));
+                mp.feed(in);
+                td.feed(in);
+                fd.feed(in);
+            }
+        }
+    }
+}
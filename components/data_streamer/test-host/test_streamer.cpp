@@ -17,6 +17,7 @@
 #include "config.h"
 #include "gtest/gtest.h"
 #include "streamer.h"
+#include "server_ops.h"
 #include "esp_http_server.h"
 #include "esp_err.h"
 
@@ -150,6 +151,7 @@ struct MockHttpServerOps {
     MOCK_STATIC_RETURN(register_uri_handler, (httpd_handle_t server, const httpd_uri_t* uri_desc))
     MOCK_STATIC_RETURN(unregister_uri_handler, (httpd_handle_t server, const char* uri, http_method method))
     MOCK_STATIC_RETURN(resp_sendstr_chunk, (httpd_req_t* req, const char* chunk))
+    MOCK_STATIC_RETURN(resp_send, (httpd_req_t* req, const char* buf, ssize_t size))
     MOCK_STATIC_RETURN(resp_send_chunk, (httpd_req_t* req, const char* chunk, ssize_t size))
     MOCK_STATIC_RETURN(resp_send_err, (httpd_req_t* req, httpd_err_code_t error, const char* msg))
     MOCK_STATIC_RETURN(resp_set_type, (httpd_req_t* req, const char* type))
@@ -158,8 +160,24 @@ struct MockHttpServerOps {
     MOCK_STATIC_RETURN(req_get_url_query_str, (httpd_req_t *r, char *buf, size_t buf_len))
     MOCK_STATIC_RETURN(query_key_value, (const char *qry, const char *key, char *val, size_t val_size))
 
+    MOCK_STATIC_RETURN(req_get_hdr_value_str, (httpd_req_t *r, const char *field, char *val, size_t val_size))
+    MOCK_STATIC_RETURN(req_async_handler_begin, (httpd_req_t *r, httpd_req_t **out))
+    MOCK_STATIC_RETURN(req_async_handler_complete, (httpd_req_t *r))
+
+    static esp_err_t resp_send_chunkv(httpd_req_t *req, std::span<const std::span<const char>> parts) {
+        return resp_send_chunk_ret;
+    }
+
+    static esp_err_t send_raw(httpd_req_t *req, const char *buf, size_t len) {
+        return resp_send_chunk_ret;
+    }
+
     static inline size_t req_get_url_query_len_ret = 0;
     static size_t req_get_url_query_len(httpd_req_t *r) { return req_get_url_query_len_ret; }
+    static inline size_t req_get_hdr_value_len_ret = 0;
+    static size_t req_get_hdr_value_len(httpd_req_t *r, const char *field) { return req_get_hdr_value_len_ret; }
+    static inline int req_recv_ret = 0;
+    static int req_recv(httpd_req_t *r, char *buf, size_t buf_len) { return req_recv_ret; }
 
     static void reset() {
         register_uri_handler_ret = ESP_OK;
@@ -236,3 +254,21 @@ TEST_F(StreamerTest, test_handler_wrapper_iterable_of_chunkables){
     EXPECT_EQ(ChunkableIterDataStreamer::handler_wrapper(&req), ESP_FAIL);
 }
 
+TEST(EspServerOpsTest, test_send_chunkv_one_chunk) {
+    // headers and a payload larger than the stack buffer: one chunk, in order; empty parts send nothing
+    std::string large(EspHttpServerOps::GATHER_BUFFER_SIZE + 1, 'x');
+    const std::array<std::span<const char>, 5> parts{
+        std::span<const char>("ab", 2), std::span<const char>(), std::span<const char>(large),
+        std::span<const char>("cd", 2), std::span<const char>("ef", 2)};
+    httpd_req_t req{};
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(EspHttpServerOps::resp_send_chunkv(&req, parts), ESP_OK);
+    EXPECT_EQ(EspHttpServerOps::resp_send_chunkv(&req, std::span(parts).first(2).subspan(1)), ESP_OK);
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "207\r\nab" + large + "cdef\r\n");
+
+    // small parts, and a single part sent in place
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(EspHttpServerOps::resp_send_chunkv(&req, std::span(parts).last(2)), ESP_OK);
+    EXPECT_EQ(EspHttpServerOps::resp_send_chunkv(&req, std::span(parts).subspan(1, 2)), ESP_OK);
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "4\r\ncdef\r\n201\r\n" + large + "\r\n");
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "summary.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using namespace data_streamer::summary;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+#pragma pack(push, 1)
+struct Sample {
+    uint32_t ts;
+    float temperature;
+    int32_t unused;
+    float humidity;
+};
+#pragma pack(pop)
+
+static constexpr RecordLayout LAYOUT{.record_size = sizeof(Sample), .channels = 3};
+
+static std::vector<std::vector<std::string>> parse_csv(const std::string &body) {
+    std::vector<std::vector<std::string>> rows;
+    std::istringstream in(body);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> row;
+        std::istringstream fields(line);
+        std::string field;
+        while (std::getline(fields, field, ',')) row.push_back(field);
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+class SummaryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_summary";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        // two files of one record per second over 3 minutes each, temperature = second of the minute
+        for (int f = 0; f < 2; f++) {
+            std::ofstream out(dir / ("log" + std::to_string(f) + ".bin"), std::ios::binary);
+            for (uint32_t t = 0; t < 180; t++) {
+                uint32_t ts = 600 + f * 180 + t;
+                Sample s{ts, static_cast<float>(ts % 60), 0, static_cast<float>(f)};
+                out.write(reinterpret_cast<const char*>(&s), sizeof(s));
+            }
+        }
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    std::string get(std::string_view query) {
+        auto streamer = SummaryStreamer<FlatDirIterable<>, CapturingServerOps>(dir.string(), LAYOUT);
+        CapturingServerOps::begin(query);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ(decltype(streamer)::handler_wrapper(&req), ESP_OK);
+        return CapturingServerOps::capture.body();
+    }
+
+    fs::path dir;
+};
+
+TEST(SummaryAggregatorTest, test_records_split_across_pieces) {
+    std::vector<Bucket> buckets;
+    auto aggregator = Aggregator(LAYOUT, {.bucket_seconds = 10, .channels = {0}},
+                                 [&](const Bucket &b) { buckets.push_back(b); return true; });
+    std::string data;
+    for (uint32_t t = 0; t < 25; t++) {
+        Sample s{t, static_cast<float>(t), 0, 0};
+        data.append(reinterpret_cast<const char*>(&s), sizeof(s));
+    }
+    for (size_t i = 0; i < data.size(); i += 7) aggregator.feed(std::string_view(data).substr(i, 7));
+    aggregator.feed(std::string_view(data).substr(0, 5));  // partial record, dropped
+    EXPECT_TRUE(aggregator.finish());
+    EXPECT_EQ(aggregator.records(), 25u);
+    EXPECT_EQ(aggregator.dropped(), 5u);
+    ASSERT_EQ(buckets.size(), 3u);
+    EXPECT_EQ(buckets[1].start, 10);
+    EXPECT_EQ(buckets[1].count, 10u);
+    EXPECT_EQ(buckets[1].min[0], 10);
+    EXPECT_EQ(buckets[1].max[0], 19);
+    EXPECT_EQ(buckets[1].sum[0], 145);
+    EXPECT_EQ(buckets[2].count, 5u);
+}
+
+TEST_F(SummaryTest, test_per_minute_summary) {
+    auto rows = parse_csv(get("bucket=60"));
+    ASSERT_EQ(rows.size(), 7u);  // header and 6 minutes
+    EXPECT_EQ(rows[0], (std::vector<std::string>{"start", "count", "min0", "max0", "mean0", "min1", "max1", "mean1",
+                                                 "min2", "max2", "mean2"}));
+    EXPECT_EQ(rows[1][0], "600");
+    EXPECT_EQ(rows[1][1], "60");
+    EXPECT_EQ(rows[1][2], "0");
+    EXPECT_EQ(rows[1][3], "59");
+    EXPECT_EQ(rows[1][4], "29.5");
+    EXPECT_EQ(rows[6][0], "900");
+    EXPECT_EQ(rows[6][10], "1");  // humidity of the second file
+}
+
+TEST_F(SummaryTest, test_filters_and_channels) {
+    auto rows = parse_csv(get("bucket=120&channels=2&since=630&until=840&from=log0.bin&to=log0.bin"));
+    ASSERT_EQ(rows.size(), 3u);
+    EXPECT_EQ(rows[0], (std::vector<std::string>{"start", "count", "min2", "max2", "mean2"}));
+    EXPECT_EQ(rows[1][0], "600");
+    EXPECT_EQ(rows[1][1], "90");   // 630..719
+    EXPECT_EQ(rows[2][0], "720");
+    EXPECT_EQ(rows[2][1], "60");   // 720..779, the rest is in log1.bin
+}
+
+TEST_F(SummaryTest, test_invalid_query) {
+    EXPECT_TRUE(get("channels=3").empty());
+    EXPECT_TRUE(get("bucket=0").empty());
+    EXPECT_TRUE(get("since=abc").empty());
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "stream_decoder.h"
+#include "timing.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+using capture::RecordKind;
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+// Gets the duration of a phase in a Server-Timing value, in ms (-1 if absent)
+static double duration_of(std::string_view value, std::string_view phase) {
+    auto pos = value.find(std::string(phase) + ";dur=");
+    if (pos == std::string_view::npos) return -1;
+    return strtod(std::string(value.substr(pos + phase.size() + 5)).c_str(), nullptr);
+}
+
+// Capturing server operations whose sends take a while, as if the client read slowly
+struct SlowServerOps: CapturingServerOps {
+    static esp_err_t resp_send_chunk(httpd_req_t* req, const char* chunk, ssize_t size) {
+        std::this_thread::sleep_for(5ms);
+        return CapturingServerOps::resp_send_chunk(req, chunk, size);
+    }
+    static esp_err_t resp_send_chunkv(httpd_req_t* req, std::span<const std::span<const char>> parts) {
+        std::this_thread::sleep_for(5ms);
+        return CapturingServerOps::resp_send_chunkv(req, parts);
+    }
+};
+
+struct TimingTrailerHandler {
+    std::optional<std::string> trailer;
+    void on_part_begin(std::string_view) {}
+    void on_part_data(std::span<const char>) {}
+    void on_part_end() {}
+    void on_stream_end(std::string_view t) { trailer = std::string(t); }
+};
+
+TEST(TimingTest, test_timings) {
+    timing::Timings t;
+    t.add(timing::Read, 3ms);
+    t.add_send(1ms);
+    t.add_send(timing::BLOCKED_AFTER + 4ms);
+    EXPECT_EQ(t.spent[timing::Read], 3ms);
+    EXPECT_EQ(t.spent[timing::Send], 1ms + timing::BLOCKED_AFTER);
+    EXPECT_EQ(t.spent[timing::Blocked], 4ms);
+    EXPECT_EQ(t.count[timing::Send], 2);
+    EXPECT_EQ(t.count[timing::Blocked], 1);
+    EXPECT_TRUE(t.sending);
+    auto header = t.to_header(t.started + 10ms);
+    EXPECT_TRUE(header.starts_with("scan;dur=0.000, open;dur=0.000, read;dur=3.000, "));
+    EXPECT_TRUE(header.ends_with("blocked;dur=4.000, total;dur=10.000"));
+
+    // spans only count with a recorder
+    { timing::Span span(timing::Open); }
+    timing::Timings recorded;
+    {
+        timing::Recorder recorder(recorded);
+        timing::Span span(timing::Open);
+    }
+    EXPECT_EQ(recorded.count[timing::Open], 1);
+    EXPECT_EQ(timing::Recorder::active(), nullptr);
+}
+
+class TimingStreamerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_timing";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        for (int i = 0; i < 3; i++) {
+            std::ofstream(dir / ("f" + std::to_string(i) + ".bin"), std::ios::binary) << std::string(3000, 'a' + i);
+        }
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    template<typename T, typename Ops = CapturingServerOps>
+    void stream(const std::string &path, std::string_view query = {}, bool enabled = true) {
+        CapturingServerOps::begin(query);
+        auto streamer = DataStreamer<T, Ops>(path);
+        streamer.set_server_timing(enabled);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ((DataStreamer<T, Ops>::handler_wrapper(&req)), ESP_OK);
+    }
+
+    fs::path dir;
+};
+
+TEST_F(TimingStreamerTest, test_file_trailer) {
+    stream<FileChunker<1024>>((dir / "f0.bin").string());
+    const auto &cap = CapturingServerOps::capture;
+    EXPECT_EQ(cap.header("Trailer"), "Server-Timing");
+    EXPECT_EQ(cap.body(), std::string(3000, 'a'));
+    ASSERT_EQ(cap.records.back().kind, RecordKind::End);
+    const auto &trailer = cap.records.back().data;
+    EXPECT_TRUE(trailer.starts_with("Server-Timing: scan;dur=")) << trailer;
+    EXPECT_TRUE(trailer.ends_with("\r\n"));
+    for (auto phase: {"scan", "open", "read", "send", "blocked", "total"}) {
+        EXPECT_GE(duration_of(trailer, phase), 0) << phase;
+    }
+
+    // disabled: plain last chunk
+    stream<FileChunker<1024>>((dir / "f0.bin").string(), {}, false);
+    EXPECT_FALSE(cap.header("Trailer"));
+    EXPECT_EQ(cap.records.back().data, "");
+}
+
+TEST_F(TimingStreamerTest, test_collection_trailer) {
+    for (auto format: {"multipart", "framed"}) {
+        SCOPED_TRACE(format);
+        stream<FlatDirIterable<1024>>(dir.string(), std::string("format=") + format);
+        const auto &cap = CapturingServerOps::capture;
+        EXPECT_FALSE(cap.header("Trailer"));
+        EXPECT_EQ(cap.records.back().data, "");  // reported in the stream trailer instead
+        TimingTrailerHandler h;
+        auto body = cap.body();
+        bool ok;
+        if (std::string_view(format) == "multipart") {
+            auto dec = decoder::MultipartDecoder<TimingTrailerHandler>(BOUNDARY, h);
+            ok = dec.feed(body) && dec.finish();
+        } else {
+            auto dec = decoder::FramedDecoder<TimingTrailerHandler>(h);
+            ok = dec.feed(body) && dec.finish();
+        }
+        ASSERT_TRUE(ok);
+        ASSERT_TRUE(h.trailer);
+        EXPECT_TRUE(h.trailer->starts_with("Server-Timing: ")) << *h.trailer;
+        EXPECT_GE(duration_of(*h.trailer, "scan"), 0);
+    }
+
+    // no stream trailer in tar: HTTP trailer
+    stream<FlatDirIterable<1024>>(dir.string(), "format=tar");
+    EXPECT_EQ(CapturingServerOps::capture.header("Trailer"), "Server-Timing");
+    EXPECT_TRUE(CapturingServerOps::capture.records.back().data.starts_with("Server-Timing: "));
+}
+
+TEST_F(TimingStreamerTest, test_blocked_sends) {
+    stream<FileChunker<1024>, SlowServerOps>((dir / "f0.bin").string());
+    const auto &trailer = CapturingServerOps::capture.records.back().data;
+    // 3 chunks of 5 ms, of which all but BLOCKED_AFTER are blocked
+    auto blocked_after = std::chrono::duration<double, std::milli>(timing::BLOCKED_AFTER).count();
+    EXPECT_GE(duration_of(trailer, "blocked"), 3 * (5 - blocked_after)) << trailer;
+    EXPECT_LE(duration_of(trailer, "send"), 3 * blocked_after + 0.001) << trailer;
+    EXPECT_GE(duration_of(trailer, "total"), 15) << trailer;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "tls.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+// Counts the TLS records of a response, as sent by mbedTLS under ESP's HTTP server: each write to the
+// connection makes ceil(n / max_fragment) records, and each chunk sent by resp_send_chunk takes three writes.
+struct RecordModel {
+    size_t max_fragment{4096};
+    size_t record_overhead{29};  // TLS 1.2 AES-GCM: header, explicit nonce, tag
+    size_t records{0};
+    size_t wire_bytes{0};
+
+    void write(size_t n) {
+        size_t r = (n + max_fragment - 1) / max_fragment;
+        records += r;
+        wire_bytes += n + r * record_overhead;
+    }
+};
+
+struct RecordCountingServerOps: CapturingServerOps {
+    static inline RecordModel model;
+
+    static esp_err_t resp_send_chunk(httpd_req_t* req, const char* chunk, ssize_t size) {
+        size_t n = chunk == nullptr ? 0 : size == HTTPD_RESP_USE_STRLEN ? strlen(chunk) : size;
+        if (n == 0) {
+            model.write(5);  // "0\r\n\r\n"
+        } else {
+            model.write(tls::hex_digits(n) + 2);
+            model.write(n);
+            model.write(2);
+        }
+        return CapturingServerOps::resp_send_chunk(req, chunk, size);
+    }
+    static esp_err_t resp_send_chunkv(httpd_req_t* req, std::span<const std::span<const char>> parts) {
+        size_t n = 0;
+        for (auto part: parts) n += part.size();
+        if (n > 0) {
+            model.write(tls::hex_digits(n) + 2);
+            model.write(n);
+            model.write(2);
+        }
+        return CapturingServerOps::resp_send_chunkv(req, parts);
+    }
+    static esp_err_t send_raw(httpd_req_t* req, const char* buf, size_t len) {
+        model.write(len);
+        return CapturingServerOps::send_raw(req, buf, len);
+    }
+};
+
+TEST(TlsTest, test_chunk_payload) {
+    EXPECT_EQ(tls::hex_digits(0xfff), 3);
+    EXPECT_EQ(tls::hex_digits(0x1000), 4);
+    // "0ff8\r\n" + 4088 bytes + "\r\n"
+    EXPECT_EQ(tls::chunk_payload(4096), 4088);
+    EXPECT_EQ(tls::chunk_payload(16384), 16376);
+}
+
+TEST(TlsTest, test_packer_frames) {
+    CapturingServerOps::begin();
+    httpd_req_t req{};
+    tls::ChunkPacker<CapturingServerOps> packer(&req, 256);
+    auto capacity = tls::chunk_payload(256);
+    std::string data(3 * capacity + 10, 'x');
+    for (size_t i = 0; i < data.size(); i++) data[i] = static_cast<char>('a' + i % 26);
+    // written in odd pieces, sent in full chunks
+    for (size_t i = 0; i < data.size(); i += 7) {
+        ASSERT_EQ(packer.write(std::span<const char>(data).subspan(i, std::min<size_t>(7, data.size() - i))), ESP_OK);
+    }
+    ASSERT_EQ(packer.flush(), ESP_OK);
+    const auto &cap = CapturingServerOps::capture;
+    ASSERT_EQ(cap.chunk_count(), 4);
+    EXPECT_EQ(cap.records[0].data.size(), capacity);
+    EXPECT_EQ(cap.records[3].data.size(), 10);
+    EXPECT_EQ(cap.body(), data);
+
+    // disabled: sent as written
+    CapturingServerOps::begin();
+    tls::ChunkPacker<CapturingServerOps> passthrough(&req, 0);
+    ASSERT_EQ(passthrough.write(std::span<const char>(data).first(100)), ESP_OK);
+    ASSERT_EQ(passthrough.flush(), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.chunk_count(), 1);
+}
+
+class TlsRecordsTest : public ::testing::Test {
+protected:
+    static constexpr size_t SIZE = 1 << 20;
+
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_tls";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        content.resize(SIZE);
+        std::mt19937 rng(1);
+        for (auto &c: content) c = static_cast<char>(rng());
+        std::ofstream(dir / "data.bin", std::ios::binary) << content;
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    // streams the file (4096-byte chunks), and gets the model of the records sent
+    template<typename T>
+    RecordModel stream(const std::string &path, size_t record_size, std::string_view query = {}) {
+        RecordCountingServerOps::model = {.max_fragment = 4096};
+        CapturingServerOps::begin(query);
+        auto streamer = DataStreamer<T, RecordCountingServerOps>(path);
+        streamer.set_record_size(record_size);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ((DataStreamer<T, RecordCountingServerOps>::handler_wrapper(&req)), ESP_OK);
+        return RecordCountingServerOps::model;
+    }
+
+    fs::path dir;
+    std::string content;
+};
+
+TEST_F(TlsRecordsTest, test_records_per_mb) {
+    auto path = (dir / "data.bin").string();
+    auto plain = stream<FileChunker<4096>>(path, 0);
+    EXPECT_EQ(CapturingServerOps::capture.body(), content);
+    auto sized = stream<FileChunker<4096>>(path, 4096);
+    EXPECT_EQ(CapturingServerOps::capture.body(), content);
+
+    // 3 records per chunk, vs full records
+    EXPECT_EQ(plain.records, 3 * SIZE / 4096 + 1);
+    EXPECT_LE(sized.records, SIZE / tls::chunk_payload(4096) + 4);
+    auto overhead = [](const RecordModel &m) { return m.wire_bytes - SIZE; };
+    EXPECT_LT(2 * overhead(sized), overhead(plain));
+    printf("records/MB: %zu -> %zu, overhead bytes: %zu -> %zu\n",
+           plain.records, sized.records, overhead(plain), overhead(sized));
+}
+
+TEST_F(TlsRecordsTest, test_framed_records) {
+    auto plain = stream<FlatDirIterable<4096>>(dir.string(), 0, "format=framed");
+    auto body = CapturingServerOps::capture.body();
+    auto sized = stream<FlatDirIterable<4096>>(dir.string(), 4096, "format=framed");
+    EXPECT_EQ(CapturingServerOps::capture.body(), body);
+    EXPECT_LT(2 * sized.records, plain.records);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+using FileUploader = DataUploader<FileSink, CapturingServerOps>;
+
+/**
+ * Sink recording write sizes in memory, optionally failing after some writes
+ */
+struct RecordingSink {
+    static inline std::string data{};
+    static inline std::vector<size_t> writes{};
+    static inline std::optional<size_t> fail_after{};
+    static inline bool committed{false};
+
+    static void reset() {
+        data.clear();
+        writes.clear();
+        fail_after.reset();
+        committed = false;
+    }
+
+    explicit RecordingSink(std::string_view) {}
+    size_t received() { return data.size(); }
+    bool open(size_t offset) { data.resize(offset); return true; }
+    size_t block_size() { return 512; }
+    bool write(std::span<const char> chunk) {
+        if (fail_after && writes.size() >= *fail_after) return false;
+        writes.push_back(chunk.size());
+        data.append(chunk.data(), chunk.size());
+        return true;
+    }
+    bool commit() { committed = true; return true; }
+    std::optional<int> error() { return std::nullopt; }
+};
+
+using RecordingUploader = DataUploader<RecordingSink, CapturingServerOps>;
+
+class UploadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = fs::temp_directory_path() / "ds_test_upload";
+        fs::remove_all(root);
+        fs::create_directories(root);
+        target = root / "table.bin";
+        std::mt19937 rng(42);
+        content.resize(10000);
+        for (auto &c: content) c = static_cast<char>(rng());
+        CapturingServerOps::recv_size = 1000;
+        RecordingSink::reset();
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+        CapturingServerOps::recv_size = 1460;
+    }
+
+    template<typename U>
+    esp_err_t put(U &uploader, std::string_view body, std::string_view query = {},
+                  std::optional<size_t> fail_at = std::nullopt) {
+        CapturingServerOps::begin_upload(body, query, fail_at);
+        httpd_req_t req{.content_len = body.size(), .user_ctx = &uploader};
+        return U::handler_wrapper(&req);
+    }
+
+    static std::string status() {
+        for (const auto &r: CapturingServerOps::capture.records) {
+            if (r.kind == capture::RecordKind::Status) return r.data;
+        }
+        return {};
+    }
+
+    static std::string read(const fs::path &path) {
+        std::ifstream in(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(in), {}};
+    }
+
+    fs::path root;
+    fs::path target;
+    std::string content;
+};
+
+TEST_F(UploadTest, test_upload_is_published_when_complete) {
+    std::ofstream(target) << "old content";
+    auto uploader = FileUploader(target.string());
+    EXPECT_EQ(put(uploader, content), ESP_OK);
+    EXPECT_EQ(status(), HTTPD_201);
+    EXPECT_EQ(CapturingServerOps::capture.header(upload::OFFSET_FIELD), "10000");
+    EXPECT_EQ(read(target), content);
+    EXPECT_FALSE(fs::exists(root / "table.bin.part"));
+}
+
+TEST_F(UploadTest, test_resume_after_broken_connection) {
+    std::ofstream(target) << "old content";
+    auto uploader = FileUploader(target.string());
+    EXPECT_EQ(put(uploader, content, {}, 4321), ESP_FAIL);
+    EXPECT_EQ(read(target), "old content");  // not published
+    EXPECT_EQ(fs::file_size(root / "table.bin.part"), 4321u);
+
+    CapturingServerOps::begin();
+    httpd_req_t head{.user_ctx = &uploader};
+    EXPECT_EQ(FileUploader::status_handler_wrapper(&head), ESP_OK);
+    EXPECT_EQ(CapturingServerOps::capture.header(upload::OFFSET_FIELD), "4321");
+
+    EXPECT_EQ(put(uploader, std::string_view(content).substr(4321), "offset=4321"), ESP_OK);
+    EXPECT_EQ(status(), HTTPD_201);
+    EXPECT_EQ(CapturingServerOps::capture.header(upload::OFFSET_FIELD), "10000");
+    EXPECT_EQ(read(target), content);
+}
+
+TEST_F(UploadTest, test_wrong_offset_is_a_conflict) {
+    auto uploader = FileUploader(target.string());
+    EXPECT_EQ(put(uploader, content.substr(0, 100), "more=1"), ESP_OK);
+    EXPECT_EQ(put(uploader, content.substr(100), "offset=50"), ESP_FAIL);
+    EXPECT_EQ(status(), upload::STATUS_409);
+    EXPECT_EQ(CapturingServerOps::capture.header(upload::OFFSET_FIELD), "100");
+    EXPECT_EQ(put(uploader, content.substr(100), "offset=abc"), ESP_FAIL);
+    EXPECT_FALSE(fs::exists(target));
+}
+
+TEST_F(UploadTest, test_upload_in_several_requests) {
+    auto uploader = FileUploader(target.string());
+    EXPECT_EQ(put(uploader, content.substr(0, 3000), "more=1"), ESP_OK);
+    EXPECT_EQ(status(), HTTPD_200);
+    EXPECT_EQ(put(uploader, content.substr(3000, 3000), "offset=3000&more=1"), ESP_OK);
+    EXPECT_FALSE(fs::exists(target));
+    EXPECT_EQ(put(uploader, content.substr(6000), "offset=6000"), ESP_OK);
+    EXPECT_EQ(read(target), content);
+}
+
+TEST_F(UploadTest, test_writes_are_block_aligned) {
+    auto uploader = RecordingUploader("mem");
+    EXPECT_EQ(put(uploader, content.substr(0, 100), "more=1"), ESP_OK);
+    RecordingSink::writes.clear();
+    EXPECT_EQ(put(uploader, content.substr(100), "offset=100"), ESP_OK);
+    // 2048-byte buffers; the first one ends on the next block boundary
+    std::vector<size_t> expected{2048 - 100, 2048, 2048, 2048, 10000 - 100 - 1948 - 3 * 2048};
+    EXPECT_EQ(RecordingSink::writes, expected);
+    EXPECT_EQ(RecordingSink::data, content);
+    EXPECT_TRUE(RecordingSink::committed);
+}
+
+TEST_F(UploadTest, test_write_error) {
+    RecordingSink::fail_after = 2;
+    auto uploader = RecordingUploader("mem");
+    EXPECT_EQ(put(uploader, content), ESP_FAIL);
+    EXPECT_FALSE(RecordingSink::committed);
+    EXPECT_EQ(RecordingSink::data, content.substr(0, 4096));
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <filesystem>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "vfs_streamer.h"
+#include "wire.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+namespace fs = std::filesystem;
+
+TEST(WireTest, test_meter_chunks) {
+    wire::Stats stats;
+    {
+        wire::Meter meter(stats, 4096);
+        EXPECT_EQ(wire::Meter::active(), &meter);
+        meter.chunk(5000);  // "1388\r\n", data (2 records), "\r\n"
+        meter.payload(5000);
+        meter.chunk(0);
+    }
+    EXPECT_EQ(wire::Meter::active(), nullptr);
+    EXPECT_EQ(stats.payload, 5000);
+    EXPECT_EQ(stats.format(), 0);
+    EXPECT_EQ(stats.framing, 6 + 2 + 5);
+    EXPECT_EQ(stats.writes, 4);
+    EXPECT_EQ(stats.tls, 5 * wire::TLS_RECORD_OVERHEAD);
+    EXPECT_EQ(stats.total(), 5000 + 13 + 5 * wire::TLS_RECORD_OVERHEAD);
+
+    // a raw write of a packed chunk
+    wire::Stats raw;
+    {
+        wire::Meter meter(raw);
+        std::string frame = "0003\r\nabc\r\n";
+        meter.raw(frame);
+    }
+    EXPECT_EQ(raw.sent, 3);
+    EXPECT_EQ(raw.framing, 8);
+    EXPECT_EQ(raw.writes, 1);
+}
+
+class WireStreamerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "ds_test_wire";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        for (int i = 0; i < 3; i++) {
+            std::ofstream(dir / ("f" + std::to_string(i) + ".bin"), std::ios::binary) << std::string(10000, 'a' + i);
+        }
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    template<typename T>
+    wire::Stats stream(const std::string &path, std::string_view query = {}, size_t record_size = 0) {
+        CapturingServerOps::begin(query);
+        auto streamer = DataStreamer<T, CapturingServerOps>(path);
+        streamer.set_record_size(record_size);
+        httpd_req_t req{.user_ctx = &streamer};
+        EXPECT_EQ((DataStreamer<T, CapturingServerOps>::handler_wrapper(&req)), ESP_OK);
+        return streamer.wire_stats();
+    }
+
+    fs::path dir;
+};
+
+TEST_F(WireStreamerTest, test_file_payload) {
+    auto stats = stream<FileChunker<4096>>((dir / "f0.bin").string());
+    EXPECT_EQ(stats.payload, 10000);
+    EXPECT_EQ(stats.format(), 0);
+    EXPECT_EQ(stats.sent, CapturingServerOps::capture.body().size());
+    // 2 chunks of 0x1000 bytes, one of 0x710 and the last chunk
+    EXPECT_EQ(stats.framing, 2 * (6 + 2) + (5 + 2) + 5);
+    EXPECT_GT(stats.efficiency(), 0.9);
+    EXPECT_LT(stats.efficiency(), 1);
+}
+
+TEST_F(WireStreamerTest, test_collection_formats) {
+    for (auto format: {"multipart", "tar", "framed"}) {
+        SCOPED_TRACE(format);
+        auto stats = stream<FlatDirIterable<4096>>(dir.string(), std::string("format=") + format);
+        EXPECT_EQ(stats.payload, 30000);
+        EXPECT_GT(stats.format(), 0);
+        EXPECT_EQ(stats.sent, CapturingServerOps::capture.body().size());
+        EXPECT_GT(stats.framing, 0);
+    }
+}
+
+TEST_F(WireStreamerTest, test_packed_framing) {
+    auto plain = stream<FlatDirIterable<4096>>(dir.string(), "format=framed");
+    auto packed = stream<FlatDirIterable<4096>>(dir.string(), "format=framed", 4096);
+    EXPECT_EQ(packed.payload, plain.payload);
+    EXPECT_EQ(packed.sent, plain.sent);
+    // one write per chunk instead of three
+    EXPECT_LT(packed.writes, plain.writes);
+    EXPECT_LT(packed.tls, plain.tls);
+    EXPECT_GT(packed.efficiency(), plain.efficiency());
+    EXPECT_NE(packed.to_json().find(R"("payload_bytes":30000)"), std::string::npos);
+}
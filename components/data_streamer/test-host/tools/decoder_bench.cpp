@@ -0,0 +1,112 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host benchmark: replays a capture file through the matching client decoder (picked from the
+// captured Content-Type) and reports decoder throughput as a JSON object on stdout, with the wire
+// accounting of the captured body (see wire.h; each captured chunk counted as sent by resp_send_chunk).
+//
+// Usage: decoder_bench <in.dscap> [iterations] [link_rate_bytes_per_s]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "capture.h"
+#include "stream_decoder.h"
+#include "wire.h"
+
+using namespace data_streamer;
+using namespace data_streamer::capture;
+using namespace data_streamer::decoder;
+
+struct CountingHandler {
+    size_t parts{0};
+    size_t bytes{0};
+    void on_part_begin(std::string_view) { parts++; }
+    void on_part_data(std::span<const char> data) { bytes += data.size(); }
+    void on_part_end() {}
+};
+
+template<typename D>
+static bool run(const Capture &cap, D &dec, double rate, ReplayStats &stats) {
+    stats = replay(cap, [&](std::span<const char> chunk) { dec.feed(chunk); }, rate);
+    return dec.finish();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <in.dscap> [iterations] [link_rate_bytes_per_s]\n", argv[0]);
+        return 2;
+    }
+    auto cap = Capture::load(argv[1]);
+    if (!cap) {
+        fprintf(stderr, "Can't load capture %s\n", argv[1]);
+        return 1;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+    double rate = argc > 3 ? strtod(argv[3], nullptr) : 0;
+    auto content_type = cap->header("Content-Type").value_or("");
+
+    CountingHandler handler;
+    double total_seconds = 0;
+    size_t total_bytes = 0;
+    ReplayStats stats{};
+    for (int i = 0; i < iterations; i++) {
+        handler = {};
+        bool ok;
+        if (content_type.starts_with("multipart/")) {
+            auto pos = content_type.find("boundary=");
+            if (pos == std::string::npos) {
+                fprintf(stderr, "No boundary in Content-Type\n");
+                return 1;
+            }
+            auto dec = MultipartDecoder<CountingHandler>(content_type.substr(pos + 9), handler);
+            ok = run(*cap, dec, rate, stats);
+        } else if (content_type == tar::CONTENT_TYPE) {
+            auto dec = TarDecoder<CountingHandler>(handler);
+            ok = run(*cap, dec, rate, stats);
+        } else if (content_type == framed::CONTENT_TYPE) {
+            auto dec = FramedDecoder<CountingHandler>(handler);
+            ok = run(*cap, dec, rate, stats);
+        } else {
+            fprintf(stderr, "No decoder for Content-Type '%s'\n", content_type.c_str());
+            return 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "Decoding failed\n");
+            return 1;
+        }
+        total_seconds += stats.seconds;
+        total_bytes += stats.bytes;
+    }
+    wire::Stats wire_stats;
+    {
+        wire::Meter meter(wire_stats);
+        for (const auto &record: cap->records) {
+            if (record.kind == RecordKind::Chunk) {
+                meter.chunk(record.data.size());
+            }
+        }
+        meter.chunk(0);
+        meter.payload(handler.bytes);
+    }
+    printf("{\"capture\": \"%s\", \"content_type\": \"%s\", \"iterations\": %d, \"link_rate\": %.0f, "
+           "\"stream_bytes\": %zu, \"chunks\": %zu, \"parts\": %zu, \"payload_bytes\": %zu, "
+           "\"seconds\": %.6f, \"mb_per_s\": %.2f, \"wire\": %s}\n",
+           argv[1], content_type.c_str(), iterations, rate,
+           stats.bytes, stats.chunks, handler.parts, handler.bytes,
+           total_seconds, total_seconds > 0 ? total_bytes / total_seconds / 1e6 : 0.0,
+           wire_stats.to_json().c_str());
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host benchmark: builds the signature of a synthetic basis, modifies it in place at random
+// offsets (plus one insertion, as a log rewritten with a shifted record), encodes the delta in
+// CHUNK_SIZE pieces as the device does, rebuilds the file, and reports sizes and throughputs as JSON.
+//
+// Usage: delta_bench [size_bytes] [edits] [block_size] [iterations]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "delta.h"
+
+using namespace data_streamer;
+using namespace data_streamer::delta;
+using clock_type = std::chrono::steady_clock;
+
+static double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    size_t size = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4 << 20;
+    int edits = argc > 2 ? atoi(argv[2]) : 16;
+    int iterations = argc > 4 ? atoi(argv[4]) : 5;
+    uint32_t block_size = argc > 3 && atoi(argv[3]) > 0 ? static_cast<uint32_t>(atoi(argv[3])) : choose_block_size(size);
+
+    std::mt19937 rng(1234);
+    std::string basis(size, '\0');
+    for (auto &c: basis) c = static_cast<char>(rng());
+    auto current = basis;
+    for (int i = 0; i < edits && size > 16; i++) {
+        auto offset = rng() % (size - 16);
+        for (size_t j = 0; j < 16; j++) current[offset + j] = static_cast<char>(rng());
+    }
+    current.insert(size / 2, "inserted record\n");
+
+    double signature_seconds = 0;
+    double encode_seconds = 0;
+    double patch_seconds = 0;
+    std::string signature;
+    std::string delta;
+    DeltaStats stats{};
+    for (int it = 0; it < iterations; it++) {
+        auto start = clock_type::now();
+        auto builder = SignatureBuilder(block_size);
+        builder.update(basis);
+        signature = builder.finish();
+        signature_seconds += seconds_since(start);
+
+        start = clock_type::now();
+        auto parsed = Signature::parse(signature);
+        if (!parsed) {
+            fprintf(stderr, "Signature too large (block size %u)\n", block_size);
+            return 1;
+        }
+        delta.clear();
+        auto encoder = DeltaEncoder(*parsed);
+        auto emit = [&](std::span<const char> d) { delta.append(d.data(), d.size()); return true; };
+        for (size_t i = 0; i < current.size(); i += CHUNK_SIZE) {
+            encoder.feed(std::string_view(current).substr(i, CHUNK_SIZE), emit);
+        }
+        encoder.finish(emit);
+        stats = encoder.statistics();
+        encode_seconds += seconds_since(start);
+
+        start = clock_type::now();
+        size_t rebuilt = 0;
+        auto patcher = DeltaPatcher(block_size, basis.size(),
+                                    [&](uint64_t offset, std::span<char> out) {
+                                        memcpy(out.data(), basis.data() + offset, out.size());
+                                        return true;
+                                    },
+                                    [&](std::span<const char> d) { rebuilt += d.size(); return true; });
+        if (!patcher.feed(delta) || !patcher.finish() || rebuilt != current.size()) {
+            fprintf(stderr, "Patching failed\n");
+            return 1;
+        }
+        patch_seconds += seconds_since(start);
+    }
+    auto mb_per_s = [&](double seconds) { return seconds > 0 ? iterations * current.size() / seconds / 1e6 : 0.0; };
+    printf("{\"size\": %zu, \"edits\": %d, \"block_size\": %u, \"iterations\": %d, "
+           "\"signature_bytes\": %zu, \"delta_bytes\": %zu, \"literal_bytes\": %llu, \"copied_bytes\": %llu, "
+           "\"transfer_ratio\": %.4f, \"signature_mb_per_s\": %.2f, \"encode_mb_per_s\": %.2f, "
+           "\"patch_mb_per_s\": %.2f}\n",
+           current.size(), edits, block_size, iterations,
+           signature.size(), delta.size(), static_cast<unsigned long long>(stats.literal_bytes),
+           static_cast<unsigned long long>(stats.copied_bytes),
+           current.empty() ? 0.0 : static_cast<double>(signature.size() + delta.size()) / current.size(),
+           mb_per_s(signature_seconds), mb_per_s(encode_seconds), mb_per_s(patch_seconds));
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host benchmark: runs the diagnostic streamers (diag.h) against server operations that discard
+// the response, and reports the throughput of the link test (synthetic content generation and the
+// streamer's send path, no network) and of the storage test (read and discard a test file) as JSON.
+//
+// Usage: diag_bench [size_bytes] [iterations] [test_file]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include "vfs_streamer.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+using clock_type = std::chrono::steady_clock;
+
+// Capturing server operations discarding the body, to measure the streamer alone
+struct DiscardingServerOps: CapturingServerOps {
+    static inline size_t body_bytes{0};
+
+    static esp_err_t resp_send_chunk(httpd_req_t*, const char* chunk, ssize_t size) {
+        if (chunk != nullptr) body_bytes += size == HTTPD_RESP_USE_STRLEN ? strlen(chunk) : size;
+        return ESP_OK;
+    }
+    static esp_err_t resp_sendstr_chunk(httpd_req_t* req, const char* chunk) {
+        return resp_send_chunk(req, chunk, HTTPD_RESP_USE_STRLEN);
+    }
+    static esp_err_t resp_send_chunkv(httpd_req_t*, std::span<const std::span<const char>> parts) {
+        for (auto part: parts) body_bytes += part.size();
+        return ESP_OK;
+    }
+    static esp_err_t send_raw(httpd_req_t*, const char*, size_t len) {
+        body_bytes += len;
+        return ESP_OK;
+    }
+};
+
+static double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    size_t size = argc > 1 ? strtoull(argv[1], nullptr, 10) : 16 << 20;
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    std::string path = argc > 3 ? argv[3] : (std::filesystem::temp_directory_path() / "diag_bench.bin").string();
+    bool own_file = argc <= 3;
+
+    using LinkTest = DataStreamer<diag::SyntheticChunker<4096>, DiscardingServerOps>;
+    auto link_test = LinkTest(std::to_string(size));
+    double link_seconds = 0;
+    for (int i = 0; i < iterations; i++) {
+        CapturingServerOps::begin();
+        httpd_req_t req{.user_ctx = &link_test};
+        auto start = clock_type::now();
+        if (LinkTest::handler_wrapper(&req) != ESP_OK) {
+            fprintf(stderr, "Link test failed\n");
+            return 1;
+        }
+        link_seconds += seconds_since(start);
+    }
+
+    if (own_file) {
+        if (auto err = diag::write_test_file(path, size)) {
+            fprintf(stderr, "Can't write %s: %s\n", path.c_str(), strerror(*err));
+            return 1;
+        }
+    }
+    using StorageTest = StorageTestStreamer<FileChunker<4096>, CapturingServerOps>;
+    auto storage_test = StorageTest(path);
+    double storage_seconds = 0;
+    for (int i = 0; i < iterations; i++) {
+        CapturingServerOps::begin();
+        httpd_req_t req{.user_ctx = &storage_test};
+        auto start = clock_type::now();
+        if (StorageTest::handler_wrapper(&req) != ESP_OK || CapturingServerOps::capture.records.empty()) {
+            fprintf(stderr, "Storage test of %s failed\n", path.c_str());
+            return 1;
+        }
+        storage_seconds += seconds_since(start);
+    }
+    if (own_file) {
+        std::filesystem::remove(path);
+    }
+
+    auto mb_per_s = [&](double seconds) { return seconds > 0 ? size * iterations / seconds / 1e6 : 0.0; };
+    printf("{\"size\": %zu, \"iterations\": %d, \"link_mb_per_s\": %.2f, \"link_wire\": %s, "
+           "\"storage_mb_per_s\": %.2f, \"storage_report\": %s}\n",
+           size, iterations, mb_per_s(link_seconds), link_test.wire_stats().to_json().c_str(),
+           mb_per_s(storage_seconds), CapturingServerOps::capture.body().c_str());
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool: runs DataStreamer against a local file or directory and saves the emitted
+// response (status, headers and body chunks with their boundaries) to a capture file.
+//
+// The byte accounting of the response (see wire.h) is printed to stderr.
+//
+// Usage: stream_capture <file|dir> <out.dscap> [query]
+//   e.g. stream_capture ./data dir.dscap "from=a.bin&to=z.bin"
+#include <cstdio>
+#include <sys/stat.h>
+#include "vfs_streamer.h"
+#include "capture.h"
+
+using namespace data_streamer;
+using capture::CapturingServerOps;
+
+template<typename T>
+static esp_err_t run(const char *path) {
+    auto streamer = DataStreamer<T, CapturingServerOps>(path);
+    httpd_req_t req{.user_ctx = &streamer};
+    auto ret = DataStreamer<T, CapturingServerOps>::handler_wrapper(&req);
+    fprintf(stderr, "Wire bytes: %s\n", streamer.wire_stats().to_json().c_str());
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <file|dir> <out.dscap> [query]\n", argv[0]);
+        return 2;
+    }
+    struct stat st{};
+    if (stat(argv[1], &st) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    CapturingServerOps::begin(argc > 3 ? argv[3] : "");
+    auto ret = S_ISDIR(st.st_mode) ? run<FlatDirIterable<>>(argv[1]) : run<FileChunker<>>(argv[1]);
+    if (ret != ESP_OK) {
+        fprintf(stderr, "Streamer returned error %d, capture saved anyway\n", ret);
+    }
+    if (auto err = CapturingServerOps::capture.save(argv[2])) {
+        fprintf(stderr, "Can't write %s: %s\n", argv[2], strerror(*err));
+        return 1;
+    }
+    fprintf(stderr, "Captured %zu chunks, %zu body bytes\n",
+            CapturingServerOps::capture.chunk_count(), CapturingServerOps::capture.body().size());
+    return ret == ESP_OK ? 0 : 1;
+}
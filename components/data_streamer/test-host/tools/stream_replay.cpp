@@ -0,0 +1,51 @@
+/*
+ * Copyright 2025 OIST
+ * Copyright 2025 fold ecosystemics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Host tool: replays the body of a capture file to stdout, with original chunk boundaries,
+// either at maximum speed or at a simulated link rate. Pipe it into any client decoder.
+// Response headers are printed to stderr so the decoder can be configured (e.g. boundary).
+//
+// Usage: stream_replay <in.dscap> [link_rate_bytes_per_s]
+#include <cstdio>
+#include <cstdlib>
+#include "capture.h"
+
+using namespace data_streamer::capture;
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <in.dscap> [link_rate_bytes_per_s]\n", argv[0]);
+        return 2;
+    }
+    auto cap = Capture::load(argv[1]);
+    if (!cap) {
+        fprintf(stderr, "Can't load capture %s\n", argv[1]);
+        return 1;
+    }
+    for (const auto &r: cap->records) {
+        if (r.kind == RecordKind::Status || r.kind == RecordKind::Header) {
+            fprintf(stderr, "%s\n", r.data.c_str());
+        }
+    }
+    double rate = argc > 2 ? strtod(argv[2], nullptr) : 0;
+    auto stats = replay(*cap, [](std::span<const char> chunk) {
+        fwrite(chunk.data(), 1, chunk.size(), stdout);
+        fflush(stdout);
+    }, rate);
+    fprintf(stderr, "Replayed %zu chunks, %zu bytes in %.3f s (%.0f B/s)\n",
+            stats.chunks, stats.bytes, stats.seconds, stats.bytes_per_second());
+    return 0;
+}
@@ -15,10 +15,12 @@
  * limitations under the License.
  */
 #include <cstring>
+#include <vector>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_task_wdt.h"
+#include "esp_pthread.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -30,6 +32,8 @@
 #include "driver/spi_common.h"
 #include "sdmmc_cmd.h"
 #include "esp_vfs_fat.h"
+#include "diskio_sdmmc.h"
+#include "ff.h"
 #include "lwip/sys.h"
 #include "vfs_streamer.h"
 #include "esp_https_server.h"
@@ -46,6 +50,8 @@
 static EventGroupHandle_t s_wifi_event_group;
 // Counter for wifi connection retries
 static int s_retry_num = 0;
+// Load and capabilities of the streamers, advertised in mDNS TXT records
+static data_streamer::advertise::Advertiser s_advertiser;
 // mDNS hostname
 constexpr std::string_view HOSTNAME = CONFIG_EXAMPLE_DATA_STREAMER_HOSTNAME;
 
@@ -70,7 +76,7 @@ static const char *TAG = "main";
  * - CS: GPIO45
  * (This example specifically targets the Adafruit Metro ESP32S3 N16R8)
  *
- * Mounts the SD card at "/sdcard" using FAT filesystem.
+ * Mounts the SD card at "/sdcard" using FAT filesystem, and applies its storage calibration.
  *
  * @note The function will panic (ESP_ERROR_CHECK) if mounting fails
  */
@@ -106,6 +112,72 @@ void setup_sd_card () {
     sdmmc_card_t* card;
     ESP_ERROR_CHECK(esp_vfs_fat_sdspi_mount(mount_point, &host, &slot_config, &mount_config, &card));
     ESP_LOGI(TAG, "SD card mounted");
+
+    // Uploads are aligned to CONFIG_DATA_STREAMER_CLUSTER_SIZE, as FAT's stat() doesn't report it
+    char drive[] = {static_cast<char>('0' + ff_diskio_get_pdrv_card(card)), ':', '\0'};
+    DWORD free_clusters;
+    FATFS* fatfs;
+    if (f_getfree(drive, &free_clusters, &fatfs) == FR_OK) {
+#if FF_MAX_SS != FF_MIN_SS
+        size_t cluster_size = static_cast<size_t>(fatfs->csize) * fatfs->ssize;
+#else
+        size_t cluster_size = static_cast<size_t>(fatfs->csize) * FF_MAX_SS;
+#endif
+        if (cluster_size != CONFIG_DATA_STREAMER_CLUSTER_SIZE) {
+            ESP_LOGW(TAG, "Card cluster size is %u, set CONFIG_DATA_STREAMER_CLUSTER_SIZE to it",
+                     static_cast<unsigned>(cluster_size));
+        }
+    }
+
+    // Tune reads to this card (measured the first time it's mounted)
+    data_streamer::calibration::run_at_boot(mount_point);
+}
+
+#ifdef CONFIG_EXAMPLE_DATA_STREAMER_DIR_ACK
+using DirStreamer = data_streamer::VFSAckedDirStreamer;
+#else
+using DirStreamer = data_streamer::VFSFlatDirStreamer;
+#endif
+
+/**
+ * @brief Gets the streamer of CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH, created on first use (after mounting the card)
+ */
+DirStreamer &dir_streamer() {
+#ifdef CONFIG_EXAMPLE_DATA_STREAMER_DIR_ACK
+    static auto streamer = DirStreamer("/sdcard/" CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH,
+                                       data_streamer::DirConsumer("/sdcard/" CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH));
+#else
+    static auto streamer = DirStreamer("/sdcard/" CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH);
+#endif
+    return streamer;
+}
+
+// Background build of the streamed directory's index, paused while the directory is streamed
+static data_streamer::IndexWarmUp s_index_warm_up([] { return dir_streamer().active_streams() > 0; });
+
+/**
+ * @brief Starts building the index of the streamed directory in a low-priority background task
+ *
+ * Files may be added to the directory by writers that don't report them to the index, unlike RecordWriter
+ * and FileSink, hence DirIndex::Writers::Any: requests scan the directory, and the index only estimates
+ * the bytes waiting for an acknowledgement, advertised over mDNS. Declare DirIndex::Writers::Hooked if
+ * every writer reports its files, to serve filtered requests from it. Its progress is logged by app_main().
+ */
+void start_index_warm_up() {
+    if (strlen(CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH) == 0) {
+        return;
+    }
+    s_index_warm_up.add(data_streamer::DirIndex::enable("/sdcard/" CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH,
+                                                        data_streamer::DirIndex::Writers::Any));
+
+    // below the HTTP server task (tskIDLE_PRIORITY + 5), so that requests get the CPU and the card first
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.prio = tskIDLE_PRIORITY + 1;
+    cfg.thread_name = "idx_warm_up";
+    ESP_ERROR_CHECK(esp_pthread_set_cfg(&cfg));
+    s_index_warm_up.start();
+    cfg = esp_pthread_get_default_config();
+    ESP_ERROR_CHECK(esp_pthread_set_cfg(&cfg));
 }
 
 // WiFi event handler
@@ -218,7 +290,8 @@ void wifi_init_sta() {
  * - MAC address-based hostname (if HOSTNAME is "MAC")
  * - Custom hostname from HOSTNAME constant
  *
- * Advertises HTTPS service on port 443.
+ * Advertises HTTPS service on port 443, with TXT records describing the load and capabilities
+ * of the device (see update_mdns_txt()).
  *
  * @note When using MAC as hostname, appropriate SSL certificates must be in place
  */
@@ -240,6 +313,28 @@ void setup_mdns() {
     ESP_ERROR_CHECK(mdns_service_add(hostname, "_https", "_tcp", 443, nullptr, 0));
 }
 
+/**
+ * @brief Updates the TXT records of the HTTPS service, if the status of the streamers changed
+ *
+ * Publishes active streams, free stream slots, supported formats and features, and bytes waiting
+ * for an acknowledgement if CONFIG_EXAMPLE_DATA_STREAMER_DIR_ACK is set (see data_streamer::advertise),
+ * so that gateways can schedule their pulls.
+ */
+void update_mdns_txt() {
+    static data_streamer::advertise::TxtRecords published;
+    auto txt = s_advertiser.status().txt();
+    if (txt == published) {
+        return;
+    }
+    std::vector<mdns_txt_item_t> items;
+    for (const auto &[key, value]: txt) {
+        items.push_back({key.c_str(), value.c_str()});
+    }
+    if (mdns_service_txt_set("_https", "_tcp", items.data(), items.size()) == ESP_OK) {
+        published = std::move(txt);
+    }
+}
+
 
 /**
  * @brief Initializes HTTPS server with streaming endpoints
@@ -274,12 +369,13 @@ void setup_http_server() {
         ESP_LOGI(TAG, "Creating file_stream endpoint");
         static auto file_streamer = data_streamer::VFSFileStreamer("/sdcard/" CONFIG_EXAMPLE_DATA_STREAMER_FILE_PATH);
         ESP_ERROR_CHECK(file_streamer.bind(server, "/file_stream:443", HTTP_GET));
+        s_advertiser.add(file_streamer);
     }
 
     if (strlen(CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH) > 0) {
         ESP_LOGI(TAG, "Creating dir_stream endpoint, bound to /sdcard/" CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH);
-        static auto dir_streamer = data_streamer::VFSFlatDirStreamer("/sdcard/" CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH);
-        ESP_ERROR_CHECK(dir_streamer.bind(server, "/dir_stream:443", HTTP_GET));
+        ESP_ERROR_CHECK(dir_streamer().bind(server, "/dir_stream:443", HTTP_GET));
+        s_advertiser.add(dir_streamer());
     }
 }
 
@@ -295,12 +391,23 @@ extern "C" void app_main()
 
     // Initialize sd card, wifi, mDNS and http services
     setup_sd_card();
+    start_index_warm_up();
     wifi_init_sta();
     setup_mdns();
     setup_http_server();
 
     ESP_LOGI(TAG, "Initialization complete");
-    while (1) {  // loop forever
+    bool warming_up = strlen(CONFIG_EXAMPLE_DATA_STREAMER_DIR_PATH) > 0;
+    for (int tick = 0; ; tick++) {  // loop forever
+        if (tick % CONFIG_EXAMPLE_DATA_STREAMER_MDNS_UPDATE == 0) {
+            update_mdns_txt();
+        }
         vTaskDelay(pdMS_TO_TICKS(1000));
+        if (warming_up && (s_index_warm_up.done() || tick % 10 == 0)) {
+            auto progress = s_index_warm_up.progress();
+            ESP_LOGI(TAG, "Index warm-up: %zu/%zu files%s", progress.indexed, progress.listed,
+                     progress.complete ? ", complete" : "");
+            warming_up = !s_index_warm_up.done();
+        }
     }
 }
@@ -0,0 +1,111 @@
+#   Copyright 2025 OIST
+#   Copyright 2025 fold ecosystemics
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+"""Benchmark of the client multipart parser against captured device responses.
+
+Captures are produced on host with the `stream_capture` tool of the data_streamer component
+(see components/data_streamer/README.md). Results are printed as a JSON object.
+"""
+
+import json
+import re
+import struct
+from time import perf_counter
+
+import click
+
+from client import MultipartParser
+
+CAPTURE_MAGIC = b'DSCAP\x01'
+
+
+def read_capture(path: str) -> tuple[dict, list[bytes]]:
+    """Read a capture file.
+
+    Returns:
+        Tuple of (response headers, body chunks with their original boundaries)
+    """
+    headers = {}
+    chunks = []
+    with open(path, 'rb') as f:
+        if f.read(len(CAPTURE_MAGIC)) != CAPTURE_MAGIC:
+            raise ValueError(f"{path} is not a capture file")
+        while record := f.read(5):
+            kind, length = struct.unpack('<BI', record)
+            data = f.read(length)
+            if kind == ord('H'):
+                field, _, value = data.decode('utf-8').partition(': ')
+                headers[field] = value
+            elif kind == ord('C'):
+                chunks.append(data)
+    return headers, chunks
+
+
+def rechunk(chunks: list[bytes], chunk_size: int) -> list[bytes]:
+    """Split the body the way requests' iter_content(chunk_size) would deliver it."""
+    body = b''.join(chunks)
+    return [body[i:i + chunk_size] for i in range(0, len(body), chunk_size)]
+
+
+@click.command()
+@click.argument('capture', type=click.Path(exists=True, dir_okay=False))
+@click.option('--iterations', default=10, type=int, help='Number of parsing runs')
+@click.option('--chunk-size', default=0, type=int,
+              help='Re-split the body in pieces of this size (0 keeps the captured chunk boundaries)')
+def main(capture: str, iterations: int, chunk_size: int) -> None:
+    """Parse CAPTURE repeatedly and report parser throughput."""
+    headers, chunks = read_capture(capture)
+    boundary_match = re.search(r'boundary=(.*)', headers.get('Content-Type', ''))
+    if not boundary_match:
+        raise click.ClickException("Capture is not a multipart response")
+    boundary = boundary_match.group(1).encode('utf-8')
+    if chunk_size > 0:
+        chunks = rechunk(chunks, chunk_size)
+    stream_bytes = sum(len(c) for c in chunks)
+
+    payload_bytes = 0
+    parts = 0
+
+    def on_part_begin(_name: str) -> None:
+        nonlocal parts
+        parts += 1
+
+    def on_part_data(data: memoryview) -> None:
+        nonlocal payload_bytes
+        payload_bytes += len(data)
+
+    elapsed = 0.0
+    for _ in range(iterations):
+        parts = payload_bytes = 0
+        parser = MultipartParser(boundary, on_part_begin, on_part_data, lambda: None)
+        start = perf_counter()
+        for chunk in chunks:
+            parser.feed(chunk)
+        parser.finish()
+        elapsed += perf_counter() - start
+
+    print(json.dumps({
+        'capture': capture,
+        'iterations': iterations,
+        'chunks': len(chunks),
+        'stream_bytes': stream_bytes,
+        'parts': parts,
+        'payload_bytes': payload_bytes,
+        'seconds': round(elapsed, 6),
+        'mb_per_s': round(stream_bytes * iterations / elapsed / 1e6, 2) if elapsed else 0,
+    }))
+
+
+if __name__ == '__main__':
+    main()
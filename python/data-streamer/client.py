@@ -18,12 +18,16 @@
 - download its data
 """
 
+import json
 import logging
 import os
 import re
+import threading
+from concurrent.futures import ThreadPoolExecutor, wait
+from dataclasses import dataclass
 from pathlib import Path
 from time import time, sleep
-from typing import Optional
+from typing import Callable, Optional
 from urllib.parse import urljoin
 
 import click
@@ -35,6 +39,10 @@ from zeroconf import ServiceListener, Zeroconf, ServiceBrowser
 CHUNK_SIZE = 8192
 SERVICE_TYPE = "_https._tcp.local."
 ENDPOINT = "dir_stream"
+SYNC_STATE_FILE = ".sync_state.json"
+COMMIT_TOKEN_FIELD = "X-Commit-Token"
+FILE_ENDPOINT = "file_stream"
+RANGE_SEGMENT_SIZE = 1 << 20
 
 logging.basicConfig(format='[%(asctime)s] %(message)s')
 LOGGER = logging.getLogger(__name__)
@@ -47,7 +55,8 @@ class ESPListener(ServiceListener):
         self.devices = {}
 
     def update_service(self, zc: Zeroconf, type_: str, name: str) -> None:
-        pass
+        # TXT records (device load) changed
+        self.add_service(zc, type_, name)
 
     def remove_service(self, zc: Zeroconf, type_: str, name: str) -> None:
         if name in self.devices:
@@ -62,9 +71,137 @@ class ESPListener(ServiceListener):
             self.devices[hostname] = info
 
 
+class MultipartParser:
+    """Incremental multipart/mixed parser.
+
+    Each received byte is examined a constant number of times: the buffer is scanned from a
+    moving offset, consumed bytes are dropped from the front of the buffer (cheap for bytearray),
+    and part content is handed to ``on_part_data`` as memoryview slices of the buffer, without
+    copies. The buffer holds at most one received chunk plus a delimiter-sized tail (or one
+    part's headers, bounded by ``MAX_HEADERS_SIZE``).
+
+    Header lines following the final delimiter, up to an empty line, are collected in ``trailer``
+    (e.g. the commit token of acknowledged streams); anything else there is ignored.
+
+    Parts with an ``X-Heartbeat`` header (sent by follow streams while there's nothing new) are
+    skipped. For parts resuming a file at a byte offset (``X-Part-Offset`` header),
+    ``on_part_offset`` is called right after ``on_part_begin``: their content continues the file
+    from there.
+    """
+    MAX_HEADERS_SIZE = 8192
+
+    def __init__(self, boundary: bytes, on_part_begin: Callable[[str], None],
+                 on_part_data: Callable[[memoryview], None], on_part_end: Callable[[], None],
+                 on_part_offset: Optional[Callable[[int], None]] = None):
+        self._delimiter = b'\r\n--' + boundary
+        self._on_part_begin = on_part_begin
+        self._on_part_data = on_part_data
+        self._on_part_end = on_part_end
+        self._on_part_offset = on_part_offset
+        # a virtual CRLF lets the first delimiter come without its leading line break
+        self._buffer = bytearray(b'\r\n')
+        self._pos = 0
+        self._headers_scanned = 0
+        self._state = 'preamble'
+        self.done = False
+        self.trailer = {}
+
+    def feed(self, chunk: bytes) -> None:
+        """Parse the next piece of the response body (any split of the body is valid)."""
+        if self._state == 'epilogue':
+            return
+        self._buffer += chunk
+        buffer = self._buffer
+        delimiter = self._delimiter
+        with memoryview(buffer) as view:
+            while True:
+                if self._state in ('preamble', 'body'):
+                    idx = buffer.find(delimiter, self._pos)
+                    end = idx if idx != -1 else len(buffer) - len(delimiter) + 1
+                    if self._state == 'body' and end > self._pos:
+                        with view[self._pos:end] as data:
+                            self._on_part_data(data)
+                    if idx == -1:
+                        self._pos = max(self._pos, end)
+                        break
+                    if self._state == 'body':
+                        self._on_part_end()
+                    self._pos = idx + len(delimiter)
+                    self._state = 'delimiter'
+                elif self._state == 'delimiter':
+                    if len(buffer) - self._pos < 2:
+                        break
+                    marker = bytes(view[self._pos:self._pos + 2])
+                    self._pos += 2
+                    if marker == b'--':
+                        self.done = True
+                        self._state = 'close_line'
+                        continue
+                    if marker != b'\r\n':
+                        raise ValueError("Malformed multipart delimiter")
+                    self._state = 'headers'
+                elif self._state == 'close_line':
+                    while self._pos < len(buffer) and buffer[self._pos] in b' \t':
+                        self._pos += 1
+                    if len(buffer) - self._pos < 2:
+                        break
+                    self._state = 'trailer' if buffer.startswith(b'\r\n', self._pos) else 'epilogue'
+                    self._pos += 2
+                elif self._state == 'trailer':
+                    eol = buffer.find(b'\r\n', self._pos)
+                    if eol == -1:
+                        if len(buffer) - self._pos > self.MAX_HEADERS_SIZE:
+                            self._state = 'epilogue'
+                        break
+                    line = bytes(view[self._pos:eol]).decode("utf-8", errors="replace")
+                    self._pos = eol + 2
+                    field, sep, value = line.partition(':')
+                    if not sep:
+                        self._state = 'epilogue'
+                        break
+                    self.trailer[field.strip()] = value.strip()
+                elif self._state == 'epilogue':
+                    self._pos = len(buffer)
+                    break
+                else:  # headers
+                    headers_end = buffer.find(b'\r\n\r\n', self._pos + self._headers_scanned)
+                    if headers_end == -1:
+                        if len(buffer) - self._pos > self.MAX_HEADERS_SIZE:
+                            raise ValueError("Multipart part headers too large")
+                        # the terminator may straddle chunks: next time, rescan only its possible start
+                        self._headers_scanned = max(0, len(buffer) - self._pos - 3)
+                        break
+                    self._headers_scanned = 0
+                    headers = bytes(view[self._pos:headers_end]).decode("utf-8", errors="replace")
+                    self._pos = headers_end + 4
+                    if re.search(r'^X-Heartbeat:', headers, re.IGNORECASE | re.MULTILINE):
+                        self._state = 'preamble'  # skip its (empty) content like a preamble
+                        continue
+                    name_match = re.search(r'X-Part-Name:\s*"([^"]+)"', headers)
+                    if not name_match:
+                        raise ValueError("Multipart part without X-Part-Name header")
+                    offset_match = re.search(r'^X-Part-Offset:[ \t]*(\S*)[ \t]*$', headers,
+                                             re.IGNORECASE | re.MULTILINE)
+                    if offset_match and not offset_match.group(1).isdigit():
+                        raise ValueError("Malformed X-Part-Offset header")
+                    self._on_part_begin(name_match.group(1))
+                    if offset_match and self._on_part_offset:
+                        self._on_part_offset(int(offset_match.group(1)))
+                    self._state = 'body'
+        # drop consumed bytes; bytearray deletes from the front without moving the rest
+        del buffer[:self._pos]
+        self._pos = 0
+
+    def finish(self) -> None:
+        """Signal the end of the body; raises if the final delimiter wasn't received."""
+        if not self.done:
+            raise ValueError("Multipart response ended before the final boundary")
+
+
 class Client:
     def __init__(self, base_url: str, cert_path: str, key_path: str,
-                 ca_path: str, download_dir: str):
+                 ca_path: str, download_dir: str,
+                 on_file_done: Optional[Callable[[str], None]] = None, ack: bool = False):
         """Initialize the client with server details and certificates.
 
         Args:
@@ -73,9 +210,15 @@ class Client:
             key_path: Path to client private key
             ca_path: Path to CA certificate
             download_dir: Directory where files will be downloaded
+            on_file_done: Called with the file name each time a file has been completely received
+            ack: Acknowledge directory streams once stored, so that the device consumes the files
         """
         self.base_url = base_url.rstrip('/')
         self.download_dir = download_dir
+        self.on_file_done = on_file_done
+        self.ack = ack
+        # Total bytes received by this client, readable from other threads for progress reporting
+        self.bytes_received = 0
         # Create download directory if it doesn't exist
         os.makedirs(download_dir, exist_ok=True)
 
@@ -100,8 +243,13 @@ class Client:
             speed /= 1024.0
         return f"{speed:.2f} TB/s"
 
-    def _handle_multipart_response(self, response: requests.Response) -> None:
-        """Handle multipart response and save files."""
+    def _handle_multipart_response(self, response: requests.Response, skip: Optional[str] = None) -> None:
+        """Handle multipart response and save files.
+
+        Args:
+            response: Streaming response from the device
+            skip: Name of a part that is already stored locally; its content is discarded
+        """
         # Get boundary from Content-Type header
         start_time = time()
         content_type = response.headers.get('Content-Type', '')
@@ -111,56 +259,87 @@ class Client:
 
         boundary = boundary_match.group(1).encode("utf-8")
         current_file = None
-        buffer = bytearray()
+        current_name = None
+        # where the current part starts in its file (X-Part-Offset), None once positioned there
+        part_offset = 0
         tot_bytes = 0
 
-        for chunk in response.iter_content(chunk_size=CHUNK_SIZE, decode_unicode=False):
-            time_now = time()
-            tot_bytes = tot_bytes + len(chunk)
-            if chunk:
-                buffer += chunk
-                while buffer:
-                    if buffer.startswith(b'\r\n--' + boundary):  # starting of part
-                        if current_file:
-                            current_file.close()
-                            current_file = None
-                        headers_end = buffer.find(b'\r\n\r\n')
-                        if headers_end == -1:
-                            break
-
-                        headers = buffer[:headers_end].decode("utf-8")
-                        name_match = re.search(r'X-Part-Name:\s*"([^"]+)"', headers)
-                        if name_match:
-                            current_filename = name_match.group(1)
-                            current_file = open(os.path.join(self.download_dir, current_filename), 'wb')
-                            LOGGER.info("Downloading: %s", current_filename)
-                            _, avg_speed = self._calculate_speed(bytes_received=len(chunk), total_bytes=tot_bytes,
-                                                                 elapsed_time=time_now - start_time)
-                            LOGGER.info("Avg speed: %s", self._format_speed(avg_speed))
-
-                        buffer = buffer[headers_end + 4:]
-
-                    elif buffer.startswith(b'\r\n--%b--' % boundary):  # ending of all parts
-                        print("Done")
-                        if current_file:
-                            current_file.close()
-                        break
-
-                    elif current_file:  # we're currently in the middle of a part
-                        next_boundary = buffer.find(b'\r\n--%b' %boundary)
-                        if next_boundary != -1:
-                            data = buffer[:next_boundary]
-                            current_file.write(data)
-                            buffer = buffer[next_boundary:]
-                        else:
-                            safe_length = max(0, len(buffer) - CHUNK_SIZE)
-                            if safe_length > 0:
-                                data = buffer[:safe_length]
-                                current_file.write(data)
-                                buffer = buffer[safe_length:]
-                            break
-                    else:
-                        break
+        def on_part_begin(name: str) -> None:
+            nonlocal current_file, current_name, part_offset
+            current_name = name
+            part_offset = 0
+            if name == skip:
+                current_file = open(os.devnull, 'wb')
+                part_offset = None
+                return
+            # not truncated yet: a resumed part continues the local file (see on_part_offset)
+            path = os.path.join(self.download_dir, name)
+            current_file = os.fdopen(os.open(path, os.O_WRONLY | os.O_CREAT, 0o644), 'wb')
+            LOGGER.info("Downloading: %s", name)
+            _, avg_speed = self._calculate_speed(bytes_received=0, total_bytes=tot_bytes,
+                                                 elapsed_time=time() - start_time)
+            LOGGER.info("Avg speed: %s", self._format_speed(avg_speed))
+
+        def on_part_offset(offset: int) -> None:
+            nonlocal part_offset
+            if part_offset is None:
+                return
+            if offset > os.fstat(current_file.fileno()).st_size:
+                raise ValueError(f"{current_name} resumes at {offset}, past the end of the local file")
+            LOGGER.info("Resuming %s at %d", current_name, offset)
+            part_offset = offset
+
+        def position() -> None:
+            nonlocal part_offset
+            if part_offset is not None:
+                current_file.seek(part_offset)
+                current_file.truncate()
+                part_offset = None
+
+        def on_part_data(data: memoryview) -> None:
+            position()
+            current_file.write(data)
+
+        def on_part_end() -> None:
+            nonlocal current_file
+            position()
+            if self.ack:  # the device may delete its copy: make sure ours is on disk
+                current_file.flush()
+                os.fsync(current_file.fileno())
+            current_file.close()
+            current_file = None
+            if self.on_file_done and current_name != skip:
+                self.on_file_done(current_name)
+
+        parser = MultipartParser(boundary, on_part_begin=on_part_begin, on_part_data=on_part_data,
+                                 on_part_end=on_part_end, on_part_offset=on_part_offset)
+        try:
+            for chunk in response.iter_content(chunk_size=CHUNK_SIZE, decode_unicode=False):
+                tot_bytes += len(chunk)
+                self.bytes_received += len(chunk)
+                parser.feed(chunk)
+            parser.finish()
+            print("Done")
+        finally:
+            if current_file:
+                current_file.close()
+        if self.ack:
+            self._acknowledge(response.url, parser.trailer.get(COMMIT_TOKEN_FIELD))
+
+    def _acknowledge(self, url: str, token: Optional[str]) -> None:
+        """Send back the commit token of a completely stored stream."""
+        if token is None:
+            LOGGER.info("Nothing to acknowledge")
+            return
+        if hasattr(os, 'O_DIRECTORY'):  # persist the directory entries of the new files too
+            fd = os.open(self.download_dir, os.O_RDONLY | os.O_DIRECTORY)
+            try:
+                os.fsync(fd)
+            finally:
+                os.close(fd)
+        response = self.session.post(url.split('?', 1)[0], params={'commit': token})
+        response.raise_for_status()
+        LOGGER.info("Acknowledged, device cursor is now at %s", response.text or "(start)")
 
     def _handle_single_file_response(self, response: requests.Response) -> None:
         """Handle single file response and save it."""
@@ -181,13 +360,17 @@ class Client:
                     f.write(chunk)
         print(f"Downloaded: {filename}")
 
-    def download(self, endpoint: str, from_=None, to=None) -> None:
+    def download(self, endpoint: str, from_=None, to=None, skip: Optional[str] = None) -> bool:
         """Download data from the specified endpoint.
 
         Args:
             endpoint: The endpoint to retrieve from (e.g., '/files')
             from_: name for which any filename <= of url_from (lexicographically) is not downloaded
             to: name for which any filename > of url_to (lexicographically) is not downloaded
+            skip: name of a file already stored locally, which is not written again
+
+        Returns:
+            True if the whole response was received and stored
         """
         try:
             url = urljoin(self.base_url, endpoint.lstrip('/')) + ":443"
@@ -200,19 +383,350 @@ class Client:
             response.raise_for_status()
             content_type = response.headers.get('Content-Type', '')
             if 'multipart' in content_type:
-                self._handle_multipart_response(response)
+                self._handle_multipart_response(response, skip=skip)
             else:
                 self._handle_single_file_response(response)
+            return True
         except ChunkedEncodingError as e:
             print(f"Error during chunked transfer: {e}")
         except Exception as e:
             print(f"Error: {e}")
+        return False
+
+    def _new_session(self) -> requests.Session:
+        """New session with the same TLS settings, for an additional concurrent connection."""
+        session = requests.Session()
+        session.verify = self.session.verify
+        session.cert = self.session.cert
+        return session
+
+    def download_ranged(self, endpoint: str, max_connections: int = 3,
+                        segment_size: int = RANGE_SEGMENT_SIZE) -> bool:
+        """Download a single file over several concurrent connections, each fetching byte ranges.
+
+        The file is preallocated and every range written in place with ``os.pwrite``. The number of
+        connections starts at one and grows while each added connection increases the measured
+        throughput, up to ``max_connections``. Servers that don't honour Range requests are
+        downloaded over a single connection.
+
+        Args:
+            endpoint: The single file endpoint (e.g., 'file_stream')
+            max_connections: Upper bound for concurrent connections
+            segment_size: Size of the ranges requested, in bytes
+
+        Returns:
+            True if the whole file was received and stored
+        """
+        url = urljoin(self.base_url, endpoint.lstrip('/')) + ":443"
+        try:
+            probe = self.session.get(url, headers={'Range': 'bytes=0-0'}, stream=True)
+            probe.close()
+            if probe.status_code == 416:  # no byte 0: an empty file, nothing to split
+                LOGGER.info("Empty file, using a single connection")
+                return self.download(endpoint)
+            probe.raise_for_status()
+            size_match = re.match(r'bytes \d+-\d+/(\d+)', probe.headers.get('Content-Range', ''))
+            if probe.status_code != 206 or not size_match:
+                LOGGER.info("Server doesn't support ranges, using a single connection")
+                return self.download(endpoint)
+            filename_match = re.search(r'filename="?([^"]+)"?', probe.headers.get('Content-Disposition', ''))
+            if not filename_match:
+                raise ValueError("No filename in Content-Disposition header")
+            size = int(size_match.group(1))
+            path = os.path.join(self.download_dir, filename_match.group(1))
+            transfer = _RangedTransfer(self, url, path, size, max_connections, segment_size)
+            ok = transfer.run()
+            print(f"Downloaded: {filename_match.group(1)}" if ok else "Ranged download failed")
+            return ok
+        except Exception as e:
+            print(f"Error: {e}")
+        return False
 
     def __del__(self):
         """Cleanup session on object destruction."""
         self.session.close()
 
 
+class _RangedTransfer:
+    """State of one parallel ranged download (see Client.download_ranged)."""
+    # Throughput must grow by this fraction for an added connection to be kept
+    MIN_GAIN = 0.1
+    # Seconds between throughput measurements driving the connection count
+    PROBE_INTERVAL = 1.0
+    # Failed range requests that received nothing, tolerated before giving up
+    MAX_FAILURES = 5
+
+    def __init__(self, client: 'Client', url: str, path: str, size: int,
+                 max_connections: int, segment_size: int):
+        self.client = client
+        self.url = url
+        self.path = path
+        self.size = size
+        self.max_connections = max_connections
+        self.lock = threading.Lock()
+        self.segments = [(start, min(start + segment_size, size) - 1)
+                         for start in range(0, size, segment_size)]
+        self.segments.reverse()  # popped from the end, in file order
+        self.pending = len(self.segments)
+        self.target = 1
+        self.failures = 0
+        self.bytes_written = 0
+        self.fd = -1
+        self.finished = threading.Event()
+        if self.pending == 0:
+            self.finished.set()
+
+    def _next_segment(self, index: int) -> Optional[tuple[int, int]]:
+        with self.lock:
+            if index >= self.target or not self.segments or self.failures > self.MAX_FAILURES:
+                return None
+            return self.segments.pop()
+
+    def _worker(self, index: int) -> None:
+        session = self.client._new_session()
+        try:
+            while segment := self._next_segment(index):
+                start, end = segment
+                offset = start
+                try:
+                    with session.get(self.url, headers={'Range': f'bytes={start}-{end}'}, stream=True) as r:
+                        if r.status_code != 206 or not r.headers.get('Content-Range', '').startswith(
+                                f'bytes {start}-{end}/'):
+                            raise ValueError(f"Unexpected response to range {start}-{end}: {r.status_code}")
+                        for chunk in r.iter_content(chunk_size=CHUNK_SIZE):
+                            if offset + len(chunk) > end + 1:
+                                raise ValueError("Range response longer than requested")
+                            os.pwrite(self.fd, chunk, offset)
+                            offset += len(chunk)
+                            with self.lock:
+                                self.bytes_written += len(chunk)
+                                self.client.bytes_received += len(chunk)
+                    if offset != end + 1:
+                        raise ChunkedEncodingError("Range response ended prematurely")
+                    with self.lock:
+                        self.pending -= 1
+                        if self.pending == 0:
+                            self.finished.set()
+                except Exception as e:
+                    LOGGER.warning("Range %d-%d failed at %d: %s", start, end, offset, e)
+                    with self.lock:
+                        if offset == start:
+                            self.failures += 1
+                        if offset <= end:
+                            self.segments.append((offset, end))  # retry what's missing, next
+                        else:
+                            self.pending -= 1
+                        if self.failures > self.MAX_FAILURES or self.pending == 0:
+                            self.finished.set()
+        finally:
+            session.close()
+
+    def run(self) -> bool:
+        self.fd = os.open(self.path, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)
+        try:
+            if self.size:
+                if hasattr(os, 'posix_fallocate'):
+                    os.posix_fallocate(self.fd, 0, self.size)
+                else:
+                    os.ftruncate(self.fd, self.size)
+            workers = {}
+            best = 0.0
+            growing = True
+            last_bytes, last_time = 0, time()
+            start_time = last_time
+            while not self.finished.is_set():
+                with self.lock:
+                    target = self.target
+                for index in range(target):
+                    if index not in workers or not workers[index].is_alive():
+                        workers[index] = threading.Thread(target=self._worker, args=(index,), daemon=True)
+                        workers[index].start()
+                self.finished.wait(self.PROBE_INTERVAL)
+                now = time()
+                with self.lock:
+                    throughput = (self.bytes_written - last_bytes) / (now - last_time)
+                    last_bytes, last_time = self.bytes_written, now
+                    if growing and not self.finished.is_set():
+                        if throughput > best * (1 + self.MIN_GAIN):
+                            best = throughput
+                            self.target = min(self.target + 1, self.max_connections)
+                        else:
+                            # the last connection didn't pay off: drop it and settle
+                            self.target = max(1, self.target - 1)
+                            growing = False
+                LOGGER.info("Ranged download: %d connection(s), %s, %.1f%% done", target,
+                            self.client._format_speed(throughput), 100 * last_bytes / max(self.size, 1))
+            for w in workers.values():
+                w.join()
+            elapsed = time() - start_time
+            LOGGER.info("Ranged download: %d bytes in %.1fs (%s)", self.bytes_written, elapsed,
+                        self.client._format_speed(self.bytes_written / max(elapsed, 1e-9)))
+            return self.pending == 0
+        finally:
+            os.close(self.fd)
+
+
+class SyncState:
+    """Per-device resume state, persisted as JSON so that interrupted or repeated syncs continue
+    from the last file completely stored for each device.
+
+    Resuming relies on the device range filter (``from``), i.e. on files being produced in
+    lexicographic name order, as is the case for time-stamped logs.
+    """
+    def __init__(self, path: str):
+        self.path = path
+        self._lock = threading.Lock()
+        try:
+            with open(path) as f:
+                self._state = json.load(f)
+        except FileNotFoundError:
+            self._state = {}
+
+    def last_done(self, device_id: str) -> Optional[str]:
+        """Name of the last file completely stored for the device, if any."""
+        with self._lock:
+            return self._state.get(device_id, {}).get('last_done')
+
+    def mark_done(self, device_id: str, name: str) -> None:
+        """Record a completely stored file and persist the state atomically."""
+        with self._lock:
+            entry = self._state.setdefault(device_id, {})
+            if entry.get('last_done') is None or name > entry['last_done']:
+                entry['last_done'] = name
+            tmp_path = self.path + '.tmp'
+            with open(tmp_path, 'w') as f:
+                json.dump(self._state, f, indent=2)
+            os.replace(tmp_path, self.path)
+
+
+@dataclass
+class DeviceResult:
+    """Outcome of syncing one device."""
+    device_id: str
+    ok: bool = False
+    attempts: int = 0
+    bytes: int = 0
+    seconds: float = 0.0
+
+
+def device_base_url(device: str) -> str:
+    """Base URL for a device given either as mDNS device id or as URL (e.g. a local stand-in server)."""
+    if '://' in device:
+        return device
+    return f"https://{device}.local"
+
+
+def device_id_from(device: str) -> str:
+    """Filesystem-friendly identifier for a device given as device id or URL."""
+    return re.sub(r'[^A-Za-z0-9_.-]+', '_', device.split('://', 1)[-1]).strip('_')
+
+
+def sync_device(device: str, state: SyncState, retries: int, client_args: dict,
+                from_: Optional[str], to: Optional[str], clients: list) -> DeviceResult:
+    """Download everything new from one device, retrying with exponential backoff.
+
+    Every attempt resumes after the last completely stored file (see SyncState).
+    """
+    device_id = device_id_from(device)
+    result = DeviceResult(device_id)
+    start = time()
+    for attempt in range(retries + 1):
+        result.attempts = attempt + 1
+        resume = state.last_done(device_id)
+        client = Client(base_url=device_base_url(device),
+                        download_dir=os.path.join(client_args['download_dir'], device_id),
+                        on_file_done=lambda name: state.mark_done(device_id, name),
+                        **{k: v for k, v in client_args.items() if k != 'download_dir'})
+        clients.append(client)
+        if client.ack:  # the device resumes after its own consumption cursor
+            start_from, resume = from_, None
+        else:
+            start_from = max(filter(None, [resume, from_]), default=None)
+        if client.download(ENDPOINT, from_=start_from, to=to, skip=resume):
+            result.ok = True
+        result.bytes += client.bytes_received
+        if result.ok:
+            break
+        if attempt < retries:
+            delay = min(2 ** attempt, 30)
+            LOGGER.warning("%s: attempt %d failed, retrying in %ds", device_id, attempt + 1, delay)
+            sleep(delay)
+    result.seconds = time() - start
+    return result
+
+
+def sync_devices(devices: list[str], workers: int, retries: int, client_args: dict,
+                 from_: Optional[str] = None, to: Optional[str] = None,
+                 report_interval: float = 5.0) -> list[DeviceResult]:
+    """Sync many devices concurrently with a bounded pool of workers.
+
+    Aggregate throughput is logged every ``report_interval`` seconds and at the end.
+    """
+    state = SyncState(os.path.join(client_args['download_dir'], SYNC_STATE_FILE))
+    clients = []
+    start = time()
+    with ThreadPoolExecutor(max_workers=workers) as pool:
+        futures = [pool.submit(sync_device, device, state, retries, client_args, from_, to, clients)
+                   for device in devices]
+        last_bytes, last_time = 0, start
+        while not all(f.done() for f in futures):
+            wait(futures, timeout=report_interval)
+            now = time()
+            total = sum(c.bytes_received for c in list(clients))
+            LOGGER.info("Progress: %d/%d devices done, %.1f MB, current %.2f MB/s, average %.2f MB/s",
+                        sum(f.done() for f in futures), len(futures), total / 1e6,
+                        (total - last_bytes) / max(now - last_time, 1e-9) / 1e6,
+                        total / max(now - start, 1e-9) / 1e6)
+            last_bytes, last_time = total, now
+        results = [f.result() for f in futures]
+    elapsed = time() - start
+    for r in results:
+        LOGGER.info("%s: %s after %d attempt(s), %.1f MB in %.1fs", r.device_id,
+                    "ok" if r.ok else "FAILED", r.attempts, r.bytes / 1e6, r.seconds)
+    total = sum(r.bytes for r in results)
+    LOGGER.info("Synced %d/%d devices, %.1f MB in %.1fs (aggregate %.2f MB/s)",
+                sum(r.ok for r in results), len(results), total / 1e6, elapsed,
+                total / max(elapsed, 1e-9) / 1e6)
+    return results
+
+
+@dataclass
+class DeviceLoad:
+    """Load and capabilities advertised by a device in its mDNS TXT records (see advertise.h)."""
+    streams: int = 0
+    slots: Optional[int] = None
+    formats: tuple[str, ...] = ()
+    features: tuple[str, ...] = ()
+    pending: Optional[int] = None
+
+    @classmethod
+    def from_properties(cls, properties: dict) -> "DeviceLoad":
+        txt = {k.decode(errors='replace'): (v or b'').decode(errors='replace') for k, v in properties.items()}
+
+        def number(key: str) -> Optional[int]:
+            return int(txt[key]) if txt.get(key, '').isdigit() else None
+
+        def items(key: str) -> tuple[str, ...]:
+            return tuple(i for i in txt.get(key, '').split(',') if i)
+
+        return cls(streams=number('streams') or 0, slots=number('slots'), formats=items('formats'),
+                   features=items('features'), pending=number('pending'))
+
+    def __str__(self) -> str:
+        parts = [f"{self.streams} active stream(s)"]
+        if self.slots is not None:
+            parts.append(f"{self.slots} free")
+        if self.pending is not None:
+            parts.append(f"{self.pending / 1e6:.1f} MB pending")
+        return ", ".join(parts)
+
+
+def schedule_devices(devices: dict) -> list[str]:
+    """Order discovered devices for syncing: devices with free stream slots first, largest backlog first."""
+    loads = {d: DeviceLoad.from_properties(info.properties or {}) for d, info in devices.items()}
+    return sorted(devices, key=lambda d: (loads[d].slots == 0, -(loads[d].pending or 0)))
+
+
 def discover_devices(timeout: int=3) -> dict:
     """Discover ESP devices on the network.
 
@@ -277,13 +791,48 @@ def get_default_cert_path(cert_name):
               help='Range start for query')
 @click.option('--to', default=None, type=str,
               help='Range end for query')
+@click.option('--all', 'all_', is_flag=True, default=False,
+              help='Non-interactive: sync all discovered devices concurrently')
+@click.option('--device', 'devices_', multiple=True, type=str,
+              help='Non-interactive: sync this device (mDNS device id, or base URL such as '
+                   'http://127.0.0.1:8000 for a stand-in server). Can be repeated')
+@click.option('--workers', default=4, type=click.IntRange(min=1),
+              help='Max number of devices synced at the same time')
+@click.option('--retries', default=3, type=click.IntRange(min=0),
+              help='Retries per device after a failed attempt')
+@click.option('--ack', is_flag=True, default=False,
+              help='Acknowledge directory downloads once stored, so that the device deletes or archives the files')
+@click.option('--file', 'file_', is_flag=True, default=False,
+              help='Download the single file endpoint of the selected device, over parallel ranged requests')
+@click.option('--max-connections', default=3, type=click.IntRange(min=1),
+              help='Max concurrent connections for --file')
 def main(config: dict, ca_path: str, cert_path: str, key_path: str,
          download_dir: str, discovery_timeout: int,
-         from_: Optional[str], to: Optional[str]) -> None:
+         from_: Optional[str], to: Optional[str],
+         all_: bool, devices_: tuple[str, ...], workers: int, retries: int,
+         ack: bool, file_: bool, max_connections: int) -> None:
     """ESP File Stream Client.
 
     Discovers ESP devices on the network and downloads files from the selected device.
+    With --all or --device, syncs several devices concurrently into per-device subdirectories
+    of the download directory, resuming from where the previous sync of each device stopped.
     """
+    if all_ or devices_:
+        targets = list(devices_)
+        if all_:
+            click.echo("Discovering devices...")
+            targets += [d for d in schedule_devices(discover_devices(discovery_timeout)) if d not in targets]
+        if not targets:
+            LOGGER.error("No devices found!")
+            return
+        client_args = dict(ca_path=ca_path, cert_path=cert_path, key_path=key_path,
+                           download_dir=download_dir, ack=ack)
+        results = sync_devices(targets, workers=workers, retries=retries, client_args=client_args,
+                               from_=from_, to=to)
+        if not all(r.ok for r in results):
+            raise SystemExit(1)
+        return
+
     click.echo("Discovering devices...")
     devices = discover_devices(discovery_timeout)
     if not devices:
@@ -292,8 +841,8 @@ def main(config: dict, ca_path: str, cert_path: str, key_path: str,
 
     # Present device selection menu
     click.echo("Available devices:")
-    for idx, device_id in enumerate(devices.keys(), 1):
-        click.echo(f"{idx}. {device_id}")
+    for idx, (device_id, info) in enumerate(devices.items(), 1):
+        click.echo(f"{idx}. {device_id} ({DeviceLoad.from_properties(info.properties or {})})")
     while True:
         try:
             choice = click.prompt("Select device (number)", type=int)
@@ -312,10 +861,14 @@ def main(config: dict, ca_path: str, cert_path: str, key_path: str,
         ca_path=ca_path,
         cert_path=cert_path,
         key_path=key_path,
-        download_dir=download_dir
+        download_dir=download_dir,
+        ack=ack
     )
     click.echo(f"Connecting to {base_url}...")
-    client.download(ENDPOINT, from_=from_, to=to)
+    if file_:
+        client.download_ranged(FILE_ENDPOINT, max_connections=max_connections)
+    else:
+        client.download(ENDPOINT, from_=from_, to=to)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,190 @@
+#   Copyright 2025 OIST
+#   Copyright 2025 fold ecosystemics
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+"""Stand-in for one or more devices, serving a local directory the way the device
+``dir_stream`` endpoint does (chunked multipart/mixed, ``from``/``to`` filters), and optionally
+one of its files at the ``file_stream`` endpoint, with Range support. With ``--ack``, directory
+streams carry a commit token and acknowledged files are deleted, like a device using DirConsumer
+(all instances share ROOT, so use a single instance per directory).
+
+Meant for exercising the client (e.g. ``client.py --device http://127.0.0.1:8000``) without
+hardware. It can throttle each connection and drop it after a given number of bytes, to test
+retries and resume.
+"""
+
+import re
+import threading
+import uuid
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+from time import sleep
+from typing import Optional
+from urllib.parse import urlparse, parse_qs
+
+import click
+
+BOUNDARY = "data_streamer_boundary"
+ENDPOINT = "/dir_stream:443"
+FILE_ENDPOINT = "/file_stream:443"
+CHUNK_SIZE = 4096
+
+
+def make_handler(root: Path, rate: float, fail_after: int, file: Optional[str] = None, ack: bool = False):
+    # acknowledgement state of this stand-in device: consumption cursor and streams awaiting acknowledgement
+    cursor = None
+    pending = {}
+    lock = threading.Lock()
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def _send_chunk(self, data: bytes) -> None:
+            self.sent += len(data)
+            if fail_after and self.sent > fail_after:
+                # drop the connection mid-stream, as a device losing Wi-Fi would
+                raise ConnectionAbortedError("simulated link failure")
+            self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+            if rate:
+                sleep(len(data) / rate)
+
+        def _send_file(self) -> None:
+            """Single file endpoint, honouring single byte range requests like the device."""
+            path = root / file
+            size = path.stat().st_size
+            first, last = 0, size - 1
+            match = re.fullmatch(r'bytes=(\d*)-(\d*)', self.headers.get('Range', '').strip())
+            if match and match.group(1):
+                first = int(match.group(1))
+                last = min(int(match.group(2)), size - 1) if match.group(2) else size - 1
+            elif match and match.group(2):
+                first = max(size - int(match.group(2)), 0)
+            if match and first >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", f"bytes */{size}")
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            self.send_response(206 if match else 200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Disposition", f'attachment; filename="{file}"')
+            self.send_header("Accept-Ranges", "bytes")
+            if match:
+                self.send_header("Content-Range", f"bytes {first}-{last}/{size}")
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            self.sent = 0
+            try:
+                with open(path, 'rb') as f:
+                    f.seek(first)
+                    remaining = last - first + 1
+                    while remaining > 0 and (chunk := f.read(min(CHUNK_SIZE, remaining))):
+                        self._send_chunk(chunk)
+                        remaining -= len(chunk)
+                self.wfile.write(b"0\r\n\r\n")
+            except ConnectionAbortedError:
+                self.close_connection = True
+
+        def do_GET(self):
+            url = urlparse(self.path)
+            if url.path == FILE_ENDPOINT and file:
+                self._send_file()
+                return
+            if url.path != ENDPOINT:
+                self.send_error(404)
+                return
+            query = parse_qs(url.query)
+            from_ = query.get('from', [None])[0]
+            to = query.get('to', [None])[0]
+            after = cursor if ack and from_ is None else None
+            names = sorted(p.name for p in root.iterdir() if p.is_file())
+            names = [n for n in names if (from_ is None or n >= from_) and (after is None or n > after)
+                     and (to is None or n <= to)]
+
+            self.send_response(200)
+            self.send_header("Content-Type", f"multipart/mixed; boundary={BOUNDARY}")
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            self.sent = 0
+            try:
+                for name in names:
+                    self._send_chunk(f"\r\n--{BOUNDARY}\r\nContent-Type: application/octet-stream\r\n"
+                                     f"Content-Disposition: attachment;\r\n"
+                                     f"X-Part-Name: \"{name}\"\r\n\r\n".encode())
+                    with open(root / name, 'rb') as f:
+                        while chunk := f.read(CHUNK_SIZE):
+                            self._send_chunk(chunk)
+                self._send_chunk(f"\r\n--{BOUNDARY}--\r\n".encode())
+                if ack and names:
+                    token = uuid.uuid4().hex
+                    with lock:
+                        pending[token] = names
+                    self._send_chunk(f"X-Commit-Token: {token}\r\n\r\n".encode())
+                self.wfile.write(b"0\r\n\r\n")
+            except ConnectionAbortedError:
+                self.close_connection = True
+
+        def do_POST(self):
+            """Acknowledgement of a directory stream: consume (delete) the files it carried."""
+            nonlocal cursor
+            url = urlparse(self.path)
+            token = parse_qs(url.query).get('commit', [None])[0]
+            with lock:
+                names = pending.pop(token, None) if url.path == ENDPOINT else None
+                if names is None:
+                    self.send_error(404)
+                    return
+                for name in names:
+                    (root / name).unlink(missing_ok=True)
+                cursor = max(names + ([cursor] if cursor else []))
+                body = cursor.encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "text/plain")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, format, *args):
+            pass
+
+    return Handler
+
+
+@click.command()
+@click.argument('root', type=click.Path(exists=True, file_okay=False, path_type=Path))
+@click.option('--port', default=8000, type=int, help='Port of the first stand-in device')
+@click.option('--instances', default=1, type=click.IntRange(min=1),
+              help='Number of stand-in devices, on consecutive ports, all serving ROOT')
+@click.option('--rate', default=0.0, type=float, help='Per-connection rate limit (bytes/s), 0 for none')
+@click.option('--fail-after', default=0, type=int,
+              help='Drop each connection after this many body bytes, 0 for never')
+@click.option('--file', default=None, type=str,
+              help='Name of a file in ROOT to serve at the file_stream endpoint, with Range support')
+@click.option('--ack', is_flag=True, default=False,
+              help='End directory streams with a commit token, and delete the files once acknowledged')
+def main(root: Path, port: int, instances: int, rate: float, fail_after: int, file: Optional[str],
+         ack: bool) -> None:
+    """Serve ROOT as one or more stand-in devices."""
+    servers = [ThreadingHTTPServer(("127.0.0.1", port + i), make_handler(root, rate, fail_after, file, ack))
+               for i in range(instances)]
+    for s in servers:
+        threading.Thread(target=s.serve_forever, daemon=True).start()
+        click.echo(f"Serving {root} at http://127.0.0.1:{s.server_address[1]}")
+    try:
+        threading.Event().wait()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()